@@ -0,0 +1,83 @@
+/*
+ * addon.js
+ *
+ * The native addon (make addon) against the Emscripten bundle, side by side on the same operations.
+ * Writes the same JSON layout as bench/matrix.cpp, with the build in the name: matrixMul/native/256.
+ * Usage: node bench/addon.js [maxSize] [results.json]
+ */
+let fs = require('fs')
+
+let builds = {
+	native: require('../build/oh-strang.node'),
+	wasm: require('../js/oh-strang').OhStrang
+}
+
+let maxSize = parseInt(process.argv[2] || '1024')
+let json = process.argv[3]
+let minTime = 0.2
+
+let operations = {
+	matrixMul: { flops: n => 2 * n * n * n, run: (A, B) => A.matrixMul(B) },
+	transpose: { flops: n => 0, run: (A) => A.transpose() },
+	toLU: { flops: n => 2 * n * n * n / 3, run: (A, B, Matrix) => {
+		let L = new Matrix(1, 1)
+		let U = new Matrix(1, 1)
+		A.toLU(L, U)
+		L.__destroy__()
+		U.__destroy__()
+	} }
+}
+
+//Filled through setValue, which both builds have, outside of the timings
+function filled(Matrix, n, seed){
+	let A = new Matrix(n, n)
+	for(let i = 1; i <= n; i++){
+		for(let j = 1; j <= n; j++){
+			A.setValue(i, j, Math.sin((i * n + j) * seed) + (i === j ? n : 0))
+		}
+	}
+	return A
+}
+
+let results = []
+for(let n = 16; n <= maxSize; n *= 2){
+	let seconds = {}
+	Object.keys(builds).forEach(build => {
+		let Matrix = builds[build].DoubleMatrix
+		let A = filled(Matrix, n, 0.7)
+		let B = filled(Matrix, n, 1.3)
+		Object.keys(operations).forEach(name => {
+			let operation = operations[name]
+			let iterations = 0
+			let start = process.hrtime()
+			let elapsed = 0
+			do{
+				//[Value] results of the bundle live in a static of the binding, they are not destroyed
+				operation.run(A, B, Matrix)
+				iterations++
+				let time = process.hrtime(start)
+				elapsed = time[0] + time[1] / 1e9
+			}while(elapsed < minTime)
+
+			let time = elapsed / iterations
+			seconds[name + '/' + build] = time
+			results.push({
+				name: name + '/' + build + '/' + n, operation: name, size: n, iterations: iterations,
+				real_time: time * 1e9, time_unit: 'ns', gflops: operation.flops(n) / time / 1e9, bytes_per_second: 0
+			})
+		})
+		A.__destroy__()
+		B.__destroy__()
+	})
+	Object.keys(operations).forEach(name => {
+		let wasm = seconds[name + '/wasm'], native = seconds[name + '/native']
+		console.log(name + '/' + n + '\twasm ' + Math.round(wasm * 1e6) + ' us\tnative ' + Math.round(native * 1e6) + ' us\t'
+				+ (wasm / native).toFixed(1) + 'x')
+	})
+}
+
+if(json){
+	fs.writeFileSync(json, '{\n  "context": {\n    "date": "' + new Date().toISOString() + '",\n    "node": "' + process.version
+			+ '"\n  },\n  "benchmarks": [\n' + results.map(r => '    ' + JSON.stringify(r).replace(/":/g, '": ').replace(/,"/g, ', "')).join(',\n')
+			+ '\n  ]\n}\n')
+}
@@ -0,0 +1,46 @@
+/*
+ * binding.js
+ *
+ * JS binding round-trip through the Emscripten module: fill a DoubleMatrix from a Float64Array,
+ * read it back, and go through toArrayBuffer/fromArrayBuffer. Writes the same JSON layout as bench/matrix.cpp.
+ * Usage: node bench/binding.js [maxSize] [results.json]
+ */
+let DoubleMatrix = require('../js/Matrix')
+let fs = require('fs')
+
+let maxSize = parseInt(process.argv[2] || '4096')
+let json = process.argv[3]
+let minTime = 0.2
+
+let results = []
+for(let n = 4; n <= maxSize; n *= 2){
+	let values = new Float64Array(n * n).map((v, i) => Math.sin(i * 0.7))
+	let matrix = new DoubleMatrix(n, n, 0, 1)
+	let iterations = 0
+	let start = process.hrtime()
+	let elapsed = 0
+	do{
+		matrix.setValues(values)
+		let copy = DoubleMatrix.fromArrayBuffer(matrix.toArrayBuffer())
+		values[0] = copy.getTypedValues()[0]
+		copy.__destroy__()
+		iterations++
+		let time = process.hrtime(start)
+		elapsed = time[0] + time[1] / 1e9
+	}while(elapsed < minTime)
+	matrix.__destroy__()
+
+	let seconds = elapsed / iterations
+	let result = {
+		name: 'jsRoundTrip/' + n, operation: 'jsRoundTrip', size: n, iterations: iterations,
+		real_time: seconds * 1e9, time_unit: 'ns', gflops: 0, bytes_per_second: 4 * n * n * 8 / seconds
+	}
+	results.push(result)
+	console.log(result.name + '\t' + Math.round(result.real_time) + ' ns\t' + (result.bytes_per_second / 1e9).toFixed(3) + ' GB/s')
+}
+
+if(json){
+	fs.writeFileSync(json, '{\n  "context": {\n    "date": "' + new Date().toISOString() + '",\n    "node": "' + process.version
+			+ '"\n  },\n  "benchmarks": [\n' + results.map(r => '    ' + JSON.stringify(r).replace(/":/g, '": ').replace(/,"/g, ', "')).join(',\n')
+			+ '\n  ]\n}\n')
+}
@@ -0,0 +1,355 @@
+/*
+ * matrix.cpp
+ *
+ * Performance suite for the MatrixCRTP operations, swept over square sizes from 4 to 4096.
+ * Each operation and size is repeated until --min-time seconds have elapsed and reported with its
+ * mean time, GFLOP/s and bytes/s. Larger sizes of an operation are skipped once a single run takes
+ * longer than --max-time seconds (toLU and det are far from O(n^3) friendly at 4096).
+ *
+ * Usage: matrix [--min-size=4] [--max-size=4096] [--min-time=0.2] [--max-time=2] [--filter=name]
+ *               [--json=results.json] [--baseline=previous.json] [--tolerance=0.1]
+ *
+ * --json writes the results in the Google Benchmark layout, one benchmark per line, so two runs can be
+ * diffed. --baseline compares this run with a previous JSON file and exits with 1 when an operation
+ * got slower by more than --tolerance.
+ */
+#include "../binding/cppToJs.cpp"
+#include "../src/vector.cpp"
+#include "../src/strassen.cpp"
+#include "../src/comparison.cpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+
+using namespace std;
+
+typedef chrono::steady_clock Clock;
+
+struct Options {
+	size_t minSize = 4;
+	size_t maxSize = 4096;
+	double minTime = 0.2;
+	double maxTime = 2;
+	double tolerance = 0.1;
+	string filter;
+	string json;
+	string baseline;
+};
+
+struct Result {
+	string name;
+	string operation;
+	size_t size;
+	size_t iterations;
+	double seconds;			//mean time of an iteration
+	double flops;			//floating point operations of an iteration
+	double bytes;			//bytes read and written by an iteration
+
+	double gflops() const {
+		return flops / seconds / 1e9;
+	}
+
+	double bytesPerSecond() const {
+		return bytes / seconds;
+	}
+};
+
+struct Operation {
+	string name;
+	//nominal counts of the operation on n x n matrices, independent of the implementation
+	function<double(double)> flops;
+	function<double(double)> bytes;
+	//prepares the operands and returns the timed function
+	function<function<void()>(size_t)> setup;
+};
+
+//Keeps the results alive so the timed calls are not optimized away
+volatile double sink;
+
+Matrix<double> randomMatrix(size_t n, double seed) {
+	Matrix<double> A(n, n, 0, 1);
+	double* values = A.getValues();
+	for (size_t i = 0; i < n * n; i++) {
+		values[i] = sin(i * 0.7 + seed) + (i % (n + 1) == 0 ? n : 0); //diagonally dominant, no pivoting
+	}
+	return A;
+}
+
+vector<Operation> operations() {
+	const double d = sizeof(double);
+	vector<Operation> all;
+
+	all.push_back({ "multiply", [](double n) { return 2 * n * n * n; },
+			[=](double n) { return 3 * n * n * d; }, [](size_t n) {
+		auto A = make_shared<Matrix<double>>(randomMatrix(n, 1));
+		auto B = make_shared<Matrix<double>>(randomMatrix(n, 2));
+		return function<void()>([=] { sink = *(*A * *B).begin(); });
+	} });
+
+	//Strassen-Winograd down to the tuned cutoff; the nominal flops are the classical ones so the rates compare
+	all.push_back({ "strassen", [](double n) { return 2 * n * n * n; },
+			[=](double n) { return 3 * n * n * d; }, [](size_t n) {
+		auto A = make_shared<Matrix<double>>(randomMatrix(n, 1));
+		auto B = make_shared<Matrix<double>>(randomMatrix(n, 2));
+		auto workspace = make_shared<StrassenWorkspace<double>>();
+		return function<void()>([=] { sink = *strassenMultiply(*A, *B, *workspace).begin(); });
+	} });
+
+	all.push_back({ "add", [](double n) { return n * n; },
+			[=](double n) { return 3 * n * n * d; }, [](size_t n) {
+		auto A = make_shared<Matrix<double>>(randomMatrix(n, 1));
+		auto B = make_shared<Matrix<double>>(randomMatrix(n, 2));
+		return function<void()>([=] { sink = *(*A + *B).begin(); });
+	} });
+
+	all.push_back({ "subtract", [](double n) { return n * n; },
+			[=](double n) { return 3 * n * n * d; }, [](size_t n) {
+		auto A = make_shared<Matrix<double>>(randomMatrix(n, 1));
+		auto B = make_shared<Matrix<double>>(randomMatrix(n, 2));
+		return function<void()>([=] { sink = *(*A - *B).begin(); });
+	} });
+
+	all.push_back({ "transpose", [](double) { return 0.0; },
+			[=](double n) { return 2 * n * n * d; }, [](size_t n) {
+		auto A = make_shared<Matrix<double>>(randomMatrix(n, 1));
+		return function<void()>([=] { sink = *A->transpose().begin(); });
+	} });
+
+	//The same on padded values, whose rows start on cache lines whatever the width
+	all.push_back({ "multiply-padded", [](double n) { return 2 * n * n * n; },
+			[=](double n) { return 3 * n * n * d; }, [](size_t n) {
+		typedef Matrix<double, layout::Padded<layout::RowMajor>> PaddedMatrix;
+		auto A = make_shared<PaddedMatrix>(randomMatrix(n, 1));
+		auto B = make_shared<PaddedMatrix>(randomMatrix(n, 2));
+		return function<void()>([=] { sink = *(*A * *B).begin(); });
+	} });
+
+	all.push_back({ "transpose-padded", [](double) { return 0.0; },
+			[=](double n) { return 2 * n * n * d; }, [](size_t n) {
+		typedef Matrix<double, layout::Padded<layout::RowMajor>> PaddedMatrix;
+		auto A = make_shared<PaddedMatrix>(randomMatrix(n, 1));
+		return function<void()>([=] { sink = *A->transpose().begin(); });
+	} });
+
+	all.push_back({ "concat", [](double) { return 0.0; },
+			[=](double n) { return 4 * n * n * d; }, [](size_t n) {
+		auto A = make_shared<Matrix<double>>(randomMatrix(n, 1));
+		auto B = make_shared<Matrix<double>>(randomMatrix(n, 2));
+		return function<void()>([=] { sink = *A->concat(*B).begin(); });
+	} });
+
+	all.push_back({ "split", [](double) { return 0.0; },
+			[=](double n) { return 2 * n * n * d; }, [](size_t n) {
+		auto A = make_shared<Matrix<double>>(randomMatrix(n, 1));
+		return function<void()>([=] {
+			Matrix<double> left, right;
+			A->split(n / 2, left, right);
+			sink = *right.begin();
+		});
+	} });
+
+	all.push_back({ "toLU", [](double n) { return 2 * n * n * n / 3; },
+			[=](double n) { return 3 * n * n * d; }, [](size_t n) {
+		auto A = make_shared<Matrix<double>>(randomMatrix(n, 1));
+		return function<void()>([=] {
+			Matrix<double> L, U;
+			sink = A->toLU(L, U);
+		});
+	} });
+
+	all.push_back({ "det", [](double n) { return 2 * n * n * n / 3; },
+			[=](double n) { return n * n * d; }, [](size_t n) {
+		auto A = make_shared<Matrix<double>>(randomMatrix(n, 1));
+		return function<void()>([=] { sink = A->det(); });
+	} });
+
+	all.push_back({ "rref", [](double n) { return 2 * n * n * n; },
+			[=](double n) { return 3 * n * n * d; }, [](size_t n) {
+		auto A = make_shared<Matrix<double>>(randomMatrix(n, 1));
+		return function<void()>([=] { sink = A->echelon().rank; });
+	} });
+
+	all.push_back({ "gram", [](double n) { return n * n * (n + 1); },
+			[=](double n) { return 2 * n * n * d; }, [](size_t n) {
+		auto A = make_shared<Matrix<double>>(randomMatrix(n, 1));
+		return function<void()>([=] { sink = *A->gram().begin(); });
+	} });
+
+	all.push_back({ "gemv", [](double n) { return 2 * n * n; },
+			[=](double n) { return (n * n + 2 * n) * d; }, [](size_t n) {
+		auto A = make_shared<Matrix<double>>(randomMatrix(n, 1));
+		auto x = make_shared<Vector<double>>(n, 1.0);
+		return function<void()>([=] { sink = (*A * *x).getValue(1); });
+	} });
+
+	all.push_back({ "swapRows", [](double) { return 0.0; },
+			[=](double n) { return 2 * n * n * d; }, [](size_t n) {
+		auto A = make_shared<Matrix<double>>(randomMatrix(n, 1));
+		return function<void()>([=] { sink = *A->swapRows(1, n).begin(); });
+	} });
+
+	//Full scans, the copies being equal
+	all.push_back({ "equal", [](double n) { return n * n; },
+			[=](double n) { return 2 * n * n * d; }, [](size_t n) {
+		auto A = make_shared<Matrix<double>>(randomMatrix(n, 1));
+		auto B = make_shared<Matrix<double>>(randomMatrix(n, 1));
+		return function<void()>([=] { sink = *A == *B; });
+	} });
+
+	all.push_back({ "deviation", [](double n) { return 5 * n * n; },
+			[=](double n) { return 2 * n * n * d; }, [](size_t n) {
+		auto A = make_shared<Matrix<double>>(randomMatrix(n, 1));
+		auto B = make_shared<Matrix<double>>(randomMatrix(n, 1));
+		return function<void()>([=] { sink = deviation(*A, *B, Tolerance<double>(0, 1e-12, 4)).maxDeviation; });
+	} });
+
+	//The C++ side of a JS round-trip: Matrix.fromArrayBuffer(matrix.toArrayBuffer()), see js/Matrix.js.
+	//bench/binding.js measures the whole round-trip through the Emscripten module.
+	all.push_back({ "bindingRoundTrip", [](double) { return 0.0; },
+			[=](double n) { return 2 * n * n * d; }, [](size_t n) {
+		auto A = make_shared<DoubleMatrix>(n, n, 0, 1, randomMatrix(n, 1).getValues());
+		return function<void()>([=] {
+			const void* data = A->toBinary(false);
+			DoubleMatrix B = DoubleMatrix::fromBinary(data, A->getBinarySize());
+			sink = B.getData()[0];
+		});
+	} });
+
+	return all;
+}
+
+Result measure(const Operation& operation, size_t n, const Options& options) {
+	function<void()> fn = operation.setup(n);
+	Result result = { operation.name + "/" + to_string(n), operation.name, n, 0, 0,
+			operation.flops(n), operation.bytes(n) };
+	double elapsed = 0;
+	auto start = Clock::now();
+	do {
+		fn();
+		result.iterations++;
+		elapsed = chrono::duration<double>(Clock::now() - start).count();
+	} while (elapsed < options.minTime);
+	result.seconds = elapsed / result.iterations;
+	return result;
+}
+
+void writeJson(ostream& out, const vector<Result>& results) {
+	char date[32];
+	time_t now = time(0);
+	strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", localtime(&now));
+	out << "{\n"
+			<< "  \"context\": {\n"
+			<< "    \"date\": \"" << date << "\",\n"
+			<< "    \"num_threads\": " << parallel::hardwareThreads() << ",\n"
+			<< "    \"compiler\": \"" << __VERSION__ << "\"\n"
+			<< "  },\n"
+			<< "  \"benchmarks\": [\n";
+	out << setprecision(6);
+	for (size_t i = 0; i < results.size(); i++) {
+		const Result& r = results[i];
+		out << "    {\"name\": \"" << r.name << "\", \"operation\": \"" << r.operation << "\", \"size\": " << r.size
+				<< ", \"iterations\": " << r.iterations << ", \"real_time\": " << r.seconds * 1e9
+				<< ", \"time_unit\": \"ns\", \"gflops\": " << r.gflops()
+				<< ", \"bytes_per_second\": " << r.bytesPerSecond() << "}"
+				<< (i + 1 < results.size() ? "," : "") << "\n";
+	}
+	out << "  ]\n}\n";
+}
+
+//Reads back the name and real_time of each benchmark line written by writeJson
+map<string, double> readJson(istream& in) {
+	map<string, double> times;
+	string line;
+	while (getline(in, line)) {
+		size_t name = line.find("\"name\": \"");
+		size_t time = line.find("\"real_time\": ");
+		if (name == string::npos || time == string::npos) {
+			continue;
+		}
+		name += 9;
+		times[line.substr(name, line.find('"', name) - name)] = atof(line.c_str() + time + 13);
+	}
+	return times;
+}
+
+bool option(const char* arg, const char* name, string& value) {
+	size_t length = strlen(name);
+	if (strncmp(arg, name, length) != 0 || arg[length] != '=') {
+		return false;
+	}
+	value = arg + length + 1;
+	return true;
+}
+
+int main(int argc, char * argv[]) {
+	Options options;
+	for (int i = 1; i < argc; i++) {
+		string value;
+		if (option(argv[i], "--min-size", value)) {
+			options.minSize = atoi(value.c_str());
+		} else if (option(argv[i], "--max-size", value)) {
+			options.maxSize = atoi(value.c_str());
+		} else if (option(argv[i], "--min-time", value)) {
+			options.minTime = atof(value.c_str());
+		} else if (option(argv[i], "--max-time", value)) {
+			options.maxTime = atof(value.c_str());
+		} else if (option(argv[i], "--tolerance", value)) {
+			options.tolerance = atof(value.c_str());
+		} else if (!option(argv[i], "--filter", options.filter) && !option(argv[i], "--json", options.json)
+				&& !option(argv[i], "--baseline", options.baseline)) {
+			cerr << "Unknown option " << argv[i] << endl;
+			return 2;
+		}
+	}
+
+	vector<Result> results;
+	cout << left << setw(24) << "Benchmark" << right << setw(14) << "Time (ns)" << setw(12) << "Iterations"
+			<< setw(12) << "GFLOP/s" << setw(14) << "GB/s" << endl;
+	for (const Operation& operation : operations()) {
+		if (operation.name.find(options.filter) == string::npos) {
+			continue;
+		}
+		for (size_t n = options.minSize; n <= options.maxSize; n *= 2) {
+			Result result = measure(operation, n, options);
+			results.push_back(result);
+			cout << left << setw(24) << result.name << right << fixed << setprecision(0) << setw(14)
+					<< result.seconds * 1e9 << setw(12) << result.iterations << setprecision(3) << setw(12)
+					<< result.gflops() << setw(14) << result.bytesPerSecond() / 1e9 << endl;
+			if (result.seconds > options.maxTime) {
+				cout << operation.name << ": skipping the sizes above " << n << endl;
+				break;
+			}
+		}
+	}
+
+	if (!options.json.empty()) {
+		ofstream out(options.json);
+		writeJson(out, results);
+	}
+
+	int status = 0;
+	if (!options.baseline.empty()) {
+		ifstream in(options.baseline);
+		map<string, double> baseline = readJson(in);
+		for (const Result& result : results) {
+			auto previous = baseline.find(result.name);
+			if (previous == baseline.end()) {
+				continue;
+			}
+			double ratio = result.seconds * 1e9 / previous->second;
+			if (ratio > 1 + options.tolerance) {
+				cout << "Regression " << result.name << ": " << setprecision(2) << ratio << "x slower" << endl;
+				status = 1;
+			}
+		}
+	}
+	return status;
+}
@@ -0,0 +1,75 @@
+/*
+ * text.cpp
+ *
+ * Throughput of the text import/export in MB/s.
+ * Usage: text [rows] [columns]
+ */
+#include "../src/text.cpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+
+using namespace std;
+
+typedef chrono::steady_clock Clock;
+
+template<typename F>
+double bestSeconds(int repeat, F fn) {
+	double best = 1e300;
+	for (int i = 0; i < repeat; i++) {
+		auto start = Clock::now();
+		fn();
+		best = min(best, chrono::duration<double>(Clock::now() - start).count());
+	}
+	return best;
+}
+
+void report(const char* name, size_t bytes, double seconds) {
+	cout << name << ": " << bytes / seconds / 1e6 << " MB/s (" << bytes << " bytes in " << seconds << "s)" << endl;
+}
+
+int main(int argc, char * argv[]) {
+	size_t rows = argc > 1 ? atoi(argv[1]) : 2000;
+	size_t columns = argc > 2 ? atoi(argv[2]) : 500;
+
+	Matrix<double> A(rows, columns, 0, 1);
+	double* values = A.getValues();
+	for (size_t i = 0; i < rows * columns; i++) {
+		values[i] = sin(i) * pow(10.0, int(i % 9) - 4);
+	}
+
+	string csv;
+	double seconds = bestSeconds(3, [&] {
+		ostringstream out;
+		writeDelimited(out, A);
+		csv = out.str();
+	});
+	report("CSV format", csv.size(), seconds);
+
+	seconds = bestSeconds(3, [&] {
+		Matrix<double> B = readDelimited<Matrix<double>>(csv.data(), csv.size());
+	});
+	report("CSV parse", csv.size(), seconds);
+
+	string market;
+	seconds = bestSeconds(3, [&] {
+		ostringstream out;
+		writeMatrixMarket(out, A);
+		market = out.str();
+	});
+	report("MatrixMarket format", market.size(), seconds);
+
+	seconds = bestSeconds(3, [&] {
+		Matrix<double> B = readMatrixMarket<Matrix<double>>(market.data(), market.size());
+	});
+	report("MatrixMarket parse", market.size(), seconds);
+
+	string matrix;
+	seconds = bestSeconds(3, [&] {
+		matrix = A.toString();
+	});
+	report("toString", matrix.size(), seconds);
+
+	return 0;
+}
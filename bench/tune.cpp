@@ -0,0 +1,48 @@
+/*
+ * tune.cpp
+ *
+ * Tuning mode: times the kernel parameter candidates for Matrix<float> and Matrix<double> on this machine
+ * and writes the best ones to the tuning file loaded at startup (see src/tuning.cpp).
+ * Usage: tune [file] [size]
+ */
+#include "../src/autotune.cpp"
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+
+using namespace std;
+
+void printCurrent(const char* type, const tuning::KernelParameters& parameters) {
+	cout << "Current " << type << " parameters:" << endl;
+	tuning::writeConfig(cout, type, parameters);
+}
+
+int main(int argc, char * argv[]) {
+	string path = argc > 1 ? argv[1] : tuning::defaultConfigPath();
+	tuning::TuneOptions options = tuning::defaultTuneOptions();
+	if (argc > 2) {
+		options.size = atoi(argv[2]);
+	}
+
+	tuning::CacheSizes caches = tuning::detectCaches();
+	cout << "Caches: L1 " << caches.l1 << ", L2 " << caches.l2 << ", L3 " << caches.l3 << " bytes" << endl;
+	printCurrent("float", tuning::parameters<float>());
+	printCurrent("double", tuning::parameters<double>());
+
+	tuning::KernelParameters single = tuning::autotune<float>(options, &cout);
+	tuning::KernelParameters precision = tuning::autotune<double>(options, &cout);
+
+	ofstream out(path.c_str());
+	out << "# Kernel parameters tuned by bench/tune.cpp\n";
+	tuning::writeConfig(out, "float", single);
+	tuning::writeConfig(out, "double", precision);
+	if (!out) {
+		cerr << "Cannot write " << path << endl;
+		return 1;
+	}
+	cout << "Written to " << path << ":" << endl;
+	tuning::writeConfig(cout, "float", single);
+	tuning::writeConfig(cout, "double", precision);
+	return 0;
+}
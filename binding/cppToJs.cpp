@@ -1,39 +1,214 @@
 #include "../src/matrix.cpp"
+#include "../src/serialization.cpp"
+#include "../src/batched.cpp"
+#include "../src/solvers.cpp"
+#include "../src/instrumentation.cpp"
+
+#if defined(__EMSCRIPTEN__) || defined(__GLIBC__)
+#include <malloc.h>
+#endif
 
 /*
  * 'Wrappers' to interface JS and the matrix library.
  */
 
 
-/* JavaScript numbers are always stored as double precision floating point numbers, following the international IEEE 754 standard */
-class DoubleMatrix : public MatrixCRTP<double, DoubleMatrix> {
-	using MatrixCRTP<double, DoubleMatrix>::MatrixCRTP;
-
+/*
+ * Methods shared by the bound matrices, C being the bound class itself.
+ */
+template<typename T, class C>
+class BoundMatrix : public MatrixCRTP<T, C> {
 	public:
+		using MatrixCRTP<T, C>::MatrixCRTP;
 
-		static DoubleMatrix getIdentity(const std::size_t& rows, const std::size_t& columns) {
-			return identity( rows, columns, 0, 1 );
+		static C getIdentity(const std::size_t& rows, const std::size_t& columns) {
+			return C::identity( rows, columns, 0, 1 );
 		}
 
-		DoubleMatrix(): MatrixCRTP<double, DoubleMatrix>(0, 0, 0, 1){}
+		BoundMatrix(): MatrixCRTP<T, C>(0, 0, 0, 1){}
+
+		BoundMatrix(const std::size_t& rows, const std::size_t& columns) : MatrixCRTP<T, C>(rows, columns, 0, 1){}
 
-		DoubleMatrix(const std::size_t& rows, const std::size_t& columns) : MatrixCRTP<double, DoubleMatrix>(rows, columns, 0, 1){}
+		BoundMatrix(const std::size_t& rows, const std::size_t& columns, const T& fillValue) : MatrixCRTP<T, C>(rows, columns, 0, 1, fillValue){}
 
-		DoubleMatrix(const std::size_t& rows, const std::size_t& columns, const double& fillValue) : MatrixCRTP<double, DoubleMatrix>(rows, columns, 0, 1, fillValue){}
+		BoundMatrix(std::size_t rows, std::size_t columns, T* _values) : MatrixCRTP<T, C>(rows, columns, 0, 1, _values) {
+			OH_STRANG_MEASURE(BINDING_COPY, 0, rows * columns * sizeof(T), rows * columns * sizeof(T));
+		}
 
-		DoubleMatrix(std::size_t rows, std::size_t columns, double* _values) : MatrixCRTP<double, DoubleMatrix>(rows, columns, 0, 1, _values) {}
+		C scalarMul(T scalar) { return self() * scalar; }
+		C matrixMul(const C& matrix) { return self() * matrix; }
 
-		DoubleMatrix scalarMul(double scalar) { return DoubleMatrix( m, n, (*this * scalar).getValues() ); }
-		DoubleMatrix matrixMul(DoubleMatrix matrix) { return DoubleMatrix( m, matrix.getColumnsCount(), (*this * matrix).getValues() ); }
+		bool equal(const C& matrix){ return self() == matrix; }
 
-		bool equal(DoubleMatrix matrix){ return *this == matrix; }
+		//X = this^-1 * B, from the factors cached by cacheFactorizations(true) while the matrix is unchanged
+		bool solve(const C& B, C& X){ return ::solve(self(), B, X); }
 
+		//The text stays valid until the next call on this matrix
 		const char* asString(){
-			return toString().c_str();
+			return this->toString(textBuffer, ::text::MatrixFormat()).c_str();
+		}
+
+		//With precision significant digits (0 for the shortest round trip), showing only edgeItems rows and columns
+		//at each end of a matrix of more than 1000 values (0 shows them all)
+		const char* asFormattedString(int precision, std::size_t edgeItems){
+			return this->toString(textBuffer, ::text::MatrixFormat(precision, edgeItems)).c_str();
+		}
+
+		//Start of the row-major values, for typed array views from JS: pinned, so that the views stay on them.
+		//Reading does not drop the cached factors, writes through a view are followed by bumpVersion()
+		T* getData(){
+			return this->getPinnedValues();
+		}
+
+		//Start of the row-major values to read at once, not pinned so that the copies of the matrix keep sharing them:
+		//valid until the matrix is written, copied or assigned
+		const T* getConstData() const {
+			return this->getValues();
+		}
+
+		//Binary serialization, the bytes stay valid until the next call to toBinary() on this matrix
+		const void* toBinary(bool checksum){
+			OH_STRANG_MEASURE(BINDING_COPY, 0, this->getRowsCount() * this->getColumnsCount() * sizeof(T),
+					this->getRowsCount() * this->getColumnsCount() * sizeof(T));
+			binaryBuffer = ::toBinary(*this, checksum);
+			return binaryBuffer.data();
 		}
 
+		std::size_t getBinarySize(){
+			return binaryBuffer.size();
+		}
+
+		static C fromBinary(const void* data, std::size_t size){
+			OH_STRANG_MEASURE(BINDING_COPY, 0, size, size);
+			return ::fromBinary<C>(static_cast<const char*>(data), size);
+		}
+
+	private:
+		std::string textBuffer;
+		std::string binaryBuffer;
+
+		C& self(){
+			return *static_cast<C*>(this);
+		}
 };
 
 
+/* JavaScript numbers are always stored as double precision floating point numbers, following the international IEEE 754 standard */
+class DoubleMatrix : public BoundMatrix<double, DoubleMatrix> {
+	public:
+		using BoundMatrix<double, DoubleMatrix>::BoundMatrix;
+
+		DoubleMatrix(): BoundMatrix<double, DoubleMatrix>(){}
+};
+
+
+/* Single precision matrices, backed by a Float32Array on the JS side */
+class FloatMatrix : public BoundMatrix<float, FloatMatrix> {
+	public:
+		using BoundMatrix<float, FloatMatrix>::BoundMatrix;
+
+		FloatMatrix(): BoundMatrix<float, FloatMatrix>(){}
+};
+
 
+/* A batch of small matrices of the same size stored in a single buffer, filled from JS through a Float64Array */
+class DoubleBatch {
+	private:
+		std::vector<double> values;
+		std::vector<std::int32_t> pivots;
+		Batch<double> batch;
 
+	public:
+		DoubleBatch(std::size_t count, std::size_t rows, std::size_t columns, bool interleaved) : values(count * rows * columns) {
+			batch = interleaved ? Batch<double>::interleaved(values.data(), count, rows, columns) :
+					Batch<double>::contiguous(values.data(), count, rows, columns);
+		}
+
+		std::size_t getCount(){ return batch.count; }
+		std::size_t getRowsCount(){ return batch.rows; }
+		std::size_t getColumnsCount(){ return batch.columns; }
+		bool isInterleaved(){ return batch.isInterleaved(); }
+
+		double* getData(){ return values.data(); }
+
+		//C = this * B
+		void multiply(DoubleBatch& B, DoubleBatch& C){ batchMultiply(batch, B.batch, C.batch); }
+
+		//In place LU decomposition, returns the number of singular matrices
+		std::size_t lu(){
+			pivots.resize(batch.count * batch.rows);
+			return batchLU(batch, pivots.data());
+		}
+
+		//Overwrites B with the solutions, lu() must have been called first
+		void solve(DoubleBatch& B){
+			if (pivots.size() != batch.count * batch.rows) {
+				throw std::domain_error("The batch must be factored with lu() before solving.");
+			}
+			batchSolve(batch, pivots.data(), B.batch);
+		}
+
+		//determinants is a batch of 1 x 1 matrices
+		void determinant(DoubleBatch& determinants){
+			if (determinants.values.size() != batch.count) {
+				throw std::domain_error("Expected a batch of count 1 x 1 matrices.");
+			}
+			batchDeterminant(batch, determinants.getData());
+		}
+
+		//Returns the number of singular matrices
+		std::size_t inverse(DoubleBatch& inverses){ return batchInverse(batch, inverses.batch); }
+
+	private:
+		DoubleBatch(const DoubleBatch&);
+		DoubleBatch& operator=(const DoubleBatch&);
+};
+
+
+/* Instrumentation counters, see src/instrumentation.cpp. The returned strings stay valid until the next call. */
+class Instrumentation {
+	public:
+		static bool isEnabled(){ return instrumentation::enabled; }
+
+		//JSON object of counters keyed by operation name
+		static const char* snapshot(){
+			text() = instrumentation::snapshot().toJson();
+			return text().c_str();
+		}
+
+		static void reset(){ instrumentation::reset(); }
+		static void startTrace(){ instrumentation::startTrace(); }
+		static void stopTrace(){ instrumentation::stopTrace(); }
+
+		//Chrome trace event JSON of the calls recorded since startTrace()
+		static const char* chromeTrace(){
+			std::ostringstream out;
+			instrumentation::writeChromeTrace(out);
+			text() = out.str();
+			return text().c_str();
+		}
+
+	private:
+		static std::string& text(){
+			static std::string buffer;
+			return buffer;
+		}
+};
+
+
+/* Heap statistics for js/Matrix.js */
+class Memory {
+	public:
+		//Bytes in use from malloc, which the matrices and every temporary allocate from, 0 when the allocator does not tell
+		static std::size_t allocatedBytes(){
+#if defined(__EMSCRIPTEN__)
+			return mallinfo().uordblks;
+#elif defined(__GLIBC__) && __GLIBC_PREREQ(2, 33)
+			return mallinfo2().uordblks;
+#elif defined(__GLIBC__)
+			return mallinfo().uordblks;
+#else
+			return 0;
+#endif
+		}
+};
@@ -0,0 +1,672 @@
+#define NAPI_VERSION 8
+#include <node_api.h>
+
+#include <memory>
+#include <string>
+#include <stdexcept>
+
+#include "cppToJs.cpp"
+
+/*
+ * napi.cpp
+ *
+ * Native Node.js addon with the interface of matrix.idl, built by make addon into build/oh-strang.node
+ * and loaded by js/Matrix.js in place of the Emscripten bundle when it exists.
+ *
+ * Differences with the Emscripten classes:
+ * - view() is a typed array over the values themselves, not over the heap. It stays valid as long as it is
+ *   referenced, even after the matrix is collected, but is detached when the values are replaced
+ *   (toLU, solve and split assign their outputs) or freed by __destroy__().
+ * - toBinary() returns an ArrayBuffer and fromBinary() takes one, or a typed array or a Buffer.
+ * - getValue and setValue check their indices and throw a RangeError.
+ * - [Value] results are new objects, not a static of the binding overwritten by the next call.
+ * - C++ exceptions become JS errors instead of aborting.
+ * Garbage collection frees the matrices; __destroy__() only frees them earlier.
+ */
+
+namespace napi {
+
+struct Error : std::runtime_error {
+	explicit Error(const std::string& message) : std::runtime_error(message) {}
+};
+
+inline void check(napi_status status) {
+	if (status != napi_ok) {
+		throw Error("N-API call failed");
+	}
+}
+
+//Runs a callback body, turning C++ exceptions into pending JS errors
+template<typename F>
+napi_value guard(napi_env env, F body) {
+	try {
+		return body();
+	} catch (const std::out_of_range& e) {
+		napi_throw_range_error(env, 0, e.what());
+	} catch (const std::exception& e) {
+		napi_throw_error(env, 0, e.what());
+	}
+	return 0;
+}
+
+//The arguments and the receiver of a callback
+struct Arguments {
+	napi_env env;
+	napi_value self;
+	napi_value values[4];
+	std::size_t count;
+	void* data;
+
+	Arguments(napi_env env, napi_callback_info info) : env(env), count(4) {
+		check(napi_get_cb_info(env, info, &count, values, &self, &data));
+	}
+
+	napi_value operator[](std::size_t i) const {
+		if (i >= count) {
+			throw Error("Missing argument");
+		}
+		return values[i];
+	}
+
+	double number(std::size_t i) const {
+		double value;
+		if (napi_get_value_double(env, (*this)[i], &value) != napi_ok) {
+			throw Error("Expected a number");
+		}
+		return value;
+	}
+
+	std::size_t size(std::size_t i) const {
+		double value = number(i);
+		if (!(value >= 0)) {
+			throw std::out_of_range("Expected a size");
+		}
+		return std::size_t(value);
+	}
+
+	bool boolean(std::size_t i) const {
+		bool value = false;
+		napi_value coerced;
+		if (i < count && napi_coerce_to_bool(env, values[i], &coerced) == napi_ok) {
+			check(napi_get_value_bool(env, coerced, &value));
+		}
+		return value;
+	}
+};
+
+inline napi_value number(napi_env env, double value) {
+	napi_value result;
+	check(napi_create_double(env, value, &result));
+	return result;
+}
+
+inline napi_value boolean(napi_env env, bool value) {
+	napi_value result;
+	check(napi_get_boolean(env, value, &result));
+	return result;
+}
+
+inline napi_value string(napi_env env, const std::string& value) {
+	napi_value result;
+	check(napi_create_string_utf8(env, value.data(), value.size(), &result));
+	return result;
+}
+
+inline napi_value undefined(napi_env env) {
+	napi_value result;
+	check(napi_get_undefined(env, &result));
+	return result;
+}
+
+//Bytes of an ArrayBuffer, a typed array or a Buffer
+inline std::pair<const char*, std::size_t> bytes(napi_env env, napi_value value) {
+	void* data = 0;
+	std::size_t size = 0;
+	bool is;
+	if (napi_is_arraybuffer(env, value, &is) == napi_ok && is) {
+		check(napi_get_arraybuffer_info(env, value, &data, &size));
+	} else if (napi_is_typedarray(env, value, &is) == napi_ok && is) {
+		napi_typedarray_type type;
+		std::size_t length, offset;
+		napi_value buffer;
+		check(napi_get_typedarray_info(env, value, &type, &length, &data, &buffer, &offset));
+		size = length * (type == napi_float64_array ? 8 : type == napi_float32_array ? 4 : 1);
+	} else if (napi_is_buffer(env, value, &is) == napi_ok && is) {
+		check(napi_get_buffer_info(env, value, &data, &size));
+	} else {
+		throw Error("Expected an ArrayBuffer, a typed array or a Buffer");
+	}
+	return std::make_pair(static_cast<const char*>(data), size);
+}
+
+template<typename T> struct ArrayType;
+template<> struct ArrayType<double> { static const napi_typedarray_type value = napi_float64_array; };
+template<> struct ArrayType<float> { static const napi_typedarray_type value = napi_float32_array; };
+
+/*
+ * A typed array over native values kept alive by owner, through the finalizer of its external ArrayBuffer.
+ * Only one ArrayBuffer may exist at a time over the same values, see Wrapped::view.
+ */
+template<typename T, class Owner>
+napi_value externalArray(napi_env env, const std::shared_ptr<Owner>& owner, T* data, std::size_t length,
+		napi_value* arrayBuffer) {
+	std::shared_ptr<Owner>* hold = new std::shared_ptr<Owner>(owner);
+	napi_status status = napi_create_external_arraybuffer(env, data, length * sizeof(T),
+			[](napi_env, void*, void* hint) {
+				delete static_cast<std::shared_ptr<Owner>*>(hint);
+			}, hold, arrayBuffer);
+	if (status != napi_ok) {
+		delete hold;
+		throw Error("External memory is not supported by this runtime");
+	}
+	napi_value array;
+	check(napi_create_typedarray(env, ArrayType<T>::value, length, *arrayBuffer, 0, &array));
+	return array;
+}
+
+/*
+ * Native state of a JS object of class C: the value shared with the external views on it,
+ * and the ArrayBuffer of the current view, detached once the values move.
+ */
+template<class C>
+struct Wrapped {
+	std::shared_ptr<C> value;
+	napi_ref buffer;
+	const void* bufferData;
+
+	explicit Wrapped(C* value) : value(value), buffer(0), bufferData(0) {}
+
+	void detach(napi_env env) {
+		if (buffer) {
+			napi_value arrayBuffer;
+			if (napi_get_reference_value(env, buffer, &arrayBuffer) == napi_ok && arrayBuffer) {
+				napi_detach_arraybuffer(env, arrayBuffer);
+			}
+			napi_delete_reference(env, buffer);
+			buffer = 0;
+			bufferData = 0;
+		}
+	}
+
+	template<typename T>
+	napi_value view(napi_env env, T* data, std::size_t length) {
+		napi_value arrayBuffer, array;
+		if (buffer && bufferData == data) {
+			check(napi_get_reference_value(env, buffer, &arrayBuffer));
+			check(napi_create_typedarray(env, ArrayType<T>::value, length, arrayBuffer, 0, &array));
+			return array;
+		}
+		detach(env);
+		array = externalArray(env, value, data, length, &arrayBuffer);
+		check(napi_create_reference(env, arrayBuffer, 1, &buffer));
+		bufferData = data;
+		return array;
+	}
+};
+
+//Slots of the constructors in the instance data of the addon
+enum { DOUBLE_MATRIX, FLOAT_MATRIX, DOUBLE_BATCH, CLASSES_COUNT };
+
+//Constructor slot and type tag of each class, the tags telling the classes apart when unwrapping arguments
+template<class C> struct Class;
+
+template<> struct Class<DoubleMatrix> {
+	enum { slot = DOUBLE_MATRIX };
+	static const napi_type_tag* tag() {
+		static const napi_type_tag value = { 0x6f682d737472616eULL, 0x0000000000000001ULL };
+		return &value;
+	}
+};
+
+template<> struct Class<FloatMatrix> {
+	enum { slot = FLOAT_MATRIX };
+	static const napi_type_tag* tag() {
+		static const napi_type_tag value = { 0x6f682d737472616eULL, 0x0000000000000002ULL };
+		return &value;
+	}
+};
+
+template<> struct Class<DoubleBatch> {
+	enum { slot = DOUBLE_BATCH };
+	static const napi_type_tag* tag() {
+		static const napi_type_tag value = { 0x6f682d737472616eULL, 0x0000000000000003ULL };
+		return &value;
+	}
+};
+
+//The constructors live in the instance data, as workers load the addon in environments of their own
+template<class C>
+napi_value constructor(napi_env env) {
+	napi_ref* constructors = 0;
+	check(napi_get_instance_data(env, reinterpret_cast<void**>(&constructors)));
+	napi_value result;
+	check(napi_get_reference_value(env, constructors[Class<C>::slot], &result));
+	return result;
+}
+
+template<class C>
+Wrapped<C>& unwrap(napi_env env, napi_value object) {
+	bool tagged = false;
+	void* wrapped = 0;
+	if (napi_check_object_type_tag(env, object, Class<C>::tag(), &tagged) != napi_ok || !tagged
+			|| napi_unwrap(env, object, &wrapped) != napi_ok) {
+		throw Error("Wrong type of argument");
+	}
+	return *static_cast<Wrapped<C>*>(wrapped);
+}
+
+template<class C>
+C& unwrapValue(napi_env env, napi_value object) {
+	Wrapped<C>& wrapped = unwrap<C>(env, object);
+	if (!wrapped.value) {
+		throw Error("The object was destroyed");
+	}
+	return *wrapped.value;
+}
+
+//Hands wrapped over to the finalizer of object, wrapped is left to its owner when that fails
+template<class C>
+void wrap(napi_env env, napi_value object, std::unique_ptr<Wrapped<C>>& wrapped) {
+	check(napi_type_tag_object(env, object, Class<C>::tag()));
+	napi_status status = napi_wrap(env, object, wrapped.get(), [](napi_env env, void* data, void*) {
+		Wrapped<C>* wrapped = static_cast<Wrapped<C>*>(data);
+		if (wrapped->buffer) {
+			napi_delete_reference(env, wrapped->buffer);
+		}
+		delete wrapped;
+	}, 0, 0);
+	if (status != napi_ok) {
+		throw Error("Could not wrap the object");
+	}
+	wrapped.release();
+}
+
+//A JS object owning a copy of value, built by handing an external to the constructor.
+//The copy stays owned here until the constructor wraps it, so it is freed once whatever fails.
+template<class C>
+napi_value instance(napi_env env, const C& value) {
+	std::unique_ptr<Wrapped<C>> wrapped(new Wrapped<C>(new C(value)));
+	napi_value external, object;
+	check(napi_create_external(env, &wrapped, 0, 0, &external));
+	if (napi_new_instance(env, napi::constructor<C>(env), 1, &external, &object) != napi_ok) {
+		throw Error("Could not create the object");
+	}
+	return object;
+}
+
+//The owner of the value passed by instance(), if its external is the only argument
+template<class C>
+std::unique_ptr<Wrapped<C>>* adopted(const Arguments& args) {
+	napi_valuetype type;
+	if (args.count == 1 && napi_typeof(args.env, args.values[0], &type) == napi_ok && type == napi_external) {
+		void* owner;
+		check(napi_get_value_external(args.env, args.values[0], &owner));
+		return static_cast<std::unique_ptr<Wrapped<C>>*>(owner);
+	}
+	return 0;
+}
+
+//Callback of a method F taking the native object and the arguments
+template<class C, napi_value (*F)(C&, const Arguments&)>
+napi_value method(napi_env env, napi_callback_info info) {
+	return guard(env, [&]() {
+		Arguments args(env, info);
+		return F(unwrapValue<C>(env, args.self), args);
+	});
+}
+
+//Frees the native object now rather than at the next garbage collection, detaching its view
+template<class C>
+napi_value destroy(napi_env env, napi_callback_info info) {
+	return guard(env, [&]() {
+		Arguments args(env, info);
+		Wrapped<C>& wrapped = unwrap<C>(env, args.self);
+		wrapped.detach(env);
+		wrapped.value.reset();
+		return undefined(env);
+	});
+}
+
+template<class C>
+int index(const C& A, const Arguments& args, std::size_t i, bool row) {
+	double value = args.number(i);
+	if (!(value >= 1 && value <= (row ? A.getRowsCount() : A.getColumnsCount()))) {
+		throw std::out_of_range(row ? "Row index must be between 1 and rowsCount()" :
+				"Column index must be between 1 and columnsCount()");
+	}
+	return int(value);
+}
+
+/*
+ * The methods of DoubleMatrix and FloatMatrix in matrix.idl
+ */
+template<typename T, class C>
+struct MatrixMethods {
+
+	static napi_value construct(napi_env env, napi_callback_info info) {
+		return guard(env, [&]() {
+			Arguments args(env, info);
+			std::unique_ptr<Wrapped<C>>* owner = adopted<C>(args);
+			std::unique_ptr<Wrapped<C>> created;
+			if (!owner) {
+				created.reset(new Wrapped<C>(args.count > 2 ? new C(args.size(0), args.size(1), T(args.number(2))) :
+						new C(args.size(0), args.size(1))));
+				owner = &created;
+			}
+			wrap(env, args.self, *owner);
+			return args.self;
+		});
+	}
+
+	static napi_value getZero(C& A, const Arguments& args) { return number(args.env, A.getZero()); }
+	static napi_value getOne(C& A, const Arguments& args) { return number(args.env, A.getOne()); }
+	static napi_value getRowsCount(C& A, const Arguments& args) { return number(args.env, A.getRowsCount()); }
+	static napi_value getColumnsCount(C& A, const Arguments& args) { return number(args.env, A.getColumnsCount()); }
+
+	static napi_value getValue(C& A, const Arguments& args) {
+		return number(args.env, A.getValue(index(A, args, 0, true), index(A, args, 1, false)));
+	}
+
+	static napi_value setValue(C& A, const Arguments& args) {
+		return number(args.env, A.setValue(index(A, args, 0, true), index(A, args, 1, false), T(args.number(2))));
+	}
+
+	static napi_value asString(C& A, const Arguments& args) { return string(args.env, A.asString()); }
+	static napi_value asFormattedString(C& A, const Arguments& args) {
+		return string(args.env, A.asFormattedString(int(args.number(0)), args.size(1)));
+	}
+
+	static napi_value scalarMul(C& A, const Arguments& args) { return instance(args.env, A.scalarMul(T(args.number(0)))); }
+	static napi_value matrixMul(C& A, const Arguments& args) { return instance(args.env, A.matrixMul(unwrapValue<C>(args.env, args[0]))); }
+	static napi_value transpose(C& A, const Arguments& args) { return instance(args.env, A.transpose()); }
+	static napi_value swapColumns(C& A, const Arguments& args) { return instance(args.env, A.swapColumns(args.number(0), args.number(1))); }
+	static napi_value swapRows(C& A, const Arguments& args) { return instance(args.env, A.swapRows(args.number(0), args.number(1))); }
+	static napi_value concat(C& A, const Arguments& args) { return instance(args.env, A.concat(unwrapValue<C>(args.env, args[0]))); }
+	static napi_value rref(C& A, const Arguments& args) { return instance(args.env, A.rref()); }
+	static napi_value rank(C& A, const Arguments& args) { return number(args.env, A.rank()); }
+	static napi_value columnSpace(C& A, const Arguments& args) { return instance(args.env, A.columnSpace()); }
+	static napi_value nullSpace(C& A, const Arguments& args) { return instance(args.env, A.nullSpace()); }
+	static napi_value gram(C& A, const Arguments& args) { return instance(args.env, A.gram()); }
+	static napi_value outerGram(C& A, const Arguments& args) { return instance(args.env, A.outerGram()); }
+	static napi_value equal(C& A, const Arguments& args) { return boolean(args.env, A.equal(unwrapValue<C>(args.env, args[0]))); }
+
+	//The outputs are assigned, so their views are detached
+	static napi_value split(C& A, const Arguments& args) {
+		Wrapped<C>& left = unwrap<C>(args.env, args[1]);
+		Wrapped<C>& right = unwrap<C>(args.env, args[2]);
+		A.split(args.number(0), unwrapValue<C>(args.env, args[1]), unwrapValue<C>(args.env, args[2]));
+		left.detach(args.env);
+		right.detach(args.env);
+		return undefined(args.env);
+	}
+
+	static napi_value toLU(C& A, const Arguments& args) {
+		Wrapped<C>& L = unwrap<C>(args.env, args[0]);
+		Wrapped<C>& U = unwrap<C>(args.env, args[1]);
+		bool singular = A.toLU(unwrapValue<C>(args.env, args[0]), unwrapValue<C>(args.env, args[1]));
+		L.detach(args.env);
+		U.detach(args.env);
+		return boolean(args.env, singular);
+	}
+
+	static napi_value det(C& A, const Arguments& args) { return number(args.env, A.det()); }
+
+	static napi_value solve(C& A, const Arguments& args) {
+		Wrapped<C>& X = unwrap<C>(args.env, args[1]);
+		bool singular = A.solve(unwrapValue<C>(args.env, args[0]), unwrapValue<C>(args.env, args[1]));
+		X.detach(args.env);
+		return boolean(args.env, singular);
+	}
+
+	static napi_value cacheFactorizations(C& A, const Arguments& args) {
+		A.cacheFactorizations(args.boolean(0));
+		return undefined(args.env);
+	}
+
+	//After writes through view(), which the version does not see
+	static napi_value bumpVersion(C& A, const Arguments& args) {
+		A.bumpVersion();
+		return undefined(args.env);
+	}
+
+	//A typed array of its own holding a copy of the values, which are neither pinned nor written
+	static napi_value copyValues(C& A, const Arguments& args) {
+		const std::size_t length = A.getRowsCount() * A.getColumnsCount();
+		const T* values = A.getConstData();
+		void* data;
+		napi_value buffer, array;
+		check(napi_create_arraybuffer(args.env, length * sizeof(T), &data, &buffer));
+		std::copy(values, values + length, static_cast<T*>(data));
+		check(napi_create_typedarray(args.env, ArrayType<T>::value, length, buffer, 0, &array));
+		return array;
+	}
+
+	//A live writable view, which pins the values: the copies of the matrix no longer share them
+	static napi_value view(napi_env env, napi_callback_info info) {
+		return guard(env, [&]() {
+			Arguments args(env, info);
+			Wrapped<C>& wrapped = unwrap<C>(env, args.self);
+			C& A = unwrapValue<C>(env, args.self);
+			return wrapped.view(env, A.getData(), A.getRowsCount() * A.getColumnsCount());
+		});
+	}
+
+	static napi_value toBinary(C& A, const Arguments& args) {
+		const char* binary = static_cast<const char*>(A.toBinary(args.boolean(0)));
+		void* data;
+		napi_value result;
+		check(napi_create_arraybuffer(args.env, A.getBinarySize(), &data, &result));
+		std::copy(binary, binary + A.getBinarySize(), static_cast<char*>(data));
+		return result;
+	}
+
+	static napi_value fromBinary(napi_env env, napi_callback_info info) {
+		return guard(env, [&]() {
+			Arguments args(env, info);
+			std::pair<const char*, std::size_t> data = bytes(env, args[0]);
+			return instance(env, C::fromBinary(data.first, data.second));
+		});
+	}
+
+	static napi_value getIdentity(napi_env env, napi_callback_info info) {
+		return guard(env, [&]() {
+			Arguments args(env, info);
+			return instance(env, C::getIdentity(args.size(0), args.size(1)));
+		});
+	}
+};
+
+/*
+ * The methods of DoubleBatch, its values never move
+ */
+struct BatchMethods {
+
+	static napi_value construct(napi_env env, napi_callback_info info) {
+		return guard(env, [&]() {
+			Arguments args(env, info);
+			std::unique_ptr<Wrapped<DoubleBatch>> wrapped(
+					new Wrapped<DoubleBatch>(new DoubleBatch(args.size(0), args.size(1), args.size(2), args.boolean(3))));
+			wrap(env, args.self, wrapped);
+			return args.self;
+		});
+	}
+
+	static napi_value getCount(DoubleBatch& A, const Arguments& args) { return number(args.env, A.getCount()); }
+	static napi_value getRowsCount(DoubleBatch& A, const Arguments& args) { return number(args.env, A.getRowsCount()); }
+	static napi_value getColumnsCount(DoubleBatch& A, const Arguments& args) { return number(args.env, A.getColumnsCount()); }
+	static napi_value isInterleaved(DoubleBatch& A, const Arguments& args) { return boolean(args.env, A.isInterleaved()); }
+
+	static napi_value multiply(DoubleBatch& A, const Arguments& args) {
+		A.multiply(unwrapValue<DoubleBatch>(args.env, args[0]), unwrapValue<DoubleBatch>(args.env, args[1]));
+		return undefined(args.env);
+	}
+
+	static napi_value lu(DoubleBatch& A, const Arguments& args) { return number(args.env, A.lu()); }
+
+	static napi_value solve(DoubleBatch& A, const Arguments& args) {
+		A.solve(unwrapValue<DoubleBatch>(args.env, args[0]));
+		return undefined(args.env);
+	}
+
+	static napi_value determinant(DoubleBatch& A, const Arguments& args) {
+		A.determinant(unwrapValue<DoubleBatch>(args.env, args[0]));
+		return undefined(args.env);
+	}
+
+	static napi_value inverse(DoubleBatch& A, const Arguments& args) {
+		return number(args.env, A.inverse(unwrapValue<DoubleBatch>(args.env, args[0])));
+	}
+
+	static napi_value view(napi_env env, napi_callback_info info) {
+		return guard(env, [&]() {
+			Arguments args(env, info);
+			Wrapped<DoubleBatch>& wrapped = unwrap<DoubleBatch>(env, args.self);
+			DoubleBatch& A = unwrapValue<DoubleBatch>(env, args.self);
+			return wrapped.view(env, A.getData(), A.getCount() * A.getRowsCount() * A.getColumnsCount());
+		});
+	}
+};
+
+/*
+ * Instrumentation and Memory, plain objects of functions
+ */
+struct InstrumentationMethods {
+
+	template<napi_value (*F)(napi_env)>
+	static napi_value call(napi_env env, napi_callback_info) {
+		return guard(env, [&]() {
+			return F(env);
+		});
+	}
+
+	static napi_value isEnabled(napi_env env) { return boolean(env, Instrumentation::isEnabled()); }
+	static napi_value snapshot(napi_env env) { return string(env, Instrumentation::snapshot()); }
+	static napi_value reset(napi_env env) { Instrumentation::reset(); return undefined(env); }
+	static napi_value startTrace(napi_env env) { Instrumentation::startTrace(); return undefined(env); }
+	static napi_value stopTrace(napi_env env) { Instrumentation::stopTrace(); return undefined(env); }
+	static napi_value chromeTrace(napi_env env) { return string(env, Instrumentation::chromeTrace()); }
+
+	static napi_value allocatedBytes(napi_env env) { return number(env, Memory::allocatedBytes()); }
+};
+
+inline napi_property_descriptor property(const char* name, napi_callback callback, bool isStatic = false) {
+	napi_property_descriptor descriptor = { name, 0, callback, 0, 0, 0,
+			isStatic ? napi_property_attributes(napi_static | napi_writable | napi_configurable) : napi_default_method, 0 };
+	return descriptor;
+}
+
+template<class C>
+napi_value defineClass(napi_env env, napi_value exports, const char* name, napi_callback construct,
+		const std::vector<napi_property_descriptor>& properties, napi_ref* constructors) {
+	napi_value constructor;
+	check(napi_define_class(env, name, NAPI_AUTO_LENGTH, construct, 0, properties.size(), properties.data(), &constructor));
+	check(napi_create_reference(env, constructor, 1, &constructors[Class<C>::slot]));
+	check(napi_set_named_property(env, exports, name, constructor));
+	return constructor;
+}
+
+//Static methods are also on the prototype, where the Emscripten bindings put them
+template<typename T, class C>
+void defineMatrix(napi_env env, napi_value exports, const char* name, napi_ref* constructors) {
+	typedef MatrixMethods<T, C> M;
+	std::vector<napi_property_descriptor> properties = {
+		property("getZero", method<C, M::getZero>),
+		property("getOne", method<C, M::getOne>),
+		property("getRowsCount", method<C, M::getRowsCount>),
+		property("getColumnsCount", method<C, M::getColumnsCount>),
+		property("getValue", method<C, M::getValue>),
+		property("setValue", method<C, M::setValue>),
+		property("asString", method<C, M::asString>),
+		property("asFormattedString", method<C, M::asFormattedString>),
+		property("scalarMul", method<C, M::scalarMul>),
+		property("matrixMul", method<C, M::matrixMul>),
+		property("transpose", method<C, M::transpose>),
+		property("swapColumns", method<C, M::swapColumns>),
+		property("swapRows", method<C, M::swapRows>),
+		property("concat", method<C, M::concat>),
+		property("split", method<C, M::split>),
+		property("toLU", method<C, M::toLU>),
+		property("det", method<C, M::det>),
+		property("solve", method<C, M::solve>),
+		property("cacheFactorizations", method<C, M::cacheFactorizations>),
+		property("bumpVersion", method<C, M::bumpVersion>),
+		property("rref", method<C, M::rref>),
+		property("rank", method<C, M::rank>),
+		property("columnSpace", method<C, M::columnSpace>),
+		property("nullSpace", method<C, M::nullSpace>),
+		property("gram", method<C, M::gram>),
+		property("outerGram", method<C, M::outerGram>),
+		property("equal", method<C, M::equal>),
+		property("view", M::view),
+		property("copyValues", method<C, M::copyValues>),
+		property("toBinary", method<C, M::toBinary>),
+		property("fromBinary", M::fromBinary, true),
+		property("getIdentity", M::getIdentity, true),
+		property("__destroy__", destroy<C>)
+	};
+	napi_value constructor = defineClass<C>(env, exports, name, M::construct, properties, constructors);
+	napi_value prototype;
+	check(napi_get_named_property(env, constructor, "prototype", &prototype));
+	napi_property_descriptor statics[] = { property("fromBinary", M::fromBinary), property("getIdentity", M::getIdentity) };
+	check(napi_define_properties(env, prototype, 2, statics));
+}
+
+napi_value init(napi_env env, napi_value exports) {
+	return guard(env, [&]() {
+		napi_ref* constructors = new napi_ref[CLASSES_COUNT];
+		if (napi_set_instance_data(env, constructors, [](napi_env env, void* data, void*) {
+			napi_ref* constructors = static_cast<napi_ref*>(data);
+			for (int i = 0; i < CLASSES_COUNT; i++) {
+				napi_delete_reference(env, constructors[i]);
+			}
+			delete[] constructors;
+		}, 0) != napi_ok) {
+			delete[] constructors;
+			throw Error("Could not set the instance data");
+		}
+
+		defineMatrix<double, DoubleMatrix>(env, exports, "DoubleMatrix", constructors);
+		defineMatrix<float, FloatMatrix>(env, exports, "FloatMatrix", constructors);
+
+		typedef BatchMethods B;
+		std::vector<napi_property_descriptor> batch = {
+			property("getCount", method<DoubleBatch, B::getCount>),
+			property("getRowsCount", method<DoubleBatch, B::getRowsCount>),
+			property("getColumnsCount", method<DoubleBatch, B::getColumnsCount>),
+			property("isInterleaved", method<DoubleBatch, B::isInterleaved>),
+			property("multiply", method<DoubleBatch, B::multiply>),
+			property("lu", method<DoubleBatch, B::lu>),
+			property("solve", method<DoubleBatch, B::solve>),
+			property("determinant", method<DoubleBatch, B::determinant>),
+			property("inverse", method<DoubleBatch, B::inverse>),
+			property("view", B::view),
+			property("__destroy__", destroy<DoubleBatch>)
+		};
+		defineClass<DoubleBatch>(env, exports, "DoubleBatch", B::construct, batch, constructors);
+
+		typedef InstrumentationMethods I;
+		napi_value instrumentation;
+		check(napi_create_object(env, &instrumentation));
+		napi_property_descriptor functions[] = {
+			property("isEnabled", I::call<I::isEnabled>),
+			property("snapshot", I::call<I::snapshot>),
+			property("reset", I::call<I::reset>),
+			property("startTrace", I::call<I::startTrace>),
+			property("stopTrace", I::call<I::stopTrace>),
+			property("chromeTrace", I::call<I::chromeTrace>)
+		};
+		check(napi_define_properties(env, instrumentation, sizeof(functions) / sizeof(functions[0]), functions));
+		check(napi_set_named_property(env, exports, "Instrumentation", instrumentation));
+
+		napi_value memory;
+		check(napi_create_object(env, &memory));
+		napi_property_descriptor memoryFunctions[] = { property("allocatedBytes", I::call<I::allocatedBytes>) };
+		check(napi_define_properties(env, memory, 1, memoryFunctions));
+		check(napi_set_named_property(env, exports, "Memory", memory));
+		return exports;
+	});
+}
+
+}
+
+NAPI_MODULE(NODE_GYP_MODULE_NAME, napi::init)
@@ -0,0 +1,186 @@
+/*
+ * Lifetime.js
+ *
+ * Freeing of the bound objects of js/Matrix.js without calling __destroy__() by hand:
+ * - every object the caller gets is owned by it and freed once it is garbage collected (FinalizationRegistry),
+ * - scope(fn) frees the objects created while fn runs, except the ones it returns,
+ * - the objects are disposable, for using declarations,
+ * - memory() tells how many objects are alive and how much the native heap holds.
+ *
+ * In the Emscripten bundle a [Value] result lives in a static of the binding, overwritten by the next call of the
+ * same method, and must not be destroyed: the results are copied into objects of their own, which the registry
+ * frees. The addon already hands out objects of their own, collected with their JS object.
+ * The registry runs when the engine decides to, so a hot loop should still use scope() or __destroy__().
+ */
+
+//The results of these methods are [Value] in matrix.idl
+const VALUE_METHODS = ['scalarMul', 'matrixMul', 'transpose', 'swapColumns', 'swapRows', 'concat', 'rref', 'columnSpace',
+		'nullSpace', 'gram', 'outerGram']
+const VALUE_STATICS = ['getIdentity', 'fromBinary']
+
+
+let statistics = { created: 0, destroyed: 0, collected: 0, live: 0, peakLive: 0 }
+let owned = new WeakSet()
+let scopes = []
+
+//Frees the native object of a collected JS object, held being what the object left behind
+let registry = new FinalizationRegistry(held => {
+	statistics.collected++
+	statistics.live--
+	if(held){
+		let proxy = Object.create(held.prototype)
+		proxy.ptr = held.ptr
+		held.destroy.call(proxy)
+	}
+})
+
+
+/*
+ * Makes the bound classes of a module manage the lifetime of their objects, isNative telling the addon apart
+ * from the Emscripten bundle. Returns the classes to export instead of the bound ones.
+ */
+function manage(OhStrang, isNative){
+
+	let own = (object, Bound, destroy) => {
+		owned.add(object)
+		statistics.created++
+		statistics.peakLive = Math.max(statistics.peakLive, ++statistics.live)
+		let held = null
+		if(!isNative){
+			//The cache of the bindings would keep the object alive
+			delete OhStrang.getCache(Bound)[object.ptr]
+			held = { ptr: object.ptr, prototype: Object.getPrototypeOf(object), destroy: destroy }
+		}
+		registry.register(object, held, object)
+		if(scopes.length > 0){
+			scopes[scopes.length - 1].push(object)
+		}
+		return object
+	}
+
+	let managed = (Bound, copy) => {
+		if(!Bound){
+			return Bound
+		}
+		let prototype = Bound.prototype
+		let destroy = prototype.__destroy__
+
+		class Managed extends Bound {
+			constructor(...args){
+				super(...args)
+				own(this, Bound, destroy)
+			}
+		}
+
+		//Destroying twice, or after a collection, does nothing
+		prototype.__destroy__ = function(){
+			if(owned.has(this)){
+				owned.delete(this)
+				registry.unregister(this)
+				statistics.destroyed++
+				statistics.live--
+				destroy.call(this)
+			}
+		}
+
+		if(Symbol.dispose){
+			prototype[Symbol.dispose] = prototype.__destroy__
+		}
+
+		if(copy){
+			//A result of the bundle is a static of the binding, the addon's is already a new object, of the bound class.
+			//Bundles built before getData was added to matrix.idl have no view, the values are then copied one by one
+			let hasView = !!prototype.getData
+			let result = isNative ? (value => own(Object.setPrototypeOf(value, Managed.prototype), Bound, destroy)) : (value => {
+				let rows = value.getRowsCount(), columns = value.getColumnsCount()
+				let matrix = new Managed(rows, columns)
+				if(hasView){
+					matrix.view().set(value.view())
+					return matrix
+				}
+				for(let r = 1; r <= rows; r++){
+					for(let c = 1; c <= columns; c++){
+						matrix.setValue( r, c, value.getValue( r, c ) )
+					}
+				}
+				return matrix
+			})
+			let wrap = (target, name) => {
+				let method = target[name]
+				if(method){
+					target[name] = function(){
+						return result(method.apply(this, arguments))
+					}
+				}
+			}
+			VALUE_METHODS.forEach(name => wrap(prototype, name))
+			VALUE_STATICS.forEach(name => {
+				wrap(prototype, name)
+				if(Object.prototype.hasOwnProperty.call(Bound, name)){
+					wrap(Bound, name)
+				}
+			})
+		}
+		return Managed
+	}
+
+	return {
+		DoubleMatrix: managed(OhStrang.DoubleMatrix, true),
+		FloatMatrix: managed(OhStrang.FloatMatrix, true),
+		DoubleBatch: managed(OhStrang.DoubleBatch, false),
+		memory: () => ({
+			live: statistics.live,
+			peakLive: statistics.peakLive,
+			created: statistics.created,
+			destroyed: statistics.destroyed,
+			collected: statistics.collected,
+			//Bytes in use by the native allocator, matrices and temporaries alike
+			allocatedBytes: OhStrang.Memory ? (isNative ? OhStrang.Memory : OhStrang.Memory.prototype).allocatedBytes() : undefined,
+			//Size of the Emscripten heap, which never shrinks, or the resident size of the process with the addon
+			heapBytes: isNative ? process.memoryUsage().rss : OhStrang.HEAPU8.length
+		})
+	}
+}
+
+
+//The owned objects in a value: the value itself, or the items of an array or the properties of a plain object
+function reachable(value){
+	if(owned.has(value)){
+		return [value]
+	}
+	if(Array.isArray(value)){
+		return value.filter(item => owned.has(item))
+	}
+	if(value !== null && typeof value === 'object' && Object.getPrototypeOf(value) === Object.prototype){
+		return Object.keys(value).map(key => value[key]).filter(item => owned.has(item))
+	}
+	return []
+}
+
+
+/*
+ * Runs fn and destroys the objects created during it, except the ones it returns, which move to the enclosing scope.
+ * fn must be synchronous: the objects created after it returns a Promise are not in the scope.
+ */
+function scope(fn){
+	let created = []
+	scopes.push(created)
+	let result
+	try{
+		result = fn()
+	}finally{
+		scopes.pop()
+		let kept = new Set(reachable(result))
+		created.forEach(object => {
+			if(!kept.has(object)){
+				object.__destroy__()
+			}else if(scopes.length > 0){
+				scopes[scopes.length - 1].push(object)
+			}
+		})
+	}
+	return result
+}
+
+
+module.exports = { manage: manage, scope: scope }
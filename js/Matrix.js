@@ -1,39 +1,191 @@
-let OhStrang = require('./oh-strang').OhStrang
+//The native addon built by make addon when there is one, unless OH_STRANG_WASM is set, else the Emscripten bundle
+function loadAddon(){
+	if(process.env.OH_STRANG_WASM){
+		return null
+	}
+	try{
+		return require('../build/oh-strang.node')
+	}catch(e){
+		return null
+	}
+}
 
+let addon = loadAddon()
+let OhStrang = addon || require('./oh-strang').OhStrang
+let Lifetime = require('./Lifetime')
 
-let NumberMatrix = OhStrang.DoubleMatrix.prototype;
 
-NumberMatrix.setValues = function(values){
-	let i = 0
-	for(let r = 1; r <= this.getRowsCount(); r++){
-		for(let c = 1; c <= this.getColumnsCount(); c++){
-			this.setValue( r, c, values[i++] )
+//Adds the JS helpers to a bound matrix class, TypedArray being the array type matching its values
+function extend(Matrix, TypedArray){
+
+	let NumberMatrix = Matrix.prototype;
+
+	//The addon has its own view() over the native values, see binding/napi.cpp
+	if(!addon && NumberMatrix.getData){
+		//Live view on the values in the Emscripten heap, only valid until the matrix is destroyed
+		NumberMatrix.view = function(){
+			let pointer = OhStrang.getPointer(this.getData())
+			return new TypedArray(OhStrang.HEAPU8.buffer, pointer, this.getRowsCount() * this.getColumnsCount())
+		}
+	}
+	//Bundles built before getData was added to matrix.idl have no view, the values then go one by one
+	let hasView = !!NumberMatrix.view
+
+	//A typed array of its own with the values. The reads do not go through view(), which pins the values,
+	//so that the copies of a matrix JS only reads keep sharing them
+	let copyValues = function(matrix){
+		if(addon){
+			return matrix.copyValues()
+		}
+		if(NumberMatrix.getConstData){
+			let pointer = OhStrang.getPointer(matrix.getConstData())
+			return new TypedArray(OhStrang.HEAPU8.buffer, pointer, matrix.getRowsCount() * matrix.getColumnsCount()).slice()
+		}
+		return matrix.view().slice()
+	}
+
+
+	NumberMatrix.setValues = function(values){
+		let count = this.getRowsCount() * this.getColumnsCount()
+		if(values.length !== count){
+			throw new RangeError('Expected ' + count + ' values, got ' + values.length)
+		}
+		if(!hasView){
+			let i = 0
+			for(let r = 1; r <= this.getRowsCount(); r++){
+				for(let c = 1; c <= this.getColumnsCount(); c++){
+					this.setValue( r, c, values[i++] )
+				}
+			}
+			return
+		}
+		this.view().set(values)
+		if(this.bumpVersion){ //the cached factorizations are stale after writing through the view
+			this.bumpVersion()
 		}
 	}
-}
 
 
-NumberMatrix.getValues = function(){
-	let i = 0
-	let values = []
-	for(let r = 1; r <= this.getRowsCount(); r++){
-		for(let c = 1; c <= this.getColumnsCount(); c++){
-			values[i++] = this.getValue( r, c )
+	NumberMatrix.getValues = function(){
+		if(!hasView){
+			let i = 0
+			let values = []
+			for(let r = 1; r <= this.getRowsCount(); r++){
+				for(let c = 1; c <= this.getColumnsCount(); c++){
+					values[i++] = this.getValue( r, c )
+				}
+			}
+			return values
 		}
+		return Array.from(copyValues(this))
 	}
-	return values
-}
 
 
+	//Copy of the values as a typed array
+	NumberMatrix.getTypedValues = function(){
+		return hasView ? copyValues(this) : TypedArray.from(this.getValues())
+	}
+
+
+
+	//Binary round-trip, see src/serialization.cpp for the format
+	NumberMatrix.toArrayBuffer = function(checksum){
+		if(addon){
+			return this.toBinary(!!checksum)
+		}
+		let pointer = OhStrang.getPointer(this.toBinary(!!checksum))
+		return OhStrang.HEAPU8.slice(pointer, pointer + this.getBinarySize()).buffer
+	}
+
+
+	Matrix.fromArrayBuffer = function(buffer){
+		if(addon){
+			return Matrix.fromBinary(buffer)
+		}
+		let bytes = new Uint8Array(buffer)
+		let pointer = OhStrang._malloc(bytes.length)
+		try{
+			OhStrang.HEAPU8.set(bytes, pointer)
+			return NumberMatrix.fromBinary(pointer, bytes.length)
+		}finally{
+			OhStrang._free(pointer)
+		}
+	}
+
+
+
+	//options: precision, the significant digits (default the shortest text that reads back the same value),
+	//and edgeItems, the rows and columns shown at each end of a matrix of more than 1000 values (default all)
+	NumberMatrix.toString = function(options){
+		if(options){
+			return this.asFormattedString(options.precision || 0, options.edgeItems || 0)
+		}
+		return this.asString()
+	}
+
+
+	//Summarized, logging a large matrix stays cheap
+	NumberMatrix.inspect = function(){
+		return this.toString({ edgeItems: 3 })
+	}
+
+	NumberMatrix[Symbol.for('nodejs.util.inspect.custom')] = NumberMatrix.inspect
+
+}
+
 
-NumberMatrix.toString = function(){
-	return this.asString()
+extend(OhStrang.DoubleMatrix, Float64Array)
+if(OhStrang.FloatMatrix){ //only in bundles built from the current matrix.idl
+	extend(OhStrang.FloatMatrix, Float32Array)
 }
 
+//Subclasses of the bound classes whose objects are freed on garbage collection, see Lifetime.js
+let classes = Lifetime.manage(OhStrang, !!addon)
+
+if(classes.DoubleBatch){
+	let Batch = classes.DoubleBatch
+
+	if(!addon){
+		//Live view on the whole batch in the Emscripten heap, only valid until the batch is destroyed
+		Batch.prototype.view = function(){
+			let pointer = OhStrang.getPointer(this.getData())
+			return new Float64Array(OhStrang.HEAPU8.buffer, pointer, this.getCount() * this.getRowsCount() * this.getColumnsCount())
+		}
+	}
+
+	//Creates a batch from a single typed array holding all the matrices, see src/batched.cpp for the layouts
+	Batch.fromTypedArray = function(values, count, rows, columns, interleaved){
+		let batch = new Batch(count, rows, columns, !!interleaved)
+		let view = batch.view()
+		if(values.length !== view.length){
+			batch.__destroy__()
+			throw new RangeError('Expected ' + view.length + ' values, got ' + values.length)
+		}
+		view.set(values)
+		return batch
+	}
+}
 
-NumberMatrix.inspect = function(){
-	return this.toString()
+//Counters of the native operations, only filled when the module is built with -DOH_STRANG_PROFILE
+let counters = OhStrang.Instrumentation && (addon ? OhStrang.Instrumentation : OhStrang.Instrumentation.prototype)
+let instrumentation = {
+	isEnabled: () => counters.isEnabled(),
+	snapshot: () => JSON.parse(counters.snapshot()),
+	reset: () => counters.reset(),
+	startTrace: () => counters.startTrace(),
+	stopTrace: () => counters.stopTrace(),
+	//Load the text in chrome://tracing or https://ui.perfetto.dev
+	chromeTrace: () => counters.chromeTrace()
 }
 
 
-module.exports = OhStrang.DoubleMatrix
+module.exports = classes.DoubleMatrix
+module.exports.DoubleMatrix = classes.DoubleMatrix
+module.exports.FloatMatrix = classes.FloatMatrix
+module.exports.DoubleBatch = classes.DoubleBatch
+module.exports.instrumentation = OhStrang.Instrumentation ? instrumentation : undefined
+//Frees the matrices created by a function except the ones it returns: Matrix.scope(() => A.matrixMul(B).transpose())
+module.exports.scope = Lifetime.scope
+module.exports.memory = classes.memory
+//true when the native addon is loaded
+module.exports.isNative = !!addon
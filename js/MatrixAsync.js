@@ -0,0 +1,276 @@
+/*
+ * MatrixAsync.js
+ *
+ * Promise based API running the operations of Matrix.js on a pool of worker_threads, so a large multiply
+ * does not block the event loop. Every worker loads its own copy of the compiled module.
+ *
+ * Operands and results travel as { rows, columns, values } with values a Float64Array or a Float32Array:
+ * values backed by a SharedArrayBuffer are shared with the worker, other buffers are transferred,
+ * which detaches them on the calling side. A bound matrix is accepted too and its values copied once.
+ * Small jobs waiting in the queue are sent together in one message.
+ *
+ * let pool = new MatrixPool()
+ * pool.multiply(A, B).then(C => ...)
+ * pool.terminate()
+ */
+let workerThreads = require('worker_threads')
+let os = require('os')
+let path = require('path')
+
+
+//Returns the values of each result of an operation, given the bound matrices of its operands and its arguments
+let operations = {
+	multiply: (A, B) => [A.matrixMul(B)],
+	scalarMul: (A, scalar) => [A.scalarMul(scalar)],
+	transpose: (A) => [A.transpose()],
+	concat: (A, B) => [A.concat(B)],
+	rref: (A) => [A.rref()],
+	columnSpace: (A) => [A.columnSpace()],
+	nullSpace: (A) => [A.nullSpace()],
+	gram: (A) => [A.gram()],
+	outerGram: (A) => [A.outerGram()],
+	rank: (A) => A.rank(),
+	equal: (A, B) => A.equal(B),
+	toLU: (A, Matrix) => {
+		let L = new Matrix(1, 1)
+		let U = new Matrix(1, 1)
+		let singular = A.toLU(L, U)
+		return { singular: singular, L: L, U: U }
+	}
+}
+
+
+/*
+ * Worker side: runs the batches of jobs and posts back one reply per batch
+ */
+if(!workerThreads.isMainThread && workerThreads.workerData && workerThreads.workerData.ohStrangPool){
+
+	let Matrix = require(workerThreads.workerData.modulePath)
+	let classes = { Float64Array: Matrix.DoubleMatrix || Matrix, Float32Array: Matrix.FloatMatrix }
+
+	let toBound = (operand) => {
+		let Bound = classes[operand.values.constructor.name]
+		if(!Bound){
+			throw new TypeError('Values must be a Float64Array or a Float32Array')
+		}
+		let bound = new Bound(operand.rows, operand.columns)
+		bound.setValues(operand.values)
+		return bound
+	}
+
+	//Copies the values out of the module heap and frees the bound matrix
+	let toPlain = (bound, transfers) => {
+		let plain = { rows: bound.getRowsCount(), columns: bound.getColumnsCount(), values: bound.getTypedValues() }
+		bound.__destroy__()
+		transfers.push(plain.values.buffer)
+		return plain
+	}
+
+	let run = (job, transfers) => {
+		let operands = job.operands.map(toBound)
+		try{
+			//toLU allocates its results, so it gets the class of its operand
+			let args = job.operation === 'toLU' ? [operands[0], operands[0].constructor] : operands.concat(job.args)
+			let result = operations[job.operation].apply(null, args)
+			if(Array.isArray(result)){
+				return toPlain(result[0], transfers)
+			}
+			if(result !== null && typeof result === 'object'){
+				return { singular: result.singular, L: toPlain(result.L, transfers), U: toPlain(result.U, transfers) }
+			}
+			return result
+		}finally{
+			operands.forEach(bound => bound.__destroy__())
+		}
+	}
+
+	workerThreads.parentPort.on('message', (batch) => {
+		let transfers = []
+		let replies = batch.map(job => {
+			try{
+				return { id: job.id, result: run(job, transfers) }
+			}catch(e){
+				return { id: job.id, error: e instanceof Error ? e.message : String(e) }
+			}
+		})
+		workerThreads.parentPort.postMessage(replies, transfers)
+	})
+
+	return
+}
+
+
+/*
+ * Main side: the pool and its queue
+ */
+
+//Operands of more values than this are sent alone
+const BATCH_VALUES = 1 << 16
+
+let toOperand = (matrix, transfers) => {
+	if(typeof matrix.getTypedValues === 'function'){
+		let values = matrix.getTypedValues()
+		transfers.push(values.buffer)
+		return { rows: matrix.getRowsCount(), columns: matrix.getColumnsCount(), values: values }
+	}
+	let values = matrix.values
+	if(!(values instanceof Float64Array || values instanceof Float32Array)){
+		throw new TypeError('Values must be a Float64Array or a Float32Array')
+	}
+	if(values.length !== matrix.rows * matrix.columns){
+		throw new RangeError('Expected ' + matrix.rows * matrix.columns + ' values, got ' + values.length)
+	}
+	if(!(values.buffer instanceof SharedArrayBuffer) && transfers.indexOf(values.buffer) < 0){
+		transfers.push(values.buffer)
+	}
+	return { rows: matrix.rows, columns: matrix.columns, values: values }
+}
+
+
+class MatrixPool {
+
+	//options: size, the number of workers (default the number of CPUs), and modulePath, the module loaded by the workers
+	constructor(options){
+		options = options || {}
+		this.size = Math.max(1, options.size || os.cpus().length)
+		this.modulePath = options.modulePath || path.join(__dirname, 'Matrix.js')
+		this.workers = []
+		this.idle = []
+		this.queue = []
+		this.pending = new Map()
+		this.nextId = 0
+	}
+
+	//Queues an operation of matrices, resolved with its result, see operations for the names
+	run(operation, matrices, args){
+		if(!operations[operation]){
+			return Promise.reject(new TypeError('Unknown operation ' + operation))
+		}
+		return new Promise((resolve, reject) => {
+			let transfers = []
+			let job
+			try{
+				job = { id: this.nextId++, operation: operation, operands: matrices.map(m => toOperand(m, transfers)), args: args || [] }
+			}catch(e){
+				return reject(e)
+			}
+			let values = job.operands.reduce((total, operand) => total + operand.values.length, 0)
+			this.queue.push({ job: job, transfers: transfers, values: values })
+			this.pending.set(job.id, { resolve: resolve, reject: reject })
+			this.dispatch()
+		})
+	}
+
+	multiply(A, B){ return this.run('multiply', [A, B]) }
+	scalarMul(A, scalar){ return this.run('scalarMul', [A], [scalar]) }
+	transpose(A){ return this.run('transpose', [A]) }
+	concat(A, B){ return this.run('concat', [A, B]) }
+	rref(A){ return this.run('rref', [A]) }
+	rank(A){ return this.run('rank', [A]) }
+	columnSpace(A){ return this.run('columnSpace', [A]) }
+	nullSpace(A){ return this.run('nullSpace', [A]) }
+	gram(A){ return this.run('gram', [A]) }
+	outerGram(A){ return this.run('outerGram', [A]) }
+	equal(A, B){ return this.run('equal', [A, B]) }
+	//Resolved with { singular, L, U }
+	toLU(A){ return this.run('toLU', [A]) }
+
+	//Stops the workers, rejecting the jobs not done yet
+	terminate(){
+		let error = new Error('The pool was terminated')
+		this.pending.forEach(job => job.reject(error))
+		this.pending.clear()
+		this.queue = []
+		this.idle = []
+		let workers = this.workers
+		this.workers = []
+		return Promise.all(workers.map(worker => worker.terminate()))
+	}
+
+
+	spawn(){
+		let worker = new workerThreads.Worker(__filename, { workerData: { ohStrangPool: true, modulePath: this.modulePath } })
+		worker.on('message', (replies) => {
+			replies.forEach(reply => {
+				let job = this.pending.get(reply.id)
+				if(!job){
+					return
+				}
+				this.pending.delete(reply.id)
+				if(reply.error !== undefined){
+					job.reject(new Error(reply.error))
+				}else{
+					job.resolve(reply.result)
+				}
+			})
+			//Idle workers do not keep the process alive
+			worker.unref()
+			this.idle.push(worker)
+			this.dispatch()
+		})
+		worker.on('error', (e) => {
+			(worker.batch || []).forEach(id => {
+				let job = this.pending.get(id)
+				if(job){
+					this.pending.delete(id)
+					job.reject(e)
+				}
+			})
+			this.workers.splice(this.workers.indexOf(worker), 1)
+			this.dispatch()
+		})
+		worker.unref()
+		this.workers.push(worker)
+		return worker
+	}
+
+	//Hands the queued jobs to the idle workers, small ones grouped up to BATCH_VALUES values
+	dispatch(){
+		while(this.queue.length > 0){
+			if(this.idle.length === 0 && this.workers.length < this.size){
+				this.idle.push(this.spawn())
+			}
+			if(this.idle.length === 0){
+				return
+			}
+			let worker = this.idle.pop()
+			let batch = [this.queue.shift()]
+			let values = batch[0].values
+			while(this.queue.length > 0 && values + this.queue[0].values <= BATCH_VALUES){
+				values += this.queue[0].values
+				batch.push(this.queue.shift())
+			}
+			//Jobs of a batch may share a buffer, which can only be listed once
+			let transfers = Array.from(new Set([].concat.apply([], batch.map(queued => queued.transfers))))
+			worker.batch = batch.map(queued => queued.job.id)
+			//Busy workers keep the process alive until they reply
+			worker.ref()
+			try{
+				worker.postMessage(batch.map(queued => queued.job), transfers)
+			}catch(e){
+				//Nothing was sent, a buffer already transferred by an earlier batch for instance
+				worker.batch.forEach(id => {
+					let job = this.pending.get(id)
+					this.pending.delete(id)
+					job.reject(e)
+				})
+				worker.batch = []
+				worker.unref()
+				this.idle.push(worker)
+			}
+		}
+	}
+}
+
+
+//Turns a result of the pool back into a bound matrix of the module loaded on this thread
+MatrixPool.toMatrix = function(result){
+	let Matrix = require('./Matrix')
+	let Bound = result.values instanceof Float32Array ? Matrix.FloatMatrix : Matrix.DoubleMatrix
+	let bound = new Bound(result.rows, result.columns)
+	bound.setValues(result.values)
+	return bound
+}
+
+
+module.exports = MatrixPool
@@ -0,0 +1,164 @@
+#ifndef OH_STRANG_AUTOTUNE
+#define OH_STRANG_AUTOTUNE
+
+#include <chrono>
+#include <vector>
+#include <ostream>
+#include <algorithm>
+
+#include "kernels.cpp"
+#include "tuning.cpp"
+
+/*
+ * autotune.cpp
+ *
+ * Picks the kernel parameters of T by timing the candidates on the running machine.
+ * Each parameter is tuned in turn with the others fixed at their best value so far:
+ * the multiply blocking and unrolling, then the serial/parallel crossover, then the LU panel width, then the
+ * order below which a Strassen-Winograd level costs more than the classical product.
+ * The result is applied to tuning::parameters<T>() and can be saved with tuning::writeConfig.
+ */
+
+namespace tuning {
+
+struct TuneOptions {
+	std::size_t size;			//order of the matrices timed for the blocking candidates
+	double minSeconds;			//each candidate runs at least this long
+};
+
+inline TuneOptions defaultTuneOptions() {
+	TuneOptions options = { 512, 0.05 };
+	return options;
+}
+
+//Best time of fn over repeated runs lasting at least minSeconds in total
+template<typename F>
+double timeCandidate(double minSeconds, F fn) {
+	typedef std::chrono::steady_clock Clock;
+	double best = 1e300, total = 0;
+	do {
+		Clock::time_point start = Clock::now();
+		fn();
+		double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+		best = std::min(best, seconds);
+		total += seconds;
+	} while (total < minSeconds);
+	return best;
+}
+
+template<typename T>
+void fillCandidate(std::vector<T>& values, std::size_t seed) {
+	for (std::size_t i = 0; i < values.size(); i++) {
+		values[i] = T(((i * 7 + seed) % 17) / 17.0 - 0.5);
+	}
+}
+
+template<typename T>
+KernelParameters autotune(const TuneOptions& options = defaultTuneOptions(), std::ostream* log = 0) {
+	KernelParameters& current = parameters<T>();
+	KernelParameters best = current;
+	const std::size_t n = options.size;
+	std::vector<T> A(n * n), B(n * n), C(n * n);
+	fillCandidate(A, 1);
+	fillCandidate(B, 2);
+
+	//Multiply blocking and unrolling, on one thread
+	double bestSeconds = 1e300;
+	const std::size_t blocksK[] = { 32, 64, 128, 256, 512 };
+	const std::size_t blocksN[] = { 128, 256, 512, 1024, 2048 };
+	const std::size_t unrolls[] = { 1, 2, 4 };
+	for (std::size_t blockK : blocksK) {
+		for (std::size_t blockN : blocksN) {
+			for (std::size_t unroll : unrolls) {
+				current = best;
+				current.gemmBlockK = blockK;
+				current.gemmBlockN = blockN;
+				current.gemmUnroll = unroll;
+				double seconds = timeCandidate(options.minSeconds, [&] {
+					kernels::gemm(n, n, n, T(1), &A[0], n, &B[0], n, &C[0], n);
+				});
+				if (log) {
+					*log << "gemm blockK=" << blockK << " blockN=" << blockN << " unroll=" << unroll << ": "
+							<< 2.0 * n * n * n / seconds / 1e9 << " GFLOP/s\n";
+				}
+				if (seconds < bestSeconds) {
+					bestSeconds = seconds;
+					best = current;
+				}
+			}
+		}
+	}
+
+	//Smallest cube on which the threads pay off
+	current = best;
+	best.gemmParallelThreshold = n * n * n + 1;
+	for (std::size_t order = 16; order <= n; order *= 2) {
+		current.gemmParallelThreshold = 0;
+		double parallel = timeCandidate(options.minSeconds, [&] {
+			kernels::gemmParallel(order, order, order, T(1), &A[0], n, &B[0], n, &C[0], n);
+		});
+		double serial = timeCandidate(options.minSeconds, [&] {
+			kernels::gemm(order, order, order, T(1), &A[0], n, &B[0], n, &C[0], n);
+		});
+		if (log) {
+			*log << "gemm order=" << order << ": serial " << serial << "s, parallel " << parallel << "s\n";
+		}
+		if (parallel < serial * 0.8) { //with a margin for the timing noise
+			best.gemmParallelThreshold = order * order * order;
+			break;
+		}
+	}
+
+	//LU panel width
+	current = best;
+	bestSeconds = 1e300;
+	std::vector<std::size_t> pivots(n);
+	const std::size_t panels[] = { 16, 32, 64, 128, 256 };
+	for (std::size_t panel : panels) {
+		if (panel >= n && panel != panels[0]) { //a single panel is the unblocked factorization
+			break;
+		}
+		current.getrfBlock = panel;
+		double seconds = timeCandidate(options.minSeconds, [&] {
+			std::copy(A.begin(), A.end(), C.begin());
+			kernels::getrf(n, &C[0], n, &pivots[0]);
+		});
+		if (log) {
+			*log << "getrf block=" << panel << ": " << 2.0 * n * n * n / 3 / seconds / 1e9 << " GFLOP/s\n";
+		}
+		if (seconds < bestSeconds) {
+			bestSeconds = seconds;
+			best.getrfBlock = panel;
+		}
+	}
+
+	//Strassen-Winograd cutoff: the smallest order c at which one level on 2c beats gemm on 2c,
+	//otherwise the recursion stops at the tuned size
+	current = best;
+	best.strassenCutoff = n;
+	std::vector<T> workspace(kernels::strassenWorkspace(n, 1));
+	for (std::size_t cutoff = 64; 2 * cutoff <= n; cutoff *= 2) {
+		const std::size_t order = 2 * cutoff;
+		double classical = timeCandidate(options.minSeconds, [&] {
+			std::fill(C.begin(), C.end(), T(0));
+			kernels::gemmParallel(order, order, order, T(1), &A[0], n, &B[0], n, &C[0], n);
+		});
+		double strassen = timeCandidate(options.minSeconds, [&] {
+			kernels::strassen(order, &A[0], n, &B[0], n, &C[0], n, 1, &workspace[0]);
+		});
+		if (log) {
+			*log << "strassen order=" << order << ": classical " << classical << "s, one level " << strassen << "s\n";
+		}
+		if (strassen < classical * 0.95) {
+			best.strassenCutoff = cutoff;
+			break;
+		}
+	}
+
+	current = best;
+	return best;
+}
+
+}
+
+#endif //OH_STRANG_AUTOTUNE
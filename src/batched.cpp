@@ -0,0 +1,351 @@
+#ifndef OH_STRANG_BATCHED
+#define OH_STRANG_BATCHED
+
+#include <cmath>
+#include <cstdint>
+#include <atomic>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+
+#include "parallel.cpp"
+
+/*
+ * batched.cpp
+ *
+ * Operations on batches of small matrices of the same size, without a matrix object per item.
+ *
+ * A Batch describes where the element (i, j) of the matrix b lives in one buffer:
+ *   data[b * matrixStride + (i * columns + j) * elementStride]
+ * In the contiguous layout the matrices follow each other (matrixStride = rows * columns, elementStride = 1).
+ * In the interleaved layout the same element of every matrix is contiguous (matrixStride = 1, elementStride = count):
+ * the kernels loop over the batch innermost, so in this layout each step is one vector operation across matrices.
+ *
+ * The batch is split between the threads, each thread working on a range of matrices.
+ * Pivots are always interleaved: pivots[c * count + b] is the row exchanged with row c of the matrix b.
+ */
+
+template<typename T>
+struct Batch {
+	T* data;
+	std::size_t count;
+	std::size_t rows;
+	std::size_t columns;
+	std::size_t matrixStride;
+	std::size_t elementStride;
+
+	static Batch interleaved(T* data, std::size_t count, std::size_t rows, std::size_t columns) {
+		Batch batch = { data, count, rows, columns, 1, count };
+		return batch;
+	}
+
+	static Batch contiguous(T* data, std::size_t count, std::size_t rows, std::size_t columns) {
+		Batch batch = { data, count, rows, columns, rows * columns, 1 };
+		return batch;
+	}
+
+	bool isInterleaved() const {
+		return matrixStride == 1;
+	}
+
+	//Element (i, j) of the matrix b, all indices 0 based
+	T& operator()(std::size_t b, std::size_t i, std::size_t j) const {
+		return data[b * matrixStride + (i * columns + j) * elementStride];
+	}
+
+	//The matrices first..last of this batch
+	Batch slice(std::size_t first, std::size_t last) const {
+		Batch batch = { data + first * matrixStride, last - first, rows, columns, matrixStride, elementStride };
+		return batch;
+	}
+};
+
+namespace batched {
+
+//Matrices per thread task
+const std::size_t GRAIN = 256;
+
+/*
+ * Element access for the kernels.
+ * Interleaved batches get a compile time unit stride between matrices so the loops over the batch vectorize.
+ */
+template<typename T, bool Interleaved>
+struct Lanes {
+	T* data;
+	std::size_t matrixStride;
+	std::size_t elementStride;
+	std::size_t columns;
+
+	Lanes(const Batch<T>& batch) :
+			data(batch.data), matrixStride(batch.matrixStride), elementStride(batch.elementStride), columns(batch.columns) {}
+
+	T& operator()(std::size_t b, std::size_t i, std::size_t j) const {
+		return data[(Interleaved ? b : b * matrixStride) + (i * columns + j) * elementStride];
+	}
+};
+
+template<typename T, bool Interleaved>
+void multiply(const Batch<T>& A, const Batch<T>& B, const Batch<T>& C) {
+	Lanes<T, Interleaved> a(A), b(B), c(C);
+	std::size_t count = A.count;
+	for (std::size_t i = 0; i < C.rows; i++) {
+		for (std::size_t j = 0; j < C.columns; j++) {
+			for (std::size_t l = 0; l < count; l++) {
+				c(l, i, j) = T(0);
+			}
+		}
+		for (std::size_t p = 0; p < A.columns; p++) {
+			for (std::size_t j = 0; j < C.columns; j++) {
+				for (std::size_t l = 0; l < count; l++) {
+					c(l, i, j) += a(l, i, p) * b(l, p, j);
+				}
+			}
+		}
+	}
+}
+
+//In place LU with partial pivoting of each matrix, returns the number of singular matrices
+template<typename T, bool Interleaved>
+std::size_t lu(const Batch<T>& A, std::int32_t* pivots, std::size_t pivotStride) {
+	Lanes<T, Interleaved> a(A);
+	std::size_t count = A.count;
+	std::size_t n = A.rows;
+	std::vector<std::int32_t> best(count);
+	std::vector<T> largest(count);
+	std::vector<T> inverse(count);
+	std::vector<char> singular(count, 0);
+
+	for (std::size_t c = 0; c < n; c++) {
+		//pivot search, one row per lane
+		for (std::size_t l = 0; l < count; l++) {
+			best[l] = c;
+			largest[l] = std::abs(a(l, c, c));
+		}
+		for (std::size_t r = c + 1; r < n; r++) {
+			for (std::size_t l = 0; l < count; l++) {
+				T value = std::abs(a(l, r, c));
+				bool larger = value > largest[l];
+				largest[l] = larger ? value : largest[l];
+				best[l] = larger ? std::int32_t(r) : best[l];
+			}
+		}
+		for (std::size_t l = 0; l < count; l++) {
+			pivots[c * pivotStride + l] = best[l];
+			singular[l] |= largest[l] == T(0);
+			if (best[l] != std::int32_t(c)) {
+				for (std::size_t j = 0; j < n; j++) {
+					std::swap(a(l, c, j), a(l, best[l], j));
+				}
+			}
+			//a zero pivot leaves the column as it is
+			inverse[l] = largest[l] == T(0) ? T(0) : T(1) / a(l, c, c);
+		}
+
+		for (std::size_t r = c + 1; r < n; r++) {
+			for (std::size_t l = 0; l < count; l++) {
+				a(l, r, c) *= inverse[l];
+			}
+			for (std::size_t j = c + 1; j < n; j++) {
+				for (std::size_t l = 0; l < count; l++) {
+					a(l, r, j) -= a(l, r, c) * a(l, c, j);
+				}
+			}
+		}
+	}
+
+	std::size_t singularCount = 0;
+	for (std::size_t l = 0; l < count; l++) {
+		singularCount += singular[l];
+	}
+	return singularCount;
+}
+
+//Overwrites B with LU^-1 * B
+template<typename T, bool Interleaved>
+void solve(const Batch<T>& LU, const std::int32_t* pivots, std::size_t pivotStride, const Batch<T>& B) {
+	Lanes<T, Interleaved> a(LU), x(B);
+	std::size_t count = LU.count;
+	std::size_t n = LU.rows;
+	std::size_t nrhs = B.columns;
+
+	for (std::size_t c = 0; c < n; c++) {
+		for (std::size_t l = 0; l < count; l++) {
+			std::size_t pivot = pivots[c * pivotStride + l];
+			if (pivot != c) {
+				for (std::size_t j = 0; j < nrhs; j++) {
+					std::swap(x(l, c, j), x(l, pivot, j));
+				}
+			}
+		}
+	}
+	for (std::size_t i = 1; i < n; i++) {
+		for (std::size_t q = 0; q < i; q++) {
+			for (std::size_t j = 0; j < nrhs; j++) {
+				for (std::size_t l = 0; l < count; l++) {
+					x(l, i, j) -= a(l, i, q) * x(l, q, j);
+				}
+			}
+		}
+	}
+	for (std::size_t i = n; i-- > 0;) {
+		for (std::size_t q = i + 1; q < n; q++) {
+			for (std::size_t j = 0; j < nrhs; j++) {
+				for (std::size_t l = 0; l < count; l++) {
+					x(l, i, j) -= a(l, i, q) * x(l, q, j);
+				}
+			}
+		}
+		for (std::size_t j = 0; j < nrhs; j++) {
+			for (std::size_t l = 0; l < count; l++) {
+				x(l, i, j) /= a(l, i, i);
+			}
+		}
+	}
+}
+
+//Copies a batch into an interleaved scratch buffer and factors it
+template<typename T>
+std::size_t factorCopy(const Batch<T>& A, std::vector<T>& scratch, std::vector<std::int32_t>& pivots, Batch<T>& LU) {
+	scratch.resize(A.count * A.rows * A.columns);
+	pivots.resize(A.count * A.rows);
+	LU = Batch<T>::interleaved(&scratch[0], A.count, A.rows, A.columns);
+	for (std::size_t i = 0; i < A.rows; i++) {
+		for (std::size_t j = 0; j < A.columns; j++) {
+			for (std::size_t l = 0; l < A.count; l++) {
+				LU(l, i, j) = A(l, i, j);
+			}
+		}
+	}
+	return lu<T, true>(LU, &pivots[0], A.count);
+}
+
+template<typename T>
+void checkSquare(const Batch<T>& A) {
+	if (A.rows != A.columns) {
+		throw std::domain_error("Batched matrices must be square.");
+	}
+}
+
+template<typename T>
+void checkSameCount(const Batch<T>& A, const Batch<T>& B) {
+	if (A.count != B.count) {
+		throw std::domain_error("Batches must hold the same number of matrices.");
+	}
+}
+
+//Runs fn(first, last) over ranges of the batch in parallel
+template<typename F>
+void forBatch(std::size_t count, F fn) {
+	parallel::forRange(0, count, GRAIN, fn);
+}
+
+}
+
+//C(b) = A(b) * B(b) for each matrix b of the batches
+template<typename T>
+void batchMultiply(const Batch<T>& A, const Batch<T>& B, const Batch<T>& C) {
+	batched::checkSameCount(A, B);
+	batched::checkSameCount(A, C);
+	if (A.columns != B.rows) {
+		throw std::domain_error(
+				"Left matrix columns count must match right matrix rows count.");
+	}
+	if (C.rows != A.rows || C.columns != B.columns) {
+		throw std::domain_error("Result matrix must have as many rows as A and as many columns as B.");
+	}
+	bool interleaved = A.isInterleaved() && B.isInterleaved() && C.isInterleaved();
+	batched::forBatch(A.count, [&](std::size_t first, std::size_t last) {
+		if (interleaved) {
+			batched::multiply<T, true>(A.slice(first, last), B.slice(first, last), C.slice(first, last));
+		} else {
+			batched::multiply<T, false>(A.slice(first, last), B.slice(first, last), C.slice(first, last));
+		}
+	});
+}
+
+//In place LU decomposition with partial pivoting of each matrix, pivots must hold count * rows values.
+//Returns the number of singular matrices.
+template<typename T>
+std::size_t batchLU(const Batch<T>& A, std::int32_t* pivots) {
+	batched::checkSquare(A);
+	std::atomic<std::size_t> singular(0);
+	batched::forBatch(A.count, [&](std::size_t first, std::size_t last) {
+		singular += A.isInterleaved() ?
+				batched::lu<T, true>(A.slice(first, last), pivots + first, A.count) :
+				batched::lu<T, false>(A.slice(first, last), pivots + first, A.count);
+	});
+	return singular;
+}
+
+//Solves LU(b) * X(b) = B(b) for each matrix, B being overwritten by X. LU and pivots come from batchLU.
+template<typename T>
+void batchSolve(const Batch<T>& LU, const std::int32_t* pivots, const Batch<T>& B) {
+	batched::checkSquare(LU);
+	batched::checkSameCount(LU, B);
+	if (B.rows != LU.rows) {
+		throw std::domain_error("Right hand side rows count must match the matrix rows count.");
+	}
+	bool interleaved = LU.isInterleaved() && B.isInterleaved();
+	batched::forBatch(LU.count, [&](std::size_t first, std::size_t last) {
+		if (interleaved) {
+			batched::solve<T, true>(LU.slice(first, last), pivots + first, LU.count, B.slice(first, last));
+		} else {
+			batched::solve<T, false>(LU.slice(first, last), pivots + first, LU.count, B.slice(first, last));
+		}
+	});
+}
+
+//Determinant of each matrix of the batch, A is left unchanged
+template<typename T>
+void batchDeterminant(const Batch<T>& A, T* determinants) {
+	batched::checkSquare(A);
+	batched::forBatch(A.count, [&](std::size_t first, std::size_t last) {
+		std::vector<T> scratch;
+		std::vector<std::int32_t> pivots;
+		Batch<T> LU;
+		batched::factorCopy(A.slice(first, last), scratch, pivots, LU);
+		std::size_t count = last - first;
+		for (std::size_t l = 0; l < count; l++) {
+			determinants[first + l] = T(1);
+		}
+		for (std::size_t c = 0; c < A.rows; c++) {
+			for (std::size_t l = 0; l < count; l++) {
+				T diagonal = LU(l, c, c);
+				determinants[first + l] *= pivots[c * count + l] == std::int32_t(c) ? diagonal : -diagonal;
+			}
+		}
+	});
+}
+
+//Inverse of each matrix of the batch, returns the number of singular matrices (whose inverse is undefined)
+template<typename T>
+std::size_t batchInverse(const Batch<T>& A, const Batch<T>& inverses) {
+	batched::checkSquare(A);
+	batched::checkSameCount(A, inverses);
+	if (inverses.rows != A.rows || inverses.columns != A.columns) {
+		throw std::domain_error("Rows and columns count must match.");
+	}
+	std::atomic<std::size_t> singular(0);
+	batched::forBatch(A.count, [&](std::size_t first, std::size_t last) {
+		std::vector<T> scratch;
+		std::vector<std::int32_t> pivots;
+		Batch<T> LU;
+		singular += batched::factorCopy(A.slice(first, last), scratch, pivots, LU);
+		Batch<T> X = inverses.slice(first, last);
+		for (std::size_t i = 0; i < A.rows; i++) {
+			for (std::size_t j = 0; j < A.columns; j++) {
+				for (std::size_t l = 0; l < X.count; l++) {
+					X(l, i, j) = i == j ? T(1) : T(0);
+				}
+			}
+		}
+		if (X.isInterleaved()) {
+			batched::solve<T, true>(LU, &pivots[0], LU.count, X);
+		} else {
+			batched::solve<T, false>(LU, &pivots[0], LU.count, X);
+		}
+	});
+	return singular;
+}
+
+#endif //OH_STRANG_BATCHED
@@ -0,0 +1,219 @@
+#ifndef OH_STRANG_COMPARISON
+#define OH_STRANG_COMPARISON
+
+#include <cstdint>
+#include <cmath>
+#include <vector>
+#include <atomic>
+#include <algorithm>
+#include <stdexcept>
+
+#include "matrix.cpp"
+#include "kernels.cpp"
+#include "parallel.cpp"
+#include "instrumentation.cpp"
+
+/*
+ * comparison.cpp
+ *
+ * Approximate equality of float and double matrices, for regression checks of large results.
+ * operator== only forgives differences below epsilon, which means nothing for values far from 1: here two values
+ * match when they are equal, or when any of the absolute, relative and ULP tolerances accepts them.
+ * The kernels (kernels::firstMismatch, kernels::compareValues) test blocks of values without branching, so they
+ * vectorize, and approxEqual stops at the first block holding a mismatch.
+ * The parallel mode splits the values in chunks of at least parallelGrain values between the threads.
+ * Both matrices have the same layout, the values being compared in its order. Dense values are scanned as one
+ * range, padded ones (layout::Padded) line by line.
+ */
+
+template<typename T>
+struct Tolerance {
+	T absolute;				//|a - b| <= absolute
+	T relative;				//|a - b| <= relative * max(|a|, |b|)
+	std::uint64_t ulps;		//at most ulps representable values from a to b, +0 and -0 being 1 apart
+
+	Tolerance(T absolute = 0, T relative = 0, std::uint64_t ulps = 0) : absolute(absolute), relative(relative),
+			ulps(ulps) {}
+
+	static Tolerance ulp(std::uint64_t ulps) {
+		return Tolerance(0, 0, ulps);
+	}
+};
+
+//Where and how much two matrices differ
+template<typename T>
+struct Deviation {
+	std::size_t mismatches;		//values out of the tolerance
+	T maxDeviation;				//largest |a - b|, infinite when a or b is NaN
+	std::size_t row;			//1 based position of maxDeviation, 0 for empty matrices
+	std::size_t column;
+	std::size_t firstRow;		//1 based position of the first mismatch in the order of the layout, 0 when there is none
+	std::size_t firstColumn;
+
+	bool equal() const {
+		return mismatches == 0;
+	}
+};
+
+namespace comparison {
+
+const std::size_t parallelGrain = 1 << 16;
+
+//Contiguous ranges of n values, a few per thread so that an early mismatch leaves the others idle soon
+inline std::vector<std::size_t> chunkBounds(std::size_t n, bool parallelScan) {
+	std::size_t chunks = parallelScan ? std::min(4 * parallel::hardwareThreads(), (n + parallelGrain - 1) / parallelGrain) : 1;
+	chunks = std::max<std::size_t>(chunks, 1);
+	std::vector<std::size_t> bounds(chunks + 1);
+	for (std::size_t c = 0; c <= chunks; c++) {
+		bounds[c] = n / chunks * c + std::min(c, n % chunks);
+	}
+	return bounds;
+}
+
+//Ranges of the values of A and B to scan: chunks of the dense values, or the lines when either is padded.
+//Segment s holds count(s) values from aOffset(s) in A, bOffset(s) in B, and first(s) in the dense order.
+struct Segments {
+	std::vector<std::size_t> bounds;
+	std::size_t length, lda, ldb;
+	bool lines;
+
+	Segments(std::size_t lineCount, std::size_t length, std::size_t lda, std::size_t ldb, bool parallelScan) :
+			length(length), lda(lda), ldb(ldb), lines(lda != length || ldb != length) {
+		if (!lines) {
+			bounds = chunkBounds(lineCount * length, parallelScan);
+		} else {
+			bounds.resize(lineCount + 1);
+		}
+	}
+
+	std::size_t size() const {
+		return bounds.size() - 1;
+	}
+
+	//Segments per task of parallel::forRange: one per chunk, lines of parallelGrain values in all
+	std::size_t grain(bool parallelScan) const {
+		if (!lines) {
+			return 1;
+		}
+		return parallelScan ? std::max<std::size_t>(1, parallelGrain / std::max<std::size_t>(1, length))
+				: std::max<std::size_t>(1, size());
+	}
+
+	std::size_t count(std::size_t s) const {
+		return lines ? length : bounds[s + 1] - bounds[s];
+	}
+
+	std::size_t first(std::size_t s) const {
+		return lines ? s * length : bounds[s];
+	}
+
+	std::size_t aOffset(std::size_t s) const {
+		return lines ? s * lda : bounds[s];
+	}
+
+	std::size_t bOffset(std::size_t s) const {
+		return lines ? s * ldb : bounds[s];
+	}
+};
+
+}
+
+//Whether every value of A matches the one of B within tolerance, false when their sizes differ
+template<typename T, class C, class L>
+bool approxEqual(const MatrixCRTP<T, C, L>& A, const MatrixCRTP<T, C, L>& B, const Tolerance<T>& tolerance,
+		bool parallelScan = false) {
+	if (A.getRowsCount() != B.getRowsCount() || A.getColumnsCount() != B.getColumnsCount()) {
+		return false;
+	}
+	const std::size_t n = A.getRowsCount() * A.getColumnsCount();
+	OH_STRANG_MEASURE(COMPARE, 3.0 * n, 0, 0);
+	if (n == 0) {
+		return true;
+	}
+	const T* a = A.getValues();
+	const T* b = B.getValues();
+	const comparison::Segments segments(L::lines(A.getRowsCount(), A.getColumnsCount()),
+			L::length(A.getRowsCount(), A.getColumnsCount()), A.getLeadingDimension(), B.getLeadingDimension(),
+			parallelScan);
+	std::atomic<bool> mismatch(false);
+	parallel::forRange(0, segments.size(), segments.grain(parallelScan),
+			[&](std::size_t firstSegment, std::size_t lastSegment) {
+		for (std::size_t c = firstSegment; c < lastSegment; c++) {
+			//the segment is scanned by steps, to stop soon after a mismatch in another one
+			const std::size_t end = segments.count(c);
+			for (std::size_t first = 0; first < end && !mismatch.load(std::memory_order_relaxed);
+					first += comparison::parallelGrain) {
+				const std::size_t count = std::min(comparison::parallelGrain, end - first);
+				if (kernels::firstMismatch(count, a + segments.aOffset(c) + first, b + segments.bOffset(c) + first,
+						tolerance.absolute, tolerance.relative, tolerance.ulps) != count) {
+					mismatch.store(true, std::memory_order_relaxed);
+				}
+			}
+		}
+	});
+	return !mismatch.load();
+}
+
+//Compares all the values of A and B of the same size, counting the mismatches and locating the largest deviation
+template<typename T, class C, class L>
+Deviation<T> deviation(const MatrixCRTP<T, C, L>& A, const MatrixCRTP<T, C, L>& B, const Tolerance<T>& tolerance,
+		bool parallelScan = false) {
+	if (A.getRowsCount() != B.getRowsCount() || A.getColumnsCount() != B.getColumnsCount()) {
+		throw std::domain_error("Matrices of different sizes cannot be compared.");
+	}
+	const std::size_t n = A.getRowsCount() * A.getColumnsCount();
+	OH_STRANG_MEASURE(COMPARE, 5.0 * n, 0, 0);
+	Deviation<T> result = { 0, 0, 0, 0, 0, 0 };
+	if (n == 0) {
+		return result;
+	}
+	const T* a = A.getValues();
+	const T* b = B.getValues();
+
+	struct Chunk {
+		std::size_t mismatches;
+		std::size_t first;
+		T deviation;
+		std::size_t at;
+	};
+	const comparison::Segments segments(L::lines(A.getRowsCount(), A.getColumnsCount()),
+			L::length(A.getRowsCount(), A.getColumnsCount()), A.getLeadingDimension(), B.getLeadingDimension(),
+			parallelScan);
+	std::vector<Chunk> chunks(segments.size());
+	parallel::forRange(0, chunks.size(), segments.grain(parallelScan),
+			[&](std::size_t firstChunk, std::size_t lastChunk) {
+		for (std::size_t c = firstChunk; c < lastChunk; c++) {
+			Chunk& chunk = chunks[c];
+			chunk.mismatches = kernels::compareValues(segments.count(c), a + segments.aOffset(c),
+					b + segments.bOffset(c), tolerance.absolute, tolerance.relative, tolerance.ulps, chunk.first,
+					chunk.deviation, chunk.at);
+			chunk.first += segments.first(c);
+			chunk.at += segments.first(c);
+		}
+	});
+
+	//the first chunk wins ties, as in a serial scan
+	std::size_t first = n;
+	std::size_t at = chunks[0].at;
+	result.maxDeviation = chunks[0].deviation;
+	for (std::size_t c = 0; c < chunks.size(); c++) {
+		result.mismatches += chunks[c].mismatches;
+		if (first == n && chunks[c].mismatches != 0) {
+			first = chunks[c].first;
+		}
+		if (chunks[c].deviation > result.maxDeviation) {
+			result.maxDeviation = chunks[c].deviation;
+			at = chunks[c].at;
+		}
+	}
+	const std::size_t length = L::length(A.getRowsCount(), A.getColumnsCount());
+	result.row = (L::rowMajor ? at / length : at % length) + 1;
+	result.column = (L::rowMajor ? at % length : at / length) + 1;
+	if (first != n) {
+		result.firstRow = (L::rowMajor ? first / length : first % length) + 1;
+		result.firstColumn = (L::rowMajor ? first % length : first / length) + 1;
+	}
+	return result;
+}
+
+#endif //OH_STRANG_COMPARISON
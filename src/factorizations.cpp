@@ -0,0 +1,483 @@
+#ifndef OH_STRANG_FACTORIZATIONS
+#define OH_STRANG_FACTORIZATIONS
+
+#include <cstddef>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+
+#include "matrix.cpp"
+#include "kernels.cpp"
+#include "structured.cpp"
+#include "vector.cpp"
+
+/*
+ * factorizations.cpp
+ *
+ * Factorizations kept up to date while their matrix changes, each change costing O(n^2) instead of the O(n^3)
+ * of factoring again:
+ *  - LUFactorization<T>, P * A = L * U with partial pivoting, for A + x * y^T (a downdate being a negative x),
+ *    a replaced row or column, and a row and a column appended
+ *  - CholeskyFactorization<T>, A = L * L^T of a symmetric positive definite A, for A + x * x^T, A - x * x^T
+ *    and a row and a column appended
+ * The updates run row by row on contiguous values. An LU update keeps the row order of the factorization
+ * (Bennett's algorithm), which is stable as long as the multipliers stay small: when one would exceed
+ * 1 / pivotThreshold the updated matrix is factored again with partial pivoting, see getRefactorizations().
+ *
+ * solveWoodbury solves with a low-rank correction of a factored matrix without updating anything.
+ */
+
+template<typename T>
+class LUFactorization {
+	std::size_t n;
+	std::vector<T> matrix;				//A, row-major, for the row and column replacements and the refactorizations
+	std::vector<T> lu;					//L below the diagonal, its unit diagonal implied, and U
+	std::vector<std::size_t> pivots;	//row exchanges, as returned by getrf
+	bool singular;
+	T pivotThreshold;
+	std::size_t refactorizations;
+	std::vector<T> work;
+
+public:
+	LUFactorization() : n(0), singular(false), pivotThreshold(T(0.1)), refactorizations(0) {}
+
+	//Factors the square A. The default threshold bounds the multipliers to 10, as threshold pivoting does.
+	template<class C>
+	explicit LUFactorization(const MatrixCRTP<T, C>& A, const T& threshold = T(0.1)) :
+			n(A.getRowsCount()), matrix(A.begin(), A.end()), singular(false), pivotThreshold(threshold),
+			refactorizations(0) {
+		if (n != A.getColumnsCount()) {
+			throw std::domain_error("Only a square matrix has an LU factorization.");
+		}
+		factor();
+	}
+
+	std::size_t getSize() const {
+		return n;
+	}
+
+	bool isSingular() const {
+		return singular;
+	}
+
+	//The updates that factored the matrix again
+	std::size_t getRefactorizations() const {
+		return refactorizations;
+	}
+
+	//The factored matrix, with the updates
+	template<class C = Matrix<T>>
+	C getMatrix() const {
+		C A(n, n, T(0), T(1));
+		std::copy(matrix.begin(), matrix.end(), A.getValues());
+		return A;
+	}
+
+	//Solves A * X = B. Returns true when A is singular, X then being B.
+	template<class C>
+	bool solve(const MatrixCRTP<T, C>& B, C& X) const {
+		if (B.getRowsCount() != n) {
+			throw std::domain_error("Right hand side rows count must match the matrix rows count.");
+		}
+		std::size_t nrhs = B.getColumnsCount();
+		X = C(n, nrhs, B.getZero(), B.getOne());
+		std::copy(B.begin(), B.end(), X.getValues());
+		return solveInPlace(nrhs, X.getValues(), nrhs);
+	}
+
+	//The nrhs columns of B are overwritten by X, unless A is singular
+	bool solveInPlace(std::size_t nrhs, T* B, std::size_t ldb) const {
+		if (singular) {
+			return true;
+		}
+		if (n > 0 && nrhs > 0) {
+			kernels::getrs(n, nrhs, &lu[0], n, &pivots[0], B, ldb);
+		}
+		return false;
+	}
+
+	//A += x * y^T
+	void update(const VectorView<T>& x, const VectorView<T>& y) {
+		if (x.getSize() != n || y.getSize() != n) {
+			throw std::domain_error("Vector sizes must match the matrix.");
+		}
+		if (n == 0) {
+			return;
+		}
+		kernels::ger(n, n, T(1), x.getValues(), x.getStride(), y.getValues(), y.getStride(), &matrix[0], n);
+		rankOne(x, y);
+	}
+
+	//Replaces the 1 based row of A by values
+	void replaceRow(int row, const VectorView<T>& values) {
+		if (row < 1 || row > n) {
+			throw std::out_of_range("Row index must be between 1 and the order of the matrix");
+		}
+		if (values.getSize() != n) {
+			throw std::domain_error("Vector sizes must match the matrix.");
+		}
+		//e_row * (values - A(row, :))
+		Vector<T> x(n), y(values);
+		x.setValue(row, T(1));
+		T* a = &matrix[(row - 1) * n];
+		for (std::size_t j = 0; j < n; j++) {
+			y.getValues()[j] -= a[j];
+			a[j] = values.getValues()[j * values.getStride()];
+		}
+		rankOne(x, y);
+	}
+
+	//Replaces the 1 based column of A by values
+	void replaceColumn(int column, const VectorView<T>& values) {
+		if (column < 1 || column > n) {
+			throw std::out_of_range("Column index must be between 1 and the order of the matrix");
+		}
+		if (values.getSize() != n) {
+			throw std::domain_error("Vector sizes must match the matrix.");
+		}
+		//(values - A(:, column)) * e_column^T
+		Vector<T> x(values), y(n);
+		y.setValue(column, T(1));
+		for (std::size_t i = 0; i < n; i++) {
+			T& a = matrix[i * n + column - 1];
+			x.getValues()[i] -= a;
+			a = values.getValues()[i * values.getStride()];
+		}
+		rankOne(x, y);
+	}
+
+	//Borders A with a last column, a last row and their common corner value
+	void append(const VectorView<T>& column, const VectorView<T>& row, const T& corner) {
+		if (column.getSize() != n || row.getSize() != n) {
+			throw std::domain_error("Vector sizes must match the matrix.");
+		}
+		const std::size_t m = n + 1;
+		std::vector<T> bordered(m * m), factors(m * m);
+		for (std::size_t i = 0; i < n; i++) {
+			std::copy(&matrix[i * n], &matrix[i * n] + n, &bordered[i * m]);
+			std::copy(&lu[i * n], &lu[i * n] + n, &factors[i * m]);
+			bordered[i * m + n] = column.getValues()[i * column.getStride()];
+			bordered[n * m + i] = row.getValues()[i * row.getStride()];
+		}
+		bordered[n * m + n] = corner;
+		matrix.swap(bordered);
+		lu.swap(factors);
+		pivots.push_back(n);
+		n = m;
+
+		//The last column of U is L^-1 * P * column, the last row of L solves l * U = row
+		const std::size_t last = n - 1;
+		T* u = &lu[0];
+		for (std::size_t i = 0; i < last; i++) {
+			u[i * n + last] = matrix[i * n + last];
+		}
+		for (std::size_t i = 0; i < last; i++) {
+			if (pivots[i] != i) {
+				std::swap(u[i * n + last], u[pivots[i] * n + last]);
+			}
+		}
+		for (std::size_t i = 1; i < last; i++) {
+			T sum = u[i * n + last];
+			for (std::size_t q = 0; q < i; q++) {
+				sum -= u[i * n + q] * u[q * n + last];
+			}
+			u[i * n + last] = sum;
+		}
+		T* l = u + last * n;
+		std::copy(&matrix[last * n], &matrix[last * n] + n, l);
+		const T limit = T(1) / pivotThreshold;
+		T pivot = l[last];
+		for (std::size_t j = 0; j < last; j++) {
+			const T* rowU = u + j * n;
+			if (rowU[j] == T(0)) {
+				refactor();
+				return;
+			}
+			l[j] /= rowU[j];
+			if (!(std::abs(l[j]) <= limit)) {
+				refactor();
+				return;
+			}
+			kernels::subtractRow(last - j - 1, l + j + 1, l[j], rowU + j + 1);
+			pivot -= l[j] * rowU[last];
+		}
+		l[last] = pivot;
+		singular = pivot == T(0);
+	}
+
+private:
+	void factor() {
+		lu = matrix;
+		pivots.assign(n, 0);
+		singular = n > 0 && kernels::getrf(n, &lu[0], n, &pivots[0]);
+	}
+
+	void refactor() {
+		refactorizations++;
+		factor();
+	}
+
+	//L * U += (P * x) * y^T, A being already updated
+	void rankOne(const VectorView<T>& x, const VectorView<T>& y) {
+		work.resize(4 * n);
+		T* px = &work[0];
+		T* py = px + n;
+		for (std::size_t i = 0; i < n; i++) {
+			px[i] = x.getValues()[i * x.getStride()];
+			py[i] = y.getValues()[i * y.getStride()];
+		}
+		for (std::size_t i = 0; i < n; i++) {
+			if (pivots[i] != i) {
+				std::swap(px[i], px[pivots[i]]);
+			}
+		}
+		if (bennett(px, py, py + n, py + 2 * n)) {
+			singular = lu[n * n - 1] == T(0);
+		} else {
+			refactor();
+		}
+	}
+
+	/*
+	 * Bennett's update of L * U by x * y^T, one row after the other. Row k of U gives the new multipliers of column k,
+	 * l' = l * scale[k] + x * shift[k] (the old over the new pivot, and y over the new pivot), and the x of the rows
+	 * below lose x[k] * l. Row i of U needs the y left by the rows of U above it.
+	 * Returns false when a multiplier grows over the threshold or a pivot vanishes, L * U being then partly updated.
+	 */
+	bool bennett(T* x, T* y, T* scale, T* shift) {
+		const T limit = T(1) / pivotThreshold;
+		for (std::size_t i = 0; i < n; i++) {
+			T* row = &lu[i * n];
+			T xi = x[i];
+			for (std::size_t k = 0; k < i; k++) {
+				const T l = row[k];
+				const T multiplier = l * scale[k] + xi * shift[k];
+				if (!(std::abs(multiplier) <= limit)) {
+					return false;
+				}
+				row[k] = multiplier;
+				xi -= x[k] * l;
+			}
+			const T old = row[i];
+			row[i] += xi * y[i];
+			x[i] = xi;
+			if (i + 1 < n) {
+				if (row[i] == T(0)) {
+					return false;
+				}
+				const T inverse = T(1) / row[i];
+				scale[i] = old * inverse;
+				shift[i] = y[i] * inverse;
+				for (std::size_t j = i + 1; j < n; j++) {
+					row[j] += xi * y[j];
+				}
+				kernels::subtractRow(n - i - 1, y + i + 1, shift[i], row + i + 1);
+			}
+		}
+		return true;
+	}
+};
+
+
+template<typename T>
+class CholeskyFactorization {
+	std::size_t n;
+	std::vector<T> factor;	//L, its packed lower triangle
+	std::vector<T> work;
+
+public:
+	CholeskyFactorization() : n(0) {}
+
+	//Factors the symmetric positive definite A, reading its lower triangle
+	template<class C>
+	explicit CholeskyFactorization(const MatrixCRTP<T, C>& A) : n(A.getRowsCount()), factor(n * (n + 1) / 2) {
+		if (n != A.getColumnsCount()) {
+			throw std::domain_error("Only a square matrix has a Cholesky factorization.");
+		}
+		for (std::size_t i = 0; i < n; i++) {
+			for (std::size_t j = 0; j <= i; j++) {
+				factor[kernels::packedRow(n, i, true) + j] = A.getValue(i + 1, j + 1);
+			}
+		}
+		decompose();
+	}
+
+	explicit CholeskyFactorization(const SymmetricMatrix<T>& A) : n(A.getRowsCount()), factor(A.begin(), A.end()) {
+		decompose();
+	}
+
+	std::size_t getSize() const {
+		return n;
+	}
+
+	//A = L * L^T
+	TriangularMatrix<T> getL() const {
+		TriangularMatrix<T> L(n, true, T(0), T(1));
+		std::copy(factor.begin(), factor.end(), L.getValues());
+		return L;
+	}
+
+	//Solves A * X = B. Returns false, A being positive definite.
+	template<class C>
+	bool solve(const MatrixCRTP<T, C>& B, C& X) const {
+		if (B.getRowsCount() != n) {
+			throw std::domain_error("Right hand side rows count must match the matrix rows count.");
+		}
+		std::size_t nrhs = B.getColumnsCount();
+		X = C(n, nrhs, B.getZero(), B.getOne());
+		std::copy(B.begin(), B.end(), X.getValues());
+		return solveInPlace(nrhs, X.getValues(), nrhs);
+	}
+
+	bool solveInPlace(std::size_t nrhs, T* B, std::size_t ldb) const {
+		if (n > 0 && nrhs > 0) {
+			kernels::pptrs(n, nrhs, &factor[0], B, ldb);
+		}
+		return false;
+	}
+
+	//A += x * x^T
+	void update(const VectorView<T>& x) {
+		rotate(T(1), x);
+	}
+
+	//A -= x * x^T. Returns false, leaving the factorization as is, when the result is not positive definite.
+	bool downdate(const VectorView<T>& x) {
+		return rotate(T(-1), x);
+	}
+
+	//Borders A with a last column and row, corner being their common value. Returns false, leaving the
+	//factorization as is, when the result is not positive definite.
+	bool append(const VectorView<T>& column, const T& corner) {
+		if (column.getSize() != n) {
+			throw std::domain_error("Vector sizes must match the matrix.");
+		}
+		//The last row of L solves L * l = column
+		work.resize(n + 1);
+		T* l = &work[0];
+		T d = corner;
+		for (std::size_t i = 0; i < n; i++) {
+			const T* row = &factor[kernels::packedRow(n, i, true)];
+			T sum = column.getValues()[i * column.getStride()];
+			for (std::size_t q = 0; q < i; q++) {
+				sum -= row[q] * l[q];
+			}
+			l[i] = sum / row[i];
+			d -= l[i] * l[i];
+		}
+		if (!(d > T(0))) {
+			return false;
+		}
+		l[n] = std::sqrt(d);
+		factor.insert(factor.end(), l, l + n + 1);
+		n++;
+		return true;
+	}
+
+private:
+	void decompose() {
+		if (n > 0 && !kernels::pptrf(n, &factor[0])) {
+			throw std::domain_error("The matrix is not positive definite.");
+		}
+	}
+
+	/*
+	 * L * L^T + sigma * x * x^T by one rotation per row, each row of L needing the rotations of the rows above it.
+	 * A downdate first computes the rotations alone, so that it fails before changing anything.
+	 */
+	bool rotate(const T& sigma, const VectorView<T>& x) {
+		if (x.getSize() != n) {
+			throw std::domain_error("Vector sizes must match the matrix.");
+		}
+		work.resize(3 * n);
+		T* values = &work[0];
+		for (std::size_t i = 0; i < n; i++) {
+			values[i] = x.getValues()[i * x.getStride()];
+		}
+		if (sigma < T(0) && !rotations(sigma, values, false)) {
+			return false;
+		}
+		return rotations(sigma, values, true);
+	}
+
+	bool rotations(const T& sigma, const T* x, bool apply) {
+		T* c = &work[n];
+		T* s = c + n;
+		for (std::size_t i = 0; i < n; i++) {
+			T* row = &factor[kernels::packedRow(n, i, true)];
+			T xi = x[i];
+			for (std::size_t k = 0; k < i; k++) {
+				const T l = (row[k] + sigma * s[k] * xi) / c[k];
+				xi = c[k] * xi - s[k] * l;
+				if (apply) {
+					row[k] = l;
+				}
+			}
+			const T d = row[i];
+			const T r2 = d * d + sigma * xi * xi;
+			if (!(r2 > T(0))) {
+				return false;
+			}
+			const T r = std::sqrt(r2);
+			c[i] = r / d;
+			s[i] = xi / d;
+			if (apply) {
+				row[i] = r;
+			}
+		}
+		return true;
+	}
+};
+
+
+/*
+ * Solves (A + U * V^T) * X = B with the factorization of A (LUFactorization, CholeskyFactorization) and the n x k
+ * U and V of a low-rank correction, by Sherman-Morrison-Woodbury: with Y = A^-1 * B and Z = A^-1 * U,
+ * X = Y - Z * (I + V^T * Z)^-1 * V^T * Y, O(n^2 * (k + nrhs) + k^3).
+ * Returns true when A or I + V^T * Z is singular.
+ */
+template<class F, typename T, class C>
+bool solveWoodbury(const F& factorization, const MatrixCRTP<T, C>& U, const MatrixCRTP<T, C>& V,
+		const MatrixCRTP<T, C>& B, C& X) {
+	const std::size_t n = factorization.getSize(), k = U.getColumnsCount(), nrhs = B.getColumnsCount();
+	if (U.getRowsCount() != n || V.getRowsCount() != n || V.getColumnsCount() != k) {
+		throw std::domain_error("The correction must be two n x k matrices.");
+	}
+	if (B.getRowsCount() != n) {
+		throw std::domain_error("Right hand side rows count must match the matrix rows count.");
+	}
+	X = C(n, nrhs, B.getZero(), B.getOne());
+	std::copy(B.begin(), B.end(), X.getValues());
+	std::vector<T> Z(U.begin(), U.end());
+	if (factorization.solveInPlace(nrhs, X.getValues(), nrhs) || factorization.solveInPlace(k, Z.data(), k)) {
+		return true;
+	}
+	if (n == 0 || k == 0 || nrhs == 0) {
+		return false;
+	}
+
+	//S = I + V^T * Z and W = V^T * Y, adding the rows of Z and Y scaled by the rows of V
+	T* y = X.getValues();
+	const T* v = &*V.begin();
+	std::vector<T> S(k * k, T(0)), W(k * nrhs, T(0));
+	for (std::size_t r = 0; r < n; r++) {
+		for (std::size_t i = 0; i < k; i++) {
+			const T vri = v[r * k + i];
+			kernels::subtractRow(k, &S[i * k], -vri, &Z[r * k]);
+			kernels::subtractRow(nrhs, &W[i * nrhs], -vri, y + r * nrhs);
+		}
+	}
+	for (std::size_t i = 0; i < k; i++) {
+		S[i * k + i] += T(1);
+	}
+	std::vector<std::size_t> pivots(k);
+	if (kernels::getrf(k, &S[0], k, &pivots[0])) {
+		return true;
+	}
+	kernels::getrs(k, nrhs, &S[0], k, &pivots[0], &W[0], nrhs);
+	kernels::gemmParallel(n, nrhs, k, T(-1), &Z[0], k, &W[0], nrhs, y, nrhs);
+	return false;
+}
+
+#endif //OH_STRANG_FACTORIZATIONS
@@ -0,0 +1,268 @@
+#ifndef OH_STRANG_INSTRUMENTATION
+#define OH_STRANG_INSTRUMENTATION
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <ostream>
+
+#include "numbers.cpp"
+
+/*
+ * instrumentation.cpp
+ *
+ * Opt-in counters for the MatrixCRTP operations: calls, wall time, estimated flops, bytes allocated
+ * and bytes copied. Compile with -DOH_STRANG_PROFILE to enable them; otherwise OH_STRANG_MEASURE expands
+ * to nothing and the snapshots are all zeros.
+ *
+ * The counters are inclusive: toLU counts its time once under toLU, and its inner multiplications
+ * again under multiply. The Chrome trace (chrome://tracing, Perfetto) shows that nesting per thread.
+ */
+
+#ifdef OH_STRANG_PROFILE
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <functional>
+#endif
+
+namespace instrumentation {
+
+enum Operation {
+	IDENTITY,
+	PERMUTATION,
+	MULTIPLY,
+	SCALAR_MULTIPLY,
+	ADD,
+	SUBTRACT,
+	TRANSPOSE,
+	SWAP_ROWS,
+	SWAP_COLUMNS,
+	CONCAT,
+	SPLIT,
+	TO_LU,
+	DET,
+	RREF,
+	GRAM,
+	TO_STRING,
+	BINDING_COPY,
+	COPY_ON_WRITE,
+	COMPARE,
+	OPERATIONS_COUNT
+};
+
+inline const char* operationName(Operation operation) {
+	static const char* names[OPERATIONS_COUNT] = { "identity", "permutation", "multiply", "scalarMultiply", "add",
+			"subtract", "transpose", "swapRows", "swapColumns", "concat", "split", "toLU", "det", "rref", "gram", "toString",
+			"bindingCopy", "copyOnWrite", "compare" };
+	return names[operation];
+}
+
+struct Counters {
+	const char* operation;
+	std::uint64_t calls;
+	double seconds;
+	double flops;
+	std::uint64_t bytesAllocated;
+	std::uint64_t bytesCopied;
+};
+
+//The counters of every operation at some point in time
+struct Snapshot {
+	std::vector<Counters> operations;
+
+	const Counters& operator[](Operation operation) const {
+		return operations[operation];
+	}
+
+	std::string toJson() const {
+		std::string json = "{";
+		for (std::size_t i = 0; i < operations.size(); i++) {
+			const Counters& c = operations[i];
+			json += (i == 0 ? "\"" : ",\"") + std::string(c.operation) + "\":{\"calls\":";
+			text::appendNumber(json, c.calls);
+			json += ",\"seconds\":";
+			text::appendNumber(json, c.seconds);
+			json += ",\"flops\":";
+			text::appendNumber(json, c.flops);
+			json += ",\"bytesAllocated\":";
+			text::appendNumber(json, c.bytesAllocated);
+			json += ",\"bytesCopied\":";
+			text::appendNumber(json, c.bytesCopied);
+			json += "}";
+		}
+		return json + "}";
+	}
+};
+
+#ifdef OH_STRANG_PROFILE
+
+const bool enabled = true;
+
+typedef std::chrono::steady_clock Clock;
+
+struct TraceEvent {
+	Operation operation;
+	std::size_t thread;
+	double start;			//microseconds since the trace started
+	double duration;
+};
+
+struct Registry {
+	std::atomic<std::uint64_t> calls[OPERATIONS_COUNT];
+	std::atomic<std::uint64_t> nanoseconds[OPERATIONS_COUNT];
+	std::atomic<std::uint64_t> flops[OPERATIONS_COUNT];
+	std::atomic<std::uint64_t> bytesAllocated[OPERATIONS_COUNT];
+	std::atomic<std::uint64_t> bytesCopied[OPERATIONS_COUNT];
+
+	std::atomic<bool> tracing;
+	Clock::time_point traceStart;
+	std::mutex traceMutex;
+	std::vector<TraceEvent> trace;
+
+	Registry() : tracing(false) {
+		clear();
+	}
+
+	void clear() {
+		for (int i = 0; i < OPERATIONS_COUNT; i++) {
+			calls[i] = 0;
+			nanoseconds[i] = 0;
+			flops[i] = 0;
+			bytesAllocated[i] = 0;
+			bytesCopied[i] = 0;
+		}
+	}
+};
+
+inline Registry& registry() {
+	static Registry instance;
+	return instance;
+}
+
+//Adds one call of operation to the counters when it goes out of scope
+class Scope {
+	public:
+		Scope(Operation operation, double flops, std::uint64_t bytesAllocated, std::uint64_t bytesCopied) :
+				operation(operation), flops(flops), bytesAllocated(bytesAllocated), bytesCopied(bytesCopied),
+				start(Clock::now()) {
+		}
+
+		~Scope() {
+			Clock::time_point end = Clock::now();
+			Registry& r = registry();
+			r.calls[operation]++;
+			r.nanoseconds[operation] += std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+			r.flops[operation] += static_cast<std::uint64_t>(flops);
+			r.bytesAllocated[operation] += bytesAllocated;
+			r.bytesCopied[operation] += bytesCopied;
+			if (r.tracing) {
+				TraceEvent event = { operation, std::hash<std::thread::id>()(std::this_thread::get_id()),
+						std::chrono::duration<double, std::micro>(start - r.traceStart).count(),
+						std::chrono::duration<double, std::micro>(end - start).count() };
+				std::lock_guard<std::mutex> lock(r.traceMutex);
+				r.trace.push_back(event);
+			}
+		}
+
+	private:
+		Operation operation;
+		double flops;
+		std::uint64_t bytesAllocated;
+		std::uint64_t bytesCopied;
+		Clock::time_point start;
+
+		Scope(const Scope&);
+		Scope& operator=(const Scope&);
+};
+
+inline Snapshot snapshot() {
+	Registry& r = registry();
+	Snapshot s;
+	for (int i = 0; i < OPERATIONS_COUNT; i++) {
+		Counters c = { operationName(Operation(i)), r.calls[i], r.nanoseconds[i] / 1e9, double(r.flops[i]),
+				r.bytesAllocated[i], r.bytesCopied[i] };
+		s.operations.push_back(c);
+	}
+	return s;
+}
+
+//Sets all the counters back to zero, the trace is left as is
+inline void reset() {
+	registry().clear();
+}
+
+//Starts recording one event per call, dropping the previous trace
+inline void startTrace() {
+	Registry& r = registry();
+	std::lock_guard<std::mutex> lock(r.traceMutex);
+	r.trace.clear();
+	r.traceStart = Clock::now();
+	r.tracing = true;
+}
+
+inline void stopTrace() {
+	registry().tracing = false;
+}
+
+//Writes the recorded events in the Chrome trace event format
+inline void writeChromeTrace(std::ostream& out) {
+	Registry& r = registry();
+	std::lock_guard<std::mutex> lock(r.traceMutex);
+	std::string json = "{\"traceEvents\":[";
+	for (std::size_t i = 0; i < r.trace.size(); i++) {
+		const TraceEvent& e = r.trace[i];
+		json += (i == 0 ? "\n" : ",\n") + std::string("{\"name\":\"") + operationName(e.operation)
+				+ "\",\"cat\":\"matrix\",\"ph\":\"X\",\"pid\":0,\"tid\":";
+		text::appendNumber(json, e.thread % 100000);
+		json += ",\"ts\":";
+		text::appendNumber(json, e.start);
+		json += ",\"dur\":";
+		text::appendNumber(json, e.duration);
+		json += "}";
+	}
+	out << json << "\n],\"displayTimeUnit\":\"ms\"}\n";
+}
+
+#define OH_STRANG_MEASURE_NAME(line) oh_strang_measure_##line
+#define OH_STRANG_MEASURE_SCOPE(line, operation, flops, allocated, copied) \
+	instrumentation::Scope OH_STRANG_MEASURE_NAME(line)(operation, flops, allocated, copied)
+//Counts the enclosing scope as one call of operation
+#define OH_STRANG_MEASURE(operation, flops, allocated, copied) \
+	OH_STRANG_MEASURE_SCOPE(__LINE__, instrumentation::operation, flops, allocated, copied)
+
+#else
+
+const bool enabled = false;
+
+inline Snapshot snapshot() {
+	Snapshot s;
+	for (int i = 0; i < OPERATIONS_COUNT; i++) {
+		Counters c = { operationName(Operation(i)), 0, 0, 0, 0, 0 };
+		s.operations.push_back(c);
+	}
+	return s;
+}
+
+inline void reset() {
+}
+
+inline void startTrace() {
+}
+
+inline void stopTrace() {
+}
+
+inline void writeChromeTrace(std::ostream& out) {
+	out << "{\"traceEvents\":[]}\n";
+}
+
+#define OH_STRANG_MEASURE(operation, flops, allocated, copied)
+
+#endif //OH_STRANG_PROFILE
+
+}
+
+#endif //OH_STRANG_INSTRUMENTATION
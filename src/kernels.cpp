@@ -0,0 +1,1304 @@
+#ifndef OH_STRANG_KERNELS
+#define OH_STRANG_KERNELS
+
+#include <cstddef>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+#include "parallel.cpp"
+#include "tuning.cpp"
+#include "storage.cpp"
+
+/*
+ * kernels.cpp
+ *
+ * Raw, row-major compute kernels working on contiguous buffers.
+ * Each buffer is described by a pointer and a leading dimension (the distance between two rows),
+ * so the same kernel can run on a whole matrix or on a tile of a bigger one.
+ */
+
+namespace kernels {
+
+//Marks a pointer as being on a cache line, so that the vectorized loops need no peeling for alignment
+#if defined(__GNUC__)
+#define OH_STRANG_ASSUME_ALIGNED(pointer) \
+	static_cast<decltype(pointer)>(__builtin_assume_aligned((pointer), storage::ALIGNMENT))
+#else
+#define OH_STRANG_ASSUME_ALIGNED(pointer) (pointer)
+#endif
+
+//gemm, the rows of B and C starting on cache lines when aligned
+template<bool aligned, typename T>
+void gemmBlocks(std::size_t m, std::size_t n, std::size_t k, const T& alpha, const T* A, std::size_t lda,
+		const T* B, std::size_t ldb, T* C, std::size_t ldc) {
+	const tuning::KernelParameters& tuned = tuning::parameters<T>();
+	const std::size_t blockK = tuned.gemmBlockK, blockN = tuned.gemmBlockN, unroll = tuned.gemmUnroll;
+	for (std::size_t pp = 0; pp < k; pp += blockK) {
+		std::size_t pEnd = std::min(k, pp + blockK);
+		for (std::size_t jj = 0; jj < n; jj += blockN) {
+			std::size_t width = std::min(n, jj + blockN) - jj;
+			for (std::size_t i = 0; i < m; i++) {
+				T* c = C + i * ldc + jj;
+				const T* a = A + i * lda;
+				if (aligned) {
+					c = OH_STRANG_ASSUME_ALIGNED(c);
+				}
+				std::size_t p = pp;
+				for (; unroll >= 4 && p + 4 <= pEnd; p += 4) {
+					const T a0 = alpha * a[p], a1 = alpha * a[p + 1], a2 = alpha * a[p + 2], a3 = alpha * a[p + 3];
+					const T* b0 = B + p * ldb + jj;
+					const T* b1 = b0 + ldb;
+					const T* b2 = b1 + ldb;
+					const T* b3 = b2 + ldb;
+					if (aligned) {
+						b0 = OH_STRANG_ASSUME_ALIGNED(b0);
+						b1 = OH_STRANG_ASSUME_ALIGNED(b1);
+						b2 = OH_STRANG_ASSUME_ALIGNED(b2);
+						b3 = OH_STRANG_ASSUME_ALIGNED(b3);
+					}
+					for (std::size_t j = 0; j < width; j++) {
+						c[j] += a0 * b0[j] + a1 * b1[j] + a2 * b2[j] + a3 * b3[j];
+					}
+				}
+				for (; unroll >= 2 && p + 2 <= pEnd; p += 2) {
+					const T a0 = alpha * a[p], a1 = alpha * a[p + 1];
+					const T* b0 = B + p * ldb + jj;
+					const T* b1 = b0 + ldb;
+					if (aligned) {
+						b0 = OH_STRANG_ASSUME_ALIGNED(b0);
+						b1 = OH_STRANG_ASSUME_ALIGNED(b1);
+					}
+					for (std::size_t j = 0; j < width; j++) {
+						c[j] += a0 * b0[j] + a1 * b1[j];
+					}
+				}
+				for (; p < pEnd; p++) {
+					const T aip = alpha * a[p];
+					const T* b = B + p * ldb + jj;
+					if (aligned) {
+						b = OH_STRANG_ASSUME_ALIGNED(b);
+					}
+					for (std::size_t j = 0; j < width; j++) {
+						c[j] += aip * b[j];
+					}
+				}
+			}
+		}
+	}
+}
+
+//Whether the rows of a buffer of leading dimension ld all start on a cache line
+template<typename T>
+inline bool alignedRows(const T* values, std::size_t ld) {
+	return storage::isAligned(values) && ld * sizeof(T) % storage::ALIGNMENT == 0;
+}
+
+//C(m x n) += alpha * A(m x k) * B(k x n)
+//The i-p-j loop order keeps the innermost loop contiguous in B and C so it vectorizes.
+//The blocking and the number of rows of B combined per pass over C come from tuning::parameters<T>().
+//When the rows of B and C start on cache lines (the padded layouts), the vector loads and stores are aligned.
+template<typename T>
+void gemm(std::size_t m, std::size_t n, std::size_t k, const T& alpha, const T* A, std::size_t lda,
+		const T* B, std::size_t ldb, T* C, std::size_t ldc) {
+	if (alignedRows(B, ldb) && alignedRows(C, ldc)
+			&& tuning::parameters<T>().gemmBlockN * sizeof(T) % storage::ALIGNMENT == 0) {
+		gemmBlocks<true>(m, n, k, alpha, A, lda, B, ldb, C, ldc);
+	} else {
+		gemmBlocks<false>(m, n, k, alpha, A, lda, B, ldb, C, ldc);
+	}
+}
+
+//Same as gemm, with the rows of C shared between the available threads
+template<typename T>
+void gemmParallel(std::size_t m, std::size_t n, std::size_t k, const T& alpha, const T* A, std::size_t lda,
+		const T* B, std::size_t ldb, T* C, std::size_t ldc) {
+	if (m * n * k < tuning::parameters<T>().gemmParallelThreshold) {
+		gemm(m, n, k, alpha, A, lda, B, ldb, C, ldc);
+		return;
+	}
+	parallel::forRange(0, m, 16, [=](std::size_t first, std::size_t last) {
+		gemm(last - first, n, k, alpha, A + first * lda, lda, B, ldb, C + first * ldc, ldc);
+	});
+}
+
+//B(n x m) = A(m x n)^T, by tiles small enough for the rows of both to stay in cache
+template<typename T>
+void transpose(std::size_t m, std::size_t n, const T* A, std::size_t lda, T* B, std::size_t ldb) {
+	const std::size_t tile = 32;
+	for (std::size_t ii = 0; ii < m; ii += tile) {
+		const std::size_t iEnd = std::min(m, ii + tile);
+		for (std::size_t jj = 0; jj < n; jj += tile) {
+			const std::size_t jEnd = std::min(n, jj + tile);
+			for (std::size_t j = jj; j < jEnd; j++) {
+				T* b = B + j * ldb;
+				for (std::size_t i = ii; i < iEnd; i++) {
+					b[i] = A[i * lda + j];
+				}
+			}
+		}
+	}
+}
+
+/*
+ * C(m x n) += alpha * op(A) * op(B), op(X) being X^T when transX is set: A is then stored k x m and B n x k.
+ * This is how the column-major matrices are read in place, their values being those of the row-major transpose.
+ * A transposed A only changes where the scalars a(i, p) are loaded from. A transposed B would make the innermost
+ * loop strided, so each block of op(B) is first transposed into a buffer, as a BLAS gemm packs its panels.
+ */
+template<typename T>
+void gemm(bool transA, bool transB, std::size_t m, std::size_t n, std::size_t k, const T& alpha, const T* A,
+		std::size_t lda, const T* B, std::size_t ldb, T* C, std::size_t ldc) {
+	if (!transA && !transB) {
+		gemm(m, n, k, alpha, A, lda, B, ldb, C, ldc);
+		return;
+	}
+	const tuning::KernelParameters& tuned = tuning::parameters<T>();
+	const std::size_t blockK = tuned.gemmBlockK, blockN = tuned.gemmBlockN, unroll = tuned.gemmUnroll;
+	//a(i, p) is A[i * rowStride + p * columnStride]
+	const std::size_t rowStride = transA ? 1 : lda, columnStride = transA ? lda : 1;
+	storage::AlignedVector<T> panel(transB ? std::min(k, blockK) * std::min(n, blockN) : 0);
+	for (std::size_t pp = 0; pp < k; pp += blockK) {
+		std::size_t pEnd = std::min(k, pp + blockK);
+		for (std::size_t jj = 0; jj < n; jj += blockN) {
+			std::size_t width = std::min(n, jj + blockN) - jj;
+			//row p of op(B) in the block starts at b + (p - pp) * ldp
+			const T* b = B + pp * ldb + jj;
+			std::size_t ldp = ldb;
+			if (transB) {
+				transpose(width, pEnd - pp, B + jj * ldb + pp, ldb, &panel[0], width);
+				b = &panel[0];
+				ldp = width;
+			}
+			for (std::size_t i = 0; i < m; i++) {
+				T* c = C + i * ldc + jj;
+				const T* a = A + i * rowStride;
+				std::size_t p = pp;
+				for (; unroll >= 4 && p + 4 <= pEnd; p += 4) {
+					const T a0 = alpha * a[p * columnStride], a1 = alpha * a[(p + 1) * columnStride],
+							a2 = alpha * a[(p + 2) * columnStride], a3 = alpha * a[(p + 3) * columnStride];
+					const T* b0 = b + (p - pp) * ldp;
+					const T* b1 = b0 + ldp;
+					const T* b2 = b1 + ldp;
+					const T* b3 = b2 + ldp;
+					for (std::size_t j = 0; j < width; j++) {
+						c[j] += a0 * b0[j] + a1 * b1[j] + a2 * b2[j] + a3 * b3[j];
+					}
+				}
+				for (; unroll >= 2 && p + 2 <= pEnd; p += 2) {
+					const T a0 = alpha * a[p * columnStride], a1 = alpha * a[(p + 1) * columnStride];
+					const T* b0 = b + (p - pp) * ldp;
+					const T* b1 = b0 + ldp;
+					for (std::size_t j = 0; j < width; j++) {
+						c[j] += a0 * b0[j] + a1 * b1[j];
+					}
+				}
+				for (; p < pEnd; p++) {
+					const T aip = alpha * a[p * columnStride];
+					const T* b0 = b + (p - pp) * ldp;
+					for (std::size_t j = 0; j < width; j++) {
+						c[j] += aip * b0[j];
+					}
+				}
+			}
+		}
+	}
+}
+
+template<typename T>
+void gemmParallel(bool transA, bool transB, std::size_t m, std::size_t n, std::size_t k, const T& alpha, const T* A,
+		std::size_t lda, const T* B, std::size_t ldb, T* C, std::size_t ldc) {
+	if (m * n * k < tuning::parameters<T>().gemmParallelThreshold) {
+		gemm(transA, transB, m, n, k, alpha, A, lda, B, ldb, C, ldc);
+		return;
+	}
+	parallel::forRange(0, m, 16, [=](std::size_t first, std::size_t last) {
+		gemm(transA, transB, last - first, n, k, alpha, transA ? A + first : A + first * lda, lda, B, ldb,
+				C + first * ldc, ldc);
+	});
+}
+
+/*
+ * In place LU decomposition with partial pivoting of the n x n matrix A: P * A = L * U.
+ * On return A holds U on and above its diagonal and the multipliers of the unit lower triangular L below it,
+ * pivots[i] is the row exchanged with row i at step i.
+ * Panels of tuning::parameters<T>().getrfBlock columns are factored one column at a time, the rest of the matrix
+ * being updated with one gemm per panel.
+ * Returns true when the matrix is singular.
+ */
+template<typename T>
+bool getrf(std::size_t n, T* A, std::size_t lda, std::size_t* pivots) {
+	bool singular = false;
+	const std::size_t block = tuning::parameters<T>().getrfBlock;
+	for (std::size_t k = 0; k < n; k += block) {
+		std::size_t width = std::min(block, n - k);
+
+		//Factor the panel A(k..n, k..k+width)
+		for (std::size_t c = k; c < k + width; c++) {
+			std::size_t best = c;
+			for (std::size_t r = c + 1; r < n; r++) {
+				if (std::abs(A[r * lda + c]) > std::abs(A[best * lda + c])) {
+					best = r;
+				}
+			}
+			pivots[c] = best;
+			if (A[best * lda + c] == T(0)) {
+				singular = true;
+				continue;
+			}
+			if (best != c) { //the whole rows are exchanged, left and right of the panel
+				std::swap_ranges(A + c * lda, A + c * lda + n, A + best * lda);
+			}
+			const T* pivotRow = A + c * lda;
+			const T inverse = T(1) / pivotRow[c];
+			for (std::size_t r = c + 1; r < n; r++) {
+				T* row = A + r * lda;
+				const T multiplier = row[c] * inverse;
+				row[c] = multiplier;
+				for (std::size_t j = c + 1; j < k + width; j++) {
+					row[j] -= multiplier * pivotRow[j];
+				}
+			}
+		}
+
+		std::size_t rest = n - k - width;
+		if (rest == 0) {
+			continue;
+		}
+		//U12 = L11^-1 * A12
+		for (std::size_t r = k + 1; r < k + width; r++) {
+			T* row = A + r * lda + k + width;
+			for (std::size_t q = k; q < r; q++) {
+				const T l = A[r * lda + q];
+				const T* above = A + q * lda + k + width;
+				for (std::size_t j = 0; j < rest; j++) {
+					row[j] -= l * above[j];
+				}
+			}
+		}
+		//A22 -= L21 * U12
+		gemmParallel(rest, rest, width, T(-1), A + (k + width) * lda + k, lda,
+				A + k * lda + k + width, lda, A + (k + width) * lda + k + width, lda);
+	}
+	return singular;
+}
+
+//Solves A * X = B for the nrhs columns of B (overwritten by X), LU and pivots being the output of getrf
+template<typename T>
+void getrs(std::size_t n, std::size_t nrhs, const T* LU, std::size_t lda, const std::size_t* pivots,
+		T* B, std::size_t ldb) {
+	for (std::size_t i = 0; i < n; i++) {
+		if (pivots[i] != i) {
+			std::swap_ranges(B + i * ldb, B + i * ldb + nrhs, B + pivots[i] * ldb);
+		}
+	}
+	//L * Y = P * B
+	for (std::size_t i = 1; i < n; i++) {
+		T* row = B + i * ldb;
+		for (std::size_t q = 0; q < i; q++) {
+			const T l = LU[i * lda + q];
+			const T* y = B + q * ldb;
+			for (std::size_t j = 0; j < nrhs; j++) {
+				row[j] -= l * y[j];
+			}
+		}
+	}
+	//U * X = Y
+	for (std::size_t i = n; i-- > 0;) {
+		T* row = B + i * ldb;
+		for (std::size_t q = i + 1; q < n; q++) {
+			const T u = LU[i * lda + q];
+			const T* x = B + q * ldb;
+			for (std::size_t j = 0; j < nrhs; j++) {
+				row[j] -= u * x[j];
+			}
+		}
+		const T inverse = T(1) / LU[i * lda + i];
+		for (std::size_t j = 0; j < nrhs; j++) {
+			row[j] *= inverse;
+		}
+	}
+}
+
+
+//Row operations of the elimination, on rows of length n
+template<typename T>
+void swapRows(std::size_t n, T* A, std::size_t lda, std::size_t rowA, std::size_t rowB) {
+	if (rowA != rowB) {
+		std::swap_ranges(A + rowA * lda, A + rowA * lda + n, A + rowB * lda);
+	}
+}
+
+template<typename T>
+void scaleRow(std::size_t n, T* row, const T& factor) {
+	for (std::size_t j = 0; j < n; j++) {
+		row[j] *= factor;
+	}
+}
+
+//row -= factor * source
+template<typename T>
+void subtractRow(std::size_t n, T* row, const T& factor, const T* source) {
+	for (std::size_t j = 0; j < n; j++) {
+		row[j] -= factor * source[j];
+	}
+}
+
+/*
+ * In place Gauss-Jordan elimination of the m x n matrix A to its reduced row echelon form.
+ * The pivot of each column is the largest remaining value of the column; values whose magnitude is at most
+ * tolerance times the largest magnitude of A count as zeros.
+ * pivotColumns receives the column of each pivot row (room for min(m, n) columns), the rank is returned.
+ * The rows below the rank are set to zero.
+ */
+template<typename T>
+std::size_t rref(std::size_t m, std::size_t n, T* A, std::size_t lda, const T& tolerance, std::size_t* pivotColumns,
+		std::false_type) {
+	T largest = T(0);
+	for (std::size_t i = 0; i < m; i++) {
+		for (std::size_t j = 0; j < n; j++) {
+			largest = std::max<T>(largest, std::abs(A[i * lda + j]));
+		}
+	}
+	const T threshold = tolerance * largest;
+
+	std::size_t rank = 0;
+	for (std::size_t c = 0; c < n && rank < m; c++) {
+		std::size_t best = rank;
+		for (std::size_t r = rank + 1; r < m; r++) {
+			if (std::abs(A[r * lda + c]) > std::abs(A[best * lda + c])) {
+				best = r;
+			}
+		}
+		if (std::abs(A[best * lda + c]) <= threshold || A[best * lda + c] == T(0)) {
+			for (std::size_t r = rank; r < m; r++) { //free column, so the rows below the pivots are zeros left of the next pivot
+				A[r * lda + c] = T(0);
+			}
+			continue;
+		}
+		swapRows(n - c, A + c, lda, rank, best);
+		T* pivotRow = A + rank * lda + c;
+		scaleRow(n - c - 1, pivotRow + 1, T(1) / pivotRow[0]);
+		pivotRow[0] = T(1);
+
+		//Clear the column above and below the pivot, the rows are independent
+		const std::size_t pivot = rank;
+		parallel::forRange(0, m, std::max<std::size_t>(1, (1 << 16) / (n - c)), [=](std::size_t first, std::size_t last) {
+			for (std::size_t r = first; r < last; r++) {
+				T* row = A + r * lda + c;
+				if (r == pivot || row[0] == T(0)) {
+					continue;
+				}
+				subtractRow(n - c - 1, row + 1, row[0], pivotRow + 1);
+				row[0] = T(0);
+			}
+		});
+		pivotColumns[rank++] = c;
+	}
+
+	for (std::size_t r = rank; r < m; r++) {
+		std::fill(A + r * lda, A + r * lda + n, T(0));
+	}
+	return rank;
+}
+
+//a * b - c * d, or an overflow_error when it does not fit in W
+template<typename W>
+W checkedCrossDifference(W a, W b, W c, W d) {
+	W ab, cd, result;
+#if defined(__GNUC__)
+	if (!__builtin_mul_overflow(a, b, &ab) && !__builtin_mul_overflow(c, d, &cd) && !__builtin_sub_overflow(ab, cd, &result)) {
+		return result;
+	}
+#else
+	auto fits = [](W x, W y) {
+		const W high = std::numeric_limits<W>::max(), low = std::numeric_limits<W>::min();
+		return x > 0 ? (y > 0 ? x <= high / y : y >= low / x) : x == 0 || (y > 0 ? x >= low / y : y >= high / x);
+	};
+	if (fits(a, b) && fits(c, d)) {
+		ab = a * b;
+		cd = c * d;
+		if (cd > 0 ? ab >= std::numeric_limits<W>::min() + cd : ab <= std::numeric_limits<W>::max() + cd) {
+			result = ab - cd;
+			return result;
+		}
+	}
+#endif
+	throw std::overflow_error("The fraction-free elimination overflows, its minors need a wider type.");
+}
+
+/*
+ * Fraction-free Gauss-Jordan elimination of an integral matrix, in a type twice as wide as T: each row operation
+ * is scaled by the pivot and divided exactly by the previous one, so every value is a minor of A and the pivots
+ * all end up equal to the determinant d of the pivot rows and columns.
+ * A receives the rows of d * R, R being the reduced row echelon form, and denominator receives d (1 for a zero
+ * matrix). pivotColumns and the rank are as for rref. Throws an overflow_error when a minor does not fit.
+ */
+template<typename T>
+std::size_t fractionFreeRref(std::size_t m, std::size_t n, T* A, std::size_t lda, std::size_t* pivotColumns,
+		T& denominator) {
+	static_assert(std::is_integral<T>::value, "Fraction-free elimination needs an integral type");
+#ifdef __SIZEOF_INT128__
+	typedef typename std::conditional<(sizeof(T) < sizeof(long long)), long long, __int128>::type W;
+#else
+	typedef long long W;
+#endif
+	auto magnitude = [](W value) { return value < 0 ? -value : value; };
+	std::vector<W> R(m * n);
+	for (std::size_t i = 0; i < m; i++) {
+		std::copy(A + i * lda, A + i * lda + n, &R[i * n]);
+	}
+
+	W previous = 1;
+	std::size_t rank = 0;
+	for (std::size_t c = 0; c < n && rank < m; c++) {
+		std::size_t best = rank;
+		for (std::size_t r = rank + 1; r < m; r++) {
+			if (magnitude(R[r * n + c]) > magnitude(R[best * n + c])) {
+				best = r;
+			}
+		}
+		if (R[best * n + c] == 0) {
+			continue;
+		}
+		std::swap_ranges(&R[rank * n], &R[rank * n] + n, &R[best * n]);
+		const W* pivotRow = &R[rank * n];
+		const W pivot = pivotRow[c];
+		for (std::size_t r = 0; r < m; r++) {
+			if (r == rank) {
+				continue;
+			}
+			W* row = &R[r * n];
+			const W factor = row[c];
+			for (std::size_t j = 0; j < n; j++) {
+				row[j] = checkedCrossDifference(row[j], pivot, factor, pivotRow[j]) / previous;
+			}
+		}
+		previous = pivot;
+		pivotColumns[rank++] = c;
+	}
+
+	for (std::size_t i = 0; i < m; i++) {
+		for (std::size_t j = 0; j < n; j++) {
+			A[i * lda + j] = static_cast<T>(R[i * n + j]);
+			if (static_cast<W>(A[i * lda + j]) != R[i * n + j]) {
+				throw std::overflow_error("The fraction-free elimination overflows, its minors need a wider type.");
+			}
+		}
+	}
+	denominator = static_cast<T>(previous);
+	return rank;
+}
+
+//Integral matrices: the fraction-free form divided by d, the values of R that are not integers being truncated
+template<typename T>
+std::size_t rref(std::size_t m, std::size_t n, T* A, std::size_t lda, const T&, std::size_t* pivotColumns,
+		std::true_type) {
+	T denominator;
+	const std::size_t rank = fractionFreeRref(m, n, A, lda, pivotColumns, denominator);
+	for (std::size_t i = 0; i < m; i++) {
+		for (std::size_t j = 0; j < n; j++) {
+			A[i * lda + j] /= denominator;
+		}
+	}
+	return rank;
+}
+
+//Floating point matrices are eliminated with partial pivoting, integral ones fraction free
+template<typename T>
+std::size_t rref(std::size_t m, std::size_t n, T* A, std::size_t lda, const T& tolerance, std::size_t* pivotColumns) {
+	return rref(m, n, A, lda, tolerance, pivotColumns, std::is_integral<T>());
+}
+
+//C = A + sign * B for m x n matrices, C may be A or B
+template<typename T>
+void addMatrices(std::size_t m, std::size_t n, const T* A, std::size_t lda, const T* B, std::size_t ldb, const T& sign,
+		T* C, std::size_t ldc) {
+	for (std::size_t i = 0; i < m; i++) {
+		const T* a = A + i * lda;
+		const T* b = B + i * ldb;
+		T* c = C + i * ldc;
+		for (std::size_t j = 0; j < n; j++) {
+			c[j] = a[j] + sign * b[j];
+		}
+	}
+}
+
+//Values of workspace used by strassen for the order n and levels of recursion
+inline std::size_t strassenWorkspace(std::size_t n, std::size_t levels) {
+	std::size_t total = 0;
+	for (; levels > 0 && n >= 2; levels--, n /= 2) {
+		total += 2 * (n / 2) * (n / 2);
+	}
+	return total;
+}
+
+/*
+ * C = A * B for n x n matrices with levels of Strassen-Winograd recursion (7 products of half order and 15 additions
+ * instead of 8 products), the products of the last level running on gemmParallel.
+ * The products and additions follow the schedule of Douglas, Heroux, Slishman and Smith, which only needs two
+ * temporaries X and Y of half order per level: strassenWorkspace(n, levels) values of workspace in total.
+ * An odd order is peeled: the recursion runs on the even leading block and the last row and column are added
+ * with gemm.
+ */
+template<typename T>
+void strassen(std::size_t n, const T* A, std::size_t lda, const T* B, std::size_t ldb, T* C, std::size_t ldc,
+		std::size_t levels, T* workspace) {
+	if (levels == 0 || n < 2) {
+		for (std::size_t i = 0; i < n; i++) {
+			std::fill(C + i * ldc, C + i * ldc + n, T(0));
+		}
+		gemmParallel(n, n, n, T(1), A, lda, B, ldb, C, ldc);
+		return;
+	}
+	const std::size_t h = n / 2, even = 2 * h;
+	T* X = workspace;
+	T* Y = workspace + h * h;
+	T* next = workspace + 2 * h * h;
+	const T* A11 = A;
+	const T* A12 = A + h;
+	const T* A21 = A + h * lda;
+	const T* A22 = A21 + h;
+	const T* B11 = B;
+	const T* B12 = B + h;
+	const T* B21 = B + h * ldb;
+	const T* B22 = B21 + h;
+	T* C11 = C;
+	T* C12 = C + h;
+	T* C21 = C + h * ldc;
+	T* C22 = C21 + h;
+	auto multiply = [=](const T* P, std::size_t ldp, const T* Q, std::size_t ldq, T* R, std::size_t ldr) {
+		strassen(h, P, ldp, Q, ldq, R, ldr, levels - 1, next);
+	};
+	const T plus = T(1), minus = T(-1);
+
+	addMatrices(h, h, A11, lda, A21, lda, minus, X, h);		//S3 = A11 - A21
+	addMatrices(h, h, B22, ldb, B12, ldb, minus, Y, h);		//T3 = B22 - B12
+	multiply(X, h, Y, h, C21, ldc);							//P7 = S3 * T3
+	addMatrices(h, h, A21, lda, A22, lda, plus, X, h);		//S1 = A21 + A22
+	addMatrices(h, h, B12, ldb, B11, ldb, minus, Y, h);		//T1 = B12 - B11
+	multiply(X, h, Y, h, C22, ldc);							//P5 = S1 * T1
+	addMatrices(h, h, X, h, A11, lda, minus, X, h);			//S2 = S1 - A11
+	addMatrices(h, h, B22, ldb, Y, h, minus, Y, h);			//T2 = B22 - T1
+	multiply(X, h, Y, h, C12, ldc);							//P6 = S2 * T2
+	addMatrices(h, h, A12, lda, X, h, minus, X, h);			//S4 = A12 - S2
+	multiply(X, h, B22, ldb, C11, ldc);						//P3 = S4 * B22
+	multiply(A11, lda, B11, ldb, X, h);						//P1 = A11 * B11
+	addMatrices(h, h, X, h, C12, ldc, plus, C12, ldc);		//U2 = P1 + P6
+	addMatrices(h, h, C12, ldc, C21, ldc, plus, C21, ldc);	//U3 = U2 + P7
+	addMatrices(h, h, C12, ldc, C22, ldc, plus, C12, ldc);	//U4 = U2 + P5
+	addMatrices(h, h, C21, ldc, C22, ldc, plus, C22, ldc);	//C22 = U3 + P5
+	addMatrices(h, h, C12, ldc, C11, ldc, plus, C12, ldc);	//C12 = U4 + P3
+	addMatrices(h, h, Y, h, B21, ldb, minus, Y, h);			//T4 = T2 - B21
+	multiply(A22, lda, Y, h, C11, ldc);						//P4 = A22 * T4
+	addMatrices(h, h, C21, ldc, C11, ldc, minus, C21, ldc);	//C21 = U3 - P4
+	multiply(A12, lda, B21, ldb, C11, ldc);					//P2 = A12 * B21
+	addMatrices(h, h, X, h, C11, ldc, plus, C11, ldc);		//C11 = P1 + P2
+
+	if (even < n) {
+		//the last column of A times the last row of B, then the last column and the last row of C
+		gemm(even, even, 1, T(1), A + even, lda, B + even * ldb, ldb, C, ldc);
+		for (std::size_t i = 0; i < even; i++) {
+			C[i * ldc + even] = T(0);
+		}
+		gemm(even, 1, n, T(1), A, lda, B + even, ldb, C + even, ldc);
+		std::fill(C + even * ldc, C + even * ldc + n, T(0));
+		gemm(1, n, n, T(1), A + even * lda, lda, B, ldb, C + even * ldc, ldc);
+	}
+}
+
+/*
+ * Kernels of the structured storage (structured.cpp).
+ * A packed triangle of order n holds its rows one after the other: row i of a lower triangle has the columns 0..i,
+ * row i of an upper triangle the columns i..n-1.
+ * A band of kl subdiagonals and ku superdiagonals holds in row i the columns i-kl..i+ku, ldab values apart,
+ * (i, j) being at i * ldab + j - i + kl.
+ */
+
+//Offset of row i in a packed triangle of order n
+inline std::size_t packedRow(std::size_t n, std::size_t i, bool lower) {
+	return lower ? i * (i + 1) / 2 : i * n - i * (i - 1) / 2;
+}
+
+//B = T * B for the packed triangle T, whose diagonal is ones when unit is set
+template<typename T>
+void trmm(bool lower, bool unit, std::size_t n, std::size_t nrhs, const T* P, T* B, std::size_t ldb) {
+	//each row only reads the rows not yet overwritten: the rows above for a lower triangle, below for an upper one
+	for (std::size_t k = 0; k < n; k++) {
+		const std::size_t i = lower ? n - 1 - k : k;
+		const T* row = P + packedRow(n, i, lower);
+		T* b = B + i * ldb;
+		if (!unit) {
+			scaleRow(nrhs, b, row[lower ? i : 0]);
+		}
+		const std::size_t first = lower ? 0 : i + 1, last = lower ? i : n;
+		for (std::size_t q = first; q < last; q++) {
+			subtractRow(nrhs, b, T(0) - row[lower ? q : q - i], B + q * ldb);
+		}
+	}
+}
+
+//Solves T * X = B for the packed triangle T, B being overwritten by X. Returns true when T is singular.
+template<typename T>
+bool trsm(bool lower, bool unit, std::size_t n, std::size_t nrhs, const T* P, T* B, std::size_t ldb) {
+	if (!unit) {
+		for (std::size_t i = 0; i < n; i++) {
+			if (P[packedRow(n, i, lower) + (lower ? i : 0)] == T(0)) {
+				return true;
+			}
+		}
+	}
+	for (std::size_t k = 0; k < n; k++) {
+		const std::size_t i = lower ? k : n - 1 - k;
+		const T* row = P + packedRow(n, i, lower);
+		T* b = B + i * ldb;
+		const std::size_t first = lower ? 0 : i + 1, last = lower ? i : n;
+		for (std::size_t q = first; q < last; q++) {
+			subtractRow(nrhs, b, row[lower ? q : q - i], B + q * ldb);
+		}
+		if (!unit) {
+			scaleRow(nrhs, b, T(1) / row[lower ? i : 0]);
+		}
+	}
+	return false;
+}
+
+//C = S * B for the symmetric S stored as its packed lower triangle
+template<typename T>
+void spmm(std::size_t n, std::size_t nrhs, const T* P, const T* B, std::size_t ldb, T* C, std::size_t ldc) {
+	for (std::size_t i = 0; i < n; i++) {
+		std::fill(C + i * ldc, C + i * ldc + nrhs, T(0));
+	}
+	for (std::size_t i = 0; i < n; i++) {
+		const T* row = P + packedRow(n, i, true);
+		T* c = C + i * ldc;
+		for (std::size_t q = 0; q < i; q++) {
+			subtractRow(nrhs, c, T(0) - row[q], B + q * ldb);
+			subtractRow(nrhs, C + q * ldc, T(0) - row[q], B + i * ldb);
+		}
+		subtractRow(nrhs, c, T(0) - row[i], B + i * ldb);
+	}
+}
+
+/*
+ * In place L * D * L^T decomposition, without pivoting, of the symmetric S stored as its packed lower triangle:
+ * D ends on the diagonal and the unit lower triangular L below it.
+ * The rows are computed one after the other, each one only reading the rows above it, so the inner products
+ * run on contiguous prefixes. Returns false on a zero pivot.
+ */
+template<typename T>
+bool sptrf(std::size_t n, T* P) {
+	for (std::size_t i = 0; i < n; i++) {
+		T* row = P + packedRow(n, i, true);
+		//row[j] = L(i, j) * D(j) for j < i
+		for (std::size_t j = 0; j < i; j++) {
+			const T* above = P + packedRow(n, j, true);
+			T sum = row[j];
+			for (std::size_t k = 0; k < j; k++) {
+				sum -= row[k] * above[k];
+			}
+			row[j] = sum;
+		}
+		T d = row[i];
+		for (std::size_t k = 0; k < i; k++) {
+			const T l = row[k] / P[packedRow(n, k, true) + k];
+			d -= row[k] * l;
+			row[k] = l;
+		}
+		if (d == T(0)) {
+			return false;
+		}
+		row[i] = d;
+	}
+	return true;
+}
+
+//Solves S * X = B, P being the output of sptrf
+template<typename T>
+void sptrs(std::size_t n, std::size_t nrhs, const T* P, T* B, std::size_t ldb) {
+	//L * Y = B
+	for (std::size_t i = 0; i < n; i++) {
+		const T* row = P + packedRow(n, i, true);
+		for (std::size_t q = 0; q < i; q++) {
+			subtractRow(nrhs, B + i * ldb, row[q], B + q * ldb);
+		}
+	}
+	//D * L^T * X = Y, the rows of L being the columns of L^T
+	for (std::size_t i = n; i-- > 0;) {
+		const T* row = P + packedRow(n, i, true);
+		scaleRow(nrhs, B + i * ldb, T(1) / row[i]);
+	}
+	for (std::size_t i = n; i-- > 0;) {
+		const T* row = P + packedRow(n, i, true);
+		for (std::size_t q = 0; q < i; q++) {
+			subtractRow(nrhs, B + q * ldb, row[q], B + i * ldb);
+		}
+	}
+}
+
+/*
+ * In place Cholesky decomposition S = L * L^T of the symmetric positive definite S stored as its packed lower
+ * triangle, L taking its place. Row by row like sptrf. Returns false when S is not positive definite.
+ */
+template<typename T>
+bool pptrf(std::size_t n, T* P) {
+	for (std::size_t i = 0; i < n; i++) {
+		T* row = P + packedRow(n, i, true);
+		for (std::size_t j = 0; j <= i; j++) {
+			const T* above = P + packedRow(n, j, true);
+			T sum = row[j];
+			for (std::size_t k = 0; k < j; k++) {
+				sum -= row[k] * above[k];
+			}
+			if (j < i) {
+				row[j] = sum / above[j];
+			} else if (!(sum > T(0))) {
+				return false;
+			} else {
+				row[i] = std::sqrt(sum);
+			}
+		}
+	}
+	return true;
+}
+
+//Solves S * X = B, P being the output of pptrf
+template<typename T>
+void pptrs(std::size_t n, std::size_t nrhs, const T* P, T* B, std::size_t ldb) {
+	//L * Y = B
+	for (std::size_t i = 0; i < n; i++) {
+		const T* row = P + packedRow(n, i, true);
+		for (std::size_t q = 0; q < i; q++) {
+			subtractRow(nrhs, B + i * ldb, row[q], B + q * ldb);
+		}
+		scaleRow(nrhs, B + i * ldb, T(1) / row[i]);
+	}
+	//L^T * X = Y, the rows of L being the columns of L^T
+	for (std::size_t i = n; i-- > 0;) {
+		const T* row = P + packedRow(n, i, true);
+		scaleRow(nrhs, B + i * ldb, T(1) / row[i]);
+		for (std::size_t q = 0; q < i; q++) {
+			subtractRow(nrhs, B + q * ldb, row[q], B + i * ldb);
+		}
+	}
+}
+
+//C = A * B for the band A
+template<typename T>
+void gbmm(std::size_t n, std::size_t kl, std::size_t ku, std::size_t nrhs, const T* A, std::size_t ldab,
+		const T* B, std::size_t ldb, T* C, std::size_t ldc) {
+	for (std::size_t i = 0; i < n; i++) {
+		T* c = C + i * ldc;
+		std::fill(c, c + nrhs, T(0));
+		const std::size_t first = i > kl ? i - kl : 0, last = std::min(n, i + ku + 1);
+		for (std::size_t j = first; j < last; j++) {
+			subtractRow(nrhs, c, T(0) - A[i * ldab + j + kl - i], B + j * ldb);
+		}
+	}
+}
+
+/*
+ * In place LU decomposition with partial pivoting of the band A, stored with ldab = 2 * kl + ku + 1 so that
+ * the row exchanges can fill U up to kl + ku superdiagonals; the extra superdiagonals must be zeros on entry.
+ * pivots[c] is the row exchanged with row c at step c, the multipliers of step c stay below the pivot.
+ * Returns true when the matrix is singular.
+ */
+template<typename T>
+bool gbtrf(std::size_t n, std::size_t kl, std::size_t ku, T* A, std::size_t ldab, std::size_t* pivots) {
+	bool singular = false;
+	//(i, j) with room for the fill-in
+	auto at = [=](std::size_t i, std::size_t j) -> T& { return A[i * ldab + j + kl - i]; };
+	for (std::size_t c = 0; c < n; c++) {
+		const std::size_t lastRow = std::min(n - 1, c + kl), lastColumn = std::min(n - 1, c + kl + ku);
+		std::size_t best = c;
+		for (std::size_t r = c + 1; r <= lastRow; r++) {
+			if (std::abs(at(r, c)) > std::abs(at(best, c))) {
+				best = r;
+			}
+		}
+		pivots[c] = best;
+		if (at(best, c) == T(0)) {
+			singular = true;
+			continue;
+		}
+		if (best != c) {
+			for (std::size_t j = c; j <= lastColumn; j++) {
+				std::swap(at(c, j), at(best, j));
+			}
+		}
+		const T inverse = T(1) / at(c, c);
+		for (std::size_t r = c + 1; r <= lastRow; r++) {
+			const T multiplier = at(r, c) * inverse;
+			at(r, c) = multiplier;
+			subtractRow(lastColumn - c, &at(r, c + 1), multiplier, &at(c, c + 1));
+		}
+	}
+	return singular;
+}
+
+//Solves A * X = B for the nrhs columns of B (overwritten by X), A and pivots being the output of gbtrf
+template<typename T>
+void gbtrs(std::size_t n, std::size_t kl, std::size_t ku, std::size_t nrhs, const T* A, std::size_t ldab,
+		const std::size_t* pivots, T* B, std::size_t ldb) {
+	for (std::size_t c = 0; c < n; c++) {
+		swapRows(nrhs, B, ldb, c, pivots[c]);
+		for (std::size_t r = c + 1; r <= std::min(n - 1, c + kl); r++) {
+			subtractRow(nrhs, B + r * ldb, A[r * ldab + c + kl - r], B + c * ldb);
+		}
+	}
+	for (std::size_t i = n; i-- > 0;) {
+		T* b = B + i * ldb;
+		for (std::size_t j = i + 1; j <= std::min(n - 1, i + kl + ku); j++) {
+			subtractRow(nrhs, b, A[i * ldab + j + kl - i], B + j * ldb);
+		}
+		scaleRow(nrhs, b, T(1) / A[i * ldab + kl]);
+	}
+}
+
+/*
+ * Thomas algorithm for the tridiagonal A, stored as a band with kl = ku = 1 and ldab = 3: O(n) operations per column
+ * of B, without pivoting. Returns false, leaving B untouched, on a zero pivot; diagonally dominant and
+ * positive definite matrices never have one.
+ */
+template<typename T>
+bool gtsv(std::size_t n, std::size_t nrhs, const T* A, T* B, std::size_t ldb) {
+	//upper[i] is the superdiagonal of the eliminated row i divided by its pivot
+	if (n == 0) {
+		return true;
+	}
+	std::vector<T> upper(n), inverse(n);
+	for (std::size_t i = 0; i < n; i++) {
+		const T pivot = A[i * 3 + 1] - (i > 0 ? A[i * 3] * upper[i - 1] : T(0));
+		if (pivot == T(0)) {
+			return false;
+		}
+		inverse[i] = T(1) / pivot;
+		upper[i] = i + 1 < n ? A[i * 3 + 2] * inverse[i] : T(0);
+	}
+	for (std::size_t i = 0; i < n; i++) {
+		T* b = B + i * ldb;
+		if (i > 0) {
+			subtractRow(nrhs, b, A[i * 3], b - ldb);
+		}
+		scaleRow(nrhs, b, inverse[i]);
+	}
+	for (std::size_t i = n - 1; i-- > 0;) {
+		subtractRow(nrhs, B + i * ldb, upper[i], B + (i + 1) * ldb);
+	}
+	return true;
+}
+
+/*
+ * Lower triangle of the symmetric n x n C += A^T * A, A being k x n, or C += A * A^T when outer is set, A being n x k.
+ * Row i of C starts at i * ldc, or at packedRow(n, i, true) when ldc is 0 (packed lower storage).
+ * A^T * A adds, for each row a of A, a[i] * a[0..i] to row i of C: contiguous rank one updates, blocked over the rows
+ * of A like gemm. A * A^T takes the inner product of rows i and j of A, with four accumulators so it vectorizes.
+ * The rows of C are shared between the threads in pairs i and n - 1 - i, which have the same number of values.
+ */
+template<typename T>
+void syrk(bool outer, std::size_t n, std::size_t k, const T* A, std::size_t lda, T* C, std::size_t ldc) {
+	const tuning::KernelParameters& tuned = tuning::parameters<T>();
+	const std::size_t blockK = tuned.gemmBlockK;
+	auto rowOf = [=](std::size_t i) { return C + (ldc ? i * ldc : packedRow(n, i, true)); };
+	auto rows = [=](std::size_t firstPair, std::size_t lastPair) {
+		for (std::size_t pp = 0; pp < (outer ? n : k); pp += blockK) {
+			const std::size_t pEnd = std::min(outer ? n : k, pp + blockK);
+			for (std::size_t q = firstPair; q < lastPair; q++) {
+				for (std::size_t side = 0; side < (n - 1 - q == q ? 1 : 2); side++) {
+					const std::size_t i = side == 0 ? q : n - 1 - q;
+					T* c = rowOf(i);
+					if (!outer) {
+						for (std::size_t p = pp; p < pEnd; p++) {
+							const T* a = A + p * lda;
+							const T aip = a[i];
+							for (std::size_t j = 0; j <= i; j++) {
+								c[j] += aip * a[j];
+							}
+						}
+						continue;
+					}
+					//blocked over the rows j of A, which stay in cache from one row i to the next
+					const T* ai = A + i * lda;
+					for (std::size_t j = pp; j < std::min(pEnd, i + 1); j++) {
+						const T* aj = A + j * lda;
+						T s0 = T(0), s1 = T(0), s2 = T(0), s3 = T(0);
+						std::size_t p = 0;
+						for (; p + 4 <= k; p += 4) {
+							s0 += ai[p] * aj[p];
+							s1 += ai[p + 1] * aj[p + 1];
+							s2 += ai[p + 2] * aj[p + 2];
+							s3 += ai[p + 3] * aj[p + 3];
+						}
+						for (; p < k; p++) {
+							s0 += ai[p] * aj[p];
+						}
+						c[j] += (s0 + s1) + (s2 + s3);
+					}
+				}
+			}
+		}
+	};
+	const std::size_t pairs = (n + 1) / 2;
+	if (n * n * k / 2 < tuned.gemmParallelThreshold) {
+		rows(0, pairs);
+		return;
+	}
+	parallel::forRange(0, pairs, 8, rows);
+}
+
+/*
+ * Vector kernels on strided vectors: element i of x is x[i * incx].
+ * Unit strides take loops the compiler vectorizes, the reductions keeping four partial sums.
+ * The reductions over long vectors are split in blocks of VECTOR_BLOCK values whose partial sums are added in order,
+ * so the result does not depend on the number of threads.
+ */
+
+const std::size_t VECTOR_BLOCK = 1 << 14;
+
+template<typename T, typename F>
+T blockedSum(std::size_t n, F partial) {
+	const std::size_t blocks = (n + VECTOR_BLOCK - 1) / VECTOR_BLOCK;
+	if (blocks <= 1) {
+		return partial(0, n);
+	}
+	std::vector<T> sums(blocks);
+	const std::size_t grain = std::max<std::size_t>(1, tuning::parameters<T>().gemmParallelThreshold / VECTOR_BLOCK);
+	parallel::forRange(0, blocks, grain, [&](std::size_t first, std::size_t last) {
+		for (std::size_t b = first; b < last; b++) {
+			sums[b] = partial(b * VECTOR_BLOCK, std::min(n, (b + 1) * VECTOR_BLOCK));
+		}
+	});
+	T sum = T(0);
+	for (std::size_t b = 0; b < blocks; b++) {
+		sum += sums[b];
+	}
+	return sum;
+}
+
+//Inner product of the values first..last of x and y, on the calling thread
+template<typename T>
+T dotRange(std::size_t first, std::size_t last, const T* x, std::size_t incx, const T* y, std::size_t incy) {
+	T s0 = T(0), s1 = T(0), s2 = T(0), s3 = T(0);
+	std::size_t i = first;
+	if (incx == 1 && incy == 1) {
+		for (; i + 4 <= last; i += 4) {
+			s0 += x[i] * y[i];
+			s1 += x[i + 1] * y[i + 1];
+			s2 += x[i + 2] * y[i + 2];
+			s3 += x[i + 3] * y[i + 3];
+		}
+	}
+	for (; i < last; i++) {
+		s0 += x[i * incx] * y[i * incy];
+	}
+	return (s0 + s1) + (s2 + s3);
+}
+
+template<typename T>
+T dot(std::size_t n, const T* x, std::size_t incx, const T* y, std::size_t incy) {
+	return blockedSum<T>(n, [=](std::size_t first, std::size_t last) {
+		return dotRange(first, last, x, incx, y, incy);
+	});
+}
+
+//Sum of the magnitudes
+template<typename T>
+T asum(std::size_t n, const T* x, std::size_t incx) {
+	return blockedSum<T>(n, [=](std::size_t first, std::size_t last) {
+		T s0 = T(0), s1 = T(0);
+		std::size_t i = first;
+		for (; incx == 1 && i + 2 <= last; i += 2) {
+			s0 += std::abs(x[i]);
+			s1 += std::abs(x[i + 1]);
+		}
+		for (; i < last; i++) {
+			s0 += std::abs(x[i * incx]);
+		}
+		return s0 + s1;
+	});
+}
+
+//Largest magnitude
+template<typename T>
+T amax(std::size_t n, const T* x, std::size_t incx) {
+	T largest = T(0);
+	for (std::size_t i = 0; i < n; i++) {
+		largest = std::max<T>(largest, std::abs(x[i * incx]));
+	}
+	return largest;
+}
+
+//Euclidean norm, rescaled by the largest magnitude when the sum of squares overflows or underflows
+template<typename T>
+T nrm2(std::size_t n, const T* x, std::size_t incx) {
+	T norm = std::sqrt(dot(n, x, incx, x, incx));
+	if (norm > std::numeric_limits<T>::max() || (norm < std::sqrt(std::numeric_limits<T>::min()) && norm >= T(0))) {
+		const T scale = amax(n, x, incx);
+		if (scale == T(0) || scale > std::numeric_limits<T>::max()) {
+			return scale;
+		}
+		const T inverse = T(1) / scale;
+		T sum = T(0);
+		for (std::size_t i = 0; i < n; i++) {
+			const T v = x[i * incx] * inverse;
+			sum += v * v;
+		}
+		norm = scale * std::sqrt(sum);
+	}
+	return norm;
+}
+
+//y += alpha * x
+template<typename T>
+void axpy(std::size_t n, const T& alpha, const T* x, std::size_t incx, T* y, std::size_t incy) {
+	const std::size_t grain = std::max<std::size_t>(VECTOR_BLOCK, tuning::parameters<T>().gemmParallelThreshold);
+	parallel::forRange(0, n, grain, [=](std::size_t first, std::size_t last) {
+		if (incx == 1 && incy == 1) {
+			for (std::size_t i = first; i < last; i++) {
+				y[i] += alpha * x[i];
+			}
+			return;
+		}
+		for (std::size_t i = first; i < last; i++) {
+			y[i * incy] += alpha * x[i * incx];
+		}
+	});
+}
+
+/*
+ * y = alpha * A * x + beta * y for the m x n A, or y = alpha * A^T * x + beta * y when transposed is set.
+ * Each value of A is read once, in storage order: A * x takes the inner product of each row with x,
+ * A^T * x adds alpha * x[i] times row i to y. The threads take rows of A for A * x and columns for A^T * x,
+ * so they never write the same value of y.
+ */
+template<typename T>
+void gemv(bool transposed, std::size_t m, std::size_t n, const T& alpha, const T* A, std::size_t lda,
+		const T* x, std::size_t incx, const T& beta, T* y, std::size_t incy) {
+	const std::size_t outputs = transposed ? n : m;
+	const std::size_t grain = std::max<std::size_t>(16, tuning::parameters<T>().gemmParallelThreshold / std::max<std::size_t>(1, m * n / outputs));
+	parallel::forRange(0, outputs, grain, [=](std::size_t first, std::size_t last) {
+		for (std::size_t i = first; i < last; i++) {
+			y[i * incy] = beta == T(0) ? T(0) : beta * y[i * incy];
+		}
+		if (!transposed) {
+			for (std::size_t i = first; i < last; i++) {
+				y[i * incy] += alpha * dotRange<T>(0, n, A + i * lda, 1, x, incx);
+			}
+			return;
+		}
+		for (std::size_t i = 0; i < m; i++) {
+			const T xi = alpha * x[i * incx];
+			const T* a = A + i * lda;
+			if (incy == 1) {
+				for (std::size_t j = first; j < last; j++) {
+					y[j] += xi * a[j];
+				}
+			} else {
+				for (std::size_t j = first; j < last; j++) {
+					y[j * incy] += xi * a[j];
+				}
+			}
+		}
+	});
+}
+
+//A += alpha * x * y^T for the m x n A
+template<typename T>
+void ger(std::size_t m, std::size_t n, const T& alpha, const T* x, std::size_t incx, const T* y, std::size_t incy,
+		T* A, std::size_t lda) {
+	const std::size_t grain = std::max<std::size_t>(16, tuning::parameters<T>().gemmParallelThreshold / std::max<std::size_t>(1, n));
+	parallel::forRange(0, m, grain, [=](std::size_t first, std::size_t last) {
+		for (std::size_t i = first; i < last; i++) {
+			const T xi = alpha * x[i * incx];
+			T* a = A + i * lda;
+			if (incy == 1) {
+				for (std::size_t j = 0; j < n; j++) {
+					a[j] += xi * y[j];
+				}
+			} else {
+				for (std::size_t j = 0; j < n; j++) {
+					a[j] += xi * y[j * incy];
+				}
+			}
+		}
+	});
+}
+
+
+/*
+ * Approximate equality of values, see comparison.cpp. x and y match when they are equal, when |x - y| is at most
+ * absolute or relative * max(|x|, |y|), or when at most ulps floating point values lie between them; NaN matches
+ * nothing. The values are tested by blocks of compareBlock without any branch, so that the loops over a block
+ * vectorize, with one branch per block to stop at the first mismatch.
+ */
+const std::size_t compareBlock = 256;
+
+//Targets where the blocks of 64 bit values vectorize: x86 needs the 64 bit integer compares of SSE4.2
+#if defined(__SSE4_2__) || defined(__AVX__) || defined(__aarch64__)
+#define OH_STRANG_VECTOR_COMPARE 1
+#endif
+
+template<typename T>
+struct OrderedBits;
+
+template<>
+struct OrderedBits<float> {
+	typedef std::int32_t type;
+};
+
+template<>
+struct OrderedBits<double> {
+	typedef std::int64_t type;
+};
+
+//The bits of value as an integer ordered like the values, -0 being just below +0
+template<typename T>
+inline typename OrderedBits<T>::type orderedBits(T value) {
+	typedef typename OrderedBits<T>::type I;
+	I bits;
+	std::memcpy(&bits, &value, sizeof(T));
+	return bits ^ ((bits >> (8 * sizeof(T) - 1)) & std::numeric_limits<I>::max());
+}
+
+//Without the ULP test when ulp is false, which is the same when ulps is 0 and much cheaper for 64 bit values on SSE2
+template<bool ulp = true, typename T>
+inline bool matches(T x, T y, T absolute, T relative,
+		typename std::make_unsigned<typename OrderedBits<T>::type>::type ulps) {
+	typedef typename std::make_unsigned<typename OrderedBits<T>::type>::type U;
+	const T difference = std::abs(x - y);
+	const bool close = (x == y) | (difference <= absolute)
+			| (difference <= relative * std::max(std::abs(x), std::abs(y)));
+	if (!ulp) {
+		return close;
+	}
+	const typename OrderedBits<T>::type a = orderedBits(x), b = orderedBits(y);
+	const U distance = a > b ? U(a) - U(b) : U(b) - U(a);
+	return close | ((distance <= ulps) & (x == x) & (y == y));
+}
+
+//|x - y|, 0 for equal infinities and infinite when x or y is NaN
+template<typename T>
+inline T deviation(T x, T y) {
+	const T difference = x == y ? T(0) : std::abs(x - y);
+	return difference == difference ? difference : std::numeric_limits<T>::infinity();
+}
+
+//ulps within the range of the ordered bits of T
+template<typename T>
+inline typename std::make_unsigned<typename OrderedBits<T>::type>::type ulpLimit(std::uint64_t ulps) {
+	typedef typename std::make_unsigned<typename OrderedBits<T>::type>::type U;
+	return ulps < std::numeric_limits<U>::max() ? U(ulps) : std::numeric_limits<U>::max();
+}
+
+/*
+ * Mismatches among count values, and into largest the bits of their largest deviation, which order like the
+ * deviations as those are never negative. count is compareBlock for all the blocks but the last one, so that the loop
+ * has a constant trip count: the cheap vectorizer of -O2 needs one.
+ */
+template<bool ulp, typename T, typename U>
+inline std::size_t compareBlockValues(std::size_t count, const T* x, const T* y, T absolute, T relative, U ulps,
+		typename OrderedBits<T>::type& largest) {
+	std::size_t mismatches = 0;
+	typename OrderedBits<T>::type bits = 0;
+	if (count == compareBlock) {
+		for (std::size_t i = 0; i < compareBlock; i++) {
+			mismatches += !matches<ulp>(x[i], y[i], absolute, relative, ulps);
+			bits = std::max(bits, orderedBits(kernels::deviation(x[i], y[i])));
+		}
+	} else {
+		for (std::size_t i = 0; i < count; i++) {
+			mismatches += !matches<ulp>(x[i], y[i], absolute, relative, ulps);
+			bits = std::max(bits, orderedBits(kernels::deviation(x[i], y[i])));
+		}
+	}
+	largest = bits;
+	return mismatches;
+}
+
+template<bool ulp, typename T, typename U>
+inline std::size_t countMismatches(std::size_t count, const T* x, const T* y, T absolute, T relative, U ulps) {
+	std::size_t mismatches = 0;
+	if (count == compareBlock) {
+		for (std::size_t i = 0; i < compareBlock; i++) {
+			mismatches += !matches<ulp>(x[i], y[i], absolute, relative, ulps);
+		}
+	} else {
+		for (std::size_t i = 0; i < count; i++) {
+			mismatches += !matches<ulp>(x[i], y[i], absolute, relative, ulps);
+		}
+	}
+	return mismatches;
+}
+
+//Index of the first of the n values of x not matching the one of y, n when they all match
+template<typename T>
+std::size_t firstMismatch(std::size_t n, const T* x, const T* y, T absolute, T relative, std::uint64_t ulps) {
+	const auto limit = ulpLimit<T>(ulps);
+#ifndef OH_STRANG_VECTOR_COMPARE
+	if (sizeof(T) == 8) { //the blocks would run scalar: stopping right at the mismatch is faster
+		for (std::size_t i = 0; i < n; i++) {
+			if (x[i] != y[i] && !matches(x[i], y[i], absolute, relative, limit)) {
+				return i;
+			}
+		}
+		return n;
+	}
+#endif
+	for (std::size_t first = 0; first < n; first += compareBlock) {
+		const std::size_t count = std::min(compareBlock, n - first);
+		if ((limit == 0 ? countMismatches<false>(count, x + first, y + first, absolute, relative, limit) :
+				countMismatches<true>(count, x + first, y + first, absolute, relative, limit)) != 0) {
+			while (matches(x[first], y[first], absolute, relative, limit)) {
+				first++;
+			}
+			return first;
+		}
+	}
+	return n;
+}
+
+/*
+ * Full comparison of n values: returns the number of mismatches, the index of the first one going to first (n when
+ * there is none), the largest deviation(x, y) to deviation and its index to at (n when n is 0).
+ */
+template<typename T>
+std::size_t compareValues(std::size_t n, const T* x, const T* y, T absolute, T relative, std::uint64_t ulps,
+		std::size_t& first, T& deviation, std::size_t& at) {
+	const auto limit = ulpLimit<T>(ulps);
+	std::size_t mismatches = 0;
+	typename OrderedBits<T>::type largest = -1;
+	first = n;
+	at = n;
+	for (std::size_t begin = 0; begin < n; begin += compareBlock) {
+		typename OrderedBits<T>::type blockLargest;
+		const std::size_t count = std::min(compareBlock, n - begin);
+		const std::size_t blockMismatches = limit == 0 ?
+				compareBlockValues<false>(count, x + begin, y + begin, absolute, relative, limit, blockLargest) :
+				compareBlockValues<true>(count, x + begin, y + begin, absolute, relative, limit, blockLargest);
+		if (blockMismatches != 0 && first == n) {
+			first = begin;
+			while (matches(x[first], y[first], absolute, relative, limit)) {
+				first++;
+			}
+		}
+		if (blockLargest > largest) {
+			largest = blockLargest;
+			at = begin;
+			while (orderedBits(kernels::deviation(x[at], y[at])) != blockLargest) {
+				at++;
+			}
+		}
+		mismatches += blockMismatches;
+	}
+	deviation = n == 0 ? T(0) : kernels::deviation(x[at], y[at]);
+	return mismatches;
+}
+
+}
+
+#endif //OH_STRANG_KERNELS
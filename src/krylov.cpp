@@ -0,0 +1,666 @@
+#ifndef OH_STRANG_KRYLOV
+#define OH_STRANG_KRYLOV
+
+#include <cmath>
+#include <limits>
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+
+#include "matrix.cpp"
+#include "parallel.cpp"
+
+/*
+ * krylov.cpp
+ *
+ * Matrix-free iterative solvers for A * x = b: conjugate gradient, BiCGSTAB and restarted GMRES.
+ *
+ * An operator is any class with
+ *   std::size_t size() const;						//order of the square operator
+ *   void apply(const T* x, T* y) const;			//y = A * x
+ * DenseOperator wraps a square Matrix, CsrMatrix is a sparse matrix and CallbackOperator a user function.
+ *
+ * A preconditioner M is any class with
+ *   void apply(const T* r, T* z) const;			//z = M^-1 * r
+ * Jacobi works from a diagonal, ILU(0) and SSOR from a CsrMatrix (CsrMatrix::fromDense converts a Matrix).
+ *
+ * The vectors of the iterations live in a KrylovWorkspace that only grows, so the solvers allocate nothing
+ * once it is big enough; pass the same workspace to every call. x holds the initial guess on entry.
+ */
+
+template<typename T>
+struct KrylovOptions {
+	std::size_t maxIterations;		//matrix-vector products, GMRES restarts included
+	T relativeTolerance;			//converged when |b - A * x| <= max(relativeTolerance * |b|, absoluteTolerance)
+	T absoluteTolerance;
+	std::size_t restart;			//GMRES Krylov space dimension before a restart
+};
+
+template<typename T>
+KrylovOptions<T> defaultKrylovOptions() {
+	KrylovOptions<T> options = { 1000, std::sqrt(std::numeric_limits<T>::epsilon()), 0, 30 };
+	return options;
+}
+
+struct KrylovResult {
+	bool converged;
+	std::size_t iterations;
+	double residual;				//|b - A * x| / |b| as estimated by the iteration
+};
+
+namespace krylov {
+
+template<typename T>
+T dot(std::size_t n, const T* x, const T* y) {
+	T sum = 0;
+	for (std::size_t i = 0; i < n; i++) {
+		sum += x[i] * y[i];
+	}
+	return sum;
+}
+
+template<typename T>
+T norm(std::size_t n, const T* x) {
+	return std::sqrt(dot(n, x, x));
+}
+
+//y += a * x
+template<typename T>
+void axpy(std::size_t n, const T& a, const T* x, T* y) {
+	for (std::size_t i = 0; i < n; i++) {
+		y[i] += a * x[i];
+	}
+}
+
+//r = b - A * x
+template<typename T, class Operator>
+void residual(const Operator& A, const T* b, const T* x, T* r) {
+	std::size_t n = A.size();
+	A.apply(x, r);
+	for (std::size_t i = 0; i < n; i++) {
+		r[i] = b[i] - r[i];
+	}
+}
+
+}
+
+//Vectors reused by the solvers across calls
+template<typename T>
+class KrylovWorkspace {
+	private:
+		std::vector<T> vectors;
+		std::vector<T> scalars;
+		std::size_t length;
+
+	public:
+		KrylovWorkspace() : length(0) {}
+
+		//Room for count vectors of length n and scalarCount scalars, grows only
+		void reserve(std::size_t n, std::size_t count, std::size_t scalarCount) {
+			length = n;
+			if (vectors.size() < n * count) {
+				vectors.resize(n * count);
+			}
+			if (scalars.size() < scalarCount) {
+				scalars.resize(scalarCount);
+			}
+		}
+
+		T* vector(std::size_t k) {
+			return &vectors[k * length];
+		}
+
+		T* scalar(std::size_t k) {
+			return &scalars[k];
+		}
+
+		std::size_t bytes() const {
+			return (vectors.capacity() + scalars.capacity()) * sizeof(T);
+		}
+};
+
+/*
+ * Operators
+ */
+
+//A square dense matrix, the rows of the product are shared between threads. The matrix must outlive the operator.
+template<typename T>
+class DenseOperator {
+	private:
+		const T* values;
+		std::size_t n;
+
+	public:
+		template<class C>
+		explicit DenseOperator(const MatrixCRTP<T, C>& A) : values(&*A.begin()), n(A.getRowsCount()) {
+			if (n != A.getColumnsCount()) {
+				throw std::domain_error("Only a square matrix is an operator.");
+			}
+		}
+
+		std::size_t size() const {
+			return n;
+		}
+
+		void apply(const T* x, T* y) const {
+			const T* a = values;
+			const std::size_t order = n;
+			parallel::forRange(0, n, std::max<std::size_t>(1, (1 << 16) / std::max<std::size_t>(n, 1)),
+					[=](std::size_t first, std::size_t last) {
+				for (std::size_t i = first; i < last; i++) {
+					y[i] = krylov::dot(order, a + i * order, x);
+				}
+			});
+		}
+
+		T diagonal(std::size_t i) const {
+			return values[i * n + i];
+		}
+};
+
+//y = A * x computed by a user function
+template<typename T>
+class CallbackOperator {
+	private:
+		std::size_t n;
+		std::function<void(const T*, T*)> product;
+
+	public:
+		CallbackOperator(std::size_t n, std::function<void(const T*, T*)> product) : n(n), product(product) {}
+
+		std::size_t size() const {
+			return n;
+		}
+
+		void apply(const T* x, T* y) const {
+			product(x, y);
+		}
+};
+
+//Compressed sparse rows, the columns of each row in increasing order
+template<typename T>
+struct CsrMatrix {
+	std::size_t n;
+	std::vector<std::size_t> rowStart;		//n + 1 offsets in columns and values
+	std::vector<std::size_t> columns;
+	std::vector<T> values;
+
+	//The values of A whose magnitude is above dropTolerance
+	template<class C>
+	static CsrMatrix fromDense(const MatrixCRTP<T, C>& A, const T& dropTolerance = T(0)) {
+		if (A.getRowsCount() != A.getColumnsCount()) {
+			throw std::domain_error("Only a square matrix is an operator.");
+		}
+		CsrMatrix sparse;
+		sparse.n = A.getRowsCount();
+		sparse.rowStart.push_back(0);
+		auto it = A.begin();
+		for (std::size_t i = 0; i < sparse.n; i++) {
+			for (std::size_t j = 0; j < sparse.n; j++, it++) {
+				if (std::abs(*it) > dropTolerance || (i == j && *it != T(0))) {
+					sparse.columns.push_back(j);
+					sparse.values.push_back(*it);
+				}
+			}
+			sparse.rowStart.push_back(sparse.columns.size());
+		}
+		return sparse;
+	}
+
+	std::size_t size() const {
+		return n;
+	}
+
+	void apply(const T* x, T* y) const {
+		for (std::size_t i = 0; i < n; i++) {
+			T sum = 0;
+			for (std::size_t k = rowStart[i]; k < rowStart[i + 1]; k++) {
+				sum += values[k] * x[columns[k]];
+			}
+			y[i] = sum;
+		}
+	}
+
+	//Index of the diagonal entry of each row, throws when one is missing
+	std::vector<std::size_t> diagonalIndices() const {
+		std::vector<std::size_t> diagonal(n);
+		for (std::size_t i = 0; i < n; i++) {
+			std::size_t k = rowStart[i];
+			while (k < rowStart[i + 1] && columns[k] != i) {
+				k++;
+			}
+			if (k == rowStart[i + 1] || values[k] == T(0)) {
+				throw std::domain_error("The preconditioner needs a non zero diagonal.");
+			}
+			diagonal[i] = k;
+		}
+		return diagonal;
+	}
+};
+
+/*
+ * Preconditioners
+ */
+
+template<typename T>
+class IdentityPreconditioner {
+	public:
+		explicit IdentityPreconditioner(std::size_t n) : n(n) {}
+
+		void apply(const T* r, T* z) const {
+			std::copy(r, r + n, z);
+		}
+
+	private:
+		std::size_t n;
+};
+
+//M = diag(A)
+template<typename T>
+class JacobiPreconditioner {
+	private:
+		std::vector<T> inverseDiagonal;
+
+	public:
+		explicit JacobiPreconditioner(const std::vector<T>& diagonal) : inverseDiagonal(diagonal.size()) {
+			for (std::size_t i = 0; i < diagonal.size(); i++) {
+				if (diagonal[i] == T(0)) {
+					throw std::domain_error("The preconditioner needs a non zero diagonal.");
+				}
+				inverseDiagonal[i] = T(1) / diagonal[i];
+			}
+		}
+
+		explicit JacobiPreconditioner(const CsrMatrix<T>& A) : inverseDiagonal(A.n) {
+			std::vector<std::size_t> diagonal = A.diagonalIndices();
+			for (std::size_t i = 0; i < A.n; i++) {
+				inverseDiagonal[i] = T(1) / A.values[diagonal[i]];
+			}
+		}
+
+		explicit JacobiPreconditioner(const DenseOperator<T>& A) : inverseDiagonal(A.size()) {
+			for (std::size_t i = 0; i < A.size(); i++) {
+				if (A.diagonal(i) == T(0)) {
+					throw std::domain_error("The preconditioner needs a non zero diagonal.");
+				}
+				inverseDiagonal[i] = T(1) / A.diagonal(i);
+			}
+		}
+
+		void apply(const T* r, T* z) const {
+			for (std::size_t i = 0; i < inverseDiagonal.size(); i++) {
+				z[i] = r[i] * inverseDiagonal[i];
+			}
+		}
+};
+
+//Incomplete LU factorization keeping the sparsity pattern of A
+template<typename T>
+class ILU0Preconditioner {
+	private:
+		CsrMatrix<T> LU;						//unit L below the diagonal, U on and above it
+		std::vector<std::size_t> diagonal;
+
+	public:
+		explicit ILU0Preconditioner(const CsrMatrix<T>& A) : LU(A), diagonal(A.diagonalIndices()) {
+			const std::size_t none = std::numeric_limits<std::size_t>::max();
+			std::vector<std::size_t> position(LU.n, none);
+			for (std::size_t i = 0; i < LU.n; i++) {
+				for (std::size_t k = LU.rowStart[i]; k < LU.rowStart[i + 1]; k++) {
+					position[LU.columns[k]] = k;
+				}
+				//row i -= l(i, p) * row p of U, for each p < i in the pattern of row i
+				for (std::size_t k = LU.rowStart[i]; k < diagonal[i]; k++) {
+					std::size_t p = LU.columns[k];
+					LU.values[k] /= LU.values[diagonal[p]];
+					for (std::size_t q = diagonal[p] + 1; q < LU.rowStart[p + 1]; q++) {
+						if (position[LU.columns[q]] != none) {
+							LU.values[position[LU.columns[q]]] -= LU.values[k] * LU.values[q];
+						}
+					}
+				}
+				if (LU.values[diagonal[i]] == T(0)) {
+					throw std::domain_error("Zero pivot in the incomplete LU factorization.");
+				}
+				for (std::size_t k = LU.rowStart[i]; k < LU.rowStart[i + 1]; k++) {
+					position[LU.columns[k]] = none;
+				}
+			}
+		}
+
+		void apply(const T* r, T* z) const {
+			for (std::size_t i = 0; i < LU.n; i++) {
+				T sum = r[i];
+				for (std::size_t k = LU.rowStart[i]; k < diagonal[i]; k++) {
+					sum -= LU.values[k] * z[LU.columns[k]];
+				}
+				z[i] = sum;
+			}
+			for (std::size_t i = LU.n; i-- > 0;) {
+				T sum = z[i];
+				for (std::size_t k = diagonal[i] + 1; k < LU.rowStart[i + 1]; k++) {
+					sum -= LU.values[k] * z[LU.columns[k]];
+				}
+				z[i] = sum / LU.values[diagonal[i]];
+			}
+		}
+};
+
+//Symmetric successive over-relaxation, M = w/(2-w) (D/w + L) (D/w)^-1 (D/w + U), symmetric when A is
+template<typename T>
+class SSORPreconditioner {
+	private:
+		const CsrMatrix<T>& A;
+		std::vector<std::size_t> diagonal;
+		T omega;
+
+	public:
+		//A must outlive the preconditioner, omega in ]0, 2[
+		SSORPreconditioner(const CsrMatrix<T>& A, const T& omega = T(1)) : A(A), diagonal(A.diagonalIndices()),
+				omega(omega) {
+			if (!(omega > T(0) && omega < T(2))) {
+				throw std::domain_error("The SSOR relaxation factor must be between 0 and 2.");
+			}
+		}
+
+		void apply(const T* r, T* z) const {
+			//(D/w + L) y = r
+			for (std::size_t i = 0; i < A.n; i++) {
+				T sum = r[i];
+				for (std::size_t k = A.rowStart[i]; k < diagonal[i]; k++) {
+					sum -= A.values[k] * z[A.columns[k]];
+				}
+				z[i] = sum * omega / A.values[diagonal[i]];
+			}
+			//y = (D/w) y
+			for (std::size_t i = 0; i < A.n; i++) {
+				z[i] *= A.values[diagonal[i]] / omega;
+			}
+			//(D/w + U) z = y
+			for (std::size_t i = A.n; i-- > 0;) {
+				T sum = z[i];
+				for (std::size_t k = diagonal[i] + 1; k < A.rowStart[i + 1]; k++) {
+					sum -= A.values[k] * z[A.columns[k]];
+				}
+				z[i] = sum * omega / A.values[diagonal[i]];
+			}
+			const T scale = (T(2) - omega) / omega;
+			for (std::size_t i = 0; i < A.n; i++) {
+				z[i] *= scale;
+			}
+		}
+};
+
+/*
+ * Solvers
+ */
+
+//Preconditioned conjugate gradient, A and M symmetric positive definite
+template<typename T, class Operator, class Preconditioner>
+KrylovResult conjugateGradient(const Operator& A, const T* b, T* x, const Preconditioner& M,
+		const KrylovOptions<T>& options, KrylovWorkspace<T>& workspace) {
+	const std::size_t n = A.size();
+	KrylovResult result = { false, 0, 0 };
+	workspace.reserve(n, 4, 0);
+	T* r = workspace.vector(0);
+	T* z = workspace.vector(1);
+	T* p = workspace.vector(2);
+	T* q = workspace.vector(3);
+
+	const T bNorm = krylov::norm(n, b);
+	if (bNorm == T(0)) {
+		std::fill(x, x + n, T(0));
+		result.converged = true;
+		return result;
+	}
+	const T target = std::max(options.relativeTolerance * bNorm, options.absoluteTolerance);
+
+	krylov::residual(A, b, x, r);
+	T rNorm = krylov::norm(n, r);
+	result.residual = rNorm / bNorm;
+	if (rNorm <= target) {
+		result.converged = true;
+		return result;
+	}
+	M.apply(r, z);
+	std::copy(z, z + n, p);
+	T rz = krylov::dot(n, r, z);
+
+	while (result.iterations < options.maxIterations) {
+		A.apply(p, q);
+		result.iterations++;
+		const T pq = krylov::dot(n, p, q);
+		if (pq == T(0)) {
+			break;
+		}
+		const T alpha = rz / pq;
+		krylov::axpy(n, alpha, p, x);
+		krylov::axpy(n, -alpha, q, r);
+		rNorm = krylov::norm(n, r);
+		result.residual = rNorm / bNorm;
+		if (rNorm <= target) {
+			result.converged = true;
+			break;
+		}
+		M.apply(r, z);
+		const T rzNext = krylov::dot(n, r, z);
+		const T beta = rzNext / rz;
+		rz = rzNext;
+		for (std::size_t i = 0; i < n; i++) {
+			p[i] = z[i] + beta * p[i];
+		}
+	}
+	return result;
+}
+
+//Right preconditioned BiCGSTAB, for non symmetric A
+template<typename T, class Operator, class Preconditioner>
+KrylovResult bicgstab(const Operator& A, const T* b, T* x, const Preconditioner& M,
+		const KrylovOptions<T>& options, KrylovWorkspace<T>& workspace) {
+	const std::size_t n = A.size();
+	KrylovResult result = { false, 0, 0 };
+	workspace.reserve(n, 7, 0);
+	T* r = workspace.vector(0);
+	T* shadow = workspace.vector(1);
+	T* p = workspace.vector(2);
+	T* v = workspace.vector(3);
+	T* s = workspace.vector(4);				//also t = A * M^-1 * s
+	T* pHat = workspace.vector(5);
+	T* sHat = workspace.vector(6);
+
+	const T bNorm = krylov::norm(n, b);
+	if (bNorm == T(0)) {
+		std::fill(x, x + n, T(0));
+		result.converged = true;
+		return result;
+	}
+	const T target = std::max(options.relativeTolerance * bNorm, options.absoluteTolerance);
+
+	krylov::residual(A, b, x, r);
+	T rNorm = krylov::norm(n, r);
+	result.residual = rNorm / bNorm;
+	if (rNorm <= target) {
+		result.converged = true;
+		return result;
+	}
+	std::copy(r, r + n, shadow);
+	std::fill(p, p + n, T(0));
+	std::fill(v, v + n, T(0));
+	T rho = 1, alpha = 1, omega = 1;
+
+	while (result.iterations < options.maxIterations) {
+		const T rhoNext = krylov::dot(n, shadow, r);
+		if (rhoNext == T(0) || omega == T(0)) { //breakdown
+			break;
+		}
+		const T beta = (rhoNext / rho) * (alpha / omega);
+		rho = rhoNext;
+		for (std::size_t i = 0; i < n; i++) {
+			p[i] = r[i] + beta * (p[i] - omega * v[i]);
+		}
+		M.apply(p, pHat);
+		A.apply(pHat, v);
+		result.iterations++;
+		alpha = rho / krylov::dot(n, shadow, v);
+		for (std::size_t i = 0; i < n; i++) {
+			s[i] = r[i] - alpha * v[i];
+		}
+		krylov::axpy(n, alpha, pHat, x);
+		const T sNorm = krylov::norm(n, s);
+		if (sNorm <= target) {
+			result.residual = sNorm / bNorm;
+			result.converged = true;
+			break;
+		}
+
+		M.apply(s, sHat);
+		T* t = r; //r is rebuilt from s and t below
+		A.apply(sHat, t);
+		result.iterations++;
+		const T tt = krylov::dot(n, t, t);
+		omega = tt == T(0) ? T(0) : krylov::dot(n, t, s) / tt;
+		krylov::axpy(n, omega, sHat, x);
+		for (std::size_t i = 0; i < n; i++) {
+			r[i] = s[i] - omega * t[i];
+		}
+		rNorm = krylov::norm(n, r);
+		result.residual = rNorm / bNorm;
+		if (rNorm <= target) {
+			result.converged = true;
+			break;
+		}
+	}
+	return result;
+}
+
+//Right preconditioned GMRES restarted every options.restart iterations, with modified Gram-Schmidt
+template<typename T, class Operator, class Preconditioner>
+KrylovResult gmres(const Operator& A, const T* b, T* x, const Preconditioner& M,
+		const KrylovOptions<T>& options, KrylovWorkspace<T>& workspace) {
+	const std::size_t n = A.size();
+	const std::size_t m = std::max<std::size_t>(1, options.restart);
+	KrylovResult result = { false, 0, 0 };
+	//the m + 1 basis vectors, w and z, then H, the rotations, g and y
+	workspace.reserve(n, m + 3, (m + 1) * m + 2 * m + (m + 1) + m);
+	T* w = workspace.vector(m + 1);
+	T* z = workspace.vector(m + 2);
+	T* H = workspace.scalar(0);
+	T* cosines = H + (m + 1) * m;
+	T* sines = cosines + m;
+	T* g = sines + m;
+	T* y = g + m + 1;
+
+	const T bNorm = krylov::norm(n, b);
+	if (bNorm == T(0)) {
+		std::fill(x, x + n, T(0));
+		result.converged = true;
+		return result;
+	}
+	const T target = std::max(options.relativeTolerance * bNorm, options.absoluteTolerance);
+
+	while (true) {
+		T* v0 = workspace.vector(0);
+		krylov::residual(A, b, x, v0);
+		const T beta = krylov::norm(n, v0);
+		result.residual = beta / bNorm;
+		if (beta <= target) {
+			result.converged = true;
+			break;
+		}
+		if (result.iterations >= options.maxIterations) {
+			break;
+		}
+		for (std::size_t i = 0; i < n; i++) {
+			v0[i] /= beta;
+		}
+		std::fill(g, g + m + 1, T(0));
+		g[0] = beta;
+
+		std::size_t k = 0;
+		bool exhausted = false;
+		while (k < m && result.iterations < options.maxIterations) {
+			T* vk = workspace.vector(k);
+			M.apply(vk, z);
+			A.apply(z, w);
+			result.iterations++;
+			for (std::size_t i = 0; i <= k; i++) {
+				T* vi = workspace.vector(i);
+				T h = krylov::dot(n, w, vi);
+				H[i * m + k] = h;
+				krylov::axpy(n, -h, vi, w);
+			}
+			const T next = krylov::norm(n, w);
+			H[(k + 1) * m + k] = next;
+			if (next != T(0)) {
+				T* vNext = workspace.vector(k + 1);
+				for (std::size_t i = 0; i < n; i++) {
+					vNext[i] = w[i] / next;
+				}
+			}
+			//Givens rotations keep H upper triangular
+			for (std::size_t i = 0; i < k; i++) {
+				const T upper = H[i * m + k], lower = H[(i + 1) * m + k];
+				H[i * m + k] = cosines[i] * upper + sines[i] * lower;
+				H[(i + 1) * m + k] = cosines[i] * lower - sines[i] * upper;
+			}
+			const T diagonal = H[k * m + k];
+			const T radius = std::sqrt(diagonal * diagonal + next * next);
+			cosines[k] = radius == T(0) ? T(1) : diagonal / radius;
+			sines[k] = radius == T(0) ? T(0) : next / radius;
+			H[k * m + k] = radius;
+			H[(k + 1) * m + k] = 0;
+			g[k + 1] = -sines[k] * g[k];
+			g[k] = cosines[k] * g[k];
+			k++;
+			result.residual = std::abs(g[k]) / bNorm;
+			if (std::abs(g[k]) <= target || next == T(0)) { //converged or the Krylov space is invariant
+				exhausted = next == T(0);
+				break;
+			}
+		}
+
+		//x += M^-1 * V * y, H * y = g
+		for (std::size_t i = k; i-- > 0;) {
+			T sum = g[i];
+			for (std::size_t j = i + 1; j < k; j++) {
+				sum -= H[i * m + j] * y[j];
+			}
+			y[i] = H[i * m + i] == T(0) ? T(0) : sum / H[i * m + i];
+		}
+		std::fill(w, w + n, T(0));
+		for (std::size_t i = 0; i < k; i++) {
+			krylov::axpy(n, y[i], workspace.vector(i), w);
+		}
+		M.apply(w, z);
+		krylov::axpy(n, T(1), z, x);
+		if (exhausted && std::abs(g[k]) > target) {
+			break;
+		}
+	}
+	return result;
+}
+
+//The solvers with a workspace of their own
+template<typename T, class Operator, class Preconditioner>
+KrylovResult conjugateGradient(const Operator& A, const T* b, T* x, const Preconditioner& M,
+		const KrylovOptions<T>& options = defaultKrylovOptions<T>()) {
+	KrylovWorkspace<T> workspace;
+	return conjugateGradient(A, b, x, M, options, workspace);
+}
+
+template<typename T, class Operator, class Preconditioner>
+KrylovResult bicgstab(const Operator& A, const T* b, T* x, const Preconditioner& M,
+		const KrylovOptions<T>& options = defaultKrylovOptions<T>()) {
+	KrylovWorkspace<T> workspace;
+	return bicgstab(A, b, x, M, options, workspace);
+}
+
+template<typename T, class Operator, class Preconditioner>
+KrylovResult gmres(const Operator& A, const T* b, T* x, const Preconditioner& M,
+		const KrylovOptions<T>& options = defaultKrylovOptions<T>()) {
+	KrylovWorkspace<T> workspace;
+	return gmres(A, b, x, M, options, workspace);
+}
+
+#endif //OH_STRANG_KRYLOV
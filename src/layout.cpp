@@ -0,0 +1,73 @@
+#ifndef OH_STRANG_LAYOUT
+#define OH_STRANG_LAYOUT
+
+#include <cstddef>
+
+/*
+ * layout.cpp
+ *
+ * Storage orders of the dense matrices, the last template parameter of MatrixCRTP.
+ * The values of a column-major m x n matrix are those of its row-major n x m transpose, so the row-major kernels
+ * run on them unchanged, with the operands swapped or transposed: (A * B)^T = B^T * A^T, A^T * A of a column-major
+ * matrix is A * A^T of its values. The kernels read their operands in place, with a leading dimension, and
+ * kernels::gemm takes transposed operands, so that no operation converts a matrix to the other layout.
+ *
+ * The values of a line (a row, or a column when column-major) are contiguous, lines(rows, columns) lines of
+ * length(rows, columns) values, and the line i starts at i * leading dimension. The values of RowMajor and
+ * ColumnMajor matrices are dense (leading dimension = length), buffers with a larger leading dimension are accepted
+ * by their constructors. Padded<RowMajor> and Padded<ColumnMajor> start each line on a cache line, the leading
+ * dimension being storage::paddedLength unless set by MatrixCRTP::setLeadingDimension: the padding is skipped by
+ * getValue, the iterators and the comparisons, the pointer of getValues() includes it.
+ */
+
+namespace layout {
+
+struct ColumnMajor;
+
+struct RowMajor {
+	static const bool rowMajor = true;
+	static const bool padded = false;
+	typedef ColumnMajor Transposed;
+
+	//0 based position of (row, column) in values of leading dimension ld
+	static std::size_t offset(std::size_t row, std::size_t column, std::size_t ld) {
+		return row * ld + column;
+	}
+
+	static std::size_t lines(std::size_t rows, std::size_t) {
+		return rows;
+	}
+
+	static std::size_t length(std::size_t, std::size_t columns) {
+		return columns;
+	}
+};
+
+struct ColumnMajor {
+	static const bool rowMajor = false;
+	static const bool padded = false;
+	typedef RowMajor Transposed;
+
+	static std::size_t offset(std::size_t row, std::size_t column, std::size_t ld) {
+		return column * ld + row;
+	}
+
+	static std::size_t lines(std::size_t, std::size_t columns) {
+		return columns;
+	}
+
+	static std::size_t length(std::size_t rows, std::size_t) {
+		return rows;
+	}
+};
+
+//Order with aligned lines, ld values apart
+template<class Order>
+struct Padded : Order {
+	static const bool padded = true;
+	typedef Padded<typename Order::Transposed> Transposed;
+};
+
+}
+
+#endif //OH_STRANG_LAYOUT
@@ -1,3 +1,6 @@
+#ifndef OH_STRANG_MATRIX
+#define OH_STRANG_MATRIX
+
 #include <sstream>
 #include <iostream>
 #include <string>
@@ -5,6 +8,16 @@
 #include <cmath>
 #include <limits>
 #include <stdexcept>
+#include <algorithm>
+#include <memory>
+#include <cstdint>
+#include <type_traits>
+
+#include "numbers.cpp"
+#include "kernels.cpp"
+#include "instrumentation.cpp"
+#include "storage.cpp"
+#include "layout.cpp"
 
 
 /*
@@ -51,20 +64,69 @@ class Comparator: public Comparator_Operator<T,
 				FloatingPointComparator<T>, DefaultComparator<T>>::type> {
 };
 
-template<typename T, typename C>
+/*
+ * Reduced row echelon form of a matrix, with what can be read from it.
+ */
+template<class C>
+struct EchelonForm {
+	C R;									//reduced row echelon form
+	std::vector<std::size_t> pivotColumns;	//1 based indices of the pivot columns
+	std::size_t rank;
+	C columnSpace;							//the pivot columns of the matrix, a basis of its column space
+	C nullSpace;							//the special solutions as columns, a basis of its null space
+};
+
+/*
+ * Factors of a square matrix for one version of its values, kept by the matrix until it changes when it caches
+ * its factorizations, see MatrixCRTP::cacheFactorizations.
+ */
+template<typename T>
+struct LUFactors {
+	std::uint64_t version;
+	std::vector<T> lu;					//P * A = L * U, the multipliers of the unit lower triangular L below the diagonal
+	std::vector<std::size_t> pivots;	//pivots[i] is the row exchanged with row i, as returned by getrf
+	bool singular;
+	T determinant;
+};
+
+template<typename T>
+struct CholeskyFactors {
+	std::uint64_t version;
+	std::vector<T> factor;				//A = L * L^T, L in packed lower storage
+	bool positiveDefinite;				//false when the factorization broke down, factor is then meaningless
+};
+
+//Packed triangular storage, see structured.cpp
+template<typename T>
+class TriangularMatrix;
+
+//Layout is the storage order of the values, see layout.cpp
+template<typename T, typename C, class Layout = layout::RowMajor>
 class MatrixCRTP {
 protected:
-	std::vector<T> values;
+	storage::SharedValues<T> values;	//copy-on-write, see storage.cpp
 	std::size_t m;
 	std::size_t n;
+	std::size_t ld;		//values between the starts of two lines, more than their length when padded
 	T zero;
 	T one;
+	std::uint64_t version;	//changed by every write
+	bool caching;
+	mutable std::shared_ptr<const LUFactors<T>> luCache;
+	mutable std::shared_ptr<const CholeskyFactors<T>> choleskyCache;
 protected:
 	static Comparator<T> compare;
 
 public:
+	typedef T value_type;
+	typedef Layout layout_type;
+	//Pointers into the values, unless padded: the iterators of the padded layouts skip the padding
+	typedef typename std::conditional<Layout::padded, storage::LineIterator<T>,
+			typename storage::SharedValues<T>::const_iterator>::type const_iterator;
+
 	static C identity(const std::size_t& rows,
 			const std::size_t& columns, const T& z0, const T& o1) {
+		OH_STRANG_MEASURE(IDENTITY, 0, rows * columns * sizeof(T), 0);
 		C I(rows, columns, z0, o1);
 		for (int i = 1; i <= rows; i++) {
 			for (int j = 1; j <= columns; j++) {
@@ -77,6 +139,7 @@ public:
 	}
 
 	static C getPermutationMatrix(int size, T zero, T one, int c1, int c2){
+		OH_STRANG_MEASURE(PERMUTATION, 0, 0, 0);
 
 		C xchange = C::identity( size, size, zero, one);
 		if( c1 == c2 ){
@@ -97,14 +160,14 @@ public:
 	}
 
 	//Constructors
-	MatrixCRTP():m(0), n(0), zero(0), one(1){}
+	MatrixCRTP():m(0), n(0), ld(0), zero(0), one(1), version(0), caching(false){}
 
 	MatrixCRTP(const std::size_t& rows, const std::size_t& columns, const T& z0,
 			const T& o1) :
-			m(rows), n(columns), zero(z0), one(o1) {
+			m(rows), n(columns), ld(leading(rows, columns)), zero(z0), one(o1), version(0), caching(false) {
 		m = rows;
 		n = columns;
-		values.assign(m * n, zero);
+		values.assign(Layout::lines(m, n) * ld, zero);
 	}
 
 	MatrixCRTP(const std::size_t& rows, const std::size_t& columns, const T& z0,
@@ -115,23 +178,47 @@ public:
 
 	MatrixCRTP(std::size_t rows, std::size_t columns, T const &z0, T const &o1,
 			T* _values) :
-			MatrixCRTP(rows, columns, z0, o1) {
-		//convert to vector
-		std::vector<T> tmpVec(&_values[0], &_values[m * n]);
-		//and copy
-		values.insert(values.begin(), tmpVec.begin(), tmpVec.end());
+			values(layOut(rows, columns, _values, Layout::length(rows, columns), leading(rows, columns), z0)),
+			m(rows), n(columns), ld(leading(rows, columns)), zero(z0), one(o1), version(0), caching(false) {
+	}
+
+	//From a buffer whose lines (rows, or columns when column-major) are sourceLd values apart
+	MatrixCRTP(std::size_t rows, std::size_t columns, T const &z0, T const &o1, const T* _values,
+			std::size_t sourceLd) :
+			values(layOut(rows, columns, _values, sourceLd, leading(rows, columns), z0)), m(rows), n(columns),
+			ld(leading(rows, columns)), zero(z0), one(o1), version(0), caching(false) {
+	}
+
+	//Copy of a matrix in another layout, its values being transposed when the order differs
+	template<class D, class M>
+	explicit MatrixCRTP(const MatrixCRTP<T, D, M>& other) :
+			MatrixCRTP(other.getRowsCount(), other.getColumnsCount(), other.getZero(), other.getOne()) {
+		if (m * n > 0) {
+			const T* source = other.getValues();
+			const std::size_t sourceLd = other.getLeadingDimension();
+			T* target = values.write();
+			if (M::rowMajor == Layout::rowMajor) {
+				for (std::size_t i = 0; i < Layout::lines(m, n); i++) {
+					std::copy(source + i * sourceLd, source + i * sourceLd + Layout::length(m, n), target + i * ld);
+				}
+			} else {
+				kernels::transpose(M::lines(m, n), M::length(m, n), source, sourceLd, target, ld);
+			}
+		}
 	}
 
 	//Setters
 	T setValue(int row, int column, const T& val) {
-		T oldValue = values[(row - 1) * n + (column - 1)];
-		values[(row - 1) * n + (column - 1)] = val;
+		version++;
+		T& value = values.write()[at(row - 1, column - 1)];
+		T oldValue = value;
+		value = val;
 		return oldValue;
 	}
 
 	//Getters
 	const T& getValue(int row, int column) const {
-		return values[(row - 1) * n + (column - 1)];
+		return values[at(row - 1, column - 1)];
 	}
 
 	const std::size_t& getRowsCount() const {
@@ -150,46 +237,170 @@ public:
 		return one;
 	}
 
+	//The values to write, copied first when a copy of the matrix shares them, lines getLeadingDimension() apart.
+	//The pointer is valid until the matrix is copied or assigned.
 	T* getValues(){
-		return &values[0];
+		version++;
+		return values.write();
 	}
 
-	//Iterators
-	typename std::vector<T>::const_iterator begin() const {
-		return values.cbegin();
+	//The values to read, lines getLeadingDimension() apart
+	const T* getValues() const {
+		return values.data();
 	}
 
-	typename std::vector<T>::const_iterator end() const {
-		return values.cend();
+	//Values between the starts of two lines (rows, or columns when column-major): their length unless padded
+	std::size_t getLeadingDimension() const {
+		return ld;
 	}
 
-	//casting
-	std::string toString() const {
-		std::ostringstream matrix;
-		for (int i = 0; i < m; i++) {
-			matrix << "[  ";
-			for (int j = 0; j < n; j++) {
-				matrix << values[i * n + j] << "  ";
-			}
-			matrix << "]" << ((i < m - 1) ? "\n" : "");
+	//Moves the lines leadingDimension values apart, which only the padded layouts accept.
+	//The values stay the same, the pointers from getValues() are no longer valid.
+	void setLeadingDimension(std::size_t leadingDimension) {
+		const std::size_t length = Layout::length(m, n);
+		if (leadingDimension < length || (!Layout::padded && leadingDimension != length)) {
+			throw std::invalid_argument("The leading dimension must be at least the length of a line, "
+					"and only a padded layout has padding.");
+		}
+		if (leadingDimension != ld) {
+			storage::SharedValues<T> moved = layOut(m, n, values.data(), ld, leadingDimension, zero);
+			values.swap(moved);
+			ld = leadingDimension;
 		}
+	}
 
-		return matrix.str();
+	//Like getValues(), valid as long as the matrix lives: its copies never share these values.
+	//The pointer is kept to read as well as to write, so the version is left alone: call bumpVersion after writing.
+	T* getPinnedValues(){
+		return values.pin();
 	}
 
-	//Transpose
-	C transpose(){
-		T _values[m * n];
-		int index = 0;
-		for (int i = 0; i < m; i++) {
+	//Changed by setValue, getValues, operator*= and operator/=
+	std::uint64_t getVersion() const {
+		return version;
+	}
+
+	//To call after writing through a pointer kept from getValues() or getPinnedValues(), so that the cached factors
+	//are not used again
+	void bumpVersion() {
+		version++;
+	}
+
+	//Keeps the factors of det() and of the solvers until the next write, disabling drops them
+	void cacheFactorizations(bool enabled = true) {
+		caching = enabled;
+		if (!enabled) {
+			std::atomic_store(&luCache, std::shared_ptr<const LUFactors<T>>());
+			std::atomic_store(&choleskyCache, std::shared_ptr<const CholeskyFactors<T>>());
+		}
+	}
+
+	bool cachesFactorizations() const {
+		return caching;
+	}
 
-			for (int j = 0; j < n; j++) {
-				index = j * m + i;
-				_values[index] = getValue(i + 1, j + 1);
+	//P * A = L * U, with partial pivoting for the floating point types and the first non zero pivot for the others
+	std::shared_ptr<const LUFactors<T>> luFactors() const {
+		if (m != n) {
+			throw std::domain_error("Only a square matrix has an LU factorization.");
+		}
+		std::shared_ptr<const LUFactors<T>> factors = cached(luCache);
+		if (factors) {
+			return factors;
+		}
+		OH_STRANG_MEASURE(TO_LU, 2.0 * n * n * n / 3, n * n * sizeof(T), n * n * sizeof(T));
+		std::shared_ptr<LUFactors<T>> computed = std::make_shared<LUFactors<T>>();
+		computed->version = version;
+		computed->lu = rowMajorValues();
+		computed->pivots.resize(n);
+		computed->singular = n > 0 && eliminate(std::is_floating_point<T>(), computed->lu, computed->pivots);
+		computed->determinant = one;
+		for (std::size_t i = 0; i < n; i++) {
+			computed->determinant = computed->determinant * computed->lu[i * n + i];
+			if (computed->pivots[i] != i) {
+				computed->determinant = zero - computed->determinant;
 			}
+		}
+		if (computed->singular) {
+			computed->determinant = zero;
+		}
+		store(luCache, computed);
+		return computed;
+	}
+
+	//A = L * L^T from the lower triangle of the matrix, taken as symmetric
+	std::shared_ptr<const CholeskyFactors<T>> choleskyFactors() const {
+		if (m != n) {
+			throw std::domain_error("Only a square matrix has a Cholesky factorization.");
+		}
+		std::shared_ptr<const CholeskyFactors<T>> factors = cached(choleskyCache);
+		if (factors) {
+			return factors;
+		}
+		std::shared_ptr<CholeskyFactors<T>> computed = std::make_shared<CholeskyFactors<T>>();
+		computed->version = version;
+		computed->factor.resize(n * (n + 1) / 2);
+		for (std::size_t i = 0; i < n; i++) {
+			T* row = &computed->factor[kernels::packedRow(n, i, true)];
+			for (std::size_t j = 0; j <= i; j++) {
+				row[j] = values[at(i, j)];
+			}
+		}
+		computed->positiveDefinite = n == 0 || kernels::pptrf(n, &computed->factor[0]);
+		store(choleskyCache, computed);
+		return computed;
+	}
+
+	//Whether the values are shared with a copy of the matrix, until one of them is written
+	bool sharesValues() const {
+		return values.shared();
+	}
+
+	bool sharesValuesWith(const MatrixCRTP& other) const {
+		return values.sharesWith(other.values);
+	}
 
+	//Iterators, over the values in the order of the layout
+	const_iterator begin() const {
+		return valuesIterator(std::integral_constant<bool, Layout::padded>(), false);
+	}
+
+	const_iterator end() const {
+		return valuesIterator(std::integral_constant<bool, Layout::padded>(), true);
+	}
+
+	//casting, each value is written with the shortest text that reads back to the same value
+	std::string toString() const {
+		return toString(text::MatrixFormat());
+	}
+
+	//With the precision of format, summarized when the matrix is large, see text::MatrixFormat
+	std::string toString(const text::MatrixFormat& format) const {
+		std::string matrix;
+		return toString(matrix, format);
+	}
+
+	//Writes the text in out, reusing its memory
+	std::string& toString(std::string& out, const text::MatrixFormat& format) const {
+		OH_STRANG_MEASURE(TO_STRING, 0, 0, 0);
+		if (Layout::rowMajor && ld == n) {
+			text::formatMatrix(out, m, n, values.data(), format);
+		} else {
+			text::formatMatrix(out, m, n, rowMajorValues().data(), format);
+		}
+		return out;
+	}
+
+	//Transpose
+	C transpose(){
+		OH_STRANG_MEASURE(TRANSPOSE, 0, 2 * m * n * sizeof(T), 2 * m * n * sizeof(T));
+		C R(n, m, zero, one);
+		//the values of the transpose in the same layout are the transposed values
+		if (m * n > 0) {
+			kernels::transpose(Layout::lines(m, n), Layout::length(m, n), values.data(), ld, R.getValues(),
+					R.getLeadingDimension());
 		}
-		return C(n, m, zero, one, _values);
+		return R;
 	}
 
 	//Swap rows
@@ -197,6 +408,7 @@ public:
 		if( rowA < 1 || rowA > m || rowB < 1 || rowB > m ){
 			throw std::out_of_range("Row index must be between 1 and rowsCount()");
 		}
+		OH_STRANG_MEASURE(SWAP_ROWS, 0, m * m * sizeof(T), 0);
 
 		return C::getPermutationMatrix( m, zero, one, rowA, rowB ) * *static_cast<C*>(this);
 	}
@@ -207,6 +419,7 @@ public:
 			throw std::out_of_range(
 					"Column index must be between 1 and columnsCount()");
 		}
+		OH_STRANG_MEASURE(SWAP_COLUMNS, 0, n * n * sizeof(T), 0);
 
 		return *static_cast<C*>(this) * C::getPermutationMatrix( n, zero, one, colA, colB );
 	}
@@ -218,15 +431,16 @@ public:
 		}
 
 		std::size_t _n = n + B.getColumnsCount();
+		OH_STRANG_MEASURE(CONCAT, 0, 2 * m * _n * sizeof(T), 2 * m * _n * sizeof(T));
 
-		T _values[m * _n];
+		std::vector<T> _values(m * _n);
 		for(int r = 0; r < m; r++){
 			for(int c = 0; c < _n; c++ ){
-				_values[r * _n + c ] = c < n ? values[r * n + c] : B.getValue(r + 1, c + 1 - n);
+				_values[Layout::offset(r, c, Layout::length(m, _n))] = c < n ? values[at(r, c)] : B.getValue(r + 1, c + 1 - n);
 			}
 		}
 
-		return C(m, _n, zero, one, _values);
+		return C(m, _n, zero, one, _values.data());
 	}
 
 	//Split the matrix into 2.
@@ -236,33 +450,35 @@ public:
 			throw std::out_of_range(
 								"Split Column index must in the range ] 1; columnsCount() [");
 		}
+		OH_STRANG_MEASURE(SPLIT, 0, 2 * m * n * sizeof(T), 2 * m * n * sizeof(T));
 
-		T leftValues[m * splitColumn];
+		std::vector<T> leftValues(m * splitColumn);
 
-		T rightValues[m * (n - splitColumn)];
+		std::vector<T> rightValues(m * (n - splitColumn));
 
 		for(int r = 0; r < m; r++){
 			for( int c = 0; c < n; c++){
 				if( c < splitColumn ){
-					leftValues[r * splitColumn + c] = values[r * n + c];
+					leftValues[Layout::offset(r, c, Layout::length(m, splitColumn))] = values[at(r, c)];
 				}else{
-					rightValues[r * (n-splitColumn) + c - splitColumn] = values[r * n + c];
+					rightValues[Layout::offset(r, c - splitColumn, Layout::length(m, n - splitColumn))] = values[at(r, c)];
 				}
 			}
 		}
 
-		left = C(m, splitColumn, zero, one, leftValues);
-		right = C(m, n - splitColumn, zero, one, rightValues);
+		left = C(m, splitColumn, zero, one, leftValues.data());
+		right = C(m, n - splitColumn, zero, one, rightValues.data());
 	}
 
 
 	// Perform the L * U decomposition of the matrix.
 	bool toLU( C& L, C& U ){
+		OH_STRANG_MEASURE(TO_LU, 2.0 * m * m * n / 3, (m * n + 2 * m * m) * sizeof(T), m * n * sizeof(T));
 
 		bool singular = false;
 
-		//Create an copy of this matrix
-		U = C(m, n, zero, one, getValues());
+		//Create an copy of this matrix, sharing its values until the first row operation
+		U = *static_cast<C*>(this);
 
 		//This matrix will hold the multipliers
 		L = C::identity( m, m, zero, one );
@@ -322,27 +538,132 @@ public:
 		return ( !singular && U.getValue(m, m) == zero )? true : singular;
 	}
 
-	//Calculate determinant
-	T det(){
+	//P * A = L * U of a square matrix with the factors in triangular storage (structured.cpp), L having a unit diagonal.
+	//rows[i] is the 1 based row of the matrix moved to row i. Returns true when the matrix is singular.
+	bool toLU(std::vector<std::size_t>& rows, TriangularMatrix<T>& L, TriangularMatrix<T>& U) const {
 		if (m != n) {
-			throw std::domain_error("Only a square matrix has a determinant.");
+			throw std::domain_error("Only a square matrix has a triangular LU decomposition.");
+		}
+		OH_STRANG_MEASURE(TO_LU, 2.0 * n * n * n / 3, (n * n + n * (n + 1)) * sizeof(T), n * n * sizeof(T));
+		std::vector<T> LU = rowMajorValues();
+		std::vector<std::size_t> pivots(n);
+		bool singular = n > 0 && kernels::getrf(n, LU.data(), n, pivots.data());
+		rows.resize(n);
+		for (std::size_t i = 0; i < n; i++) {
+			rows[i] = i + 1;
 		}
+		for (std::size_t i = 0; i < n; i++) {
+			std::swap(rows[i], rows[pivots[i]]);
+		}
+		L = TriangularMatrix<T>(n, true, zero, one, true);
+		U = TriangularMatrix<T>(n, false, zero, one);
+		for (std::size_t i = 0; i < n; i++) {
+			for (std::size_t j = 0; j < n; j++) {
+				if (j < i) {
+					L.setValue(i + 1, j + 1, LU[i * n + j]);
+				} else {
+					U.setValue(i + 1, j + 1, LU[i * n + j]);
+				}
+			}
+		}
+		return singular;
+	}
 
-		C L;
-		C U;
+	//Calculate determinant, O(1) when the factors of this version are cached
+	T det() const {
+		if (m != n) {
+			throw std::domain_error("Only a square matrix has a determinant.");
+		}
+		OH_STRANG_MEASURE(DET, m, 0, 0);
+		return luFactors()->determinant;
+	}
 
-		//Perform LU decomposition
-		if( toLU( L, U ) ){ //The matrix is singular
-			return zero;
+	//Elimination to the reduced row echelon form, in place on a copy of the matrix with row swaps and row operations.
+	//Values at most tolerance times the largest magnitude of the matrix count as zeros.
+	//The integral types are eliminated fraction free, see kernels::fractionFreeRref: the rank, pivots, column space
+	//and null space are exact, the null space holding the special solutions times d divided by their gcd, while the
+	//values of R that are not integers are truncated.
+	EchelonForm<C> echelon(const T& tolerance) const {
+		OH_STRANG_MEASURE(RREF, 2.0 * m * n * std::min(m, n), 2 * m * n * sizeof(T), m * n * sizeof(T));
+		EchelonForm<C> form;
+		form.R = C(m, n, zero, one);
+		std::vector<std::size_t> pivots(std::min(m, n));
+		//the rows of d * R, d being 1 but for the integral types
+		std::vector<T> R = rowMajorValues();
+		T denominator = one;
+		form.rank = 0;
+		if (m * n > 0) {
+			form.rank = reduce(std::is_integral<T>(), R, tolerance, &pivots[0], denominator);
+			T* r = form.R.getValues();
+			const std::size_t ldr = form.R.getLeadingDimension();
+			for (std::size_t i = 0; i < m; i++) {
+				for (std::size_t j = 0; j < n; j++) {
+					r[Layout::offset(i, j, ldr)] = R[i * n + j] / denominator;
+				}
+			}
 		}
+		const std::size_t r = form.rank;
+
+		form.columnSpace = C(m, r, zero, one);
+		form.nullSpace = C(n, n - r, zero, one);
+		std::vector<bool> isPivot(n, false);
+		for (std::size_t k = 0; k < r; k++) {
+			form.pivotColumns.push_back(pivots[k] + 1);
+			isPivot[pivots[k]] = true;
+			for (std::size_t i = 0; i < m; i++) {
+				form.columnSpace.setValue(i + 1, k + 1, values[at(i, pivots[k])]);
+			}
+		}
+		//One special solution per free column: d for that variable, minus the free column of d * R for the pivot variables
+		std::size_t special = 0;
+		std::vector<T> solution(n);
+		for (std::size_t free = 0; free < n; free++) {
+			if (isPivot[free]) {
+				continue;
+			}
+			special++;
+			std::fill(solution.begin(), solution.end(), zero);
+			solution[free] = denominator;
+			for (std::size_t k = 0; k < r; k++) {
+				solution[pivots[k]] = zero - R[k * n + free];
+			}
+			primitive(std::is_integral<T>(), solution, free);
+			for (std::size_t i = 0; i < n; i++) {
+				form.nullSpace.setValue(i + 1, special, solution[i]);
+			}
+		}
+		return form;
+	}
 
-		T d = 1;
+	//Relative tolerance of max(rows, columns) epsilons, none for the integral types
+	EchelonForm<C> echelon() const {
+		return echelon(T(std::max(m, n)) * std::numeric_limits<T>::epsilon());
+	}
 
-		for (int i = 1; i <= m; i++) {
-				d *= U.getValue(i,i);
-		}
+	C rref() const {
+		return echelon().R;
+	}
+
+	std::size_t rank() const {
+		return echelon().rank;
+	}
+
+	C columnSpace() const {
+		return echelon().columnSpace;
+	}
 
-		return d;
+	C nullSpace() const {
+		return echelon().nullSpace;
+	}
+
+	//A^T * A, reading the matrix in place and computing one triangle before mirroring it
+	C gram() const {
+		return symmetricProduct(false);
+	}
+
+	//A * A^T
+	C outerGram() const {
+		return symmetricProduct(true);
 	}
 
 	//Equality operator
@@ -353,17 +674,8 @@ public:
 			return false;
 		}
 
-		auto iteratorA = A.begin();
-		auto iteratorB = B.begin();
-		while (iteratorA != A.end() && iteratorB != B.end()) {
-			if (C::compare(*iteratorA, *iteratorB) != 0) {
-				return false;
-			}
-			iteratorA++;
-			iteratorB++;
-		}
-
-		return true;
+		return equalValues(std::integral_constant<bool, std::is_same<T, float>::value || std::is_same<T, double>::value>(),
+				A, B);
 	}
 
 	//Inequality operator
@@ -371,16 +683,37 @@ public:
 		return !(A == B);
 	}
 
+	//Equality with a matrix of another layout or class, comparing the values as operator== does
+	template<class D, class M>
+	friend bool operator==(const C& A, const MatrixCRTP<T, D, M>& B) {
+		if (A.getRowsCount() != B.getRowsCount() || A.getColumnsCount() != B.getColumnsCount()) {
+			return false;
+		}
+		bool equal = true;
+		forEachPair(A, B, [&](std::size_t, const T& a, const T& b) {
+			equal = C::compare(a, b) == 0;
+			return equal;
+		});
+		return equal;
+	}
+
+	template<class D, class M>
+	friend bool operator!=(const C& A, const MatrixCRTP<T, D, M>& B) {
+		return !(A == B);
+	}
+
 	//Multiplication by a scalar
 	friend C operator*(const T& scalar, C const &A) {
-		T _values[A.getRowsCount() * A.getColumnsCount()];
+		OH_STRANG_MEASURE(SCALAR_MULTIPLY, A.getRowsCount() * A.getColumnsCount(),
+				2 * A.getRowsCount() * A.getColumnsCount() * sizeof(T), A.getRowsCount() * A.getColumnsCount() * sizeof(T));
+		std::vector<T> _values(A.getRowsCount() * A.getColumnsCount());
 		int i = 0;
 		for(auto it = A.begin(); it != A.end(); it++){
 			_values[i++] = *it * scalar;
 		}
 
 
-		return C(A.getRowsCount(), A.getColumnsCount(), A.getZero(), A.getOne(), _values);
+		return C(A.getRowsCount(), A.getColumnsCount(), A.getZero(), A.getOne(), _values.data());
 	}
 
 
@@ -391,7 +724,9 @@ public:
 
 	//multiplication by a scalar and mutation
 	void operator*=(const T& scalar) {
-		for (auto it = values.begin(); it != values.end(); it++) {
+		version++;
+		T* it = values.write();
+		for (T* end = it + values.size(); it != end; it++) {
 			*it *= scalar;
 		}
 	}
@@ -416,18 +751,29 @@ public:
 			throw std::domain_error("Rows and columns count must match.");
 		}
 
+		OH_STRANG_MEASURE(ADD, Rows * Columns, 2 * Rows * Columns * sizeof(T), Rows * Columns * sizeof(T));
 
-		T _values[Rows * Columns];
-		int index = 0;
-		for (int i = 0; i < Rows; i++) {
-
-			for (int j = 0; j < Columns; j++) {
-				index = i * Columns + j;
-				_values[index] = values[index] + B.getValue(i + 1, j + 1);
-			}
+		std::vector<T> _values(Rows * Columns);
+		forEachPair(*this, B, [&](std::size_t index, const T& a, const T& b) {
+			_values[index] = a + b;
+			return true;
+		});
+		return C(Rows, Columns, B.getZero(), B.getOne(), _values.data());
+	}
 
+	//In the layout of this matrix, B being read by tiles when its layout is the other one
+	template<class D, class M>
+	C operator+(const MatrixCRTP<T, D, M>& B) {
+		if (m != B.getRowsCount() || n != B.getColumnsCount()) {
+			throw std::domain_error("Rows and columns count must match.");
 		}
-		return C(Rows, Columns, B.getZero(), B.getOne(), _values);
+		OH_STRANG_MEASURE(ADD, m * n, 2 * m * n * sizeof(T), m * n * sizeof(T));
+		std::vector<T> _values(m * n);
+		forEachPair(*this, B, [&](std::size_t index, const T& a, const T& b) {
+			_values[index] = a + b;
+			return true;
+		});
+		return C(m, n, zero, one, _values.data());
 	}
 
 	C operator-(C const &B) {
@@ -438,17 +784,27 @@ public:
 			throw std::domain_error("Rows and columns count must match.");
 		}
 
-		T _values[Rows * Columns];
-		int index = 0;
-		for (int i = 0; i < Rows; i++) {
-
-			for (int j = 0; j < Columns; j++) {
-				index = i * Columns + j;
-				_values[index] = values[index] - B.getValue(i + 1, j + 1);
-			}
+		OH_STRANG_MEASURE(SUBTRACT, Rows * Columns, 2 * Rows * Columns * sizeof(T), Rows * Columns * sizeof(T));
+		std::vector<T> _values(Rows * Columns);
+		forEachPair(*this, B, [&](std::size_t index, const T& a, const T& b) {
+			_values[index] = a - b;
+			return true;
+		});
+		return C(Rows, Columns, B.getZero(), B.getOne(), _values.data());
+	}
 
+	template<class D, class M>
+	C operator-(const MatrixCRTP<T, D, M>& B) {
+		if (m != B.getRowsCount() || n != B.getColumnsCount()) {
+			throw std::domain_error("Rows and columns count must match.");
 		}
-		return C(Rows, Columns, B.getZero(), B.getOne(), _values);
+		OH_STRANG_MEASURE(SUBTRACT, m * n, 2 * m * n * sizeof(T), m * n * sizeof(T));
+		std::vector<T> _values(m * n);
+		forEachPair(*this, B, [&](std::size_t index, const T& a, const T& b) {
+			_values[index] = a - b;
+			return true;
+		});
+		return C(m, n, zero, one, _values.data());
 	}
 
 	//Matrix multiplication
@@ -464,33 +820,290 @@ public:
 
 		int aRows = A.getRowsCount();
 		int bColumns = B.getColumnsCount();
+		OH_STRANG_MEASURE(MULTIPLY, 2.0 * aRows * bColumns * aColumns, aRows * bColumns * sizeof(T), 0);
+
+		C R(aRows, bColumns, A.getZero(), A.getOne());
+		multiply(A, B, R);
+		return R;
+	}
+
+	//Product with a matrix of another layout or class, in the layout of A, without converting either operand
+	template<class D, class M>
+	friend C operator*(const C& A, const MatrixCRTP<T, D, M>& B) {
+		if (A.getColumnsCount() != B.getRowsCount()) {
+			throw std::domain_error(
+					"Left matrix columns count must match right matrix rows count.");
+		}
+		OH_STRANG_MEASURE(MULTIPLY, 2.0 * A.getRowsCount() * B.getColumnsCount() * A.getColumnsCount(),
+				A.getRowsCount() * B.getColumnsCount() * sizeof(T), 0);
+		C R(A.getRowsCount(), B.getColumnsCount(), A.getZero(), A.getOne());
+		multiply(A, B, R);
+		return R;
+	}
 
-		T _values[aRows * bColumns];
-		int index = 0;
+private:
+	//Position of the 0 based (i, j) in values
+	std::size_t at(std::size_t i, std::size_t j) const {
+		return Layout::offset(i, j, ld);
+	}
 
-		for (int i = 0; i < aRows; i++) {
-			for (int k = 0; k < bColumns; k++) {
-				_values[index] = 0;
-				for (int j = 0; j < aColumns; j++) {
-					_values[index] += A.getValue(i + 1, j + 1) * B.getValue(j + 1, k + 1);
+	static std::size_t leading(std::size_t rows, std::size_t columns) {
+		const std::size_t length = Layout::length(rows, columns);
+		return Layout::padded ? storage::paddedLength<T>(length) : length;
+	}
+
+	//The values of a rows x columns matrix from lines sourceLd apart to lines ld apart, the padding set to fill
+	static storage::SharedValues<T> layOut(std::size_t rows, std::size_t columns, const T* source,
+			std::size_t sourceLd, std::size_t ld, const T& fill) {
+		const std::size_t lines = Layout::lines(rows, columns), length = Layout::length(rows, columns);
+		if (sourceLd < length) {
+			throw std::invalid_argument("The leading dimension must be at least the length of a line.");
+		}
+		if (sourceLd == length && ld == length) {
+			return storage::SharedValues<T>(source, source + lines * length);
+		}
+		storage::SharedValues<T> laidOut(lines * ld, fill);
+		T* target = laidOut.write();
+		for (std::size_t i = 0; i < lines; i++) {
+			std::copy(source + i * sourceLd, source + i * sourceLd + length, target + i * ld);
+		}
+		return laidOut;
+	}
+
+	typename storage::SharedValues<T>::const_iterator valuesIterator(std::false_type, bool end) const {
+		return end ? values.end() : values.begin();
+	}
+
+	storage::LineIterator<T> valuesIterator(std::true_type, bool end) const {
+		return storage::LineIterator<T>(values.data() + (end ? Layout::lines(m, n) * ld : 0), Layout::length(m, n),
+				ld);
+	}
+
+	//A dense row-major copy of the values, for the kernels that work in place on one
+	std::vector<T> rowMajorValues() const {
+		std::vector<T> rowMajor(m * n);
+		if (m * n == 0) {
+			return rowMajor;
+		}
+		if (Layout::rowMajor) {
+			for (std::size_t i = 0; i < m; i++) {
+				std::copy(values.data() + i * ld, values.data() + i * ld + n, &rowMajor[i * n]);
+			}
+		} else {
+			kernels::transpose(n, m, values.data(), ld, &rowMajor[0], n);
+		}
+		return rowMajor;
+	}
+
+	//f(index, a, b) on the values at the same position of A and B, index being the position in the dense values of
+	//the layout of A. Stops when f returns false. When B has the other layout, the values are walked by tiles that
+	//hold the lines of A and of B in cache.
+	template<class D, class M, class F>
+	static void forEachPair(const MatrixCRTP& A, const MatrixCRTP<T, D, M>& B, F f) {
+		const std::size_t lines = Layout::lines(A.m, A.n), length = Layout::length(A.m, A.n);
+		if (lines * length == 0) {
+			return;
+		}
+		const T* a = A.values.data();
+		const T* b = B.getValues();
+		const std::size_t lda = A.ld, ldb = B.getLeadingDimension();
+		if (M::rowMajor == Layout::rowMajor && lda == length && ldb == length) {
+			for (std::size_t i = 0; i < lines * length; i++) {
+				if (!f(i, a[i], b[i])) {
+					return;
 				}
-				index++;
 			}
+			return;
+		}
+		if (M::rowMajor == Layout::rowMajor) {
+			for (std::size_t i = 0; i < lines; i++) {
+				for (std::size_t j = 0; j < length; j++) {
+					if (!f(i * length + j, a[i * lda + j], b[i * ldb + j])) {
+						return;
+					}
+				}
+			}
+			return;
+		}
+		const std::size_t tile = 32;
+		for (std::size_t ii = 0; ii < lines; ii += tile) {
+			for (std::size_t jj = 0; jj < length; jj += tile) {
+				for (std::size_t i = ii; i < std::min(lines, ii + tile); i++) {
+					for (std::size_t j = jj; j < std::min(length, jj + tile); j++) {
+						if (!f(i * length + j, a[i * lda + j], b[j * ldb + i])) {
+							return;
+						}
+					}
+				}
+			}
+		}
+	}
+
+	//R = A * B, R having the layout L: a column-major matrix holds the values of the row-major transpose,
+	//so the kernel reads transposed operands, or computes R^T = B^T * A^T when R is column-major
+	template<class D, class LA, class E, class LB>
+	static void multiply(const MatrixCRTP<T, D, LA>& A, const MatrixCRTP<T, E, LB>& B, C& R) {
+		const std::size_t rows = A.getRowsCount(), inner = A.getColumnsCount(), columns = B.getColumnsCount();
+		if (rows == 0 || columns == 0 || inner == 0) {
+			return;
+		}
+		const T* a = A.getValues();
+		const T* b = B.getValues();
+		const std::size_t lda = A.getLeadingDimension(), ldb = B.getLeadingDimension();
+		if (Layout::rowMajor) {
+			kernels::gemmParallel<T>(!LA::rowMajor, !LB::rowMajor, rows, columns, inner, T(1), a, lda, b, ldb,
+					R.getValues(), R.ld);
+		} else {
+			kernels::gemmParallel<T>(LB::rowMajor, LA::rowMajor, columns, rows, inner, T(1), b, ldb, a, lda,
+					R.getValues(), R.ld);
+		}
+	}
+
+	//The factors in slot when caching and computed for the current version
+	template<class F>
+	std::shared_ptr<const F> cached(const std::shared_ptr<const F>& slot) const {
+		if (!caching) {
+			return std::shared_ptr<const F>();
 		}
-		return C(aRows, bColumns, A.getZero(), A.getOne(), _values);
+		std::shared_ptr<const F> factors = std::atomic_load(&slot);
+		return factors && factors->version == version ? factors : std::shared_ptr<const F>();
 	}
 
+	template<class F>
+	void store(std::shared_ptr<const F>& slot, const std::shared_ptr<F>& factors) const {
+		if (caching) {
+			std::atomic_store(&slot, std::shared_ptr<const F>(factors));
+		}
+	}
+
+	//Values less than epsilon apart are equal, as with FloatingPointComparator, tested by the vectorized kernel
+	static bool equalValues(std::true_type, const C& A, const C& B) {
+		const std::size_t lines = Layout::lines(A.m, A.n), length = Layout::length(A.m, A.n);
+		//dense values are one range, padded ones a range per line
+		const bool dense = A.ld == length && B.ld == length;
+		const std::size_t count = dense ? lines * length : length, ranges = dense ? 1 : lines;
+		for (std::size_t i = 0; i < ranges && count > 0; i++) {
+			if (kernels::firstMismatch(count, A.getValues() + i * A.ld, B.getValues() + i * B.ld,
+					std::nextafter(std::numeric_limits<T>::epsilon(), T(0)), T(0), 0) != count) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	static bool equalValues(std::false_type, const C& A, const C& B) {
+		auto iteratorA = A.begin();
+		auto iteratorB = B.begin();
+		while (iteratorA != A.end() && iteratorB != B.end()) {
+			if (C::compare(*iteratorA, *iteratorB) != 0) {
+				return false;
+			}
+			iteratorA++;
+			iteratorB++;
+		}
+		return true;
+	}
+
+	//The reduced row echelon form in R, of d * R for the integral types with d in denominator
+	std::size_t reduce(std::false_type, std::vector<T>& R, const T& tolerance, std::size_t* pivots, T&) const {
+		return kernels::rref(m, n, &R[0], n, tolerance, pivots);
+	}
+
+	std::size_t reduce(std::true_type, std::vector<T>& R, const T&, std::size_t* pivots, T& denominator) const {
+		return kernels::fractionFreeRref(m, n, &R[0], n, pivots, denominator);
+	}
+
+	//Divides an integral special solution by the gcd of its values, keeping its free variable positive
+	static void primitive(std::false_type, std::vector<T>&, std::size_t) {
+	}
+
+	static void primitive(std::true_type, std::vector<T>& solution, std::size_t free) {
+		T divisor = 0;
+		for (std::size_t i = 0; i < solution.size(); i++) {
+			for (T a = divisor, b = solution[i]; ; ) {
+				if (b == 0) {
+					divisor = a < 0 ? T(0) - a : a;
+					break;
+				}
+				T t = a % b;
+				a = b;
+				b = t;
+			}
+		}
+		if (solution[free] < 0) {
+			divisor = T(0) - divisor;
+		}
+		for (std::size_t i = 0; i < solution.size(); i++) {
+			solution[i] /= divisor;
+		}
+	}
+
+	bool eliminate(std::true_type, std::vector<T>& a, std::vector<std::size_t>& pivots) const {
+		return kernels::getrf(n, &a[0], n, &pivots[0]);
+	}
+
+	//Exact elimination for the types without magnitude (ModInt, fractions), in the getrf format
+	bool eliminate(std::false_type, std::vector<T>& a, std::vector<std::size_t>& pivots) const {
+		bool singular = false;
+		for (std::size_t c = 0; c < n; c++) {
+			std::size_t p = c;
+			while (p < n && a[p * n + c] == zero) {
+				p++;
+			}
+			if (p == n) {
+				pivots[c] = c;
+				singular = true;
+				continue;
+			}
+			pivots[c] = p;
+			kernels::swapRows(n, &a[0], n, c, p);
+			const T inverse = one / a[c * n + c];
+			for (std::size_t r = c + 1; r < n; r++) {
+				const T multiplier = a[r * n + c] * inverse;
+				a[r * n + c] = multiplier;
+				for (std::size_t j = c + 1; j < n; j++) {
+					a[r * n + j] = a[r * n + j] - multiplier * a[c * n + j];
+				}
+			}
+		}
+		return singular;
+	}
+
+	C symmetricProduct(bool outer) const {
+		const std::size_t size = outer ? m : n, k = outer ? n : m;
+		OH_STRANG_MEASURE(GRAM, 1.0 * size * (size + 1) * k, size * size * sizeof(T), 0);
+		C G(size, size, zero, one);
+		if (size > 0 && k > 0) {
+			T* g = G.getValues();
+			const std::size_t ldg = G.ld;
+			for (std::size_t i = 0; i < size; i++) {
+				std::fill(g + i * ldg, g + i * ldg + size, T(0));
+			}
+			//the values of a column-major matrix are its transpose: A^T * A is then their outer product
+			kernels::syrk(outer == Layout::rowMajor, size, k, values.data(), ld, g, ldg);
+			for (std::size_t i = 0; i < size; i++) {
+				for (std::size_t j = 0; j < i; j++) {
+					g[j * ldg + i] = g[i * ldg + j];
+				}
+			}
+		}
+		return G;
+	}
 };
 
-template<typename T, class C>
+template<typename T, typename C, class Layout>
+Comparator<T> MatrixCRTP<T, C, Layout>::compare;
+
+template<typename T, class C, class Layout>
 std::basic_ostream<char>&
-operator<<(std::basic_ostream<char>& __os, const MatrixCRTP<T, C>& A)
+operator<<(std::basic_ostream<char>& __os, const MatrixCRTP<T, C, Layout>& A)
 {
-	const std::string __str = A.toString();
-    return _VSTD::__put_character_sequence(__os, __str.c_str(), __str.length());
+	return __os << A.toString();
 };
 
-template<typename T>
-class Matrix : public MatrixCRTP<T, Matrix<T>>{
-	using MatrixCRTP<T, Matrix<T>>::MatrixCRTP;
+template<typename T, class Layout = layout::RowMajor>
+class Matrix : public MatrixCRTP<T, Matrix<T, Layout>, Layout>{
+	using MatrixCRTP<T, Matrix<T, Layout>, Layout>::MatrixCRTP;
 };
+
+#endif //OH_STRANG_MATRIX
@@ -0,0 +1,742 @@
+#ifndef OH_STRANG_MODULAR
+#define OH_STRANG_MODULAR
+
+#include <cstdint>
+#include <climits>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <ostream>
+#include <algorithm>
+#include <stdexcept>
+#include <type_traits>
+
+#include "matrix.cpp"
+#include "parallel.cpp"
+
+/*
+ * modular.cpp
+ *
+ * Exact linear algebra without fractions:
+ *  - ModInt<P>, the integers modulo an odd prime P < 2^31 in Montgomery form, usable as Matrix<ModInt<P>>,
+ *    with modularDeterminant and modularRank eliminating in the field.
+ *  - bareissDeterminant and bareissRank, fraction-free elimination of integer matrices: every intermediate value
+ *    is a minor of the matrix, so it never grows beyond the Hadamard bound.
+ *  - multiModularDeterminant, the exact determinant of integer or rational matrices of any size: it is computed
+ *    modulo enough primes to exceed the Hadamard bound, the primes running in parallel,
+ *    then rebuilt with the Chinese remainder theorem as a BigInteger.
+ */
+
+namespace modular {
+
+/*
+ * Montgomery arithmetic modulo p with R = 2^32: a value a is stored as a * R mod p, so a product only needs
+ * multiplications and shifts. The functions are branch free so the loops over rows vectorize.
+ */
+
+//p^-1 mod 2^32 by Newton iterations, each one doubling the correct bits (p * p = 1 mod 8 for odd p)
+constexpr std::uint32_t newtonInverse(std::uint32_t p, std::uint32_t x, int steps) {
+	return steps == 0 ? x : newtonInverse(p, static_cast<std::uint32_t>(x * (2u - p * x)), steps - 1);
+}
+
+constexpr std::uint32_t negatedInverse(std::uint32_t p) {
+	return 0u - newtonInverse(p, p, 4);
+}
+
+constexpr std::uint32_t reduced(std::uint32_t u, std::uint32_t p) {
+	return u >= p ? u - p : u;
+}
+
+//t * R^-1 mod p for t < p * 2^32
+constexpr std::uint32_t reduce(std::uint64_t t, std::uint32_t p, std::uint32_t negInverse) {
+	return reduced(static_cast<std::uint32_t>((t + static_cast<std::uint64_t>(static_cast<std::uint32_t>(t) * negInverse) * p) >> 32), p);
+}
+
+//R^2 mod p
+constexpr std::uint32_t squaredRadix(std::uint32_t p) {
+	return static_cast<std::uint32_t>((((std::uint64_t(1) << 32) % p) * ((std::uint64_t(1) << 32) % p)) % p);
+}
+
+//Montgomery arithmetic for a modulus known at run time
+struct Montgomery {
+	typedef std::uint32_t value_type;
+
+	std::uint32_t p;
+	std::uint32_t negInverse;
+	std::uint32_t r2;
+
+	explicit Montgomery(std::uint32_t p) : p(p), negInverse(negatedInverse(p)), r2(squaredRadix(p)) {}
+
+	std::uint32_t fromInteger(long long value) const {
+		long long r = value % static_cast<long long>(p);
+		return multiply(static_cast<std::uint32_t>(r < 0 ? r + p : r), r2);
+	}
+
+	std::uint32_t toInteger(std::uint32_t a) const {
+		return reduce(a, p, negInverse);
+	}
+
+	std::uint32_t zero() const {
+		return 0;
+	}
+
+	std::uint32_t one() const {
+		return fromInteger(1);
+	}
+
+	bool isZero(std::uint32_t a) const {
+		return a == 0;
+	}
+
+	std::uint32_t multiply(std::uint32_t a, std::uint32_t b) const {
+		return reduce(static_cast<std::uint64_t>(a) * b, p, negInverse);
+	}
+
+	std::uint32_t subtract(std::uint32_t a, std::uint32_t b) const {
+		return reduced(a + p - b, p);
+	}
+
+	std::uint32_t negate(std::uint32_t a) const {
+		return reduced(p - a, p);
+	}
+
+	std::uint32_t inverse(std::uint32_t a) const {
+		std::uint32_t result = one();
+		for (std::uint32_t e = p - 2; e != 0; e >>= 1) {
+			if (e & 1) {
+				result = multiply(result, a);
+			}
+			a = multiply(a, a);
+		}
+		return result;
+	}
+};
+
+}
+
+//The integers modulo the odd prime P < 2^31
+template<std::uint32_t P>
+class ModInt {
+	static_assert(P % 2 == 1 && P < (1u << 31), "ModInt needs an odd prime modulus below 2^31");
+
+	private:
+		std::uint32_t v;	//Montgomery form
+
+		static constexpr std::uint32_t negInverse() {
+			return modular::negatedInverse(P);
+		}
+
+		static ModInt fromMontgomery(std::uint32_t v) {
+			ModInt a;
+			a.v = v;
+			return a;
+		}
+
+	public:
+		ModInt() : v(0) {}
+
+		ModInt(long long value) {
+			long long r = value % static_cast<long long>(P);
+			v = modular::reduce(static_cast<std::uint64_t>(r < 0 ? r + P : r) * modular::squaredRadix(P), P, negInverse());
+		}
+
+		static constexpr std::uint32_t modulus() {
+			return P;
+		}
+
+		//The representative in [0, P)
+		std::uint32_t value() const {
+			return modular::reduce(v, P, negInverse());
+		}
+
+		ModInt operator+(const ModInt& b) const {
+			return fromMontgomery(modular::reduced(v + b.v, P));
+		}
+
+		ModInt operator-(const ModInt& b) const {
+			return fromMontgomery(modular::reduced(v + P - b.v, P));
+		}
+
+		ModInt operator-() const {
+			return fromMontgomery(modular::reduced(P - v, P));
+		}
+
+		ModInt operator*(const ModInt& b) const {
+			return fromMontgomery(modular::reduce(static_cast<std::uint64_t>(v) * b.v, P, negInverse()));
+		}
+
+		ModInt pow(std::uint64_t e) const {
+			ModInt result(1), base = *this;
+			for (; e != 0; e >>= 1) {
+				if (e & 1) {
+					result *= base;
+				}
+				base *= base;
+			}
+			return result;
+		}
+
+		//Fermat's little theorem, the inverse of 0 is 0
+		ModInt inverse() const {
+			return pow(P - 2);
+		}
+
+		ModInt operator/(const ModInt& b) const {
+			if (b.v == 0) {
+				throw std::domain_error("Division by zero modulo P.");
+			}
+			return *this * b.inverse();
+		}
+
+		ModInt& operator+=(const ModInt& b) { return *this = *this + b; }
+		ModInt& operator-=(const ModInt& b) { return *this = *this - b; }
+		ModInt& operator*=(const ModInt& b) { return *this = *this * b; }
+		ModInt& operator/=(const ModInt& b) { return *this = *this / b; }
+
+		//The Montgomery form is a bijection, so it compares like the values for equality
+		bool operator==(const ModInt& b) const { return v == b.v; }
+		bool operator!=(const ModInt& b) const { return v != b.v; }
+		//Order of the representatives in [0, P), for the comparators
+		bool operator<(const ModInt& b) const { return value() < b.value(); }
+		bool operator>(const ModInt& b) const { return value() > b.value(); }
+};
+
+template<std::uint32_t P>
+std::ostream& operator<<(std::ostream& out, const ModInt<P>& a) {
+	return out << a.value();
+}
+
+namespace modular {
+
+//Field operations of ModInt<P>, with the interface of Montgomery
+template<std::uint32_t P>
+struct StaticField {
+	typedef ModInt<P> value_type;
+
+	ModInt<P> zero() const { return ModInt<P>(); }
+	ModInt<P> one() const { return ModInt<P>(1); }
+	bool isZero(const ModInt<P>& a) const { return a == ModInt<P>(); }
+	ModInt<P> multiply(const ModInt<P>& a, const ModInt<P>& b) const { return a * b; }
+	ModInt<P> subtract(const ModInt<P>& a, const ModInt<P>& b) const { return a - b; }
+	ModInt<P> negate(const ModInt<P>& a) const { return -a; }
+	ModInt<P> inverse(const ModInt<P>& a) const { return a.inverse(); }
+};
+
+/*
+ * In place row echelon form of the m x n matrix A over a field, the elimination below each pivot only.
+ * Returns the rank, determinant receives the determinant of a square A.
+ */
+template<class Field>
+std::size_t eliminate(const Field& F, std::size_t m, std::size_t n, typename Field::value_type* A,
+		typename Field::value_type& determinant) {
+	typedef typename Field::value_type V;
+	std::size_t rank = 0;
+	V product = F.one();
+	for (std::size_t c = 0; c < n && rank < m; c++) {
+		std::size_t pivot = rank;
+		while (pivot < m && F.isZero(A[pivot * n + c])) {
+			pivot++;
+		}
+		if (pivot == m) {
+			product = F.zero();
+			continue;
+		}
+		if (pivot != rank) {
+			std::swap_ranges(A + rank * n + c, A + rank * n + n, A + pivot * n + c);
+			product = F.negate(product);
+		}
+		V* pivotRow = A + rank * n;
+		product = F.multiply(product, pivotRow[c]);
+		const V inverse = F.inverse(pivotRow[c]);
+		for (std::size_t r = rank + 1; r < m; r++) {
+			V* row = A + r * n;
+			if (F.isZero(row[c])) {
+				continue;
+			}
+			const V factor = F.multiply(row[c], inverse);
+			for (std::size_t j = c; j < n; j++) {
+				row[j] = F.subtract(row[j], F.multiply(factor, pivotRow[j]));
+			}
+		}
+		rank++;
+	}
+	determinant = m == n && rank == n ? product : F.zero();
+	return rank;
+}
+
+}
+
+template<std::uint32_t P, class C>
+ModInt<P> modularDeterminant(const MatrixCRTP<ModInt<P>, C>& A) {
+	if (A.getRowsCount() != A.getColumnsCount()) {
+		throw std::domain_error("Only a square matrix has a determinant.");
+	}
+	std::vector<ModInt<P>> values(A.begin(), A.end());
+	ModInt<P> determinant(1);
+	if (!values.empty()) {
+		modular::eliminate(modular::StaticField<P>(), A.getRowsCount(), A.getColumnsCount(), &values[0], determinant);
+	}
+	return determinant;
+}
+
+template<std::uint32_t P, class C>
+std::size_t modularRank(const MatrixCRTP<ModInt<P>, C>& A) {
+	std::vector<ModInt<P>> values(A.begin(), A.end());
+	ModInt<P> determinant;
+	return values.empty() ? 0 :
+			modular::eliminate(modular::StaticField<P>(), A.getRowsCount(), A.getColumnsCount(), &values[0], determinant);
+}
+
+/*
+ * Bareiss fraction-free elimination of integer matrices.
+ * The products are computed in a type twice as wide as T and the divisions are exact;
+ * the result must fit in T.
+ */
+namespace modular {
+
+template<typename T>
+struct Wide {
+	static_assert(std::is_integral<T>::value, "Fraction-free elimination needs an integral type");
+#ifdef __SIZEOF_INT128__
+	typedef typename std::conditional<(sizeof(T) < sizeof(long long)), long long, __int128>::type type;
+#else
+	typedef long long type;
+#endif
+};
+
+//Row echelon form of the m x n matrix A, returns the rank and the sign of the row exchanges
+template<typename W>
+std::size_t bareiss(std::size_t m, std::size_t n, W* A, int& sign) {
+	std::size_t rank = 0;
+	W previous = 1;
+	sign = 1;
+	for (std::size_t c = 0; c < n && rank < m; c++) {
+		std::size_t pivot = rank;
+		while (pivot < m && A[pivot * n + c] == 0) {
+			pivot++;
+		}
+		if (pivot == m) {
+			continue;
+		}
+		if (pivot != rank) {
+			std::swap_ranges(A + rank * n, A + rank * n + n, A + pivot * n);
+			sign = -sign;
+		}
+		const W* pivotRow = A + rank * n;
+		for (std::size_t r = rank + 1; r < m; r++) {
+			W* row = A + r * n;
+			for (std::size_t j = c + 1; j < n; j++) {
+				row[j] = (row[j] * pivotRow[c] - row[c] * pivotRow[j]) / previous;
+			}
+			row[c] = 0;
+		}
+		previous = pivotRow[c];
+		rank++;
+	}
+	return rank;
+}
+
+}
+
+template<typename T, class C>
+T bareissDeterminant(const MatrixCRTP<T, C>& A) {
+	std::size_t n = A.getRowsCount();
+	if (n != A.getColumnsCount()) {
+		throw std::domain_error("Only a square matrix has a determinant.");
+	}
+	if (n == 0) {
+		return T(1);
+	}
+	typedef typename modular::Wide<T>::type W;
+	std::vector<W> values(A.begin(), A.end());
+	int sign;
+	if (modular::bareiss(n, n, &values[0], sign) < n) {
+		return T(0);
+	}
+	return static_cast<T>(sign * values[n * n - 1]);
+}
+
+template<typename T, class C>
+std::size_t bareissRank(const MatrixCRTP<T, C>& A) {
+	typedef typename modular::Wide<T>::type W;
+	std::vector<W> values(A.begin(), A.end());
+	int sign;
+	return values.empty() ? 0 : modular::bareiss(A.getRowsCount(), A.getColumnsCount(), &values[0], sign);
+}
+
+/*
+ * Arbitrary precision integers, only what the Chinese remainder reconstruction and the rational reduction need.
+ */
+class BigInteger {
+	private:
+		bool negative;
+		std::vector<std::uint32_t> limbs;	//magnitude, least significant first, no leading zero
+
+		void trim() {
+			while (!limbs.empty() && limbs.back() == 0) {
+				limbs.pop_back();
+			}
+			if (limbs.empty()) {
+				negative = false;
+			}
+		}
+
+	public:
+		BigInteger(long long value = 0) : negative(value < 0) {
+			unsigned long long magnitude = negative ? 0ull - static_cast<unsigned long long>(value) : value;
+			for (; magnitude != 0; magnitude >>= 32) {
+				limbs.push_back(static_cast<std::uint32_t>(magnitude));
+			}
+		}
+
+		bool isNegative() const {
+			return negative;
+		}
+
+		bool isZero() const {
+			return limbs.empty();
+		}
+
+		BigInteger operator-() const {
+			BigInteger result = *this;
+			result.negative = !negative && !limbs.empty();
+			return result;
+		}
+
+		//this = this * factor + addend, on the magnitude
+		void multiplyAdd(std::uint32_t factor, std::uint32_t addend) {
+			std::uint64_t carry = addend;
+			for (std::size_t i = 0; i < limbs.size(); i++) {
+				std::uint64_t t = static_cast<std::uint64_t>(limbs[i]) * factor + carry;
+				limbs[i] = static_cast<std::uint32_t>(t);
+				carry = t >> 32;
+			}
+			if (carry != 0) {
+				limbs.push_back(static_cast<std::uint32_t>(carry));
+			}
+			trim();
+		}
+
+		//Multiplies the magnitude by factor
+		void multiply(unsigned long long factor) {
+			if (factor <= 0xFFFFFFFFull) {
+				multiplyAdd(static_cast<std::uint32_t>(factor), 0);
+				return;
+			}
+			//x * factor = (x * high) * 2^32 + x * low
+			BigInteger low = *this;
+			low.multiplyAdd(static_cast<std::uint32_t>(factor), 0);
+			multiplyAdd(static_cast<std::uint32_t>(factor >> 32), 0);
+			if (limbs.empty()) {
+				return;
+			}
+			limbs.insert(limbs.begin(), 0);
+			std::uint64_t carry = 0;
+			for (std::size_t i = 0; i < limbs.size(); i++) {
+				std::uint64_t t = static_cast<std::uint64_t>(limbs[i]) + (i < low.limbs.size() ? low.limbs[i] : 0) + carry;
+				limbs[i] = static_cast<std::uint32_t>(t);
+				carry = t >> 32;
+			}
+			if (carry != 0) {
+				limbs.push_back(static_cast<std::uint32_t>(carry));
+			}
+		}
+
+		//Divides the magnitude by divisor, returns the remainder
+		unsigned long long divide(unsigned long long divisor) {
+			if (divisor == 0) {
+				throw std::domain_error("Division by zero.");
+			}
+			unsigned long long remainder = 0;
+			for (std::size_t i = limbs.size(); i-- > 0;) {
+#ifdef __SIZEOF_INT128__
+				unsigned __int128 t = (static_cast<unsigned __int128>(remainder) << 32) | limbs[i];
+				limbs[i] = static_cast<std::uint32_t>(t / divisor);
+				remainder = static_cast<unsigned long long>(t % divisor);
+#else
+				if (divisor > 0xFFFFFFFFull) {
+					throw std::overflow_error("Divisors above 2^32 need 128 bit integers.");
+				}
+				unsigned long long t = (remainder << 32) | limbs[i];
+				limbs[i] = static_cast<std::uint32_t>(t / divisor);
+				remainder = t % divisor;
+#endif
+			}
+			trim();
+			return remainder;
+		}
+
+		unsigned long long modulo(unsigned long long divisor) const {
+			BigInteger copy = *this;
+			return copy.divide(divisor);
+		}
+
+		//Compares the magnitudes
+		static int compareMagnitude(const BigInteger& a, const BigInteger& b) {
+			if (a.limbs.size() != b.limbs.size()) {
+				return a.limbs.size() < b.limbs.size() ? -1 : 1;
+			}
+			for (std::size_t i = a.limbs.size(); i-- > 0;) {
+				if (a.limbs[i] != b.limbs[i]) {
+					return a.limbs[i] < b.limbs[i] ? -1 : 1;
+				}
+			}
+			return 0;
+		}
+
+		//|a| - |b| for |a| >= |b|
+		static BigInteger subtractMagnitude(const BigInteger& a, const BigInteger& b) {
+			BigInteger result = a;
+			result.negative = false;
+			std::int64_t borrow = 0;
+			for (std::size_t i = 0; i < result.limbs.size(); i++) {
+				std::int64_t t = static_cast<std::int64_t>(result.limbs[i]) - borrow - (i < b.limbs.size() ? b.limbs[i] : 0);
+				borrow = t < 0;
+				result.limbs[i] = static_cast<std::uint32_t>(t + (borrow << 32));
+			}
+			result.trim();
+			return result;
+		}
+
+		bool operator==(const BigInteger& b) const {
+			return negative == b.negative && limbs == b.limbs;
+		}
+
+		bool operator!=(const BigInteger& b) const {
+			return !(*this == b);
+		}
+
+		double toDouble() const {
+			double result = 0;
+			for (std::size_t i = limbs.size(); i-- > 0;) {
+				result = result * 4294967296.0 + limbs[i];
+			}
+			return negative ? -result : result;
+		}
+
+		std::string toString() const {
+			if (limbs.empty()) {
+				return "0";
+			}
+			BigInteger copy = *this;
+			std::string digits;
+			while (!copy.isZero()) {
+				unsigned long long chunk = copy.divide(1000000000);
+				for (int i = 0; i < 9 && (chunk != 0 || !copy.isZero()); i++, chunk /= 10) {
+					digits += static_cast<char>('0' + chunk % 10);
+				}
+			}
+			if (negative) {
+				digits += '-';
+			}
+			return std::string(digits.rbegin(), digits.rend());
+		}
+};
+
+inline std::ostream& operator<<(std::ostream& out, const BigInteger& a) {
+	return out << a.toString();
+}
+
+//numerator / denominator in lowest terms, the denominator being positive
+struct Rational {
+	BigInteger numerator;
+	BigInteger denominator;
+
+	std::string toString() const {
+		return denominator == BigInteger(1) ? numerator.toString() : numerator.toString() + "/" + denominator.toString();
+	}
+};
+
+namespace modular {
+
+inline std::uint32_t powerModulo(std::uint64_t base, std::uint64_t e, std::uint32_t p) {
+	std::uint64_t result = 1;
+	base %= p;
+	for (; e != 0; e >>= 1) {
+		if (e & 1) {
+			result = result * base % p;
+		}
+		base = base * base % p;
+	}
+	return static_cast<std::uint32_t>(result);
+}
+
+//Deterministic Miller-Rabin for 32 bit integers
+inline bool isPrime(std::uint32_t n) {
+	if (n < 2 || n % 2 == 0) {
+		return n == 2;
+	}
+	std::uint32_t d = n - 1;
+	int s = 0;
+	while (d % 2 == 0) {
+		d /= 2;
+		s++;
+	}
+	const std::uint32_t bases[] = { 2, 7, 61 };
+	for (std::uint32_t a : bases) {
+		if (a % n == 0) {
+			continue;
+		}
+		std::uint64_t x = powerModulo(a, d, n);
+		if (x == 1 || x == n - 1) {
+			continue;
+		}
+		bool composite = true;
+		for (int i = 1; i < s && composite; i++) {
+			x = x * x % n;
+			composite = x != n - 1;
+		}
+		if (composite) {
+			return false;
+		}
+	}
+	return true;
+}
+
+//The count largest primes below 2^31
+inline std::vector<std::uint32_t> largePrimes(std::size_t count) {
+	std::vector<std::uint32_t> primes;
+	for (std::uint32_t candidate = (1u << 31) - 1; primes.size() < count; candidate -= 2) {
+		if (isPrime(candidate)) {
+			primes.push_back(candidate);
+		}
+	}
+	return primes;
+}
+
+//The integer of smallest magnitude equal to residues[i] modulo primes[i], by Garner's mixed radix algorithm
+inline BigInteger chineseRemainder(const std::vector<std::uint32_t>& residues, const std::vector<std::uint32_t>& primes) {
+	std::size_t k = primes.size();
+	std::vector<std::uint32_t> digits(k);
+	for (std::size_t i = 0; i < k; i++) {
+		//digits[i] = (residues[i] - (d0 + d1 p0 + ...)) / (p0 ... p(i-1)) mod p(i)
+		std::uint64_t p = primes[i], value = 0, radix = 1;
+		for (std::size_t j = 0; j < i; j++) {
+			value = (value + digits[j] * radix) % p;
+			radix = radix * primes[j] % p;
+		}
+		std::uint64_t difference = (residues[i] + p - value) % p;
+		digits[i] = static_cast<std::uint32_t>(difference * powerModulo(radix, p - 2, p) % p);
+	}
+	BigInteger value, modulus(1);
+	for (std::size_t i = k; i-- > 0;) {
+		value.multiplyAdd(primes[i], digits[i]);
+	}
+	for (std::size_t i = 0; i < k; i++) {
+		modulus.multiplyAdd(primes[i], 0);
+	}
+	//symmetric range: values above half the modulus are negative
+	BigInteger twice = value;
+	twice.multiplyAdd(2, 0);
+	return BigInteger::compareMagnitude(twice, modulus) > 0 ? -BigInteger::subtractMagnitude(modulus, value) : value;
+}
+
+//Determinant of an n x n integer matrix, |entries| < 2^63
+inline BigInteger multiModularDeterminant(std::size_t n, const std::vector<long long>& values) {
+	if (n == 0) {
+		return BigInteger(1);
+	}
+	//Hadamard bound: |det| <= product of the row norms
+	double bits = 2;
+	for (std::size_t i = 0; i < n; i++) {
+		double norm = 0;
+		for (std::size_t j = 0; j < n; j++) {
+			norm += static_cast<double>(values[i * n + j]) * static_cast<double>(values[i * n + j]);
+		}
+		if (norm == 0) {
+			return BigInteger(0);
+		}
+		bits += 0.5 * std::log2(norm);
+	}
+	//each prime is above 2^30
+	std::vector<std::uint32_t> primes = largePrimes(static_cast<std::size_t>(bits / 30) + 1);
+	std::vector<std::uint32_t> residues(primes.size());
+	parallel::forRange(0, primes.size(), 1, [&](std::size_t first, std::size_t last) {
+		std::vector<std::uint32_t> reduced(n * n);
+		for (std::size_t k = first; k < last; k++) {
+			Montgomery field(primes[k]);
+			for (std::size_t i = 0; i < n * n; i++) {
+				reduced[i] = field.fromInteger(values[i]);
+			}
+			std::uint32_t determinant;
+			eliminate(field, n, n, &reduced[0], determinant);
+			residues[k] = field.toInteger(determinant);
+		}
+	});
+	return chineseRemainder(residues, primes);
+}
+
+inline unsigned long long gcd(unsigned long long a, unsigned long long b) {
+	while (b != 0) {
+		unsigned long long t = a % b;
+		a = b;
+		b = t;
+	}
+	return a;
+}
+
+//a * b, the overflow being detected before the multiplication
+inline long long checkedMultiply(long long a, long long b) {
+	const bool overflow = a > 0 ? (b > 0 ? a > LLONG_MAX / b : b < LLONG_MIN / a)
+			: a < 0 && (b > 0 ? a < LLONG_MIN / b : b < LLONG_MAX / a);
+	if (overflow) {
+		throw std::overflow_error("The rational entries need more than 64 bits once brought to a common denominator.");
+	}
+	return a * b;
+}
+
+}
+
+//Exact determinant of an integer matrix
+template<typename T, class C>
+BigInteger multiModularDeterminant(const MatrixCRTP<T, C>& A) {
+	static_assert(std::is_integral<T>::value, "The multi-modular determinant needs integral entries");
+	if (A.getRowsCount() != A.getColumnsCount()) {
+		throw std::domain_error("Only a square matrix has a determinant.");
+	}
+	return modular::multiModularDeterminant(A.getRowsCount(), std::vector<long long>(A.begin(), A.end()));
+}
+
+/*
+ * Exact determinant of the rational matrix numerators / denominators (entry by entry).
+ * The entries are brought to their least common denominator D, which with the numerators must fit in 64 bits,
+ * and det(A) = det(D * A) / D^n is reduced to its lowest terms.
+ */
+template<typename T, class C>
+Rational multiModularDeterminant(const MatrixCRTP<T, C>& numerators, const MatrixCRTP<T, C>& denominators) {
+	static_assert(std::is_integral<T>::value, "The multi-modular determinant needs integral entries");
+	std::size_t n = numerators.getRowsCount();
+	if (n != numerators.getColumnsCount()) {
+		throw std::domain_error("Only a square matrix has a determinant.");
+	}
+	if (denominators.getRowsCount() != n || denominators.getColumnsCount() != n) {
+		throw std::domain_error("Rows and columns count must match.");
+	}
+	long long common = 1;
+	for (auto it = denominators.begin(); it != denominators.end(); it++) {
+		if (*it <= 0) {
+			throw std::domain_error("The denominators must be positive.");
+		}
+		common = modular::checkedMultiply(common / static_cast<long long>(modular::gcd(common, *it)), *it);
+	}
+	std::vector<long long> scaled(n * n);
+	auto numerator = numerators.begin();
+	auto denominator = denominators.begin();
+	for (std::size_t i = 0; i < n * n; i++, numerator++, denominator++) {
+		scaled[i] = modular::checkedMultiply(*numerator, common / *denominator);
+	}
+
+	//reduce the magnitude by one factor D at a time, the sign being kept by the numerator
+	Rational result = { modular::multiModularDeterminant(n, scaled), BigInteger(1) };
+	for (std::size_t k = 0; k < n && !result.numerator.isZero(); k++) {
+		unsigned long long g = modular::gcd(common, result.numerator.modulo(common));
+		result.numerator.divide(g);
+		result.denominator.multiply(static_cast<unsigned long long>(common) / g);
+	}
+	if (result.numerator.isZero()) {
+		result.denominator = BigInteger(1);
+	}
+	return result;
+}
+
+#endif //OH_STRANG_MODULAR
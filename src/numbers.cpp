@@ -0,0 +1,641 @@
+#ifndef OH_STRANG_NUMBERS
+#define OH_STRANG_NUMBERS
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+#include <sstream>
+#include <string>
+#include <limits>
+#include <type_traits>
+
+#include "parallel.cpp"
+
+/*
+ * numbers.cpp
+ *
+ * Conversions between scalars and text that do not go through streams.
+ *
+ * Decimal numbers with at most 19 significant digits whose exponent keeps them exactly representable
+ * are converted with a single multiplication or division (Clinger's fast path), anything else falls back to strtod.
+ * Formatting writes the shortest "%g" representation that parses back to the same value, as the lowest
+ * "%.*g" precision that does, except for the integers whose digits are no longer: 100 rather than 1e+02.
+ */
+
+namespace text {
+
+//Fast path limits: mantissas up to 2^digits and powers of ten up to 10^maxPower are exact in T
+template<typename T> struct FloatLimits;
+template<> struct FloatLimits<float> {
+	static const int maxPower = 10;
+	static const int roundTripPrecision = 9;
+	static float fallback(const char* s, char** end) { return std::strtof(s, end); }
+};
+template<> struct FloatLimits<double> {
+	static const int maxPower = 22;
+	static const int roundTripPrecision = 17;
+	static double fallback(const char* s, char** end) { return std::strtod(s, end); }
+};
+template<> struct FloatLimits<long double> {
+	static const int maxPower = -1; //always use the fallback
+	static const int roundTripPrecision = 21;
+	static long double fallback(const char* s, char** end) { return std::strtold(s, end); }
+};
+
+inline bool isDigit(char c) {
+	return c >= '0' && c <= '9';
+}
+
+inline bool isBlank(char c) {
+	return c == ' ' || c == '\t' || c == '\r';
+}
+
+template<typename T>
+T powerOfTen(int exponent) {
+	T power = 1;
+	for (int i = 0; i < exponent; i++) {
+		power *= 10;
+	}
+	return power;
+}
+
+//Parses a floating point number at the start of [first, last), returns the end of the number or 0 when there is none
+template<typename T>
+typename std::enable_if<std::is_floating_point<T>::value, const char*>::type
+parseNumber(const char* first, const char* last, T& value) {
+	static const T powers[] = {
+		powerOfTen<T>(0), powerOfTen<T>(1), powerOfTen<T>(2), powerOfTen<T>(3), powerOfTen<T>(4),
+		powerOfTen<T>(5), powerOfTen<T>(6), powerOfTen<T>(7), powerOfTen<T>(8), powerOfTen<T>(9),
+		powerOfTen<T>(10), powerOfTen<T>(11), powerOfTen<T>(12), powerOfTen<T>(13), powerOfTen<T>(14),
+		powerOfTen<T>(15), powerOfTen<T>(16), powerOfTen<T>(17), powerOfTen<T>(18), powerOfTen<T>(19),
+		powerOfTen<T>(20), powerOfTen<T>(21), powerOfTen<T>(22)
+	};
+
+	const char* p = first;
+	bool negative = false;
+	if (p != last && (*p == '-' || *p == '+')) {
+		negative = *p == '-';
+		p++;
+	}
+
+	std::uint64_t mantissa = 0;
+	int significant = 0;
+	int exponent = 0;
+	bool digits = false;
+	bool truncated = false;
+	for (; p != last && isDigit(*p); p++) {
+		digits = true;
+		if (significant < 19) {
+			mantissa = mantissa * 10 + (*p - '0');
+			significant += mantissa != 0;
+		} else {
+			truncated = truncated || *p != '0';
+			exponent++;
+		}
+	}
+	if (p != last && *p == '.') {
+		p++;
+		for (; p != last && isDigit(*p); p++) {
+			digits = true;
+			if (significant < 19) {
+				mantissa = mantissa * 10 + (*p - '0');
+				significant += mantissa != 0;
+				exponent--;
+			} else {
+				truncated = truncated || *p != '0';
+			}
+		}
+	}
+	if (digits && p != last && (*p == 'e' || *p == 'E')) {
+		const char* e = p + 1;
+		bool negativeExponent = false;
+		if (e != last && (*e == '-' || *e == '+')) {
+			negativeExponent = *e == '-';
+			e++;
+		}
+		if (e != last && isDigit(*e)) {
+			int explicitExponent = 0;
+			for (; e != last && isDigit(*e); e++) {
+				if (explicitExponent < 100000) {
+					explicitExponent = explicitExponent * 10 + (*e - '0');
+				}
+			}
+			exponent += negativeExponent ? -explicitExponent : explicitExponent;
+			p = e;
+		}
+	}
+
+	const int maxPower = FloatLimits<T>::maxPower;
+	if (digits && !truncated && mantissa <= (std::uint64_t(1) << std::numeric_limits<T>::digits)
+			&& exponent >= -maxPower && exponent <= maxPower) {
+		value = static_cast<T>(mantissa);
+		value = exponent < 0 ? value / powers[-exponent] : value * powers[exponent];
+		value = negative ? -value : value;
+		return p;
+	}
+
+	//Slow path: strtod needs a null terminated copy of the token (this also handles inf and nan)
+	const char* end = first;
+	while (end != last && !isBlank(*end) && *end != ',' && *end != ';' && *end != '\n') {
+		end++;
+	}
+	std::string token(first, end);
+	char* parsed = 0;
+	value = FloatLimits<T>::fallback(token.c_str(), &parsed);
+	if (parsed == token.c_str()) {
+		return 0;
+	}
+	return first + (parsed - token.c_str());
+}
+
+//Parses an integer at the start of [first, last), returns the end of the number or 0 when there is none
+template<typename T>
+typename std::enable_if<std::is_integral<T>::value, const char*>::type
+parseNumber(const char* first, const char* last, T& value) {
+	const char* p = first;
+	bool negative = false;
+	if (p != last && (*p == '-' || *p == '+')) {
+		negative = *p == '-';
+		p++;
+	}
+	if (p == last || !isDigit(*p)) {
+		return 0;
+	}
+	value = 0;
+	for (; p != last && isDigit(*p); p++) {
+		value = value * 10 + (*p - '0');
+	}
+	value = negative ? -value : value;
+	return p;
+}
+
+//Any other scalar type is read through its stream operator
+template<typename T>
+typename std::enable_if<!std::is_arithmetic<T>::value, const char*>::type
+parseNumber(const char* first, const char* last, T& value) {
+	const char* end = first;
+	while (end != last && !isBlank(*end) && *end != ',' && *end != ';' && *end != '\n') {
+		end++;
+	}
+	std::istringstream in(std::string(first, end));
+	if (!(in >> value)) {
+		return 0;
+	}
+	return in.eof() ? end : first + static_cast<std::size_t>(in.tellg());
+}
+
+template<typename T>
+typename std::enable_if<std::is_integral<T>::value, char*>::type
+formatNumber(char* out, const T& value) {
+	char digits[24];
+	int count = 0;
+	typename std::make_unsigned<T>::type magnitude = value;
+	if (value < 0) {
+		*out++ = '-';
+		magnitude = 0 - magnitude;
+	}
+	do {
+		digits[count++] = '0' + magnitude % 10;
+		magnitude /= 10;
+	} while (magnitude != 0);
+	while (count > 0) {
+		*out++ = digits[--count];
+	}
+	return out;
+}
+
+//Writes the significant digits d.ddd * 10^exponent the way "%.{precision}g" does
+inline char* formatDigits(char* out, bool negative, const char* digits, int count, int exponent, int precision) {
+	if (negative) {
+		*out++ = '-';
+	}
+	if (exponent < -4 || exponent >= precision) {
+		*out++ = digits[0];
+		if (count > 1) {
+			*out++ = '.';
+			out = std::copy(digits + 1, digits + count, out);
+		}
+		*out++ = 'e';
+		*out++ = exponent < 0 ? '-' : '+';
+		if (exponent > -10 && exponent < 10) {
+			*out++ = '0';
+		}
+		return formatNumber(out, exponent < 0 ? -exponent : exponent);
+	}
+	if (exponent < 0) {
+		*out++ = '0';
+		*out++ = '.';
+		out = std::fill_n(out, -exponent - 1, '0');
+		return std::copy(digits, digits + count, out);
+	}
+	for (int i = 0; i <= exponent; i++) {
+		*out++ = i < count ? digits[i] : '0';
+	}
+	if (count > exponent + 1) {
+		*out++ = '.';
+		out = std::copy(digits + exponent + 1, digits + count, out);
+	}
+	return out;
+}
+
+//Largest number of characters written by formatNumber for a floating point value
+const std::size_t MAX_NUMBER_LENGTH = 48;
+
+//Long doubles of the x87 kind hold 19 digit integers, and the powers of ten up to 10^27, exactly
+const bool EXTENDED_SCALING = std::numeric_limits<long double>::digits >= 64 && std::numeric_limits<long double>::digits < 100;
+
+//10^0 to 10^27, exact in extended precision
+inline const long double* widePowers() {
+	static const long double powers[] = { 1e0L, 1e1L, 1e2L, 1e3L, 1e4L, 1e5L, 1e6L, 1e7L, 1e8L, 1e9L, 1e10L, 1e11L, 1e12L,
+			1e13L, 1e14L, 1e15L, 1e16L, 1e17L, 1e18L, 1e19L, 1e20L, 1e21L, 1e22L, 1e23L, 1e24L, 1e25L, 1e26L, 1e27L };
+	return powers;
+}
+
+/*
+ * The first count significant digits of magnitude and its decimal exponent, from a single scaling by an exact power
+ * of ten rounded to an integer: correctly rounded except for a value within a fraction of an ulp of a tie.
+ * Returns false for exact ties and when the scaling would not be exact enough, which allows up to 15 digits
+ * in double and 18 in extended precision.
+ */
+inline bool scaledDigits(double magnitude, int count, char* digits, int& exponent) {
+	typedef long double Wide;
+	const Wide* powers = widePowers();
+	const int maxPower = EXTENDED_SCALING ? 27 : 22;
+	if (count > (EXTENDED_SCALING ? 18 : 15)) {
+		return false;
+	}
+	exponent = static_cast<int>(std::floor(std::log10(magnitude)));
+	for (int attempt = 0; attempt < 2; attempt++) {
+		const int scale = count - 1 - exponent;
+		if (scale < -maxPower || scale > maxPower) {
+			return false;
+		}
+		//d.dd * 10^exponent as the integer ddd
+		Wide scaled = scale >= 0 ? Wide(magnitude) * powers[scale] : Wide(magnitude) / powers[-scale];
+		if (!EXTENDED_SCALING) {
+			scaled = static_cast<double>(scaled);
+		}
+		Wide mantissa = std::floor(scaled + Wide(0.5));
+		if (scaled - std::floor(scaled) == Wide(0.5)) { //printf rounds the ties to even
+			return false;
+		}
+		if (mantissa < powers[count - 1]) { //the logarithm rounded up
+			exponent--;
+			continue;
+		}
+		if (mantissa >= powers[count]) {
+			if (mantissa > powers[count]) { //the logarithm rounded down
+				exponent++;
+				continue;
+			}
+			mantissa = powers[count - 1]; //9.99 rounded to 10.0
+			exponent++;
+		}
+		unsigned long long integer = static_cast<unsigned long long>(mantissa);
+		for (int i = count - 1; i >= 0; i--) {
+			digits[i] = '0' + integer % 10;
+			integer /= 10;
+		}
+		return true;
+	}
+	return false;
+}
+
+inline int printScientific(char* out, int count, double magnitude) {
+	return std::snprintf(out, MAX_NUMBER_LENGTH, "%.*e", count - 1, magnitude);
+}
+
+inline int printScientific(char* out, int count, long double magnitude) {
+	return std::snprintf(out, MAX_NUMBER_LENGTH, "%.*Le", count - 1, magnitude);
+}
+
+//The first count significant digits of magnitude and its decimal exponent, as printf rounds them
+template<typename T>
+void printedDigits(T magnitude, int count, char* digits, int& exponent) {
+	char scientific[MAX_NUMBER_LENGTH];
+	printScientific(scientific, count, magnitude);
+	const char* p = scientific;
+	for (int i = 0; *p != 'e'; p++) {
+		if (isDigit(*p)) {
+			digits[i++] = *p;
+		}
+	}
+	exponent = std::atoi(p + 1);
+}
+
+/*
+ * Whether the count digits d.dd * 10^exponent read back as value. In extended precision the decimal is rebuilt
+ * with one rounding and accepted when it is clearly away from the midpoints between T values, the text being
+ * parsed otherwise.
+ */
+template<typename T>
+bool readsBack(const T& value, bool negative, const char* digits, int count, int exponent) {
+	const int scale = exponent - (count - 1);
+	if (EXTENDED_SCALING && count <= 19 && scale >= -27 && scale <= 27) {
+		typedef long double Wide;
+		unsigned long long integer = 0;
+		for (int i = 0; i < count; i++) {
+			integer = integer * 10 + (digits[i] - '0');
+		}
+		const Wide* powers = widePowers();
+		Wide decimal = scale >= 0 ? Wide(integer) * powers[scale] : Wide(integer) / powers[-scale];
+		const T magnitude = negative ? -value : value;
+		const Wide below = std::nextafter(magnitude, T(0)), above = std::nextafter(magnitude, std::numeric_limits<T>::infinity());
+		const Wide low = (below + Wide(magnitude)) / 2, high = (Wide(magnitude) + above) / 2;
+		const Wide margin = decimal * std::numeric_limits<Wide>::epsilon() * 4;
+		if (decimal > low + margin && decimal < high - margin) {
+			return true;
+		}
+		if (decimal < low - margin || decimal > high + margin) {
+			return false;
+		}
+	}
+	char text[MAX_NUMBER_LENGTH];
+	char* end = formatDigits(text, negative, digits, count, exponent, FloatLimits<T>::roundTripPrecision);
+	T parsed;
+	return parseNumber(text, end, parsed) != 0 && parsed == value;
+}
+
+/*
+ * The first length digits of magnitude correctly rounded, from the count digits of all. When the digits dropped
+ * read as a tie, all may have been rounded up to it and printf rounds the digits again.
+ */
+inline void roundedDigits(double magnitude, const char* all, int count, int length, char* digits, int& exponent) {
+	bool tie = all[length] == '5';
+	for (int i = length + 1; tie && i < count; i++) {
+		tie = all[i] == '0';
+	}
+	if (tie) {
+		printedDigits(magnitude, length, digits, exponent);
+		return;
+	}
+	std::copy(all, all + length, digits);
+	if (all[length] >= '5') {
+		int i = length - 1;
+		while (i >= 0 && digits[i] == '9') {
+			digits[i--] = '0';
+		}
+		if (i < 0) { //9.99 rounds to 10.0
+			digits[0] = '1';
+			exponent++;
+		} else {
+			digits[i]++;
+		}
+	}
+}
+
+//Writes the shortest "%g" representation of the finite non-zero value that reads back exactly, returns the end
+//of the text. The value is written once with a digit more than a round-trip needs, by scaledDigits or else by
+//printf, then its correctly rounded prefixes are tried from the shortest that may read back up, each one being
+//checked with readsBack.
+template<typename T>
+char* formatShortest(char* out, const T& value) {
+	const int roundTrip = FloatLimits<T>::roundTripPrecision;
+	const bool negative = value < 0;
+	const double magnitude = negative ? -static_cast<double>(value) : static_cast<double>(value);
+	char all[24];
+	int exponent;
+	if (!scaledDigits(magnitude, roundTrip + 1, all, exponent)) {
+		printedDigits(magnitude, roundTrip + 1, all, exponent);
+	}
+
+	//Half an ulp of a normal value is under a unit of digit roundTrip - 3, so a shorter length only reads back
+	//when the digits it drops are zeros or nines up to there
+	int shortest = 1;
+	if (magnitude >= std::numeric_limits<T>::min()) {
+		shortest = roundTrip - 2;
+		while (shortest > 1 && (all[shortest - 1] == '0' || all[shortest - 1] == '9')
+				&& (shortest == roundTrip - 2 || all[shortest - 1] == all[shortest])) {
+			shortest--;
+		}
+	}
+
+	char digits[24];
+	for (int length = shortest; length <= roundTrip; length++) {
+		int rounded = exponent;
+		roundedDigits(magnitude, all, roundTrip + 1, length, digits, rounded);
+		int used = length;
+		while (used > 1 && digits[used - 1] == '0') {
+			used--;
+		}
+		if (readsBack(value, negative, digits, used, rounded)) {
+			return formatDigits(out, negative, digits, used, rounded, length);
+		}
+	}
+
+	//The round-trip digits of printf always read back
+	printedDigits(magnitude, roundTrip, all, exponent);
+	int used = roundTrip;
+	while (used > 1 && all[used - 1] == '0') {
+		used--;
+	}
+	return formatDigits(out, negative, all, used, exponent, roundTrip);
+}
+
+//Writes the shortest "%g" representation of value that reads back exactly, or its integer digits when they are
+//no longer, returns the end of the text. out must have room for MAX_NUMBER_LENGTH characters.
+template<typename T>
+typename std::enable_if<std::is_floating_point<T>::value && !std::is_same<T, long double>::value, char*>::type
+formatNumber(char* out, const T& value) {
+	if (value != value || value == 0 || value - value != 0) { //nan, zeros and infinities
+		return out + std::snprintf(out, MAX_NUMBER_LENGTH, "%g", static_cast<double>(value));
+	}
+	if (!(value > -1e15 && value < 1e15 && value == static_cast<T>(static_cast<long long>(value)))) {
+		return formatShortest(out, value);
+	}
+	//Below 2^digits all the integers are values of T, so a last digit that is not 0 is needed and "%g" writes
+	//the integer digits; otherwise the shortest text is the one with fewer characters
+	const long long integer = static_cast<long long>(value);
+	const T exact = static_cast<T>(1ull << std::numeric_limits<T>::digits);
+	if (integer % 10 != 0 && value > -exact && value < exact) {
+		return formatNumber(out, integer);
+	}
+	char digits[MAX_NUMBER_LENGTH];
+	char* end = formatNumber(digits, integer);
+	char* shortest = formatShortest(out, value);
+	if (end - digits <= shortest - out) {
+		return std::copy(digits, end, out);
+	}
+	return shortest;
+}
+
+template<typename T>
+typename std::enable_if<std::is_same<T, long double>::value, char*>::type
+formatNumber(char* out, const T& value) {
+	int length = 0;
+	for (int precision = 1; precision <= FloatLimits<T>::roundTripPrecision; precision++) {
+		length = std::snprintf(out, MAX_NUMBER_LENGTH, "%.*Lg", precision, value);
+		T parsed;
+		if (value != value || precision == FloatLimits<T>::roundTripPrecision
+				|| (parseNumber(out, out + length, parsed) && parsed == value)) {
+			break;
+		}
+	}
+	return out + length;
+}
+
+/*
+ * Writes value with precision significant digits the way "%.{precision}g" does, returns the end of the text,
+ * or the shortest round-trip text when precision is 0. out must have room for MAX_NUMBER_LENGTH characters.
+ * The digits come from scaledDigits when it can, which only differs from printf on a value within a fraction
+ * of an ulp of a tie.
+ */
+template<typename T>
+typename std::enable_if<std::is_floating_point<T>::value, char*>::type
+formatNumber(char* out, const T& value, int precision) {
+	if (precision <= 0) {
+		return formatNumber(out, value);
+	}
+	precision = std::min<int>(precision, +FloatLimits<T>::roundTripPrecision);
+	if (value != value || value == 0 || value - value != 0) { //nan, zeros and infinities
+		return out + std::snprintf(out, MAX_NUMBER_LENGTH, "%g", static_cast<double>(value));
+	}
+	const bool negative = value < 0;
+	char digits[24];
+	int exponent;
+	typedef typename std::conditional<std::is_same<T, long double>::value, long double, double>::type Printed;
+	const Printed magnitude = negative ? -static_cast<Printed>(value) : static_cast<Printed>(value);
+	if (std::is_same<T, long double>::value || !scaledDigits(static_cast<double>(magnitude), precision, digits, exponent)) {
+		printedDigits(magnitude, precision, digits, exponent);
+	}
+	int used = precision;
+	while (used > 1 && digits[used - 1] == '0') {
+		used--;
+	}
+	return formatDigits(out, negative, digits, used, exponent, precision);
+}
+
+//Integers have no precision
+template<typename T>
+typename std::enable_if<std::is_integral<T>::value, char*>::type
+formatNumber(char* out, const T& value, int) {
+	return formatNumber(out, value);
+}
+
+//Appends the text of any scalar to a string
+template<typename T>
+typename std::enable_if<std::is_arithmetic<T>::value>::type
+appendNumber(std::string& text, const T& value) {
+	char buffer[MAX_NUMBER_LENGTH];
+	text.append(buffer, formatNumber(buffer, value));
+}
+
+template<typename T>
+typename std::enable_if<!std::is_arithmetic<T>::value>::type
+appendNumber(std::string& text, const T& value) {
+	std::ostringstream out;
+	out << value;
+	text += out.str();
+}
+
+//With precision significant digits, 0 for the shortest round-trip text
+template<typename T>
+typename std::enable_if<std::is_arithmetic<T>::value>::type
+appendNumber(std::string& text, const T& value, int precision) {
+	char buffer[MAX_NUMBER_LENGTH];
+	text.append(buffer, formatNumber(buffer, value, precision));
+}
+
+template<typename T>
+typename std::enable_if<!std::is_arithmetic<T>::value>::type
+appendNumber(std::string& text, const T& value, int precision) {
+	std::ostringstream out;
+	if (precision > 0) {
+		out.precision(precision);
+	}
+	out << value;
+	text += out.str();
+}
+
+/*
+ * Text of a matrix, one "[  a  b  ]" line per row.
+ * A summarized matrix only shows edgeItems rows and columns at each end, "..." standing for the others,
+ * so the text of a large matrix costs the same as the text of a small one.
+ */
+struct MatrixFormat {
+	int precision;				//significant digits, 0 for the shortest round-trip text
+	std::size_t edgeItems;		//rows and columns shown at each end of a summarized matrix, 0 never summarizes
+	std::size_t threshold;		//values above which the matrix is summarized
+
+	explicit MatrixFormat(int precision = 0, std::size_t edgeItems = 0, std::size_t threshold = 1000) :
+			precision(precision), edgeItems(edgeItems), threshold(threshold) {}
+
+	bool summarizes(std::size_t m, std::size_t n) const {
+		return edgeItems > 0 && m * n > threshold;
+	}
+};
+
+//Values above which the rows are formatted in parallel
+const std::size_t PARALLEL_FORMAT_VALUES = 1 << 16;
+
+//Indices shown out of count, with count meaning "..."
+inline std::vector<std::size_t> shownIndices(std::size_t count, std::size_t edgeItems, bool summarized) {
+	std::vector<std::size_t> shown;
+	bool elided = summarized && count > 2 * edgeItems;
+	for (std::size_t i = 0; i < count; i++) {
+		if (elided && i == edgeItems) {
+			shown.push_back(count);
+			i = count - edgeItems - 1;
+		} else {
+			shown.push_back(i);
+		}
+	}
+	return shown;
+}
+
+/*
+ * Writes the text of the m x n row-major values in out, replacing its content but keeping its capacity,
+ * so a buffer reused from call to call stops allocating.
+ */
+template<typename T>
+void formatMatrix(std::string& out, std::size_t m, std::size_t n, const T* values, const MatrixFormat& format) {
+	const bool summarized = format.summarizes(m, n);
+	const std::vector<std::size_t> rows = shownIndices(m, format.edgeItems, summarized);
+	const std::vector<std::size_t> columns = shownIndices(n, format.edgeItems, summarized);
+
+	auto formatRows = [&](std::string& text, std::size_t first, std::size_t last) {
+		for (std::size_t r = first; r < last; r++) {
+			if (rows[r] == m) {
+				text += "...";
+			} else {
+				text += "[  ";
+				const T* row = values + rows[r] * n;
+				for (auto c = columns.begin(); c != columns.end(); c++) {
+					if (*c == n) {
+						text += "...";
+					} else {
+						appendNumber(text, row[*c], format.precision);
+					}
+					text += "  ";
+				}
+				text += "]";
+			}
+			if (r + 1 < rows.size()) {
+				text += "\n";
+			}
+		}
+	};
+
+	out.clear();
+	out.reserve(rows.size() * (columns.size() * 10 + 6));
+	if (rows.size() * columns.size() < PARALLEL_FORMAT_VALUES) {
+		formatRows(out, 0, rows.size());
+		return;
+	}
+	const std::size_t chunks = std::min(rows.size(), parallel::hardwareThreads() * 4);
+	std::vector<std::string> texts(chunks);
+	parallel::forRange(0, chunks, 1, [&](std::size_t firstChunk, std::size_t lastChunk) {
+		for (std::size_t k = firstChunk; k < lastChunk; k++) {
+			formatRows(texts[k], rows.size() * k / chunks, rows.size() * (k + 1) / chunks);
+		}
+	});
+	for (auto it = texts.begin(); it != texts.end(); it++) {
+		out += *it;
+	}
+}
+
+}
+
+#endif //OH_STRANG_NUMBERS
@@ -0,0 +1,604 @@
+#ifndef OH_STRANG_OUTOFCORE
+#define OH_STRANG_OUTOFCORE
+
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cmath>
+#include <algorithm>
+#include <stdexcept>
+
+#include "matrix.cpp"
+#include "kernels.cpp"
+#include "parallel.cpp"
+
+#ifdef OH_STRANG_THREADS
+#include <mutex>
+#include <condition_variable>
+#endif
+
+/*
+ * outofcore.cpp
+ *
+ * Tiled out-of-core multiply and LU decomposition for matrices that do not fit in memory.
+ *
+ * A DiskMatrix is stored as a grid of square tiles: the tiles follow each other in row-major order and
+ * each tile is stored row-major, so reading a tile is a single contiguous read.
+ * The tiles on the right and bottom edges are padded with zeros to the full tile size.
+ */
+
+//Time spent moving tiles vs computing, reported by the out-of-core operations
+struct OutOfCoreStats {
+	double ioSeconds;		//time spent reading and writing tiles
+	double waitSeconds;		//part of the I/O time that was not hidden behind computation
+	double computeSeconds;	//time spent in the compute kernels
+	std::size_t bytesRead;
+	std::size_t bytesWritten;
+
+	OutOfCoreStats(): ioSeconds(0), waitSeconds(0), computeSeconds(0), bytesRead(0), bytesWritten(0) {}
+
+	std::string toString() const {
+		std::ostringstream report;
+		report << "I/O: " << ioSeconds << "s (" << waitSeconds << "s not overlapped, "
+				<< bytesRead << " bytes read, " << bytesWritten << " bytes written), compute: "
+				<< computeSeconds << "s";
+		return report.str();
+	}
+};
+
+namespace outofcore {
+
+typedef std::chrono::steady_clock Clock;
+
+inline double secondsSince(const Clock::time_point& start) {
+	return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+}
+
+template<typename T>
+class DiskMatrix {
+private:
+	std::string path;
+	std::size_t m;
+	std::size_t n;
+	std::size_t tile;
+
+public:
+	//Describes an existing tiled file
+	DiskMatrix(const std::string& filePath, const std::size_t& rows, const std::size_t& columns,
+			const std::size_t& tileSize) :
+			path(filePath), m(rows), n(columns), tile(tileSize) {
+		if (tile == 0) {
+			throw std::domain_error("Tile size must be greater than 0.");
+		}
+	}
+
+	//Creates a zero filled tiled file
+	static DiskMatrix create(const std::string& filePath, const std::size_t& rows,
+			const std::size_t& columns, const std::size_t& tileSize) {
+		DiskMatrix D(filePath, rows, columns, tileSize);
+		std::ofstream file(filePath.c_str(), std::ios::binary | std::ios::trunc);
+		if (!file) {
+			throw std::runtime_error("Cannot create " + filePath);
+		}
+		//Seeking past the end leaves a sparse file filled with zeros
+		std::streamoff size = D.tileOffset(D.getTileRowsCount(), 0);
+		if (size > 0) {
+			file.seekp(size - 1);
+			file.put(0);
+		}
+		return D;
+	}
+
+	//Writes an in-memory matrix to a tiled file
+	template<class C>
+	static DiskMatrix fromMatrix(const std::string& filePath, const MatrixCRTP<T, C>& A,
+			const std::size_t& tileSize) {
+		DiskMatrix D = create(filePath, A.getRowsCount(), A.getColumnsCount(), tileSize);
+		std::vector<T> buffer(tileSize * tileSize);
+		std::fstream file = D.open();
+		const T* values = &*A.begin();
+		for (std::size_t ti = 0; ti < D.getTileRowsCount(); ti++) {
+			for (std::size_t tj = 0; tj < D.getTileColumnsCount(); tj++) {
+				std::fill(buffer.begin(), buffer.end(), T(0));
+				std::size_t rows = D.tileRows(ti);
+				std::size_t columns = D.tileColumns(tj);
+				for (std::size_t r = 0; r < rows; r++) {
+					const T* row = values + (ti * tileSize + r) * D.n + tj * tileSize;
+					std::copy(row, row + columns, buffer.begin() + r * tileSize);
+				}
+				D.writeTile(file, ti, tj, &buffer[0]);
+			}
+		}
+		return D;
+	}
+
+	//Loads the whole matrix in memory
+	template<class C>
+	C toMatrix() const {
+		C A(m, n, T(0), T(1));
+		std::vector<T> buffer(tile * tile);
+		std::fstream file = open();
+		T* values = A.getValues();
+		for (std::size_t ti = 0; ti < getTileRowsCount(); ti++) {
+			for (std::size_t tj = 0; tj < getTileColumnsCount(); tj++) {
+				readTile(file, ti, tj, &buffer[0]);
+				std::size_t rows = tileRows(ti);
+				std::size_t columns = tileColumns(tj);
+				for (std::size_t r = 0; r < rows; r++) {
+					std::copy(buffer.begin() + r * tile, buffer.begin() + r * tile + columns,
+							values + (ti * tile + r) * n + tj * tile);
+				}
+			}
+		}
+		return A;
+	}
+
+	//Getters
+	const std::string& getPath() const {
+		return path;
+	}
+
+	const std::size_t& getRowsCount() const {
+		return m;
+	}
+
+	const std::size_t& getColumnsCount() const {
+		return n;
+	}
+
+	const std::size_t& getTileSize() const {
+		return tile;
+	}
+
+	std::size_t getTileRowsCount() const {
+		return (m + tile - 1) / tile;
+	}
+
+	std::size_t getTileColumnsCount() const {
+		return (n + tile - 1) / tile;
+	}
+
+	//Number of meaningful (non padding) rows in the ti-th row of tiles
+	std::size_t tileRows(std::size_t ti) const {
+		return std::min(tile, m - ti * tile);
+	}
+
+	//Number of meaningful (non padding) columns in the tj-th column of tiles
+	std::size_t tileColumns(std::size_t tj) const {
+		return std::min(tile, n - tj * tile);
+	}
+
+	std::size_t tileBytes() const {
+		return tile * tile * sizeof(T);
+	}
+
+	std::streamoff tileOffset(std::size_t ti, std::size_t tj) const {
+		return static_cast<std::streamoff>(ti * getTileColumnsCount() + tj) * tileBytes();
+	}
+
+	//I/O, tile indices are 0 based
+	std::fstream open() const {
+		std::fstream file(path.c_str(), std::ios::binary | std::ios::in | std::ios::out);
+		if (!file) {
+			throw std::runtime_error("Cannot open " + path);
+		}
+		return file;
+	}
+
+	void readTile(std::fstream& file, std::size_t ti, std::size_t tj, T* buffer) const {
+		file.seekg(tileOffset(ti, tj));
+		file.read(reinterpret_cast<char*>(buffer), tileBytes());
+		if (!file) {
+			std::ostringstream err;
+			err << "Cannot read tile (" << ti << "," << tj << ") of " << path;
+			throw std::runtime_error(err.str());
+		}
+	}
+
+	void writeTile(std::fstream& file, std::size_t ti, std::size_t tj, const T* buffer) const {
+		file.seekp(tileOffset(ti, tj));
+		file.write(reinterpret_cast<const char*>(buffer), tileBytes());
+		if (!file) {
+			std::ostringstream err;
+			err << "Cannot write tile (" << ti << "," << tj << ") of " << path;
+			throw std::runtime_error(err.str());
+		}
+	}
+
+};
+
+//Largest tile size for which an out-of-core multiply fits in memoryBudget bytes:
+//one accumulator tile plus two pairs of operand tiles (one being computed, one being prefetched)
+template<typename T>
+std::size_t tileSizeForBudget(std::size_t memoryBudget) {
+	std::size_t tile = static_cast<std::size_t>(std::sqrt(
+			static_cast<double>(memoryBudget) / (5 * sizeof(T))));
+	//round down to a multiple of 64 elements
+	return tile >= 64 ? tile - tile % 64 : std::max<std::size_t>(tile, 1);
+}
+
+/*
+ * Reads a fixed sequence of tiles ahead of the consumer into a ring of buffers.
+ * When threads are available the reads happen on a background thread, so they overlap with
+ * whatever the consumer computes between two calls to next().
+ * Each tile returned by next() stays valid until the matching call to release() (tiles are released in order).
+ */
+template<typename T>
+class TilePrefetcher {
+public:
+	struct Request {
+		const DiskMatrix<T>* matrix;
+		std::size_t ti;
+		std::size_t tj;
+	};
+
+private:
+	std::vector<Request> requests;
+	std::size_t depth;
+	std::size_t tileElements;
+	std::vector<T> ring;
+	std::size_t produced;
+	std::size_t consumed;
+	std::size_t released;
+	//accumulated apart from the caller's statistics, which the consumer keeps updating concurrently
+	OutOfCoreStats reads;
+	OutOfCoreStats& stats;
+	std::string error;
+#ifdef OH_STRANG_THREADS
+	bool stopping;
+	std::mutex lock;
+	std::condition_variable changed;
+	std::thread reader;
+#else
+	std::vector<std::pair<const DiskMatrix<T>*, std::fstream> > files;
+#endif
+
+	//Reads a tile, keeping one stream per matrix
+	static void read(const Request& request, T* buffer,
+			std::vector<std::pair<const DiskMatrix<T>*, std::fstream> >& files) {
+		auto it = files.begin();
+		while (it != files.end() && it->first != request.matrix) {
+			it++;
+		}
+		if (it == files.end()) {
+			files.push_back(std::make_pair(request.matrix, request.matrix->open()));
+			it = files.end() - 1;
+		}
+		request.matrix->readTile(it->second, request.ti, request.tj, buffer);
+	}
+
+#ifdef OH_STRANG_THREADS
+	void run() {
+		std::vector<std::pair<const DiskMatrix<T>*, std::fstream> > files;
+		for (std::size_t index = 0; index < requests.size(); index++) {
+			{
+				std::unique_lock<std::mutex> guard(lock);
+				changed.wait(guard, [&] { return stopping || index - released < depth; });
+				if (stopping) {
+					return;
+				}
+			}
+			auto start = outofcore::Clock::now();
+			try {
+				read(requests[index], &ring[(index % depth) * tileElements], files);
+			} catch (std::exception& e) {
+				std::lock_guard<std::mutex> guard(lock);
+				error = e.what();
+				changed.notify_all();
+				return;
+			}
+			std::lock_guard<std::mutex> guard(lock);
+			reads.ioSeconds += outofcore::secondsSince(start);
+			reads.bytesRead += requests[index].matrix->tileBytes();
+			produced = index + 1;
+			changed.notify_all();
+		}
+	}
+#endif
+
+public:
+	TilePrefetcher(const std::vector<Request>& tiles, std::size_t tileSize, std::size_t buffers,
+			OutOfCoreStats& ioStats) :
+			requests(tiles), depth(std::max<std::size_t>(buffers, 1)), tileElements(tileSize * tileSize),
+			ring(depth * tileElements), produced(0), consumed(0), released(0), stats(ioStats) {
+#ifdef OH_STRANG_THREADS
+		stopping = false;
+		reader = std::thread(&TilePrefetcher::run, this);
+#endif
+	}
+
+	~TilePrefetcher() {
+#ifdef OH_STRANG_THREADS
+		{
+			//unblock the reader if the consumer stopped early
+			std::lock_guard<std::mutex> guard(lock);
+			stopping = true;
+			changed.notify_all();
+		}
+		reader.join();
+#endif
+		stats.ioSeconds += reads.ioSeconds;
+		stats.waitSeconds += reads.waitSeconds;
+		stats.bytesRead += reads.bytesRead;
+	}
+
+	//Next tile of the sequence, blocks until it has been read
+	const T* next() {
+		if (consumed >= requests.size()) {
+			throw std::out_of_range("No more tiles to prefetch.");
+		}
+		if (consumed - released >= depth) {
+			throw std::domain_error("All the prefetch buffers are in use, release a tile first.");
+		}
+		T* buffer = &ring[(consumed % depth) * tileElements];
+#ifdef OH_STRANG_THREADS
+		auto start = outofcore::Clock::now();
+		std::unique_lock<std::mutex> guard(lock);
+		changed.wait(guard, [&] { return produced > consumed || !error.empty(); });
+		if (!error.empty()) {
+			throw std::runtime_error(error);
+		}
+		reads.waitSeconds += outofcore::secondsSince(start);
+#else
+		auto start = outofcore::Clock::now();
+		read(requests[consumed], buffer, files);
+		double elapsed = outofcore::secondsSince(start);
+		reads.ioSeconds += elapsed;
+		reads.waitSeconds += elapsed;
+		reads.bytesRead += requests[consumed].matrix->tileBytes();
+#endif
+		consumed++;
+		return buffer;
+	}
+
+	//Gives back the oldest tile returned by next()
+	void release() {
+#ifdef OH_STRANG_THREADS
+		std::lock_guard<std::mutex> guard(lock);
+		released++;
+		changed.notify_all();
+#else
+		released++;
+#endif
+	}
+};
+
+//C = A * B, streaming the tiles of A and B from disk and writing each tile of C as soon as it is complete.
+//memoryBudget bounds the bytes held in memory: it must fit at least the accumulator tile and one pair of operand tiles.
+template<typename T>
+OutOfCoreStats outOfCoreMultiply(const DiskMatrix<T>& A, const DiskMatrix<T>& B, const DiskMatrix<T>& C,
+		std::size_t memoryBudget) {
+	if (A.getColumnsCount() != B.getRowsCount()) {
+		throw std::domain_error(
+				"Left matrix columns count must match right matrix rows count.");
+	}
+	if (C.getRowsCount() != A.getRowsCount() || C.getColumnsCount() != B.getColumnsCount()) {
+		throw std::domain_error("Result matrix must have as many rows as A and as many columns as B.");
+	}
+	std::size_t tile = A.getTileSize();
+	if (B.getTileSize() != tile || C.getTileSize() != tile) {
+		throw std::domain_error("Tile sizes must match.");
+	}
+	std::size_t tilesInBudget = memoryBudget / A.tileBytes();
+	if (tilesInBudget < 3) {
+		std::ostringstream err;
+		err << "Memory budget too small: " << 3 * A.tileBytes() << " bytes required for tiles of size " << tile;
+		throw std::domain_error(err.str());
+	}
+	//up to 4 pairs of operand tiles in flight, more only costs memory
+	std::size_t buffers = std::min<std::size_t>((tilesInBudget - 1) / 2, 4) * 2;
+
+	std::size_t tileRows = A.getTileRowsCount();
+	std::size_t tileColumns = B.getTileColumnsCount();
+	std::size_t tileInner = A.getTileColumnsCount();
+
+	std::vector<typename TilePrefetcher<T>::Request> requests;
+	requests.reserve(tileRows * tileColumns * tileInner * 2);
+	for (std::size_t ti = 0; ti < tileRows; ti++) {
+		for (std::size_t tj = 0; tj < tileColumns; tj++) {
+			for (std::size_t tk = 0; tk < tileInner; tk++) {
+				typename TilePrefetcher<T>::Request a = { &A, ti, tk };
+				typename TilePrefetcher<T>::Request b = { &B, tk, tj };
+				requests.push_back(a);
+				requests.push_back(b);
+			}
+		}
+	}
+
+	OutOfCoreStats stats;
+	std::vector<T> accumulator(tile * tile);
+	std::fstream output = C.open();
+	{
+		TilePrefetcher<T> prefetcher(requests, tile, buffers, stats);
+		for (std::size_t ti = 0; ti < tileRows; ti++) {
+			for (std::size_t tj = 0; tj < tileColumns; tj++) {
+				std::fill(accumulator.begin(), accumulator.end(), T(0));
+				for (std::size_t tk = 0; tk < tileInner; tk++) {
+					const T* a = prefetcher.next();
+					const T* b = prefetcher.next();
+					auto start = outofcore::Clock::now();
+					kernels::gemmParallel(A.tileRows(ti), B.tileColumns(tj), A.tileColumns(tk), T(1),
+							a, tile, b, tile, &accumulator[0], tile);
+					stats.computeSeconds += outofcore::secondsSince(start);
+					prefetcher.release();
+					prefetcher.release();
+				}
+				auto start = outofcore::Clock::now();
+				C.writeTile(output, ti, tj, &accumulator[0]);
+				double elapsed = outofcore::secondsSince(start);
+				stats.ioSeconds += elapsed;
+				stats.waitSeconds += elapsed;
+				stats.bytesWritten += C.tileBytes();
+			}
+		}
+	}
+	return stats;
+}
+
+/*
+ * In place LU decomposition with partial pivoting of a square disk matrix: P * A = L * U.
+ * On return A holds U on and above its diagonal and the multipliers of the unit lower triangular L below it.
+ * pivots[i] is the (0 based) row exchanged with row i at step i.
+ *
+ * The factorization is left-looking over columns of tiles ("panels"): each panel is loaded once,
+ * updated with the previously factored panels streamed from disk, factored in memory and written back.
+ * memoryBudget must fit a panel and two streamed tiles.
+ * Returns true when the matrix is singular.
+ */
+template<typename T>
+bool outOfCoreLU(const DiskMatrix<T>& A, std::vector<std::size_t>& pivots, std::size_t memoryBudget,
+		OutOfCoreStats& stats) {
+	if (A.getRowsCount() != A.getColumnsCount()) {
+		throw std::domain_error("Out-of-core LU requires a square matrix.");
+	}
+	std::size_t size = A.getRowsCount();
+	std::size_t tile = A.getTileSize();
+	std::size_t tiles = A.getTileRowsCount();
+	std::size_t tileElements = tile * tile;
+	if (memoryBudget < (tiles + 2) * A.tileBytes()) {
+		std::ostringstream err;
+		err << "Memory budget too small: " << (tiles + 2) * A.tileBytes() << " bytes required for a panel of tiles of size " << tile;
+		throw std::domain_error(err.str());
+	}
+
+	bool singular = false;
+	pivots.assign(size, 0);
+	std::vector<T> panel(tiles * tileElements);
+	std::fstream file = A.open();
+
+	//Row r of the panel lives in tile r / tile, at row r % tile
+	auto panelRow = [&](std::size_t r) {
+		return &panel[(r / tile) * tileElements + (r % tile) * tile];
+	};
+	auto swapPanelRows = [&](std::size_t r1, std::size_t r2) {
+		if (r1 != r2) {
+			std::swap_ranges(panelRow(r1), panelRow(r1) + tile, panelRow(r2));
+		}
+	};
+	auto timedPanelIO = [&](std::size_t first, std::size_t column, bool write) {
+		auto start = outofcore::Clock::now();
+		for (std::size_t ti = first; ti < tiles; ti++) {
+			if (write) {
+				A.writeTile(file, ti, column, &panel[ti * tileElements]);
+			} else {
+				A.readTile(file, ti, column, &panel[ti * tileElements]);
+			}
+		}
+		double elapsed = outofcore::secondsSince(start);
+		stats.ioSeconds += elapsed;
+		stats.waitSeconds += elapsed;
+		(write ? stats.bytesWritten : stats.bytesRead) += (tiles - first) * A.tileBytes();
+	};
+
+	for (std::size_t k = 0; k < tiles; k++) {
+		std::size_t first = k * tile;
+		std::size_t width = A.tileColumns(k);
+
+		timedPanelIO(0, k, false);
+
+		auto start = outofcore::Clock::now();
+		//Bring the panel up to date with the row exchanges of the previous panels
+		for (std::size_t r = 0; r < first; r++) {
+			swapPanelRows(r, pivots[r]);
+		}
+		stats.computeSeconds += outofcore::secondsSince(start);
+
+		//Left-looking update with every factored panel: stream L(j..tiles, j)
+		if (k > 0) {
+			std::vector<typename TilePrefetcher<T>::Request> requests;
+			for (std::size_t j = 0; j < k; j++) {
+				for (std::size_t ti = j; ti < tiles; ti++) {
+					typename TilePrefetcher<T>::Request request = { &A, ti, j };
+					requests.push_back(request);
+				}
+			}
+			TilePrefetcher<T> prefetcher(requests, tile, 2, stats);
+			for (std::size_t j = 0; j < k; j++) {
+				//U(j, k) = L(j, j)^-1 * A(j, k), L(j, j) being unit lower triangular
+				const T* Ljj = prefetcher.next();
+				start = outofcore::Clock::now();
+				T* Ujk = &panel[j * tileElements];
+				for (std::size_t r = 1; r < A.tileRows(j); r++) {
+					for (std::size_t q = 0; q < r; q++) {
+						const T l = Ljj[r * tile + q];
+						for (std::size_t c = 0; c < width; c++) {
+							Ujk[r * tile + c] -= l * Ujk[q * tile + c];
+						}
+					}
+				}
+				stats.computeSeconds += outofcore::secondsSince(start);
+				prefetcher.release();
+
+				//A(i, k) -= L(i, j) * U(j, k)
+				for (std::size_t ti = j + 1; ti < tiles; ti++) {
+					const T* Lij = prefetcher.next();
+					start = outofcore::Clock::now();
+					kernels::gemmParallel(A.tileRows(ti), width, A.tileRows(j), T(-1), Lij, tile, Ujk, tile,
+							&panel[ti * tileElements], tile);
+					stats.computeSeconds += outofcore::secondsSince(start);
+					prefetcher.release();
+				}
+			}
+		}
+
+		//Factor the panel rows first..size with partial pivoting
+		start = outofcore::Clock::now();
+		for (std::size_t c = 0; c < width; c++) {
+			std::size_t pivot = first + c;
+			std::size_t best = pivot;
+			for (std::size_t r = pivot + 1; r < size; r++) {
+				if (std::abs(panelRow(r)[c]) > std::abs(panelRow(best)[c])) {
+					best = r;
+				}
+			}
+			if (panelRow(best)[c] == T(0)) { //no non-zero value for this pivot
+				pivots[pivot] = pivot;
+				singular = true;
+				continue;
+			}
+			pivots[pivot] = best;
+			swapPanelRows(pivot, best);
+
+			const T* pivotRow = panelRow(pivot);
+			const T inverse = T(1) / pivotRow[c];
+			for (std::size_t r = pivot + 1; r < size; r++) {
+				T* row = panelRow(r);
+				T multiplier = row[c] * inverse;
+				row[c] = multiplier;
+				if (multiplier == T(0)) {
+					continue;
+				}
+				for (std::size_t cc = c + 1; cc < width; cc++) {
+					row[cc] -= multiplier * pivotRow[cc];
+				}
+			}
+		}
+		stats.computeSeconds += outofcore::secondsSince(start);
+
+		timedPanelIO(0, k, true);
+
+		//Apply the row exchanges of this panel to the L part of the previous panels.
+		//Both exchanged rows are at or below the first row of the panel, so only the tiles from k down are concerned.
+		bool exchanged = false;
+		for (std::size_t r = first; r < first + width; r++) {
+			exchanged = exchanged || pivots[r] != r;
+		}
+		for (std::size_t j = 0; exchanged && j < k; j++) {
+			timedPanelIO(k, j, false);
+			start = outofcore::Clock::now();
+			for (std::size_t r = first; r < first + width; r++) {
+				swapPanelRows(r, pivots[r]);
+			}
+			stats.computeSeconds += outofcore::secondsSince(start);
+			timedPanelIO(k, j, true);
+		}
+	}
+
+	return singular;
+}
+
+#endif //OH_STRANG_OUTOFCORE
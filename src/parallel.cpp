@@ -0,0 +1,66 @@
+#ifndef OH_STRANG_PARALLEL
+#define OH_STRANG_PARALLEL
+
+#include <cstddef>
+#include <vector>
+#include <algorithm>
+
+/*
+ * parallel.cpp
+ *
+ * Minimal threading helpers shared by the kernels.
+ * The Emscripten build has no pthreads, so threading is only enabled natively.
+ * Define OH_STRANG_NO_THREADS to force the serial code paths.
+ */
+
+#if !defined(OH_STRANG_NO_THREADS) && !defined(__EMSCRIPTEN__)
+#define OH_STRANG_THREADS 1
+#include <thread>
+#endif
+
+namespace parallel {
+
+//Number of worker threads available on this host
+inline std::size_t hardwareThreads() {
+#ifdef OH_STRANG_THREADS
+	std::size_t count = std::thread::hardware_concurrency();
+	return count == 0 ? 1 : count;
+#else
+	return 1;
+#endif
+}
+
+//Run fn(first, last) over [begin, end) split in contiguous chunks of at least grain items.
+//Falls back to a single call on the calling thread when the range is too small.
+template<typename F>
+void forRange(std::size_t begin, std::size_t end, std::size_t grain, F fn) {
+	if (end <= begin) {
+		return;
+	}
+	std::size_t count = end - begin;
+	std::size_t chunks = std::min(hardwareThreads(), (count + grain - 1) / std::max<std::size_t>(grain, 1));
+	if (chunks <= 1) {
+		fn(begin, end);
+		return;
+	}
+
+#ifdef OH_STRANG_THREADS
+	std::size_t chunkSize = (count + chunks - 1) / chunks;
+	std::vector<std::thread> workers;
+	workers.reserve(chunks - 1);
+	for (std::size_t first = begin + chunkSize; first < end; first += chunkSize) {
+		workers.push_back(std::thread(fn, first, std::min(end, first + chunkSize)));
+	}
+	//the calling thread takes the first chunk
+	fn(begin, std::min(end, begin + chunkSize));
+	for (auto it = workers.begin(); it != workers.end(); it++) {
+		it->join();
+	}
+#else
+	fn(begin, end);
+#endif
+}
+
+}
+
+#endif //OH_STRANG_PARALLEL
@@ -0,0 +1,435 @@
+#ifndef OH_STRANG_SERIALIZATION
+#define OH_STRANG_SERIALIZATION
+
+#include <istream>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+
+#include "matrix.cpp"
+
+#if !defined(__EMSCRIPTEN__) && (defined(__unix__) || defined(__APPLE__))
+#define OH_STRANG_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/*
+ * serialization.cpp
+ *
+ * Compact binary format for matrices:
+ *
+ *   offset  size  field
+ *   0       4     magic "OHSM"
+ *   4       2     format version
+ *   6       2     byte order mark, 0x0102 written in the writer's native order
+ *   8       1     data type, see binary::Type
+ *   9       1     layout, 0 row-major, 1 column-major
+ *   10      2     flags, bit 0: a checksum follows the values
+ *   12      4     reserved
+ *   16      8     rows
+ *   24      8     columns
+ *   32      ...   rows * columns values
+ *   ...     8     optional Fletcher-64 checksum of the values
+ *
+ * The header is 32 bytes so the values of a memory mapped file are aligned for any element type.
+ */
+
+namespace binary {
+
+const char MAGIC[4] = { 'O', 'H', 'S', 'M' };
+const std::uint16_t VERSION = 1;
+const std::uint16_t BYTE_ORDER_MARK = 0x0102;
+const std::uint16_t FLAG_CHECKSUM = 1;
+
+enum Layout {
+	ROW_MAJOR = 0, COLUMN_MAJOR = 1
+};
+
+struct Header {
+	char magic[4];
+	std::uint16_t version;
+	std::uint16_t byteOrder;
+	std::uint8_t dtype;
+	std::uint8_t layout;
+	std::uint16_t flags;
+	std::uint32_t reserved;
+	std::uint64_t rows;
+	std::uint64_t columns;
+};
+
+//Data type codes, only the types whose size is a multiple of 4 bytes are serializable
+template<typename T> struct Type;
+template<> struct Type<std::int32_t> { static const std::uint8_t code = 1; };
+template<> struct Type<std::int64_t> { static const std::uint8_t code = 2; };
+template<> struct Type<float> { static const std::uint8_t code = 3; };
+template<> struct Type<double> { static const std::uint8_t code = 4; };
+
+/*
+ * Fletcher-64 over the 32 bits words of the values.
+ * The modulo is only taken every few hundred words, before the sums could overflow.
+ */
+class Checksum {
+private:
+	std::uint64_t sum1;
+	std::uint64_t sum2;
+
+public:
+	Checksum(): sum1(0), sum2(0) {}
+
+	//size must be a multiple of 4 bytes
+	void update(const void* data, std::size_t size) {
+		const unsigned char* bytes = static_cast<const unsigned char*>(data);
+		std::size_t words = size / 4;
+		while (words > 0) {
+			std::size_t block = words < 360 ? words : 360;
+			for (std::size_t i = 0; i < block; i++) {
+				std::uint32_t word;
+				std::memcpy(&word, bytes, 4);
+				bytes += 4;
+				sum1 += word;
+				sum2 += sum1;
+			}
+			sum1 %= 0xffffffffu;
+			sum2 %= 0xffffffffu;
+			words -= block;
+		}
+	}
+
+	std::uint64_t value() const {
+		return (sum2 << 32) | sum1;
+	}
+};
+
+inline Header readHeader(std::istream& in) {
+	Header header;
+	in.read(reinterpret_cast<char*>(&header), sizeof(Header));
+	if (!in) {
+		throw std::runtime_error("Truncated binary matrix header.");
+	}
+	if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0) {
+		throw std::domain_error("Not a binary matrix.");
+	}
+	if (header.version > VERSION) {
+		std::ostringstream err;
+		err << "Unsupported binary matrix version " << header.version;
+		throw std::domain_error(err.str());
+	}
+	if (header.byteOrder != BYTE_ORDER_MARK) {
+		throw std::domain_error("Binary matrix byte order does not match this machine.");
+	}
+	if (header.layout != ROW_MAJOR && header.layout != COLUMN_MAJOR) {
+		throw std::domain_error("Unknown binary matrix layout.");
+	}
+	return header;
+}
+
+//Bytes of the values announced by a header, which must be addressable: rows * columns * sizeof(T) fits in size_t
+template<typename T>
+std::size_t valuesSize(const Header& header) {
+	const std::uint64_t limit = std::numeric_limits<std::size_t>::max() / sizeof(T);
+	if (header.rows > limit || header.columns > limit
+			|| (header.columns != 0 && header.rows > limit / header.columns)) {
+		throw std::domain_error("Binary matrix size overflows.");
+	}
+	return static_cast<std::size_t>(header.rows * header.columns * sizeof(T));
+}
+
+//Bytes left to read in a seekable stream, the largest size_t when the stream cannot tell
+inline std::size_t remainingBytes(std::istream& in) {
+	const std::istream::pos_type position = in.tellg();
+	if (position == std::istream::pos_type(-1)) {
+		in.clear();
+		return std::numeric_limits<std::size_t>::max();
+	}
+	in.seekg(0, std::ios::end);
+	const std::istream::pos_type end = in.tellg();
+	in.clear();
+	in.seekg(position);
+	if (end == std::istream::pos_type(-1) || end < position) {
+		return std::numeric_limits<std::size_t>::max();
+	}
+	return static_cast<std::size_t>(end - position);
+}
+
+template<typename T>
+void checkType(const Header& header) {
+	if (header.dtype != Type<T>::code) {
+		std::ostringstream err;
+		err << "Binary matrix data type " << int(header.dtype) << " does not match the requested type "
+				<< int(Type<T>::code);
+		throw std::domain_error(err.str());
+	}
+}
+
+}
+
+//Writes a binary matrix to a stream, the values being written in one or several bulk writes
+template<typename T>
+class BinaryMatrixWriter {
+private:
+	std::ostream& out;
+	std::size_t remaining;
+	bool withChecksum;
+	binary::Checksum checksum;
+
+public:
+	//Writes the header, the values must then be written in row-major order
+	BinaryMatrixWriter(std::ostream& stream, std::size_t rows, std::size_t columns, bool checksumValues = false) :
+			out(stream), remaining(rows * columns), withChecksum(checksumValues) {
+		binary::Header header;
+		std::memset(&header, 0, sizeof(header));
+		std::memcpy(header.magic, binary::MAGIC, sizeof(binary::MAGIC));
+		header.version = binary::VERSION;
+		header.byteOrder = binary::BYTE_ORDER_MARK;
+		header.dtype = binary::Type<T>::code;
+		header.layout = binary::ROW_MAJOR;
+		header.flags = withChecksum ? binary::FLAG_CHECKSUM : 0;
+		header.rows = rows;
+		header.columns = columns;
+		out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	}
+
+	void write(const T* values, std::size_t count) {
+		if (count > remaining) {
+			throw std::out_of_range("More values written than the matrix holds.");
+		}
+		out.write(reinterpret_cast<const char*>(values), count * sizeof(T));
+		if (withChecksum) {
+			checksum.update(values, count * sizeof(T));
+		}
+		remaining -= count;
+	}
+
+	//Writes the checksum, all the values must have been written
+	void close() {
+		if (remaining != 0) {
+			throw std::domain_error("Not all the values of the matrix have been written.");
+		}
+		if (withChecksum) {
+			std::uint64_t sum = checksum.value();
+			out.write(reinterpret_cast<const char*>(&sum), sizeof(sum));
+		}
+		out.flush();
+		if (!out) {
+			throw std::runtime_error("Cannot write binary matrix.");
+		}
+	}
+};
+
+//Reads a binary matrix from a stream, the values being read in one or several bulk reads
+template<typename T>
+class BinaryMatrixReader {
+private:
+	std::istream& in;
+	binary::Header header;
+	std::size_t remaining;
+	binary::Checksum checksum;
+
+public:
+	//Reads and validates the header, whose size must fit in what is left of a seekable stream
+	BinaryMatrixReader(std::istream& stream) :
+			in(stream), header(binary::readHeader(stream)) {
+		binary::checkType<T>(header);
+		if (binary::valuesSize<T>(header) > binary::remainingBytes(in)) {
+			throw std::runtime_error("Truncated binary matrix values.");
+		}
+		remaining = header.rows * header.columns;
+	}
+
+	std::size_t getRowsCount() const {
+		return header.rows;
+	}
+
+	std::size_t getColumnsCount() const {
+		return header.columns;
+	}
+
+	binary::Layout getLayout() const {
+		return static_cast<binary::Layout>(header.layout);
+	}
+
+	bool hasChecksum() const {
+		return (header.flags & binary::FLAG_CHECKSUM) != 0;
+	}
+
+	//Reads the next values in the file order, returns the number of values read
+	std::size_t read(T* values, std::size_t count) {
+		count = count < remaining ? count : remaining;
+		in.read(reinterpret_cast<char*>(values), count * sizeof(T));
+		if (!in) {
+			throw std::runtime_error("Truncated binary matrix values.");
+		}
+		if (hasChecksum()) {
+			checksum.update(values, count * sizeof(T));
+		}
+		remaining -= count;
+		return count;
+	}
+
+	//Verifies the checksum, all the values must have been read
+	void close() {
+		if (remaining != 0) {
+			throw std::domain_error("Not all the values of the matrix have been read.");
+		}
+		if (hasChecksum()) {
+			std::uint64_t sum;
+			in.read(reinterpret_cast<char*>(&sum), sizeof(sum));
+			if (!in) {
+				throw std::runtime_error("Truncated binary matrix checksum.");
+			}
+			if (sum != checksum.value()) {
+				throw std::runtime_error("Binary matrix checksum mismatch.");
+			}
+		}
+	}
+};
+
+template<typename T, class C>
+void writeBinary(std::ostream& out, const MatrixCRTP<T, C>& A, bool checksum = false) {
+	BinaryMatrixWriter<T> writer(out, A.getRowsCount(), A.getColumnsCount(), checksum);
+	if (A.getRowsCount() * A.getColumnsCount() > 0) {
+		writer.write(&*A.begin(), A.getRowsCount() * A.getColumnsCount());
+	}
+	writer.close();
+}
+
+//Reads a binary matrix straight into the values of a new matrix
+template<class C>
+C readBinary(std::istream& in) {
+	typedef typename C::value_type T;
+	BinaryMatrixReader<T> reader(in);
+	std::size_t rows = reader.getRowsCount();
+	std::size_t columns = reader.getColumnsCount();
+	if (reader.getLayout() == binary::ROW_MAJOR) {
+		C A(rows, columns, T(0), T(1));
+		if (rows * columns > 0) {
+			reader.read(A.getValues(), rows * columns);
+		}
+		reader.close();
+		return A;
+	}
+
+	//column-major files are read as their transpose
+	C At(columns, rows, T(0), T(1));
+	if (rows * columns > 0) {
+		reader.read(At.getValues(), rows * columns);
+	}
+	reader.close();
+	return At.transpose();
+}
+
+template<typename T, class C>
+std::string toBinary(const MatrixCRTP<T, C>& A, bool checksum = false) {
+	std::ostringstream out(std::ios::binary);
+	writeBinary(out, A, checksum);
+	return out.str();
+}
+
+template<class C>
+C fromBinary(const char* data, std::size_t size) {
+	std::istringstream in(std::string(data, size), std::ios::binary);
+	return readBinary<C>(in);
+}
+
+#ifdef OH_STRANG_MMAP
+/*
+ * Read-only memory mapping of a binary matrix file.
+ * data() points straight into the mapping, so the values are only paged in when they are accessed.
+ */
+template<typename T>
+class MappedBinaryMatrix {
+private:
+	void* mapping;
+	std::size_t mappingSize;
+	binary::Header header;
+
+	MappedBinaryMatrix(const MappedBinaryMatrix&);
+	MappedBinaryMatrix& operator=(const MappedBinaryMatrix&);
+
+public:
+	MappedBinaryMatrix(const std::string& path): mapping(MAP_FAILED), mappingSize(0) {
+		int fd = ::open(path.c_str(), O_RDONLY);
+		if (fd < 0) {
+			throw std::runtime_error("Cannot open " + path);
+		}
+		struct stat info;
+		if (::fstat(fd, &info) != 0 || static_cast<std::size_t>(info.st_size) < sizeof(binary::Header)) {
+			::close(fd);
+			throw std::runtime_error("Truncated binary matrix header.");
+		}
+		mappingSize = info.st_size;
+		mapping = ::mmap(0, mappingSize, PROT_READ, MAP_PRIVATE, fd, 0);
+		::close(fd);
+		if (mapping == MAP_FAILED) {
+			throw std::runtime_error("Cannot map " + path);
+		}
+
+		std::istringstream in(std::string(static_cast<const char*>(mapping), sizeof(binary::Header)));
+		try {
+			header = binary::readHeader(in);
+			binary::checkType<T>(header);
+			if (header.layout != binary::ROW_MAJOR) {
+				throw std::domain_error("Only row-major binary matrices can be mapped.");
+			}
+			if (binary::valuesSize<T>(header) > mappingSize - sizeof(binary::Header)) {
+				throw std::runtime_error("Truncated binary matrix values.");
+			}
+		} catch (...) {
+			::munmap(mapping, mappingSize);
+			throw;
+		}
+	}
+
+	~MappedBinaryMatrix() {
+		::munmap(mapping, mappingSize);
+	}
+
+	std::size_t getRowsCount() const {
+		return header.rows;
+	}
+
+	std::size_t getColumnsCount() const {
+		return header.columns;
+	}
+
+	const T* data() const {
+		return reinterpret_cast<const T*>(static_cast<const char*>(mapping) + sizeof(binary::Header));
+	}
+
+	//Verifies the checksum if the file has one
+	bool verify() const {
+		if ((header.flags & binary::FLAG_CHECKSUM) == 0) {
+			return true;
+		}
+		std::size_t size = header.rows * header.columns * sizeof(T);
+		if (mappingSize < sizeof(binary::Header) + size + sizeof(std::uint64_t)) {
+			return false;
+		}
+		binary::Checksum checksum;
+		checksum.update(data(), size);
+		std::uint64_t sum;
+		std::memcpy(&sum, reinterpret_cast<const char*>(data()) + size, sizeof(sum));
+		return sum == checksum.value();
+	}
+
+	//Copies the mapped values in a new matrix with a single bulk copy
+	template<class C>
+	C toMatrix() const {
+		C A(header.rows, header.columns, T(0), T(1));
+		if (header.rows * header.columns > 0) {
+			std::memcpy(A.getValues(), data(), header.rows * header.columns * sizeof(T));
+		}
+		return A;
+	}
+};
+#endif
+
+#endif //OH_STRANG_SERIALIZATION
@@ -0,0 +1,170 @@
+#ifndef OH_STRANG_SOLVERS
+#define OH_STRANG_SOLVERS
+
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+#include <memory>
+
+#include "matrix.cpp"
+#include "kernels.cpp"
+
+/*
+ * solvers.cpp
+ *
+ * Dense solvers for A * X = B built on the getrf/getrs kernels.
+ */
+
+//Solves A * X = B with a partial pivoting LU of A in the precision of T. Returns true when A is singular.
+//The factorization is O(n^3), the solve O(n^2) per column when A caches its factors (cacheFactorizations).
+template<typename T, class C>
+bool solve(const MatrixCRTP<T, C>& A, const MatrixCRTP<T, C>& B, C& X) {
+	std::size_t n = A.getRowsCount();
+	if (n != A.getColumnsCount()) {
+		throw std::domain_error("Only a square system can be solved.");
+	}
+	if (B.getRowsCount() != n) {
+		throw std::domain_error("Right hand side rows count must match the matrix rows count.");
+	}
+	std::size_t nrhs = B.getColumnsCount();
+	std::shared_ptr<const LUFactors<T>> factors = A.luFactors();
+	X = C(n, nrhs, B.getZero(), B.getOne());
+	std::copy(B.begin(), B.end(), X.getValues());
+	if (n == 0 || factors->singular) {
+		return n != 0;
+	}
+	kernels::getrs(n, nrhs, &factors->lu[0], n, &factors->pivots[0], X.getValues(), nrhs);
+	return false;
+}
+
+//Solves A * X = B for the symmetric A (its lower triangle) with a Cholesky factorization, cached like the LU of solve.
+//Returns true when A is not positive definite.
+template<typename T, class C>
+bool solvePositiveDefinite(const MatrixCRTP<T, C>& A, const MatrixCRTP<T, C>& B, C& X) {
+	std::size_t n = A.getRowsCount();
+	if (n != A.getColumnsCount()) {
+		throw std::domain_error("Only a square system can be solved.");
+	}
+	if (B.getRowsCount() != n) {
+		throw std::domain_error("Right hand side rows count must match the matrix rows count.");
+	}
+	std::size_t nrhs = B.getColumnsCount();
+	std::shared_ptr<const CholeskyFactors<T>> factors = A.choleskyFactors();
+	X = C(n, nrhs, B.getZero(), B.getOne());
+	std::copy(B.begin(), B.end(), X.getValues());
+	if (n == 0 || !factors->positiveDefinite) {
+		return n != 0;
+	}
+	kernels::pptrs(n, nrhs, &factors->factor[0], X.getValues(), nrhs);
+	return false;
+}
+
+struct RefinementResult {
+	bool converged;			//the refinement reached double precision accuracy
+	bool singular;			//the matrix is singular, X is meaningless
+	int iterations;			//refinement steps done in single precision
+	double residual;		//max |B - A * X| of the returned solution
+};
+
+/*
+ * Solves A * X = B to double precision accuracy by iterative refinement on a single precision LU factorization
+ * (the LAPACK dsgesv strategy): the O(n^3) factorization and the triangular solves run in float,
+ * only the O(n^2) residuals B - A * X are computed in double.
+ * When the refinement does not converge in maxIterations steps, or the float factorization is singular
+ * (A badly conditioned or out of the float range), the system is solved again with a double precision LU.
+ */
+template<class C>
+RefinementResult solveMixedPrecision(const MatrixCRTP<double, C>& A, const MatrixCRTP<double, C>& B, C& X,
+		int maxIterations = 30) {
+	std::size_t n = A.getRowsCount();
+	if (n != A.getColumnsCount()) {
+		throw std::domain_error("Only a square system can be solved.");
+	}
+	if (B.getRowsCount() != n) {
+		throw std::domain_error("Right hand side rows count must match the matrix rows count.");
+	}
+	std::size_t nrhs = B.getColumnsCount();
+	RefinementResult result = { false, false, 0, 0 };
+	X = C(n, nrhs, B.getZero(), B.getOne());
+	if (n == 0 || nrhs == 0) {
+		result.converged = true;
+		return result;
+	}
+
+	const double* a = &*A.begin();
+	const double* b = &*B.begin();
+	double* x = X.getValues();
+
+	//A convergence threshold relative to the size of A, as in dsgesv
+	double norm = 0;
+	for (std::size_t i = 0; i < n; i++) {
+		double sum = 0;
+		for (std::size_t j = 0; j < n; j++) {
+			sum += std::abs(a[i * n + j]);
+		}
+		norm = std::max(norm, sum);
+	}
+	const double threshold = norm * std::numeric_limits<double>::epsilon() * std::sqrt(static_cast<double>(n));
+
+	std::vector<float> LU(a, a + n * n);
+	std::vector<std::size_t> pivots(n);
+	bool singleSingular = kernels::getrf(n, &LU[0], n, &pivots[0]);
+	for (std::size_t i = 0; !singleSingular && i < n; i++) {
+		singleSingular = !std::isfinite(LU[i * n + i]);
+	}
+
+	std::vector<float> correction(b, b + n * nrhs);
+	std::vector<double> residual(n * nrhs);
+	if (!singleSingular) {
+		kernels::getrs(n, nrhs, &LU[0], n, &pivots[0], &correction[0], nrhs);
+		std::copy(correction.begin(), correction.end(), x);
+
+		for (int iteration = 0; iteration <= maxIterations; iteration++) {
+			//R = B - A * X in double precision
+			std::copy(b, b + n * nrhs, residual.begin());
+			kernels::gemmParallel(n, nrhs, n, -1.0, a, n, x, nrhs, &residual[0], nrhs);
+
+			//converged when every column residual is small compared to its solution
+			bool converged = true;
+			result.residual = 0;
+			for (std::size_t j = 0; j < nrhs; j++) {
+				double rMax = 0, xMax = 0;
+				for (std::size_t i = 0; i < n; i++) {
+					rMax = std::max(rMax, std::abs(residual[i * nrhs + j]));
+					xMax = std::max(xMax, std::abs(x[i * nrhs + j]));
+				}
+				converged = converged && rMax <= xMax * threshold;
+				result.residual = std::max(result.residual, rMax);
+			}
+			if (converged) {
+				result.converged = true;
+				return result;
+			}
+			if (iteration == maxIterations) {
+				break;
+			}
+
+			//X += A^-1 * R with the single precision factors
+			std::copy(residual.begin(), residual.end(), correction.begin());
+			kernels::getrs(n, nrhs, &LU[0], n, &pivots[0], &correction[0], nrhs);
+			for (std::size_t i = 0; i < n * nrhs; i++) {
+				x[i] += correction[i];
+			}
+			result.iterations++;
+		}
+	}
+
+	//Fall back to double precision
+	result.singular = solve(A, B, X);
+	x = X.getValues();
+	std::copy(b, b + n * nrhs, residual.begin());
+	kernels::gemmParallel(n, nrhs, n, -1.0, a, n, x, nrhs, &residual[0], nrhs);
+	result.residual = 0;
+	for (auto it = residual.begin(); it != residual.end(); it++) {
+		result.residual = std::max(result.residual, std::abs(*it));
+	}
+	return result;
+}
+
+#endif //OH_STRANG_SOLVERS
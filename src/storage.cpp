@@ -0,0 +1,283 @@
+#ifndef OH_STRANG_STORAGE
+#define OH_STRANG_STORAGE
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <memory>
+#include <new>
+#include <atomic>
+#include <utility>
+#include <iterator>
+
+#include "instrumentation.cpp"
+
+/*
+ * storage.cpp
+ *
+ * Copy-on-write values of a matrix. Copies share one reference counted block, so copying is O(1) whatever
+ * the size, and the first write through a copy whose block is shared copies the block (detaches) first.
+ *
+ * Reads go through a cached pointer to the values, without any check, and never detach: only write() does,
+ * and only the non-const accessors of MatrixCRTP call it. The reference count is atomic, so the copies of one
+ * matrix can be read and written from different threads, each copy being used by one thread at a time as
+ * with std::vector.
+ *
+ * A pointer returned by write() is valid until the storage is copied or assigned. pin() returns one valid for
+ * the lifetime of the storage: the block is never shared again and its copies are deep, as the views of the
+ * bindings need.
+ *
+ * The values start on a cache line (ALIGNMENT bytes), so the kernels load whole lines and vectors without
+ * splitting them. The padded layouts (layout::Padded) also start every row or column on a cache line, with
+ * paddedLength values per line, chosen so that the lines do not all map to the same cache sets.
+ */
+
+namespace storage {
+
+const std::size_t ALIGNMENT = 64;
+
+//Line strides that are a multiple of this many bytes make the walks across lines hit a few cache sets only
+const std::size_t CONFLICT_STRIDE = 1024;
+
+inline bool isAligned(const void* pointer) {
+	return reinterpret_cast<std::uintptr_t>(pointer) % ALIGNMENT == 0;
+}
+
+//Values between the starts of two lines of length values: whole cache lines, plus one when the stride would
+//be a multiple of CONFLICT_STRIDE. Types that do not divide a cache line are not padded.
+template<typename T>
+std::size_t paddedLength(std::size_t length) {
+	if (length == 0 || ALIGNMENT % sizeof(T) != 0) {
+		return length;
+	}
+	const std::size_t perLine = ALIGNMENT / sizeof(T);
+	std::size_t ld = (length + perLine - 1) / perLine * perLine;
+	if (ld * sizeof(T) % CONFLICT_STRIDE == 0) {
+		ld += perLine;
+	}
+	return ld;
+}
+
+//Allocates on ALIGNMENT bytes, the address returned by operator new being kept just before the values
+template<typename T>
+class AlignedAllocator {
+	public:
+		typedef T value_type;
+
+		AlignedAllocator() {}
+
+		template<typename U>
+		AlignedAllocator(const AlignedAllocator<U>&) {}
+
+		T* allocate(std::size_t count) {
+			char* raw = static_cast<char*>(::operator new(count * sizeof(T) + ALIGNMENT + sizeof(void*)));
+			std::uintptr_t address = reinterpret_cast<std::uintptr_t>(raw + sizeof(void*));
+			char* aligned = raw + sizeof(void*) + (ALIGNMENT - address % ALIGNMENT) % ALIGNMENT;
+			reinterpret_cast<void**>(aligned)[-1] = raw;
+			return reinterpret_cast<T*>(aligned);
+		}
+
+		void deallocate(T* values, std::size_t) {
+			::operator delete(reinterpret_cast<void**>(values)[-1]);
+		}
+
+		template<typename U>
+		struct rebind {
+			typedef AlignedAllocator<U> other;
+		};
+
+		template<typename U>
+		bool operator==(const AlignedAllocator<U>&) const {
+			return true;
+		}
+
+		template<typename U>
+		bool operator!=(const AlignedAllocator<U>&) const {
+			return false;
+		}
+};
+
+template<typename T>
+using AlignedVector = std::vector<T, AlignedAllocator<T>>;
+
+//Walks lines of length values ld apart, skipping the padding between them
+template<typename T>
+class LineIterator {
+	public:
+		typedef std::forward_iterator_tag iterator_category;
+		typedef T value_type;
+		typedef std::ptrdiff_t difference_type;
+		typedef const T* pointer;
+		typedef const T& reference;
+
+		LineIterator() : value(0), lineEnd(0), length(0), ld(0) {}
+
+		LineIterator(const T* line, std::size_t length, std::size_t ld) : value(line), lineEnd(line + length),
+				length(length), ld(ld) {}
+
+		reference operator*() const {
+			return *value;
+		}
+
+		pointer operator->() const {
+			return value;
+		}
+
+		LineIterator& operator++() {
+			if (++value == lineEnd) {
+				value += ld - length;
+				lineEnd += ld;
+			}
+			return *this;
+		}
+
+		LineIterator operator++(int) {
+			LineIterator previous(*this);
+			++*this;
+			return previous;
+		}
+
+		bool operator==(const LineIterator& other) const {
+			return value == other.value;
+		}
+
+		bool operator!=(const LineIterator& other) const {
+			return value != other.value;
+		}
+
+	private:
+		const T* value;
+		const T* lineEnd;
+		std::size_t length;
+		std::size_t ld;
+};
+
+template<typename T>
+class SharedValues {
+	public:
+		typedef typename AlignedVector<T>::const_iterator const_iterator;
+
+		SharedValues() : block(none()), first(0) {}
+
+		SharedValues(std::size_t count, const T& value) : block(std::make_shared<Block>(count, value)),
+				first(block->values.data()) {}
+
+		SharedValues(const T* begin, const T* end) : block(std::make_shared<Block>(begin, end)),
+				first(block->values.data()) {}
+
+		//Shares the block of other, unless it is pinned
+		SharedValues(const SharedValues& other) : block(other.block), first(other.first) {
+			if (block->pinned) {
+				copyBlock();
+			}
+		}
+
+		SharedValues(SharedValues&& other) : block(std::move(other.block)), first(other.first) {
+			other.block = none();
+			other.first = 0;
+		}
+
+		SharedValues& operator=(const SharedValues& other) {
+			SharedValues copy(other);
+			swap(copy);
+			return *this;
+		}
+
+		SharedValues& operator=(SharedValues&& other) {
+			swap(other);
+			return *this;
+		}
+
+		void swap(SharedValues& other) {
+			block.swap(other.block);
+			std::swap(first, other.first);
+		}
+
+		//Replaces the values with count copies of value, in a block of their own
+		void assign(std::size_t count, const T& value) {
+			SharedValues values(count, value);
+			swap(values);
+		}
+
+		std::size_t size() const {
+			return block->values.size();
+		}
+
+		bool empty() const {
+			return block->values.empty();
+		}
+
+		const T* data() const {
+			return first;
+		}
+
+		const T& operator[](std::size_t index) const {
+			return first[index];
+		}
+
+		const_iterator begin() const {
+			return block->values.cbegin();
+		}
+
+		const_iterator end() const {
+			return block->values.cend();
+		}
+
+		//Whether other copies use the same values
+		bool shared() const {
+			return block.use_count() > 1;
+		}
+
+		bool sharesWith(const SharedValues& other) const {
+			return block == other.block;
+		}
+
+		//The values to write, copied first when they are shared
+		T* write() {
+			if (block.use_count() != 1) {
+				copyBlock();
+			} else {
+				//The writes must not move before the releases of the copies that shared the block
+				std::atomic_thread_fence(std::memory_order_acquire);
+			}
+			return first;
+		}
+
+		//Writable values that stay in place: the block is never shared again
+		T* pin() {
+			T* values = write();
+			block->pinned = true;
+			return values;
+		}
+
+	private:
+		struct Block {
+			AlignedVector<T> values;
+			bool pinned;
+
+			Block() : pinned(false) {}
+			Block(std::size_t count, const T& value) : values(count, value), pinned(false) {}
+			Block(const T* begin, const T* end) : values(begin, end), pinned(false) {}
+		};
+
+		std::shared_ptr<Block> block;
+		T* first;
+
+		//One block shared by all the empty storages, so that they do not allocate
+		static const std::shared_ptr<Block>& none() {
+			static const std::shared_ptr<Block> block = std::make_shared<Block>();
+			return block;
+		}
+
+		void copyBlock() {
+			OH_STRANG_MEASURE(COPY_ON_WRITE, 0, size() * sizeof(T), size() * sizeof(T));
+			const AlignedVector<T>& values = block->values;
+			block = values.empty() ? std::make_shared<Block>() :
+					std::make_shared<Block>(values.data(), values.data() + values.size());
+			first = block->values.data();
+		}
+};
+
+} //namespace storage
+
+#endif //OH_STRANG_STORAGE
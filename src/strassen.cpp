@@ -0,0 +1,121 @@
+#ifndef OH_STRANG_STRASSEN
+#define OH_STRANG_STRASSEN
+
+#include <cmath>
+#include <limits>
+#include <vector>
+#include <stdexcept>
+
+#include "matrix.cpp"
+#include "kernels.cpp"
+#include "tuning.cpp"
+
+/*
+ * strassen.cpp
+ *
+ * Opt-in fast multiplication of large square matrices by Strassen-Winograd recursion (kernels::strassen):
+ * each level replaces 8 products of half order by 7, until the order reaches tuning::parameters<T>().strassenCutoff
+ * where the blocked gemm takes over. Odd orders are peeled, never padded.
+ *
+ * The price is accuracy: the error is only bounded normwise, and the bound grows by 18 per level
+ * instead of staying at n^2 (Higham, Accuracy and Stability of Numerical Algorithms, 23.2.2).
+ * StrassenReport gives both bounds so the caller can decide.
+ */
+
+//Temporary values of the recursion, reused from one product to the next, optionally capped
+template<typename T>
+class StrassenWorkspace {
+	std::vector<T> buffer;
+	std::size_t maxBytes;
+
+public:
+	//maxBytes of 0 leaves the workspace uncapped
+	explicit StrassenWorkspace(std::size_t maxBytes = 0) : maxBytes(maxBytes) {}
+
+	std::size_t getMaxBytes() const {
+		return maxBytes;
+	}
+
+	std::size_t bytes() const {
+		return buffer.capacity() * sizeof(T);
+	}
+
+	//The deepest recursion for the order n, with levels at most, that fits in the cap
+	std::size_t fittingLevels(std::size_t n, std::size_t levels) const {
+		while (levels > 0 && maxBytes != 0 && kernels::strassenWorkspace(n, levels) * sizeof(T) > maxBytes) {
+			levels--;
+		}
+		return levels;
+	}
+
+	//Grows the buffer to values, never shrinks it
+	T* reserve(std::size_t values) {
+		if (buffer.size() < values) {
+			buffer.resize(values);
+		}
+		return buffer.empty() ? 0 : &buffer[0];
+	}
+};
+
+struct StrassenReport {
+	std::size_t levels;				//levels of recursion, 0 for the classical product
+	std::size_t leafOrder;			//order of the products handed to gemm
+	std::size_t workspaceBytes;
+	double errorBound;				//max |C - computed C| <= errorBound * max|A| * max|B|, to first order
+	double classicalErrorBound;		//the same bound for the classical product
+};
+
+//Levels of recursion until the order is at most cutoff
+inline std::size_t strassenLevels(std::size_t n, std::size_t cutoff) {
+	std::size_t levels = 0;
+	for (; n > std::max<std::size_t>(cutoff, 1); n /= 2) {
+		levels++;
+	}
+	return levels;
+}
+
+/*
+ * Error bounds of the Winograd variant, ((n0^2 + 6 n0) 18^levels - 6 n) u, for leaves of order n0:
+ * n^2 u without recursion, like the classical product. Peeled orders are counted as their even part.
+ */
+template<typename T>
+StrassenReport strassenReport(std::size_t n, std::size_t levels) {
+	const double u = std::numeric_limits<T>::epsilon() / 2;
+	std::size_t leafOrder = n;
+	for (std::size_t level = 0; level < levels; level++) {
+		leafOrder /= 2;
+	}
+	const double leaf = double(leafOrder);
+	StrassenReport report = { levels, leafOrder, kernels::strassenWorkspace(n, levels) * sizeof(T),
+			((leaf * leaf + 6 * leaf) * std::pow(18.0, double(levels)) - 6.0 * n) * u, double(n) * n * u };
+	return report;
+}
+
+//A * B for square matrices by Strassen-Winograd, using the workspace and filling report when given
+template<typename T, class C>
+C strassenMultiply(const MatrixCRTP<T, C>& A, const MatrixCRTP<T, C>& B, StrassenWorkspace<T>& workspace,
+		StrassenReport* report = 0) {
+	const std::size_t n = A.getRowsCount();
+	if (A.getColumnsCount() != n || B.getRowsCount() != n || B.getColumnsCount() != n) {
+		throw std::domain_error("Strassen multiplication needs square matrices of the same order.");
+	}
+	OH_STRANG_MEASURE(MULTIPLY, 2.0 * n * n * n, n * n * sizeof(T), 0);
+	const std::size_t levels = workspace.fittingLevels(n, strassenLevels(n, tuning::parameters<T>().strassenCutoff));
+	C R(n, n, A.getZero(), A.getOne());
+	if (n > 0) {
+		kernels::strassen(n, &*A.begin(), n, &*B.begin(), n, R.getValues(), n, levels,
+				workspace.reserve(kernels::strassenWorkspace(n, levels)));
+	}
+	if (report) {
+		*report = strassenReport<T>(n, levels);
+	}
+	return R;
+}
+
+template<typename T, class C>
+C strassenMultiply(const MatrixCRTP<T, C>& A, const MatrixCRTP<T, C>& B, StrassenReport* report = 0) {
+	StrassenWorkspace<T> workspace;
+	return strassenMultiply(A, B, workspace, report);
+}
+
+#endif //OH_STRANG_STRASSEN
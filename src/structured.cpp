@@ -0,0 +1,564 @@
+#ifndef OH_STRANG_STRUCTURED
+#define OH_STRANG_STRUCTURED
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+
+#include "matrix.cpp"
+#include "kernels.cpp"
+
+/*
+ * structured.cpp
+ *
+ * Square matrices storing only their meaningful values, with the 1 based getValue/setValue of MatrixCRTP:
+ *  - DiagonalMatrix<T>, the n diagonal values
+ *  - TriangularMatrix<T>, the packed lower or upper triangle, optionally with an implicit unit diagonal
+ *  - SymmetricMatrix<T>, the packed lower triangle
+ *  - BandedMatrix<T>, the kl subdiagonals, the diagonal and the ku superdiagonals; tridiagonal for kl = ku = 1
+ * The values outside the structure read as zeros and cannot be set to anything else.
+ * Multiplying by a dense matrix, solving and the determinant run on the stored values only:
+ * TRMM/TRSM for the triangles, L * D * L^T for the symmetric matrices, banded LU and the Thomas algorithm for the bands.
+ */
+
+template<typename T, class C>
+class StructuredCRTP {
+protected:
+	std::vector<T> values;
+	std::size_t n;
+	T zero;
+	T one;
+
+	static Comparator<T> compare;
+
+	StructuredCRTP(std::size_t size, std::size_t stored, const T& z0, const T& o1) :
+			values(stored, z0), n(size), zero(z0), one(o1) {
+	}
+
+	const C& self() const {
+		return *static_cast<const C*>(this);
+	}
+
+public:
+	typedef T value_type;
+
+	//Getters
+	const T& getValue(int row, int column) const {
+		const T* value = self().find(row - 1, column - 1);
+		return value ? *value : zero;
+	}
+
+	const std::size_t& getRowsCount() const {
+		return n;
+	}
+
+	const std::size_t& getColumnsCount() const {
+		return n;
+	}
+
+	const T& getZero() const {
+		return zero;
+	}
+
+	const T& getOne() const {
+		return one;
+	}
+
+	//The stored values, in the layout of the structure
+	T* getValues() {
+		return values.empty() ? 0 : &values[0];
+	}
+
+	std::size_t getStoredCount() const {
+		return values.size();
+	}
+
+	//Iterators over the stored values
+	typename std::vector<T>::const_iterator begin() const {
+		return values.cbegin();
+	}
+
+	typename std::vector<T>::const_iterator end() const {
+		return values.cend();
+	}
+
+	//Setters, throwing std::out_of_range for a non zero value outside the structure
+	T setValue(int row, int column, const T& val) {
+		if (row < 1 || row > n || column < 1 || column > n) {
+			throw std::out_of_range("Row and column indices must be between 1 and the order of the matrix");
+		}
+		T* value = const_cast<T*>(self().find(row - 1, column - 1));
+		if (value == &one) { //the implicit unit diagonal of a triangle
+			if (val != one) {
+				throw std::out_of_range("The diagonal of a unit triangular matrix only holds ones");
+			}
+			return one;
+		}
+		if (!value) {
+			if (val != zero) {
+				throw std::out_of_range("The value is outside the structure of the matrix");
+			}
+			return zero;
+		}
+		T oldValue = *value;
+		*value = val;
+		return oldValue;
+	}
+
+	template<class D = Matrix<T>>
+	D toDense() const {
+		D A(n, n, zero, one);
+		for (std::size_t i = 1; i <= n; i++) {
+			for (std::size_t j = 1; j <= n; j++) {
+				A.setValue(i, j, getValue(i, j));
+			}
+		}
+		return A;
+	}
+
+	//casting, the same text as the dense matrix
+	std::string toString() const {
+		OH_STRANG_MEASURE(TO_STRING, 0, n * (n * 8 + 4), 0);
+		std::string matrix;
+		matrix.reserve(n * (n * 8 + 4));
+		for (std::size_t i = 1; i <= n; i++) {
+			matrix += "[  ";
+			for (std::size_t j = 1; j <= n; j++) {
+				text::appendNumber(matrix, getValue(i, j));
+				matrix += "  ";
+			}
+			matrix += (i < n) ? "]\n" : "]";
+		}
+		return matrix;
+	}
+
+	//Solves A * X = B. Returns true when A is singular.
+	template<class D>
+	bool solve(const MatrixCRTP<T, D>& B, D& X) const {
+		if (B.getRowsCount() != n) {
+			throw std::domain_error("Right hand side rows count must match the matrix rows count.");
+		}
+		std::size_t nrhs = B.getColumnsCount();
+		X = D(n, nrhs, B.getZero(), B.getOne());
+		if (n * nrhs == 0) {
+			return false;
+		}
+		std::copy(B.begin(), B.end(), X.getValues());
+		return self().solveInPlace(nrhs, X.getValues(), nrhs);
+	}
+
+	friend bool operator==(const C& A, const C& B) {
+		return static_cast<const StructuredCRTP&>(A).equals(B);
+	}
+
+	friend bool operator!=(const C& A, const C& B) {
+		return !(A == B);
+	}
+
+	//Multiplication by a dense matrix
+	template<class D>
+	friend D operator*(const C& A, const MatrixCRTP<T, D>& B) {
+		return static_cast<const StructuredCRTP&>(A).multiply(B);
+	}
+
+private:
+	//Equality of the structures and of the stored values
+	bool equals(const C& B) const {
+		if (!self().sameStructure(B)) {
+			return false;
+		}
+		for (auto a = begin(), b = B.begin(); a != end(); a++, b++) {
+			if (compare(*a, *b) != 0) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	template<class D>
+	D multiply(const MatrixCRTP<T, D>& B) const {
+		if (n != B.getRowsCount()) {
+			throw std::domain_error("Left matrix columns count must match right matrix rows count.");
+		}
+		std::size_t nrhs = B.getColumnsCount();
+		OH_STRANG_MEASURE(MULTIPLY, 2.0 * values.size() * nrhs, n * nrhs * sizeof(T), 0);
+		D R(n, nrhs, B.getZero(), B.getOne());
+		if (n * nrhs > 0) {
+			self().multiplyInto(nrhs, &*B.begin(), nrhs, R.getValues(), nrhs);
+		}
+		return R;
+	}
+};
+
+template<typename T, typename C>
+Comparator<T> StructuredCRTP<T, C>::compare;
+
+template<typename T, class C>
+std::basic_ostream<char>&
+operator<<(std::basic_ostream<char>& __os, const StructuredCRTP<T, C>& A)
+{
+	return __os << A.toString();
+}
+
+template<typename T>
+class DiagonalMatrix : public StructuredCRTP<T, DiagonalMatrix<T>> {
+	typedef StructuredCRTP<T, DiagonalMatrix<T>> Base;
+	friend Base;
+	using Base::values;
+	using Base::n;
+	using Base::zero;
+	using Base::one;
+
+public:
+	DiagonalMatrix() : Base(0, 0, 0, 1) {}
+
+	DiagonalMatrix(std::size_t size, const T& z0, const T& o1) : Base(size, size, z0, o1) {}
+
+	template<class D>
+	static DiagonalMatrix fromDense(const MatrixCRTP<T, D>& A) {
+		DiagonalMatrix R(std::min(A.getRowsCount(), A.getColumnsCount()), A.getZero(), A.getOne());
+		for (std::size_t i = 0; i < R.n; i++) {
+			R.values[i] = A.getValue(i + 1, i + 1);
+		}
+		return R;
+	}
+
+	T det() const {
+		T d = one;
+		for (std::size_t i = 0; i < n; i++) {
+			d *= values[i];
+		}
+		return d;
+	}
+
+protected:
+	const T* find(std::size_t i, std::size_t j) const {
+		return i == j ? &values[i] : 0;
+	}
+
+	bool sameStructure(const DiagonalMatrix& B) const {
+		return n == B.n;
+	}
+
+	void multiplyInto(std::size_t nrhs, const T* B, std::size_t ldb, T* C, std::size_t ldc) const {
+		for (std::size_t i = 0; i < n; i++) {
+			std::copy(B + i * ldb, B + i * ldb + nrhs, C + i * ldc);
+			kernels::scaleRow(nrhs, C + i * ldc, values[i]);
+		}
+	}
+
+	bool solveInPlace(std::size_t nrhs, T* B, std::size_t ldb) const {
+		for (std::size_t i = 0; i < n; i++) {
+			if (values[i] == zero) {
+				return true;
+			}
+		}
+		for (std::size_t i = 0; i < n; i++) {
+			kernels::scaleRow(nrhs, B + i * ldb, one / values[i]);
+		}
+		return false;
+	}
+};
+
+template<typename T>
+class TriangularMatrix : public StructuredCRTP<T, TriangularMatrix<T>> {
+	typedef StructuredCRTP<T, TriangularMatrix<T>> Base;
+	friend Base;
+	using Base::values;
+	using Base::n;
+	using Base::zero;
+	using Base::one;
+
+	bool lower;
+	bool unit;	//the diagonal is ones and is not stored
+
+public:
+	TriangularMatrix() : Base(0, 0, 0, 1), lower(true), unit(false) {}
+
+	TriangularMatrix(std::size_t size, bool lowerTriangle, const T& z0, const T& o1, bool unitDiagonal = false) :
+			Base(size, size * (size + 1) / 2, z0, o1), lower(lowerTriangle), unit(unitDiagonal) {
+		if (unit) {
+			for (std::size_t i = 0; i < n; i++) {
+				values[kernels::packedRow(n, i, lower) + (lower ? i : 0)] = one;
+			}
+		}
+	}
+
+	//The lower or upper triangle of the square matrix A
+	template<class D>
+	static TriangularMatrix fromDense(const MatrixCRTP<T, D>& A, bool lowerTriangle, bool unitDiagonal = false) {
+		if (A.getRowsCount() != A.getColumnsCount()) {
+			throw std::domain_error("Only a square matrix has a triangular part.");
+		}
+		TriangularMatrix R(A.getRowsCount(), lowerTriangle, A.getZero(), A.getOne(), unitDiagonal);
+		for (std::size_t i = 0; i < R.n; i++) {
+			for (std::size_t j = lowerTriangle ? 0 : i; j < (lowerTriangle ? i + 1 : R.n); j++) {
+				if (i != j || !unitDiagonal) {
+					*const_cast<T*>(R.find(i, j)) = A.getValue(i + 1, j + 1);
+				}
+			}
+		}
+		return R;
+	}
+
+	bool isLower() const {
+		return lower;
+	}
+
+	bool isUnitDiagonal() const {
+		return unit;
+	}
+
+	//The lower triangle becomes the upper one and conversely
+	TriangularMatrix transpose() const {
+		TriangularMatrix R(n, !lower, zero, one, unit);
+		for (std::size_t i = 0; i < n; i++) {
+			for (std::size_t j = lower ? 0 : i; j < (lower ? i + 1 : n); j++) {
+				*const_cast<T*>(R.find(j, i)) = *find(i, j);
+			}
+		}
+		return R;
+	}
+
+	T det() const {
+		T d = one;
+		for (std::size_t i = 0; i < n && !unit; i++) {
+			d *= *find(i, i);
+		}
+		return d;
+	}
+
+protected:
+	const T* find(std::size_t i, std::size_t j) const {
+		if (lower ? j > i : j < i) {
+			return 0;
+		}
+		if (unit && i == j) {
+			return &one;
+		}
+		return &values[kernels::packedRow(n, i, lower) + (lower ? j : j - i)];
+	}
+
+	bool sameStructure(const TriangularMatrix& B) const {
+		return n == B.n && lower == B.lower && unit == B.unit;
+	}
+
+	void multiplyInto(std::size_t nrhs, const T* B, std::size_t ldb, T* C, std::size_t ldc) const {
+		for (std::size_t i = 0; i < n; i++) {
+			std::copy(B + i * ldb, B + i * ldb + nrhs, C + i * ldc);
+		}
+		kernels::trmm(lower, unit, n, nrhs, &values[0], C, ldc);
+	}
+
+	bool solveInPlace(std::size_t nrhs, T* B, std::size_t ldb) const {
+		return kernels::trsm(lower, unit, n, nrhs, &values[0], B, ldb);
+	}
+};
+
+template<typename T>
+class SymmetricMatrix : public StructuredCRTP<T, SymmetricMatrix<T>> {
+	typedef StructuredCRTP<T, SymmetricMatrix<T>> Base;
+	friend Base;
+	using Base::values;
+	using Base::n;
+	using Base::zero;
+	using Base::one;
+
+public:
+	SymmetricMatrix() : Base(0, 0, 0, 1) {}
+
+	SymmetricMatrix(std::size_t size, const T& z0, const T& o1) : Base(size, size * (size + 1) / 2, z0, o1) {}
+
+	//The lower triangle of the square matrix A, mirrored
+	template<class D>
+	static SymmetricMatrix fromDense(const MatrixCRTP<T, D>& A) {
+		if (A.getRowsCount() != A.getColumnsCount()) {
+			throw std::domain_error("Only a square matrix can be symmetric.");
+		}
+		SymmetricMatrix R(A.getRowsCount(), A.getZero(), A.getOne());
+		for (std::size_t i = 0; i < R.n; i++) {
+			for (std::size_t j = 0; j <= i; j++) {
+				*const_cast<T*>(R.find(i, j)) = A.getValue(i + 1, j + 1);
+			}
+		}
+		return R;
+	}
+
+	//A^T * A, or A * A^T when outer is set, computed in the packed storage by the syrk kernel
+	template<class D>
+	static SymmetricMatrix gram(const MatrixCRTP<T, D>& A, bool outer = false) {
+		const std::size_t size = outer ? A.getRowsCount() : A.getColumnsCount(), k = outer ? A.getColumnsCount() : A.getRowsCount();
+		OH_STRANG_MEASURE(GRAM, 1.0 * size * (size + 1) * k, size * (size + 1) / 2 * sizeof(T), 0);
+		SymmetricMatrix R(size, A.getZero(), A.getOne());
+		if (size > 0 && k > 0) {
+			std::fill(R.values.begin(), R.values.end(), T(0));
+			kernels::syrk(outer, size, k, &*A.begin(), A.getColumnsCount(), &R.values[0], 0);
+		}
+		return R;
+	}
+
+	T det() const {
+		std::vector<T> factors(values);
+		//the dense LU with row exchanges when a pivot of D is zero
+		if (n > 0 && kernels::sptrf(n, &factors[0])) {
+			T d = one;
+			for (std::size_t i = 0; i < n; i++) {
+				d *= factors[kernels::packedRow(n, i, true) + i];
+			}
+			return d;
+		}
+		if (n == 0) {
+			return one;
+		}
+		Matrix<T> A = this->toDense();
+		std::vector<std::size_t> pivots(n);
+		if (kernels::getrf(n, A.getValues(), n, &pivots[0])) {
+			return zero;
+		}
+		T d = one;
+		for (std::size_t i = 0; i < n; i++) {
+			d *= A.getValues()[i * n + i];
+			if (pivots[i] != i) {
+				d = zero - d;
+			}
+		}
+		return d;
+	}
+
+protected:
+	const T* find(std::size_t i, std::size_t j) const {
+		return &values[kernels::packedRow(n, std::max(i, j), true) + std::min(i, j)];
+	}
+
+	bool sameStructure(const SymmetricMatrix& B) const {
+		return n == B.n;
+	}
+
+	void multiplyInto(std::size_t nrhs, const T* B, std::size_t ldb, T* C, std::size_t ldc) const {
+		kernels::spmm(n, nrhs, &values[0], B, ldb, C, ldc);
+	}
+
+	//L * D * L^T, or a pivoting dense LU when a pivot of D is zero (an indefinite matrix)
+	bool solveInPlace(std::size_t nrhs, T* B, std::size_t ldb) const {
+		std::vector<T> factors(values);
+		if (kernels::sptrf(n, &factors[0])) {
+			kernels::sptrs(n, nrhs, &factors[0], B, ldb);
+			return false;
+		}
+		Matrix<T> A = this->toDense();
+		std::vector<std::size_t> pivots(n);
+		if (kernels::getrf(n, A.getValues(), n, &pivots[0])) {
+			return true;
+		}
+		kernels::getrs(n, nrhs, A.getValues(), n, &pivots[0], B, ldb);
+		return false;
+	}
+};
+
+template<typename T>
+class BandedMatrix : public StructuredCRTP<T, BandedMatrix<T>> {
+	typedef StructuredCRTP<T, BandedMatrix<T>> Base;
+	friend Base;
+	using Base::values;
+	using Base::n;
+	using Base::zero;
+	using Base::one;
+
+	std::size_t kl;
+	std::size_t ku;
+
+	//LU with partial pivoting in a band widened for the fill-in, returns true when singular
+	bool factor(std::vector<T>& LU, std::vector<std::size_t>& pivots) const {
+		const std::size_t width = kl + ku + 1, ldab = 2 * kl + ku + 1;
+		LU.assign(n * ldab, zero);
+		pivots.resize(n);
+		for (std::size_t i = 0; i < n; i++) {
+			std::copy(values.begin() + i * width, values.begin() + (i + 1) * width, LU.begin() + i * ldab);
+		}
+		return kernels::gbtrf(n, kl, ku, &LU[0], ldab, &pivots[0]);
+	}
+
+public:
+	BandedMatrix() : Base(0, 0, 0, 1), kl(0), ku(0) {}
+
+	BandedMatrix(std::size_t size, std::size_t subdiagonals, std::size_t superdiagonals, const T& z0, const T& o1) :
+			Base(size, size * (subdiagonals + superdiagonals + 1), z0, o1), kl(subdiagonals), ku(superdiagonals) {
+	}
+
+	//The band of the square matrix A
+	template<class D>
+	static BandedMatrix fromDense(const MatrixCRTP<T, D>& A, std::size_t subdiagonals, std::size_t superdiagonals) {
+		if (A.getRowsCount() != A.getColumnsCount()) {
+			throw std::domain_error("Only a square matrix can be stored as a band.");
+		}
+		BandedMatrix R(A.getRowsCount(), subdiagonals, superdiagonals, A.getZero(), A.getOne());
+		for (std::size_t i = 0; i < R.n; i++) {
+			for (std::size_t j = i > subdiagonals ? i - subdiagonals : 0; j < std::min(R.n, i + superdiagonals + 1); j++) {
+				*const_cast<T*>(R.find(i, j)) = A.getValue(i + 1, j + 1);
+			}
+		}
+		return R;
+	}
+
+	std::size_t getSubdiagonalsCount() const {
+		return kl;
+	}
+
+	std::size_t getSuperdiagonalsCount() const {
+		return ku;
+	}
+
+	T det() const {
+		if (n == 0) {
+			return one;
+		}
+		std::vector<T> LU;
+		std::vector<std::size_t> pivots;
+		if (factor(LU, pivots)) {
+			return zero;
+		}
+		T d = one;
+		for (std::size_t i = 0; i < n; i++) {
+			d *= LU[i * (2 * kl + ku + 1) + kl];
+			if (pivots[i] != i) {
+				d = zero - d;
+			}
+		}
+		return d;
+	}
+
+protected:
+	//The slots of the band outside the matrix, above the first row and below the last, hold zeros
+	const T* find(std::size_t i, std::size_t j) const {
+		if (j + kl < i || j > i + ku) {
+			return 0;
+		}
+		return &values[i * (kl + ku + 1) + j + kl - i];
+	}
+
+	bool sameStructure(const BandedMatrix& B) const {
+		return n == B.n && kl == B.kl && ku == B.ku;
+	}
+
+	void multiplyInto(std::size_t nrhs, const T* B, std::size_t ldb, T* C, std::size_t ldc) const {
+		kernels::gbmm(n, kl, ku, nrhs, &values[0], kl + ku + 1, B, ldb, C, ldc);
+	}
+
+	//The Thomas algorithm for the tridiagonal matrices, falling back to the pivoting banded LU on a zero pivot
+	bool solveInPlace(std::size_t nrhs, T* B, std::size_t ldb) const {
+		if (kl == 1 && ku == 1 && kernels::gtsv(n, nrhs, &values[0], B, ldb)) {
+			return false;
+		}
+		std::vector<T> LU;
+		std::vector<std::size_t> pivots;
+		if (factor(LU, pivots)) {
+			return true;
+		}
+		kernels::gbtrs(n, kl, ku, nrhs, &LU[0], 2 * kl + ku + 1, &pivots[0], B, ldb);
+		return false;
+	}
+};
+
+#endif //OH_STRANG_STRUCTURED
@@ -0,0 +1,409 @@
+#ifndef OH_STRANG_TEXT
+#define OH_STRANG_TEXT
+
+#include <cctype>
+#include <cstring>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <stdexcept>
+
+#include "matrix.cpp"
+#include "numbers.cpp"
+#include "parallel.cpp"
+
+/*
+ * text.cpp
+ *
+ * Readers and writers for delimited text (CSV, TSV, whitespace) and MatrixMarket files.
+ * Large inputs are split in chunks of whole lines which are parsed in parallel straight into the matrix values,
+ * numbers being converted with the routines of numbers.cpp.
+ */
+
+namespace text {
+
+/*
+ * A range of whole lines of the input.
+ * firstLine is the index of the first non empty line of the chunk among all the non empty lines of the input.
+ */
+struct LineChunk {
+	const char* first;
+	const char* last;
+	std::size_t firstLine;
+	std::size_t lines;
+	std::size_t errorLine;
+	std::string error;
+};
+
+inline bool isEmptyLine(const char* first, const char* last) {
+	while (first != last && isBlank(*first)) {
+		first++;
+	}
+	return first == last;
+}
+
+inline const char* endOfLine(const char* first, const char* last) {
+	const char* end = static_cast<const char*>(std::memchr(first, '\n', last - first));
+	return end == 0 ? last : end;
+}
+
+//Calls fn(lineIndex, lineFirst, lineLast) for each non empty line of the chunk
+template<typename F>
+void forEachLine(const LineChunk& chunk, F fn) {
+	std::size_t index = chunk.firstLine;
+	for (const char* line = chunk.first; line < chunk.last;) {
+		const char* end = endOfLine(line, chunk.last);
+		if (!isEmptyLine(line, end)) {
+			fn(index++, line, end);
+		}
+		line = end + 1;
+	}
+}
+
+//Splits [first, last) in chunks of whole lines of at least minChunkBytes and counts their non empty lines in parallel
+inline std::vector<LineChunk> splitLines(const char* first, const char* last, std::size_t minChunkBytes) {
+	std::size_t size = last - first;
+	std::size_t count = std::max<std::size_t>(1, std::min(parallel::hardwareThreads() * 4, size / minChunkBytes));
+	std::vector<LineChunk> chunks;
+	const char* begin = first;
+	for (std::size_t i = 1; i <= count && begin < last; i++) {
+		const char* end = i == count ? last : first + size * i / count;
+		if (end < begin) {
+			continue;
+		}
+		end = end == last ? last : std::min(last, endOfLine(end, last) + 1);
+		LineChunk chunk = { begin, end, 0, 0, 0, "" };
+		chunks.push_back(chunk);
+		begin = end;
+	}
+
+	parallel::forRange(0, chunks.size(), 1, [&](std::size_t firstChunk, std::size_t lastChunk) {
+		for (std::size_t c = firstChunk; c < lastChunk; c++) {
+			forEachLine(chunks[c], [&](std::size_t, const char*, const char*) {
+				chunks[c].lines++;
+			});
+		}
+	});
+	std::size_t lines = 0;
+	for (auto it = chunks.begin(); it != chunks.end(); it++) {
+		it->firstLine = lines;
+		lines += it->lines;
+	}
+	return chunks;
+}
+
+//Runs parseLine(lineIndex, lineFirst, lineLast) over every chunk in parallel.
+//parseLine returns an empty string on success or an error message; the first error is thrown as a domain_error.
+template<typename F>
+void parseLines(std::vector<LineChunk>& chunks, const char* what, F parseLine) {
+	parallel::forRange(0, chunks.size(), 1, [&](std::size_t firstChunk, std::size_t lastChunk) {
+		for (std::size_t c = firstChunk; c < lastChunk; c++) {
+			LineChunk& chunk = chunks[c];
+			forEachLine(chunk, [&](std::size_t line, const char* first, const char* last) {
+				if (chunk.error.empty()) {
+					chunk.error = parseLine(line, first, last);
+					chunk.errorLine = line;
+				}
+			});
+		}
+	});
+	for (auto it = chunks.begin(); it != chunks.end(); it++) {
+		if (!it->error.empty()) {
+			std::ostringstream err;
+			err << what << " " << it->errorLine + 1 << ": " << it->error;
+			throw std::domain_error(err.str());
+		}
+	}
+}
+
+//Skips the blanks and a delimiter, whitespace delimited files accept any run of blanks
+inline const char* skipDelimiter(const char* p, const char* last, char delimiter, bool& found) {
+	while (p != last && isBlank(*p)) {
+		found = found || delimiter == ' ' || *p == delimiter;
+		p++;
+	}
+	if (p != last && *p == delimiter) {
+		found = true;
+		p++;
+		while (p != last && isBlank(*p)) {
+			p++;
+		}
+	}
+	return p;
+}
+
+//Parses the values of a delimited line into row, returns an error message or an empty string
+template<typename T>
+std::string parseDelimitedLine(const char* first, const char* last, char delimiter, T* row, std::size_t columns) {
+	const char* p = first;
+	bool found = true;
+	p = skipDelimiter(p, last, '\0', found);
+	for (std::size_t c = 0; c < columns; c++) {
+		if (!found) {
+			std::ostringstream err;
+			err << "expected " << columns << " values, found " << c;
+			return err.str();
+		}
+		const char* end = parseNumber(p, last, row[c]);
+		if (end == 0) {
+			return "invalid number \"" + std::string(p, endOfLine(p, last)) + "\"";
+		}
+		found = false;
+		p = skipDelimiter(end, last, delimiter, found);
+	}
+	if (p != last) {
+		std::ostringstream err;
+		err << "more than " << columns << " values";
+		return err.str();
+	}
+	return "";
+}
+
+}
+
+//Reads delimited text (CSV with ',', TSV with '\t', or ' ' for any whitespace) in a new matrix.
+//The first skipLines non empty lines (a header for instance) are ignored.
+//The matrix is allocated once, then the lines are parsed in parallel straight into its values.
+template<class C>
+C readDelimited(const char* data, std::size_t size, char delimiter = ',', std::size_t skipLines = 0) {
+	typedef typename C::value_type T;
+	const char* first = data;
+	const char* last = data + size;
+	for (std::size_t skipped = 0; skipped < skipLines && first < last;) {
+		const char* end = text::endOfLine(first, last);
+		skipped += !text::isEmptyLine(first, end);
+		first = std::min(last, end + 1);
+	}
+
+	std::vector<text::LineChunk> chunks = text::splitLines(first, last, 1 << 16);
+	std::size_t rows = chunks.empty() ? 0 : chunks.back().firstLine + chunks.back().lines;
+	if (rows == 0) {
+		return C(0, 0, T(0), T(1));
+	}
+
+	//the first line tells the number of columns
+	const char* line = first;
+	const char* end = text::endOfLine(line, last);
+	while (text::isEmptyLine(line, end)) {
+		line = end + 1;
+		end = text::endOfLine(line, last);
+	}
+	std::size_t columns = 0;
+	std::vector<T> scratch(1);
+	for (const char* p = line; p != end;) {
+		bool found = columns == 0;
+		p = text::skipDelimiter(p, end, columns == 0 ? '\0' : delimiter, found);
+		if (p == end || !found) {
+			break;
+		}
+		const char* next = text::parseNumber(p, end, scratch[0]);
+		if (next == 0) {
+			std::ostringstream err;
+			err << "Row 1: invalid number \"" << std::string(p, end) << "\"";
+			throw std::domain_error(err.str());
+		}
+		p = next;
+		columns++;
+	}
+
+	C A(rows, columns, T(0), T(1));
+	T* values = A.getValues();
+	text::parseLines(chunks, "Row", [&](std::size_t row, const char* lineFirst, const char* lineLast) {
+		return text::parseDelimitedLine(lineFirst, lineLast, delimiter, values + row * columns, columns);
+	});
+	return A;
+}
+
+/*
+ * Reads a MatrixMarket file: "array" (dense, column-major) or "coordinate" (sparse triplets) formats,
+ * real or integer or pattern fields, general, symmetric or skew-symmetric.
+ */
+template<class C>
+C readMatrixMarket(const char* data, std::size_t size) {
+	typedef typename C::value_type T;
+	const char* first = data;
+	const char* last = data + size;
+
+	const char* end = text::endOfLine(first, last);
+	std::istringstream banner(std::string(first, end));
+	std::string tag, object, format, field, symmetry;
+	banner >> tag >> object >> format >> field >> symmetry;
+	for (auto it = format.begin(); it != format.end(); it++) *it = std::tolower(*it);
+	for (auto it = field.begin(); it != field.end(); it++) *it = std::tolower(*it);
+	for (auto it = symmetry.begin(); it != symmetry.end(); it++) *it = std::tolower(*it);
+	if (tag != "%%MatrixMarket" || (format != "array" && format != "coordinate")) {
+		throw std::domain_error("Not a MatrixMarket matrix.");
+	}
+	if (field != "real" && field != "integer" && field != "double" && field != "pattern") {
+		throw std::domain_error("Unsupported MatrixMarket field " + field + ".");
+	}
+	if (symmetry != "general" && symmetry != "symmetric" && symmetry != "skew-symmetric") {
+		throw std::domain_error("Unsupported MatrixMarket symmetry " + symmetry + ".");
+	}
+	bool dense = format == "array";
+	bool pattern = field == "pattern";
+	bool symmetric = symmetry != "general";
+	T sign = symmetry == "skew-symmetric" ? T(-1) : T(1);
+
+	//Skip the comments up to the size line
+	do {
+		first = std::min(last, end + 1);
+		end = text::endOfLine(first, last);
+	} while (first < last && (*first == '%' || text::isEmptyLine(first, end)));
+
+	std::size_t rows = 0, columns = 0, entries = 0;
+	std::istringstream sizes(std::string(first, end));
+	sizes >> rows >> columns;
+	if (!dense) {
+		sizes >> entries;
+	}
+	if (!sizes) {
+		throw std::domain_error("Invalid MatrixMarket size line.");
+	}
+	if (symmetric && rows != columns) {
+		throw std::domain_error("Symmetric MatrixMarket matrices must be square.");
+	}
+	first = std::min(last, end + 1);
+
+	C A(rows, columns, T(0), T(1));
+	T* values = A.getValues();
+	std::vector<text::LineChunk> chunks = text::splitLines(first, last, 1 << 16);
+	std::size_t lines = chunks.empty() ? 0 : chunks.back().firstLine + chunks.back().lines;
+
+	if (dense) {
+		//Column-major values, only the lower triangle for the symmetric matrices
+		std::size_t expected = symmetric ? columns * (columns + 1) / 2 - (sign == T(-1) ? columns : 0) : rows * columns;
+		if (lines != expected) {
+			std::ostringstream err;
+			err << "Expected " << expected << " MatrixMarket values, found " << lines;
+			throw std::domain_error(err.str());
+		}
+		//Column offsets of the packed lower triangle
+		std::vector<std::size_t> starts(columns + 1, 0);
+		for (std::size_t c = 0; c < columns; c++) {
+			std::size_t height = !symmetric ? rows : (sign == T(-1) ? rows - c - 1 : rows - c);
+			starts[c + 1] = starts[c] + height;
+		}
+		text::parseLines(chunks, "Entry", [&](std::size_t entry, const char* lineFirst, const char* lineLast) {
+			std::size_t c = std::upper_bound(starts.begin(), starts.end(), entry) - starts.begin() - 1;
+			std::size_t r = entry - starts[c] + (!symmetric ? 0 : (sign == T(-1) ? c + 1 : c));
+			T value;
+			bool found = true;
+			const char* p = text::skipDelimiter(lineFirst, lineLast, '\0', found);
+			if (text::parseNumber(p, lineLast, value) == 0) {
+				return std::string("invalid number");
+			}
+			values[r * columns + c] = value;
+			if (symmetric && r != c) {
+				values[c * columns + r] = sign * value;
+			}
+			return std::string();
+		});
+		return A;
+	}
+
+	if (lines != entries) {
+		std::ostringstream err;
+		err << "Expected " << entries << " MatrixMarket entries, found " << lines;
+		throw std::domain_error(err.str());
+	}
+	text::parseLines(chunks, "Entry", [&](std::size_t, const char* lineFirst, const char* lineLast) {
+		std::size_t indices[2];
+		const char* p = lineFirst;
+		for (int i = 0; i < 2; i++) {
+			bool found = true;
+			p = text::skipDelimiter(p, lineLast, '\0', found);
+			p = text::parseNumber(p, lineLast, indices[i]);
+			if (p == 0) {
+				return std::string("invalid index");
+			}
+		}
+		if (indices[0] < 1 || indices[0] > rows || indices[1] < 1 || indices[1] > columns) {
+			return std::string("index out of range");
+		}
+		T value = T(1);
+		if (!pattern) {
+			bool found = true;
+			p = text::skipDelimiter(p, lineLast, '\0', found);
+			if (text::parseNumber(p, lineLast, value) == 0) {
+				return std::string("invalid number");
+			}
+		}
+		std::size_t r = indices[0] - 1, c = indices[1] - 1;
+		values[r * columns + c] = value;
+		if (symmetric && r != c) {
+			values[c * columns + r] = sign * value;
+		}
+		return std::string();
+	});
+	return A;
+}
+
+//Reads a whole file in memory with a single bulk read
+inline std::string readTextFile(const std::string& path) {
+	std::ifstream file(path.c_str(), std::ios::binary | std::ios::ate);
+	if (!file) {
+		throw std::runtime_error("Cannot open " + path);
+	}
+	std::string content(static_cast<std::size_t>(file.tellg()), '\0');
+	file.seekg(0);
+	if (!content.empty() && !file.read(&content[0], content.size())) {
+		throw std::runtime_error("Cannot read " + path);
+	}
+	return content;
+}
+
+template<class C>
+C readDelimitedFile(const std::string& path, char delimiter = ',', std::size_t skipLines = 0) {
+	std::string content = readTextFile(path);
+	return readDelimited<C>(content.data(), content.size(), delimiter, skipLines);
+}
+
+template<class C>
+C readMatrixMarketFile(const std::string& path) {
+	std::string content = readTextFile(path);
+	return readMatrixMarket<C>(content.data(), content.size());
+}
+
+//Writes the matrix as delimited text, one row per line
+template<typename T, class C>
+void writeDelimited(std::ostream& out, const MatrixCRTP<T, C>& A, char delimiter = ',') {
+	std::string line;
+	auto it = A.begin();
+	for (std::size_t r = 0; r < A.getRowsCount(); r++) {
+		line.clear();
+		for (std::size_t c = 0; c < A.getColumnsCount(); c++, it++) {
+			if (c > 0) {
+				line += delimiter;
+			}
+			text::appendNumber(line, *it);
+		}
+		line += '\n';
+		out.write(line.data(), line.size());
+	}
+}
+
+//Writes the matrix in the MatrixMarket dense array format
+template<typename T, class C>
+void writeMatrixMarket(std::ostream& out, const MatrixCRTP<T, C>& A) {
+	std::size_t rows = A.getRowsCount();
+	std::size_t columns = A.getColumnsCount();
+	std::ostringstream header;
+	header << "%%MatrixMarket matrix array " << (std::is_integral<T>::value ? "integer" : "real") << " general\n"
+			<< rows << " " << columns << "\n";
+	out << header.str();
+	std::string line;
+	const T* values = &*A.begin();
+	for (std::size_t c = 0; c < columns; c++) {
+		line.clear();
+		for (std::size_t r = 0; r < rows; r++) {
+			text::appendNumber(line, values[r * columns + c]);
+			line += '\n';
+		}
+		out.write(line.data(), line.size());
+	}
+}
+
+#endif //OH_STRANG_TEXT
@@ -0,0 +1,194 @@
+#ifndef OH_STRANG_TUNING
+#define OH_STRANG_TUNING
+
+#include <cstddef>
+#include <cstdlib>
+#include <cmath>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+
+/*
+ * tuning.cpp
+ *
+ * Blocking parameters and crossover thresholds of the kernels, per value type.
+ * On first use they are read from the tuning file written by the tuner (bench/tune.cpp),
+ * and otherwise derived from the cache sizes found in sysfs, with fixed fallbacks when sysfs is not
+ * available (Emscripten, macOS).
+ *
+ * The tuning file is $OH_STRANG_TUNING, or ~/.oh-strang-tuning when it is not set. It holds lines of
+ * type.parameter = value, e.g. double.gemmBlockK = 128; missing parameters keep their heuristic value.
+ */
+
+namespace tuning {
+
+struct KernelParameters {
+	std::size_t gemmBlockK;				//rows of B kept in cache by the multiply
+	std::size_t gemmBlockN;				//columns of B and C kept in cache by the multiply
+	std::size_t gemmUnroll;				//rows of B combined per pass over a row of C: 1, 2 or 4
+	std::size_t gemmParallelThreshold;	//multiply-adds below which the multiply stays on one thread
+	std::size_t getrfBlock;				//panel width of the LU decomposition
+	std::size_t strassenCutoff;			//order at which the Strassen-Winograd recursion hands off to gemm
+};
+
+//Data cache sizes in bytes, 0 when unknown
+struct CacheSizes {
+	std::size_t l1;
+	std::size_t l2;
+	std::size_t l3;
+};
+
+//Name of the type in the tuning file, 0 for the types that are never tuned
+template<typename T>
+struct TypeName {
+	static const char* value() { return 0; }
+};
+
+template<>
+struct TypeName<float> {
+	static const char* value() { return "float"; }
+};
+
+template<>
+struct TypeName<double> {
+	static const char* value() { return "double"; }
+};
+
+//Reads the data and unified caches of the first cpu from sysfs
+inline CacheSizes detectCaches(const std::string& root = "/sys/devices/system/cpu/cpu0/cache") {
+	CacheSizes caches = { 0, 0, 0 };
+	for (int index = 0; index < 16; index++) {
+		std::ostringstream path;
+		path << root << "/index" << index << "/";
+		std::ifstream levelFile((path.str() + "level").c_str());
+		std::ifstream typeFile((path.str() + "type").c_str());
+		std::ifstream sizeFile((path.str() + "size").c_str());
+		int level = 0;
+		std::string type, size;
+		if (!(levelFile >> level) || !(typeFile >> type) || !(sizeFile >> size)) {
+			continue;
+		}
+		if (type == "Instruction") {
+			continue;
+		}
+		char* unit = 0;
+		std::size_t bytes = std::strtoul(size.c_str(), &unit, 10);
+		if (*unit == 'K') {
+			bytes <<= 10;
+		} else if (*unit == 'M') {
+			bytes <<= 20;
+		}
+		if (level == 1) {
+			caches.l1 = bytes;
+		} else if (level == 2) {
+			caches.l2 = bytes;
+		} else if (level == 3) {
+			caches.l3 = bytes;
+		}
+	}
+	return caches;
+}
+
+inline std::size_t floorPowerOfTwo(std::size_t value) {
+	std::size_t power = 1;
+	while (power * 2 <= value) {
+		power *= 2;
+	}
+	return power;
+}
+
+inline std::size_t clamp(std::size_t value, std::size_t low, std::size_t high) {
+	return std::max(low, std::min(value, high));
+}
+
+/*
+ * Parameters derived from the cache sizes: a row of a block of B fills an eighth of L1 and the whole
+ * gemmBlockK x gemmBlockN block half of L2.
+ * With 32KB of L1 and 1MB of L2 this gives the historic 128 x 512 blocks for doubles.
+ */
+template<typename T>
+KernelParameters heuristicParameters(const CacheSizes& caches) {
+	std::size_t l1 = caches.l1 ? caches.l1 : 32 << 10;
+	std::size_t l2 = caches.l2 ? caches.l2 : 1 << 20;
+	KernelParameters parameters;
+	parameters.gemmBlockN = clamp(floorPowerOfTwo(l1 / (8 * sizeof(T))), 64, 1024);
+	parameters.gemmBlockK = clamp(floorPowerOfTwo(l2 / 2 / (parameters.gemmBlockN * sizeof(T))), 16, 512);
+	parameters.gemmUnroll = 1;
+	parameters.gemmParallelThreshold = 1 << 18;
+	parameters.getrfBlock = clamp(floorPowerOfTwo(static_cast<std::size_t>(std::sqrt(l2 / (32.0 * sizeof(T))))), 16, 128);
+	parameters.strassenCutoff = 512;
+	return parameters;
+}
+
+inline std::string defaultConfigPath() {
+	const char* path = std::getenv("OH_STRANG_TUNING");
+	if (path && *path) {
+		return path;
+	}
+	const char* home = std::getenv("HOME");
+	return home ? std::string(home) + "/.oh-strang-tuning" : std::string();
+}
+
+//Overrides the parameters found in the tuning file for type, returns false when the file cannot be read
+inline bool readConfig(const std::string& path, const char* type, KernelParameters& parameters) {
+	std::ifstream in(path.c_str());
+	if (!type || !in) {
+		return false;
+	}
+	std::string prefix = std::string(type) + ".";
+	std::string line;
+	while (std::getline(in, line)) {
+		std::size_t equal = line.find('=');
+		if (line.empty() || line[0] == '#' || equal == std::string::npos || line.compare(0, prefix.size(), prefix) != 0) {
+			continue;
+		}
+		std::string key = line.substr(prefix.size(), equal - prefix.size());
+		key.erase(key.find_last_not_of(" \t") + 1);
+		std::size_t value = std::strtoul(line.c_str() + equal + 1, 0, 10);
+		if (value == 0) {
+			continue;
+		}
+		if (key == "gemmBlockK") {
+			parameters.gemmBlockK = value;
+		} else if (key == "gemmBlockN") {
+			parameters.gemmBlockN = value;
+		} else if (key == "gemmUnroll") {
+			parameters.gemmUnroll = value;
+		} else if (key == "gemmParallelThreshold") {
+			parameters.gemmParallelThreshold = value;
+		} else if (key == "getrfBlock") {
+			parameters.getrfBlock = value;
+		} else if (key == "strassenCutoff") {
+			parameters.strassenCutoff = value;
+		}
+	}
+	return true;
+}
+
+inline void writeConfig(std::ostream& out, const char* type, const KernelParameters& parameters) {
+	out << type << ".gemmBlockK = " << parameters.gemmBlockK << "\n"
+			<< type << ".gemmBlockN = " << parameters.gemmBlockN << "\n"
+			<< type << ".gemmUnroll = " << parameters.gemmUnroll << "\n"
+			<< type << ".gemmParallelThreshold = " << parameters.gemmParallelThreshold << "\n"
+			<< type << ".getrfBlock = " << parameters.getrfBlock << "\n"
+			<< type << ".strassenCutoff = " << parameters.strassenCutoff << "\n";
+}
+
+template<typename T>
+KernelParameters startupParameters() {
+	KernelParameters parameters = heuristicParameters<T>(detectCaches());
+	readConfig(defaultConfigPath(), TypeName<T>::value(), parameters);
+	return parameters;
+}
+
+//The parameters used by the kernels for T, loaded on first use; they can be changed before running the kernels
+template<typename T>
+KernelParameters& parameters() {
+	static KernelParameters current = startupParameters<T>();
+	return current;
+}
+
+}
+
+#endif //OH_STRANG_TUNING
@@ -0,0 +1,265 @@
+#ifndef OH_STRANG_VECTOR
+#define OH_STRANG_VECTOR
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+
+#include "matrix.cpp"
+#include "kernels.cpp"
+
+/*
+ * vector.cpp
+ *
+ * Vectors for the matrix-vector kernels, instead of n x 1 matrices.
+ * A VectorView is a size and a stride over values it does not own: a whole Vector, or a row, a column or the
+ * diagonal of a matrix, so matrices and vectors work on each other without copies. Like a pointer, a view lets its
+ * values be written even when the view itself is const.
+ * A Vector owns contiguous values and is the view of them.
+ * The accessors are 1 based like the matrices.
+ */
+
+template<typename T>
+class VectorView {
+protected:
+	T* data;
+	std::size_t n;
+	std::size_t stride;
+
+public:
+	typedef T value_type;
+
+	VectorView() : data(0), n(0), stride(1) {}
+
+	VectorView(T* values, std::size_t size, std::size_t step = 1) : data(values), n(size), stride(step) {}
+
+	const std::size_t& getSize() const {
+		return n;
+	}
+
+	const std::size_t& getStride() const {
+		return stride;
+	}
+
+	T* getValues() const {
+		return data;
+	}
+
+	bool isContiguous() const {
+		return stride == 1;
+	}
+
+	const T& getValue(int i) const {
+		return data[(i - 1) * stride];
+	}
+
+	T setValue(int i, const T& val) const {
+		T oldValue = data[(i - 1) * stride];
+		data[(i - 1) * stride] = val;
+		return oldValue;
+	}
+
+	//count values starting at the 1 based first, step values of this view apart
+	VectorView slice(int first, std::size_t count, std::size_t step = 1) const {
+		if (first < 1 || (count > 0 && first - 1 + (count - 1) * step >= n)) {
+			throw std::out_of_range("The slice must be within the vector");
+		}
+		return VectorView(data + (first - 1) * stride, count, stride * step);
+	}
+
+	std::string toString() const {
+		std::string vector = "[  ";
+		for (std::size_t i = 0; i < n; i++) {
+			text::appendNumber(vector, data[i * stride]);
+			vector += "  ";
+		}
+		return vector + "]";
+	}
+};
+
+template<typename T>
+class Vector : public VectorView<T> {
+	std::vector<T> values;
+
+	void rebind() {
+		this->data = values.empty() ? 0 : &values[0];
+		this->n = values.size();
+		this->stride = 1;
+	}
+
+public:
+	Vector() {}
+
+	explicit Vector(std::size_t size, const T& fillValue = T(0)) : values(size, fillValue) {
+		rebind();
+	}
+
+	Vector(std::size_t size, const T* _values) : values(_values, _values + size) {
+		rebind();
+	}
+
+	//A contiguous copy of any view
+	explicit Vector(const VectorView<T>& x) : values(x.getSize()) {
+		for (std::size_t i = 0; i < values.size(); i++) {
+			values[i] = x.getValues()[i * x.getStride()];
+		}
+		rebind();
+	}
+
+	Vector(const Vector& x) : VectorView<T>(), values(x.values) {
+		rebind();
+	}
+
+	Vector& operator=(const Vector& x) {
+		values = x.values;
+		rebind();
+		return *this;
+	}
+
+	typename std::vector<T>::const_iterator begin() const {
+		return values.cbegin();
+	}
+
+	typename std::vector<T>::const_iterator end() const {
+		return values.cend();
+	}
+
+	friend bool operator==(const Vector& x, const Vector& y) {
+		return x.values == y.values;
+	}
+
+	friend bool operator!=(const Vector& x, const Vector& y) {
+		return !(x == y);
+	}
+};
+
+template<typename T>
+std::basic_ostream<char>& operator<<(std::basic_ostream<char>& __os, const VectorView<T>& x) {
+	return __os << x.toString();
+}
+
+//Views on the values of a matrix, 1 based like getValue, strided across the lines of its layout
+template<typename T, class C, class L>
+VectorView<T> rowOf(MatrixCRTP<T, C, L>& A, int row) {
+	if (row < 1 || row > A.getRowsCount()) {
+		throw std::out_of_range("Row index must be between 1 and rowsCount()");
+	}
+	const std::size_t ld = A.getLeadingDimension();
+	return VectorView<T>(A.getValues() + L::offset(row - 1, 0, ld), A.getColumnsCount(), L::offset(0, 1, ld));
+}
+
+template<typename T, class C, class L>
+VectorView<T> columnOf(MatrixCRTP<T, C, L>& A, int column) {
+	if (column < 1 || column > A.getColumnsCount()) {
+		throw std::out_of_range("Column index must be between 1 and columnsCount()");
+	}
+	const std::size_t ld = A.getLeadingDimension();
+	return VectorView<T>(A.getValues() + L::offset(0, column - 1, ld), A.getRowsCount(), L::offset(1, 0, ld));
+}
+
+template<typename T, class C, class L>
+VectorView<T> diagonalOf(MatrixCRTP<T, C, L>& A) {
+	return VectorView<T>(A.getValues(), std::min(A.getRowsCount(), A.getColumnsCount()), A.getLeadingDimension() + 1);
+}
+
+template<typename T>
+T dot(const VectorView<T>& x, const VectorView<T>& y) {
+	if (x.getSize() != y.getSize()) {
+		throw std::domain_error("Vector sizes must match.");
+	}
+	return kernels::dot(x.getSize(), x.getValues(), x.getStride(), y.getValues(), y.getStride());
+}
+
+//y += alpha * x
+template<typename T>
+void axpy(const T& alpha, const VectorView<T>& x, const VectorView<T>& y) {
+	if (x.getSize() != y.getSize()) {
+		throw std::domain_error("Vector sizes must match.");
+	}
+	kernels::axpy(x.getSize(), alpha, x.getValues(), x.getStride(), y.getValues(), y.getStride());
+}
+
+template<typename T>
+T norm1(const VectorView<T>& x) {
+	return kernels::asum(x.getSize(), x.getValues(), x.getStride());
+}
+
+template<typename T>
+T norm2(const VectorView<T>& x) {
+	return kernels::nrm2(x.getSize(), x.getValues(), x.getStride());
+}
+
+template<typename T>
+T normInf(const VectorView<T>& x) {
+	return kernels::amax(x.getSize(), x.getValues(), x.getStride());
+}
+
+/*
+ * y = alpha * A * x + beta * y, or y = alpha * A^T * x + beta * y when transposed is set.
+ * y must not share values with A or x.
+ */
+template<typename T, class C, class L>
+void gemv(const T& alpha, const MatrixCRTP<T, C, L>& A, bool transposed, const VectorView<T>& x, const T& beta,
+		const VectorView<T>& y) {
+	const std::size_t m = A.getRowsCount(), n = A.getColumnsCount();
+	if (x.getSize() != (transposed ? m : n) || y.getSize() != (transposed ? n : m)) {
+		throw std::domain_error("Vector sizes must match the matrix.");
+	}
+	OH_STRANG_MEASURE(MULTIPLY, 2.0 * m * n, 0, 0);
+	if (m * n == 0) {
+		for (std::size_t i = 1; i <= y.getSize(); i++) {
+			y.setValue(i, beta == T(0) ? T(0) : beta * y.getValue(i));
+		}
+		return;
+	}
+	//the values of a column-major A are those of the row-major A^T
+	kernels::gemv(transposed == L::rowMajor, L::lines(m, n), L::length(m, n), alpha, A.getValues(),
+			A.getLeadingDimension(), x.getValues(), x.getStride(), beta, y.getValues(), y.getStride());
+}
+
+//A * x
+template<typename T, class C, class L>
+Vector<T> operator*(const MatrixCRTP<T, C, L>& A, const VectorView<T>& x) {
+	Vector<T> y(A.getRowsCount());
+	gemv(T(1), A, false, x, T(0), y);
+	return y;
+}
+
+//A^T * x, without transposing A
+template<typename T, class C, class L>
+Vector<T> transposeMultiply(const MatrixCRTP<T, C, L>& A, const VectorView<T>& x) {
+	Vector<T> y(A.getColumnsCount());
+	gemv(T(1), A, true, x, T(0), y);
+	return y;
+}
+
+//A += alpha * x * y^T
+template<typename T, class C, class L>
+void ger(const T& alpha, const VectorView<T>& x, const VectorView<T>& y, MatrixCRTP<T, C, L>& A) {
+	if (x.getSize() != A.getRowsCount() || y.getSize() != A.getColumnsCount()) {
+		throw std::domain_error("Vector sizes must match the matrix.");
+	}
+	if (A.getRowsCount() * A.getColumnsCount() == 0) {
+		return;
+	}
+	if (L::rowMajor) {
+		kernels::ger(x.getSize(), y.getSize(), alpha, x.getValues(), x.getStride(), y.getValues(), y.getStride(),
+				A.getValues(), A.getLeadingDimension());
+	} else {
+		//A^T += alpha * y * x^T
+		kernels::ger(y.getSize(), x.getSize(), alpha, y.getValues(), y.getStride(), x.getValues(), x.getStride(),
+				A.getValues(), A.getLeadingDimension());
+	}
+}
+
+//x * y^T
+template<typename T>
+Matrix<T> outer(const VectorView<T>& x, const VectorView<T>& y) {
+	Matrix<T> A(x.getSize(), y.getSize(), 0, 1);
+	ger(T(1), x, y, A);
+	return A;
+}
+
+#endif //OH_STRANG_VECTOR
@@ -0,0 +1,33 @@
+/*
+ * bundle.js
+ *
+ * The JS helpers of js/Matrix.js against the committed Emscripten bundle, which predates getData:
+ * the values and the [Value] results go through getValue and setValue.
+ * Usage: OH_STRANG_WASM=1 node test/bundle.js
+ */
+let assert = require('assert')
+let DoubleMatrix = require('../js/Matrix')
+
+assert.strictEqual(DoubleMatrix.isNative, false, 'run with OH_STRANG_WASM=1')
+
+let A = new DoubleMatrix(2, 3, 0, 1)
+A.setValues([1, 2, 3, 4, 5, 6])
+assert.deepStrictEqual(A.getValues(), [1, 2, 3, 4, 5, 6])
+assert.deepStrictEqual(Array.from(A.getTypedValues()), [1, 2, 3, 4, 5, 6])
+assert.throws(() => A.setValues([1]), RangeError)
+
+//[Value] results are copied out of the statics of the binding
+let T = A.transpose()
+assert.deepStrictEqual(T.getValues(), [1, 4, 2, 5, 3, 6])
+let P = A.matrixMul(T)
+assert.deepStrictEqual(P.getValues(), [14, 32, 32, 77])
+assert.deepStrictEqual(A.scalarMul(2).getValues(), [2, 4, 6, 8, 10, 12])
+assert.deepStrictEqual(A.swapRows(1, 2).getValues(), [4, 5, 6, 1, 2, 3])
+assert.deepStrictEqual(A.concat(A).getValues(), [1, 2, 3, 1, 2, 3, 4, 5, 6, 4, 5, 6])
+//a later call of the same method leaves the earlier result as it was
+let T2 = A.scalarMul(-1).transpose()
+assert.deepStrictEqual(T.getValues(), [1, 4, 2, 5, 3, 6])
+assert.deepStrictEqual(T2.getValues(), [-1, -4, -2, -5, -3, -6])
+
+DoubleMatrix.scope(() => A.matrixMul(T).transpose())
+console.log('bundle.js: all tests passed')
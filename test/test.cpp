@@ -6,6 +6,19 @@
  */
 #include "lest.hpp"
 #include "../src/matrix.cpp"
+#include "../src/outofcore.cpp"
+#include "../src/serialization.cpp"
+#include "../src/text.cpp"
+#include "../src/solvers.cpp"
+#include "../src/batched.cpp"
+#include "../src/autotune.cpp"
+#include "../src/krylov.cpp"
+#include "../src/modular.cpp"
+#include "../src/structured.cpp"
+#include "../src/vector.cpp"
+#include "../src/strassen.cpp"
+#include "../src/factorizations.cpp"
+#include "../src/comparison.cpp"
 
 #include <array>
 
@@ -322,6 +335,1755 @@ const lest::test specification[] =
 	    EXPECT( determinant == 0 );
 	},
 
+	CASE("Copy-on-write values"){
+		double valA[6] = {
+				1,2,3,
+				4,5,6
+		};
+		Matrix<double> A(2, 3, 0, 1, valA);
+		Matrix<double> B = A;
+		Matrix<double> C;
+		C = B;
+
+		//copies share the values until one of them is written
+		EXPECT( B.sharesValuesWith(A) );
+		EXPECT( C.sharesValuesWith(A) );
+		EXPECT( A.sharesValues() );
+		const Matrix<double>& readOnly = B;
+		EXPECT( readOnly.getValue(2, 3) == 6 );
+		EXPECT( &*readOnly.begin() == &*A.begin() );
+		EXPECT( B.concat(A).getValue(1, 4) == 1 ); //reading from a non-const method does not copy
+		EXPECT( B.sharesValuesWith(A) );
+
+		instrumentation::reset();
+		B.setValue(1, 1, 10);
+		EXPECT( !B.sharesValuesWith(A) );
+		EXPECT( C.sharesValuesWith(A) );
+		EXPECT( A.getValue(1, 1) == 1 );
+		EXPECT( C.getValue(1, 1) == 1 );
+		EXPECT( B.getValue(1, 1) == 10 );
+		EXPECT( (!instrumentation::enabled || instrumentation::snapshot()[instrumentation::COPY_ON_WRITE].calls == 1u) );
+		EXPECT( (!instrumentation::enabled || instrumentation::snapshot()[instrumentation::COPY_ON_WRITE].bytesCopied == 6 * sizeof(double)) );
+
+		//the last copy writes in place
+		B.setValue(1, 2, 20);
+		C *= 2;
+		EXPECT( !A.sharesValues() );
+		A.getValues()[0] = -1;
+		EXPECT( (!instrumentation::enabled || instrumentation::snapshot()[instrumentation::COPY_ON_WRITE].calls == 2u) );
+		EXPECT( A.getValue(1, 1) == -1 );
+		EXPECT( C.getValue(1, 1) == 2 );
+		EXPECT( B.getValue(1, 2) == 20 );
+
+		//toLU starts from a shared copy, copied by the first row operation, and leaves the matrix as is
+		double valD[4] = {
+				4,3,
+				6,3
+		};
+		Matrix<double> D(2, 2, 0, 1, valD);
+		Matrix<double> L, U;
+		D.toLU(L, U);
+		EXPECT( !U.sharesValuesWith(D) );
+		EXPECT( D == Matrix<double>(2, 2, 0, 1, valD) );
+		EXPECT( U.getValue(2, 2) == -1.5 );
+		Matrix<double> I = Matrix<double>::identity(3, 3, 0, 1) * 4;
+		I.toLU(L, U);
+		EXPECT( U.sharesValuesWith(I) ); //already upper triangular, nothing was written
+
+		//pinned values stay in place: copies get their own
+		double* pinned = A.getPinnedValues();
+		Matrix<double> E = A;
+		EXPECT( !E.sharesValuesWith(A) );
+		E.setValue(1, 1, 7);
+		A.setValue(2, 2, 8);
+		EXPECT( A.getValues() == pinned );
+		EXPECT( pinned[0] == -1 );
+		EXPECT( pinned[4] == 8 );
+
+		//copies written from several threads, each one its own
+		Matrix<double> F(64, 64, 0, 1, 1.0);
+		std::vector<Matrix<double>> copies(8, F);
+		parallel::forRange(0, copies.size(), 1, [&](size_t first, size_t last){
+			for(size_t i = first; i < last; i++){
+				copies[i].setValue(1, 1, double(i));
+				copies[i] *= 2;
+			}
+		});
+		for(size_t i = 0; i < copies.size(); i++){
+			EXPECT( copies[i].getValue(1, 1) == 2.0 * i );
+			EXPECT( copies[i].getValue(64, 64) == 2 );
+		}
+		EXPECT( F.getValue(1, 1) == 1 );
+		EXPECT( !F.sharesValues() );
+		instrumentation::reset();
+	},
+
+	CASE("Cached factorizations and modification versions"){
+		auto difference = [](const Matrix<double>& X, const Matrix<double>& Y){
+			double largest = 0;
+			for(auto x = X.begin(), y = Y.begin(); x != X.end(); x++, y++){
+				largest = std::max(largest, std::abs(*x - *y));
+			}
+			return largest;
+		};
+
+		double valA[9] = {
+				0,2,1,
+				3,1,0,
+				1,0,4
+		};
+		Matrix<double> A(3, 3, 0, 1, valA);
+		EXPECT( std::abs(A.det() + 25) < 1e-12 ); //row exchanges change the sign
+
+		//every write bumps the version
+		std::uint64_t version = A.getVersion();
+		A.setValue(1, 1, 0);
+		EXPECT( A.getVersion() > version );
+		version = A.getVersion();
+		A *= 1;
+		A /= 1;
+		EXPECT( A.getVersion() == version + 2 );
+
+		//no cache by default
+		EXPECT( !A.cachesFactorizations() );
+		EXPECT( A.luFactors() != A.luFactors() );
+
+		instrumentation::reset();
+		A.cacheFactorizations();
+		std::shared_ptr<const LUFactors<double>> factors = A.luFactors();
+		EXPECT( A.luFactors() == factors );
+		EXPECT( std::abs(A.det() + 25) < 1e-12 );
+		Matrix<double> b(3, 1, 0, 1, 1.0);
+		Matrix<double> X;
+		EXPECT( !solve(A, b, X) );
+		EXPECT( difference(A * X, b) < 1e-14 );
+		EXPECT( (!instrumentation::enabled || instrumentation::snapshot()[instrumentation::TO_LU].calls == 1u) );
+
+		//copies share the cached factors until one of them is written
+		Matrix<double> B = A;
+		EXPECT( B.luFactors() == factors );
+		A.setValue(3, 3, 5);
+		EXPECT( A.luFactors() != factors );
+		EXPECT( std::abs(A.det() + 31) < 1e-12 );
+		EXPECT( B.luFactors() == factors );
+		A *= 2;
+		EXPECT( std::abs(A.det() + 248) < 1e-12 );
+		A.getValues()[0] = 1;
+		EXPECT( std::abs(A.det() + 228) < 1e-12 );
+		EXPECT( (!instrumentation::enabled || instrumentation::snapshot()[instrumentation::TO_LU].calls == 4u) );
+
+		//writes through a kept pointer need bumpVersion
+		double* values = A.getValues();
+		factors = A.luFactors();
+		values[0] = 0;
+		EXPECT( A.luFactors() == factors );
+		A.bumpVersion();
+		EXPECT( std::abs(A.det() + 248) < 1e-12 );
+
+		//pinned values are handed out to read as well: the factors stay until bumpVersion
+		double* pinned = A.getPinnedValues();
+		factors = A.luFactors();
+		EXPECT( pinned[0] == 0 );
+		EXPECT( A.luFactors() == factors );
+		pinned[0] = 1;
+		A.bumpVersion();
+		EXPECT( A.luFactors() != factors );
+		EXPECT( std::abs(A.det() + 228) < 1e-12 );
+
+		//Cholesky from the lower triangle, cached likewise
+		double valS[9] = {
+				4,0,0,
+				2,5,0,
+				2,1,6
+		};
+		Matrix<double> S(3, 3, 0, 1, valS);
+		S.cacheFactorizations();
+		std::shared_ptr<const CholeskyFactors<double>> cholesky = S.choleskyFactors();
+		EXPECT( cholesky->positiveDefinite );
+		EXPECT( S.choleskyFactors() == cholesky );
+		EXPECT( !solvePositiveDefinite(S, b, X) );
+		Matrix<double> full = S + S.transpose() - Matrix<double>::identity(3, 3, 0, 1) * 4;
+		full.setValue(2, 2, 5);
+		full.setValue(3, 3, 6);
+		EXPECT( difference(full * X, b) < 1e-14 );
+		S.setValue(1, 1, -1);
+		EXPECT( !S.choleskyFactors()->positiveDefinite );
+		EXPECT( solvePositiveDefinite(S, b, X) );
+
+		//disabling drops the factors
+		S.cacheFactorizations(false);
+		EXPECT( S.choleskyFactors() != S.choleskyFactors() );
+		instrumentation::reset();
+	},
+
+	CASE("Approximate equality with absolute, relative and ULP tolerances"){
+		Matrix<double> A(300, 500, 0, 1, 1e6);
+		Matrix<double> B = A;
+		B.setValue(120, 7, std::nextafter(1e6, 2e6));
+		B.setValue(250, 400, 1e6 + 1e-3);
+
+		//epsilon means nothing at 1e6: operator== sees the one ULP difference
+		EXPECT( A != B );
+		EXPECT( !approxEqual(A, B, Tolerance<double>()) );
+		EXPECT( !approxEqual(A, B, Tolerance<double>::ulp(1)) );
+		EXPECT( approxEqual(A, B, Tolerance<double>(2e-3)) );
+		EXPECT( approxEqual(A, B, Tolerance<double>(0, 2e-9)) );
+		EXPECT( !approxEqual(A, B, Tolerance<double>(0, 1e-10)) );
+		EXPECT( !approxEqual(A, Matrix<double>(500, 300, 0, 1, 1e6), Tolerance<double>(1)) );
+
+		Deviation<double> report = deviation(A, B, Tolerance<double>::ulp(1));
+		EXPECT( !report.equal() );
+		EXPECT( report.mismatches == 1u );
+		EXPECT( report.firstRow == 250u );
+		EXPECT( report.firstColumn == 400u );
+		EXPECT( report.row == 250u );
+		EXPECT( report.column == 400u );
+		EXPECT( std::abs(report.maxDeviation - 1e-3) < 1e-9 );
+		report = deviation(A, B, Tolerance<double>());
+		EXPECT( report.mismatches == 2u );
+		EXPECT( report.firstRow == 120u );
+		EXPECT( report.firstColumn == 7u );
+		EXPECT( deviation(A, A, Tolerance<double>()).equal() );
+		EXPECT( deviation(A, A, Tolerance<double>()).row == 1u );
+		EXPECT_THROWS_AS( deviation(A, A.transpose(), Tolerance<double>()), std::domain_error );
+
+		//NaN matches nothing, +0 and -0 are equal and 1 ULP apart, infinities match themselves
+		Matrix<float> F(1, 3, 0, 1, 0.0f);
+		Matrix<float> G(1, 3, 0, 1, -0.0f);
+		EXPECT( approxEqual(F, G, Tolerance<float>()) );
+		F.setValue(1, 2, std::numeric_limits<float>::infinity());
+		G.setValue(1, 2, std::numeric_limits<float>::infinity());
+		F.setValue(1, 3, std::nanf(""));
+		G.setValue(1, 3, std::nanf(""));
+		EXPECT( !approxEqual(F, G, Tolerance<float>(1, 1, 1000)) );
+		Deviation<float> nan = deviation(F, G, Tolerance<float>(1, 1, 1000));
+		EXPECT( nan.mismatches == 1u );
+		EXPECT( nan.column == 3u );
+		EXPECT( std::isinf(nan.maxDeviation) );
+		F.setValue(1, 3, 1e-45f);
+		G.setValue(1, 3, -1e-45f);
+		EXPECT( !approxEqual(F, G, Tolerance<float>::ulp(2)) );
+		EXPECT( approxEqual(F, G, Tolerance<float>::ulp(3)) );
+
+		//the parallel scan finds the same values
+		Matrix<double> large(1000, 1000, 0, 1, 1.0);
+		Matrix<double> other = large;
+		other.setValue(999, 3, 1.5);
+		other.setValue(17, 900, 0.75);
+		EXPECT( approxEqual(large, large, Tolerance<double>(), true) );
+		EXPECT( !approxEqual(large, other, Tolerance<double>(0.4), true) );
+		EXPECT( approxEqual(large, other, Tolerance<double>(0.5), true) );
+		Deviation<double> serial = deviation(large, other, Tolerance<double>(0.3));
+		Deviation<double> parallelReport = deviation(large, other, Tolerance<double>(0.3), true);
+		EXPECT( serial.mismatches == 1u );
+		EXPECT( parallelReport.mismatches == 1u );
+		EXPECT( parallelReport.row == 999u );
+		EXPECT( parallelReport.column == 3u );
+		EXPECT( parallelReport.firstRow == 999u );
+		EXPECT( parallelReport.maxDeviation == 0.5 );
+		EXPECT( serial.row == parallelReport.row );
+		EXPECT( serial.firstColumn == parallelReport.firstColumn );
+	},
+
+	CASE("Column-major layout and leading dimensions"){
+		typedef Matrix<double, layout::ColumnMajor> ColumnMatrix;
+		//the values of a column-major matrix are read column after column
+		double raw[] = { 1, 2, 3, 4, 5, 6 };
+		ColumnMatrix C(2, 3, 0, 1, raw);
+		EXPECT( C.getValue(1, 1) == 1 );
+		EXPECT( C.getValue(2, 1) == 2 );
+		EXPECT( C.getValue(1, 2) == 3 );
+		EXPECT( C.getValue(2, 3) == 6 );
+		double expectedRows[] = { 1, 3, 5, 2, 4, 6 };
+		Matrix<double> R(2, 3, 0, 1, expectedRows);
+		EXPECT( C == R );
+		EXPECT( R == C );
+		EXPECT( C.toString() == R.toString() );
+		EXPECT( Matrix<double>(C) == R );
+		EXPECT( ColumnMatrix(R) == C );
+		EXPECT( C.transpose() == R.transpose() );
+		EXPECT( C.transpose().getValue(3, 2) == 6 );
+
+		//buffers with a larger leading dimension, the padding being skipped
+		const double padded[] = { 1, 2, -1, 3, 4, -1, 5, 6, -1 };
+		EXPECT( ColumnMatrix(2, 3, 0, 1, padded, 3) == R );
+		const double paddedRows[] = { 1, 3, 5, -1, 2, 4, 6, -1 };
+		EXPECT( Matrix<double>(2, 3, 0, 1, paddedRows, 4) == R );
+		EXPECT_THROWS_AS( ColumnMatrix(2, 3, 0, 1, padded, 1), std::invalid_argument );
+
+		//every combination of layouts gives the row-major product, sum and difference
+		const size_t m = 37, k = 53, n = 29;
+		Matrix<double> A(m, k, 0, 1), B(k, n, 0, 1), D(m, k, 0, 1);
+		for(size_t i = 1; i <= m; i++){
+			for(size_t j = 1; j <= k; j++){
+				A.setValue(i, j, std::sin(i * 0.7 + j * 0.3));
+				D.setValue(i, j, std::cos(i * 0.2 - j * 0.9));
+			}
+		}
+		for(size_t i = 1; i <= k; i++){
+			for(size_t j = 1; j <= n; j++){
+				B.setValue(i, j, std::cos(i * 0.4 + j * 1.3));
+			}
+		}
+		ColumnMatrix AC(A), BC(B), DC(D);
+		EXPECT( AC == A );
+		EXPECT( AC.getValue(5, 7) == A.getValue(5, 7) );
+		Matrix<double> product = A * B;
+		auto close = [&](const Matrix<double>& X) {
+			return approxEqual(X, product, Tolerance<double>(1e-12));
+		};
+		EXPECT( close(A * BC) );
+		EXPECT( close(Matrix<double>(AC * B)) );
+		EXPECT( close(Matrix<double>(AC * BC)) );
+		EXPECT( approxEqual(AC * BC, ColumnMatrix(product), Tolerance<double>(1e-12)) );
+		tuning::KernelParameters saved = tuning::parameters<double>();
+		tuning::parameters<double>().gemmParallelThreshold = 1;
+		EXPECT( close(A * BC) );
+		EXPECT( close(Matrix<double>(AC * B)) );
+		EXPECT( close(Matrix<double>(AC * BC)) );
+		tuning::parameters<double>() = saved;
+		EXPECT( (A + DC) == A + D );
+		EXPECT( (AC + D) == A + D );
+		EXPECT( (AC + DC) == A + D );
+		EXPECT( (AC - D) == A - D );
+		EXPECT( (A - DC) == A - D );
+		EXPECT( AC != DC );
+		EXPECT( !(AC == D) );
+
+		//decompositions, elimination and Gram matrices read the layout
+		Matrix<double> S(5, 5, 0, 1);
+		for(size_t i = 0; i < 25; i++){
+			S.getValues()[i] = std::sin(i * 1.3) + (i % 6 == 0 ? 4 : 0);
+		}
+		ColumnMatrix SC(S);
+		EXPECT( std::abs(SC.det() - S.det()) < 1e-12 );
+		EXPECT( SC.rank() == S.rank() );
+		EXPECT( SC.rref() == S.rref() );
+		EXPECT( approxEqual(Matrix<double>(AC.gram()), A.gram(), Tolerance<double>(1e-12)) );
+		EXPECT( approxEqual(Matrix<double>(AC.outerGram()), A.outerGram(), Tolerance<double>(1e-12)) );
+		ColumnMatrix left, right;
+		AC.concat(DC).split(k, left, right);
+		EXPECT( left == A );
+		EXPECT( right == D );
+		EXPECT( AC.concat(DC) == A.concat(D) );
+
+		//vector kernels and views follow the layout
+		Vector<double> x(k), z(m);
+		for(size_t j = 1; j <= k; j++){
+			x.setValue(j, std::cos(j * 0.5));
+		}
+		for(size_t i = 1; i <= m; i++){
+			z.setValue(i, std::sin(i * 0.2));
+		}
+		Vector<double> y = A * x, w = transposeMultiply(A, z);
+		Vector<double> yC = AC * x, wC = transposeMultiply(AC, z);
+		double largest = 0;
+		for(size_t i = 1; i <= m; i++){
+			largest = std::max(largest, std::abs(y.getValue(i) - yC.getValue(i)));
+		}
+		for(size_t j = 1; j <= k; j++){
+			largest = std::max(largest, std::abs(w.getValue(j) - wC.getValue(j)));
+		}
+		EXPECT( largest < 1e-13 );
+		EXPECT( rowOf(AC, 4).getValue(9) == A.getValue(4, 9) );
+		EXPECT( columnOf(AC, 9).getStride() == 1u );
+		EXPECT( columnOf(AC, 9).getValue(4) == A.getValue(4, 9) );
+		EXPECT( diagonalOf(AC).getValue(6) == A.getValue(6, 6) );
+		ger(2.0, z, x, AC);
+		ger(2.0, z, x, A);
+		EXPECT( AC == A );
+		Deviation<double> report = deviation(AC, ColumnMatrix(A + D), Tolerance<double>(1e-3));
+		EXPECT( report.mismatches > 0u );
+		EXPECT( std::abs(AC.getValue(report.row, report.column) - (A + D).getValue(report.row, report.column))
+				== report.maxDeviation );
+	},
+
+	CASE("Aligned and padded storage"){
+		//every block of values starts on a cache line, copies included
+		Matrix<double> dense(7, 5, 0, 1);
+		Matrix<float> single(3, 3, 0, 1);
+		EXPECT( storage::isAligned(dense.getValues()) );
+		EXPECT( storage::isAligned(single.getValues()) );
+		Matrix<double> copy = dense;
+		copy.setValue(1, 1, 2);
+		EXPECT( storage::isAligned(copy.getValues()) );
+		EXPECT( dense.getLeadingDimension() == 5u );
+
+		//whole cache lines per line, one more when the stride would be a multiple of the conflict stride
+		EXPECT( storage::paddedLength<double>(5) == 8u );
+		EXPECT( storage::paddedLength<double>(100) == 104u );
+		EXPECT( storage::paddedLength<double>(128) == 136u );
+		EXPECT( storage::paddedLength<float>(256) == 272u );
+		EXPECT( (storage::paddedLength<std::array<char, 24>>(5) == 5u) );
+
+		typedef Matrix<double, layout::Padded<layout::RowMajor>> PaddedMatrix;
+		typedef Matrix<double, layout::Padded<layout::ColumnMajor>> PaddedColumns;
+		const size_t m = 37, k = 53, n = 29;
+		Matrix<double> A(m, k, 0, 1), B(k, n, 0, 1), D(m, k, 0, 1);
+		for(size_t i = 1; i <= m; i++){
+			for(size_t j = 1; j <= k; j++){
+				A.setValue(i, j, std::sin(i * 0.7 + j * 0.3));
+				D.setValue(i, j, std::cos(i * 0.2 - j * 0.9));
+			}
+		}
+		for(size_t i = 1; i <= k; i++){
+			for(size_t j = 1; j <= n; j++){
+				B.setValue(i, j, std::cos(i * 0.4 + j * 1.3));
+			}
+		}
+		PaddedMatrix P(A), Q(B), R(D);
+		EXPECT( P.getLeadingDimension() == 56u );
+		for(size_t i = 0; i < m; i++){
+			EXPECT( storage::isAligned(static_cast<const PaddedMatrix&>(P).getValues() + i * 56) );
+		}
+		//the padding is skipped by getValue, the iterators and the comparisons
+		EXPECT( P.getValue(5, 7) == A.getValue(5, 7) );
+		EXPECT( P == A );
+		EXPECT( A == P );
+		EXPECT( (size_t) std::distance(P.begin(), P.end()) == m * k );
+		EXPECT( std::equal(P.begin(), P.end(), A.begin()) );
+		EXPECT( P.toString() == A.toString() );
+		EXPECT( approxEqual(P, P, Tolerance<double>()) );
+		EXPECT( Matrix<double>(P) == A );
+
+		//operations on padded operands give the dense results
+		Matrix<double> product = A * B;
+		auto close = [&](const Matrix<double>& X) {
+			return approxEqual(X, product, Tolerance<double>(1e-12));
+		};
+		EXPECT( close(Matrix<double>(P * Q)) );
+		EXPECT( close(Matrix<double>(P * B)) );
+		EXPECT( close(A * Q) );
+		EXPECT( close(Matrix<double>(PaddedColumns(A) * Q)) );
+		tuning::KernelParameters saved = tuning::parameters<double>();
+		tuning::parameters<double>().gemmParallelThreshold = 1;
+		EXPECT( close(Matrix<double>(P * Q)) );
+		tuning::parameters<double>() = saved;
+		EXPECT( (P + R) == A + D );
+		EXPECT( (P - D) == A - D );
+		EXPECT( (2.0 * P) == 2.0 * A );
+		EXPECT( P.transpose() == A.transpose() );
+		EXPECT( P.transpose().getLeadingDimension() == 40u );
+		EXPECT( P.concat(R) == A.concat(D) );
+		PaddedMatrix left, right;
+		P.concat(R).split(k, left, right);
+		EXPECT( left == A );
+		EXPECT( right == D );
+		EXPECT( approxEqual(Matrix<double>(P.gram()), A.gram(), Tolerance<double>(1e-12)) );
+		EXPECT( approxEqual(Matrix<double>(PaddedColumns(A).outerGram()), A.outerGram(), Tolerance<double>(1e-12)) );
+		Matrix<double> S(5, 5, 0, 1);
+		for(size_t i = 0; i < 25; i++){
+			S.getValues()[i] = std::sin(i * 1.3) + (i % 6 == 0 ? 4 : 0);
+		}
+		EXPECT( std::abs(PaddedMatrix(S).det() - S.det()) < 1e-12 );
+		EXPECT( PaddedMatrix(S).rref() == S.rref() );
+		Vector<double> x(k);
+		for(size_t j = 1; j <= k; j++){
+			x.setValue(j, std::cos(j * 0.5));
+		}
+		EXPECT( (P * x) == (A * x) );
+		EXPECT( rowOf(P, 3).getValue(4) == A.getValue(3, 4) );
+		EXPECT( columnOf(P, 4).getStride() == 56u );
+		EXPECT( diagonalOf(P).getValue(9) == A.getValue(9, 9) );
+
+		//writes stay out of the padding, comparisons locate the changes
+		P.setValue(m, k, 10);
+		EXPECT( P != A );
+		Deviation<double> report = deviation(P, PaddedMatrix(A), Tolerance<double>(1e-9), true);
+		EXPECT( report.mismatches == 1u );
+		EXPECT( report.row == m );
+		EXPECT( report.column == k );
+		EXPECT( !approxEqual(P, PaddedMatrix(A), Tolerance<double>(1e-9), true) );
+
+		//configurable leading dimension, and buffers with their own
+		P.setValue(m, k, A.getValue(m, k));
+		P.setLeadingDimension(61);
+		EXPECT( P.getLeadingDimension() == 61u );
+		EXPECT( P == A );
+		EXPECT_THROWS_AS( P.setLeadingDimension(52), std::invalid_argument );
+		EXPECT_THROWS_AS( A.setLeadingDimension(60), std::invalid_argument );
+		const double padded[] = { 1, 2, -1, 3, 4, -1 };
+		PaddedMatrix small(2, 2, 0, 1, padded, 3);
+		EXPECT( small.getValue(2, 1) == 3 );
+		EXPECT( small.getLeadingDimension() == 8u );
+		EXPECT( PaddedMatrix(4, 128, 0, 1).getLeadingDimension() == 136u );
+	},
+
+	CASE("Out-of-core multiplication"){
+		Matrix<double> A(37, 29, 0, 1);
+		Matrix<double> B(29, 23, 0, 1);
+		for(int r = 1; r <= 37; r++){
+			for(int c = 1; c <= 29; c++){
+				A.setValue(r, c, (r * 7 + c * 3) % 11 - 5);
+			}
+		}
+		for(int r = 1; r <= 29; r++){
+			for(int c = 1; c <= 23; c++){
+				B.setValue(r, c, (r * 5 + c) % 13 - 6);
+			}
+		}
+
+		auto dA = DiskMatrix<double>::fromMatrix("ooc_A.bin", A, 8);
+		auto dB = DiskMatrix<double>::fromMatrix("ooc_B.bin", B, 8);
+		auto dC = DiskMatrix<double>::create("ooc_C.bin", 37, 23, 8);
+		EXPECT( dA.toMatrix<Matrix<double>>() == A );
+
+		OutOfCoreStats stats = outOfCoreMultiply(dA, dB, dC, 5 * dA.tileBytes());
+		EXPECT( dC.toMatrix<Matrix<double>>() == A * B );
+		EXPECT( stats.bytesWritten == 15 * dC.tileBytes() );
+
+		EXPECT_THROWS_AS( outOfCoreMultiply(dB, dA, dC, 5 * dA.tileBytes()), std::domain_error );
+		EXPECT_THROWS_AS( outOfCoreMultiply(dA, dB, dC, 2 * dA.tileBytes()), std::domain_error );
+
+		std::remove("ooc_A.bin");
+		std::remove("ooc_B.bin");
+		std::remove("ooc_C.bin");
+	},
+
+	CASE("Out-of-core LU decomposition"){
+		const int size = 21;
+		Matrix<double> A(size, size, 0, 1);
+		for(int r = 1; r <= size; r++){
+			for(int c = 1; c <= size; c++){
+				A.setValue(r, c, ((r * 7 + c * 13) % 17) - 8 + (r == c ? 20 : 0));
+			}
+		}
+		A.setValue(1, 1, 0); //forces a row exchange
+
+		auto dA = DiskMatrix<double>::fromMatrix("ooc_LU.bin", A, 5);
+		std::vector<std::size_t> pivots;
+		OutOfCoreStats stats;
+		EXPECT( !outOfCoreLU(dA, pivots, (5 + 2) * dA.tileBytes(), stats) );
+
+		Matrix<double> LU = dA.toMatrix<Matrix<double>>();
+		Matrix<double> L = Matrix<double>::identity(size, size, 0, 1);
+		Matrix<double> U(size, size, 0, 1);
+		for(int r = 1; r <= size; r++){
+			for(int c = 1; c <= size; c++){
+				(c < r ? L : U).setValue(r, c, LU.getValue(r, c));
+			}
+		}
+		Matrix<double> PA = A;
+		for(int r = 0; r < size; r++){
+			PA = PA.swapRows(r + 1, pivots[r] + 1);
+		}
+		Matrix<double> LtimesU = L * U;
+		double error = 0;
+		for(auto itA = PA.begin(), itB = LtimesU.begin(); itA != PA.end(); itA++, itB++){
+			error = std::max(error, std::abs(*itA - *itB));
+		}
+		EXPECT( error < 1e-10 );
+
+		//singular matrix
+		float valC[9] = {
+				1,2,3,
+				2,5,1,
+				1,3,-2
+		};
+		Matrix<double> C(3, 3, 0, 1);
+		for(int i = 0; i < 9; i++){
+			C.setValue(i / 3 + 1, i % 3 + 1, valC[i]);
+		}
+		auto dC = DiskMatrix<double>::fromMatrix("ooc_LU.bin", C, 2);
+		EXPECT( outOfCoreLU(dC, pivots, 4 * dC.tileBytes(), stats) );
+
+		std::remove("ooc_LU.bin");
+	},
+
+	CASE("Binary serialization round-trip"){
+		double val[6] = {1.0 / 3, -2.5e-300, 3e300, 4, 5, 6};
+		Matrix<double> A(2, 3, 0, 1, val);
+
+		std::string bytes = toBinary(A);
+		EXPECT( bytes.size() == 32 + 6 * sizeof(double) );
+		Matrix<double> B = fromBinary<Matrix<double>>(bytes.data(), bytes.size());
+		EXPECT( B.getRowsCount() == 2 );
+		EXPECT( B.getColumnsCount() == 3 );
+		EXPECT( std::equal(A.begin(), A.end(), B.begin()) ); //bit exact
+
+		//streaming reader with checksum, in two bulk reads
+		std::stringstream stream;
+		writeBinary(stream, A, true);
+		BinaryMatrixReader<double> reader(stream);
+		EXPECT( reader.hasChecksum() );
+		std::vector<double> values(6);
+		EXPECT( reader.read(&values[0], 4) == 4 );
+		EXPECT( reader.read(&values[4], 10) == 2 );
+		reader.close();
+		EXPECT( std::equal(values.begin(), values.end(), A.begin()) );
+
+		//corrupted values are detected by the checksum
+		std::string corrupted = toBinary(A, true);
+		corrupted[40] ^= 1;
+		EXPECT_THROWS_AS( fromBinary<Matrix<double>>(corrupted.data(), corrupted.size()), std::runtime_error );
+
+		//the type must match
+		EXPECT_THROWS_AS( fromBinary<Matrix<float>>(bytes.data(), bytes.size()), std::domain_error );
+		EXPECT_THROWS_AS( fromBinary<Matrix<double>>(bytes.data(), 20), std::runtime_error );
+
+		//sizes that overflow, or that announce more values than the bytes hold, are rejected before allocating
+		std::string header = bytes.substr(0, 32);
+		const std::uint64_t huge = std::uint64_t(1) << 32;
+		std::memcpy(&header[16], &huge, 8);
+		std::memcpy(&header[24], &huge, 8);
+		EXPECT_THROWS_AS( fromBinary<Matrix<double>>(header.data(), header.size()), std::domain_error );
+		const std::uint64_t thousand = 1000;
+		std::memcpy(&header[16], &thousand, 8);
+		std::memcpy(&header[24], &thousand, 8);
+		EXPECT_THROWS_AS( fromBinary<Matrix<double>>(header.data(), header.size()), std::runtime_error );
+		EXPECT_THROWS_AS( fromBinary<Matrix<double>>(bytes.data(), bytes.size() - 8), std::runtime_error );
+
+		//column-major files are transposed on read
+		bytes[9] = binary::COLUMN_MAJOR;
+		Matrix<double> C = fromBinary<Matrix<double>>(bytes.data(), bytes.size());
+		EXPECT( C.getRowsCount() == 2 );
+		EXPECT( C.getValue(1, 2) == val[2] );
+		EXPECT( C.getValue(2, 1) == val[1] );
+	},
+
+#ifdef OH_STRANG_MMAP
+	CASE("Memory mapped binary matrix"){
+		int val[6] = {1, 2, 3, 4, 5, 6};
+		Matrix<int> A(3, 2, 0, 1, val);
+		{
+			std::ofstream file("mapped.bin", std::ios::binary);
+			writeBinary(file, A, true);
+		}
+		MappedBinaryMatrix<int> mapped("mapped.bin");
+		EXPECT( mapped.getRowsCount() == 3 );
+		EXPECT( mapped.data()[3] == 4 );
+		EXPECT( mapped.verify() );
+		EXPECT( mapped.toMatrix<Matrix<int>>() == A );
+		{
+			std::ofstream file("mapped.bin", std::ios::binary | std::ios::trunc);
+			std::string bytes = toBinary(A);
+			const std::uint64_t huge = std::uint64_t(1) << 40;
+			std::memcpy(&bytes[16], &huge, 8);
+			std::memcpy(&bytes[24], &huge, 8);
+			file.write(bytes.data(), bytes.size());
+		}
+		EXPECT_THROWS_AS( MappedBinaryMatrix<int>("mapped.bin"), std::domain_error );
+		std::remove("mapped.bin");
+	},
+#endif
+
+	CASE("Shortest round-trip number formatting"){
+		char buffer[text::MAX_NUMBER_LENGTH];
+		EXPECT( std::string(buffer, text::formatNumber(buffer, 0.1)) == "0.1" );
+		EXPECT( std::string(buffer, text::formatNumber(buffer, 248.0)) == "248" );
+		EXPECT( std::string(buffer, text::formatNumber(buffer, 0.1f)) == "0.1" );
+		EXPECT( std::string(buffer, text::formatNumber(buffer, -42)) == "-42" );
+
+		//integral values keep their digits only when they are no longer than the "%g" text
+		EXPECT( std::string(buffer, text::formatNumber(buffer, 100.0)) == "100" );
+		EXPECT( std::string(buffer, text::formatNumber(buffer, 123456789.0)) == "123456789" );
+		EXPECT( std::string(buffer, text::formatNumber(buffer, 1e7)) == "1e+07" );
+		EXPECT( std::string(buffer, text::formatNumber(buffer, -2e10)) == "-2e+10" );
+		EXPECT( std::string(buffer, text::formatNumber(buffer, 999999999999999.0)) == "999999999999999" );
+		EXPECT( std::string(buffer, text::formatNumber(buffer, 16777217.0f)) == "16777216" );
+		EXPECT( std::string(buffer, text::formatNumber(buffer, 7.0122e11f)) == "7.0122e+11" );
+		EXPECT( std::string(buffer, text::formatNumber(buffer, 123456792.0f)) == "123456792" );
+
+		double third = 1.0 / 3;
+		double parsed = 0;
+		char* end = text::formatNumber(buffer, third);
+		EXPECT( text::parseNumber(buffer, end, parsed) == end );
+		EXPECT( parsed == third );
+
+		//the lowest "%.*g" precision that reads back, from a single digit up
+		EXPECT( std::string(buffer, text::formatNumber(buffer, 5e-324)) == "5e-324" );
+		EXPECT( std::string(buffer, text::formatNumber(buffer, -4.6190819791092965e-249)) == "-4.619081979109296e-249" );
+		std::uint64_t bits = 0x9E3779B97F4A7C15ull;
+		char expected[text::MAX_NUMBER_LENGTH];
+		for(int i = 0; i < 2000; i++){
+			bits = bits * 6364136223846793005ull + 1442695040888963407ull;
+			double value;
+			std::memcpy(&value, &bits, sizeof(value));
+			if(value != value || value - value != 0){
+				continue;
+			}
+			for(int precision = 1; precision <= 17; precision++){
+				std::snprintf(expected, sizeof(expected), "%.*g", precision, value);
+				if(std::strtod(expected, 0) == value){
+					break;
+				}
+			}
+			EXPECT( std::string(buffer, text::formatNumber(buffer, value)) == expected );
+		}
+
+		double val[4] = {0.5, -1.25, 3, 1e-7};
+		Matrix<double> A(2, 2, 0, 1, val);
+		EXPECT( A.toString() == "[  0.5  -1.25  ]\n[  3  1e-07  ]" );
+	},
+
+	CASE("Formatting with a precision and summarized matrices"){
+		char buffer[text::MAX_NUMBER_LENGTH];
+		char expected[text::MAX_NUMBER_LENGTH];
+		double samples[] = {1.0 / 3, -2.0 / 3, 9.9996, 99999.5, 123456789.0, 1e-5, 0.000123456, 6.02214076e23, -1e300, 5e-324, 1e22, 0.1};
+		for(auto value : samples){
+			for(int precision = 1; precision <= 17; precision++){
+				std::snprintf(expected, sizeof(expected), "%.*g", precision, value);
+				EXPECT( std::string(buffer, text::formatNumber(buffer, value, precision)) == expected );
+			}
+		}
+		EXPECT( std::string(buffer, text::formatNumber(buffer, 2.0f / 3, 3)) == "0.667" );
+		EXPECT( std::string(buffer, text::formatNumber(buffer, 12, 1)) == "12" );
+		EXPECT( std::string(buffer, text::formatNumber(buffer, 0.1, 0)) == "0.1" );
+
+		double val[4] = {0.5, -1.25, 3, 1e-7};
+		Matrix<double> A(2, 2, 0, 1, val);
+		EXPECT( A.toString(text::MatrixFormat(2)) == "[  0.5  -1.2  ]\n[  3  1e-07  ]" );
+		EXPECT( A.toString(text::MatrixFormat(0, 1, 2)) == "[  0.5  -1.25  ]\n[  3  1e-07  ]" );
+
+		Matrix<double> B(5, 6, 0, 1);
+		for(int i = 1; i <= 5; i++){
+			for(int j = 1; j <= 6; j++){
+				B.setValue(i, j, 10 * i + j);
+			}
+		}
+		EXPECT( B.toString(text::MatrixFormat(0, 1, 10)) == "[  11  ...  16  ]\n...\n[  51  ...  56  ]" );
+		EXPECT( B.toString(text::MatrixFormat(0, 2, 100)) == B.toString() );
+
+		//A reused buffer keeps its memory, a large matrix summarizes to a few lines
+		Matrix<double> C(2000, 2000, 0, 1, 0.25);
+		std::string out;
+		C.toString(out, text::MatrixFormat(0, 3));
+		EXPECT( std::count(out.begin(), out.end(), '\n') == 6 );
+		const char* data = out.data();
+		C.toString(out, text::MatrixFormat(3, 2));
+		EXPECT( out.data() == data );
+		EXPECT( out.substr(0, 24) == "[  0.25  0.25  ...  0.25" );
+
+		//Rows formatted in parallel come out in order
+		Matrix<double> D(400, 300, 0, 1);
+		for(int i = 1; i <= 400; i++){
+			D.setValue(i, 1, i);
+		}
+		std::string full = D.toString();
+		EXPECT( std::count(full.begin(), full.end(), '\n') == 399 );
+		EXPECT( full.substr(full.rfind('\n') + 1, 6) == "[  400" );
+	},
+
+	CASE("Number parsing"){
+		const char* inputs[] = {"0", "-1.5", "+2e3", "123456789012345678", "1.7976931348623157e308", "4.9e-324", "0.30000000000000004", "1234567890.0987654321e-5"};
+		for(auto input : inputs){
+			double fast = 0;
+			const char* end = text::parseNumber(input, input + std::strlen(input), fast);
+			EXPECT( end == input + std::strlen(input) );
+			EXPECT( fast == std::strtod(input, 0) );
+		}
+		double value;
+		const char* garbage = "abc";
+		EXPECT( text::parseNumber(garbage, garbage + 3, value) == (const char*) 0 );
+	},
+
+	CASE("Delimited text import and export"){
+		std::string csv = "a,b,c\r\n1, 2.5 ,-3\r\n\r\n4,5e-1,6\r\n";
+		Matrix<double> A = readDelimited<Matrix<double>>(csv.data(), csv.size(), ',', 1);
+		double expected[6] = {1, 2.5, -3, 4, 0.5, 6};
+		EXPECT( A == Matrix<double>(2, 3, 0, 1, expected) );
+
+		std::string tsv = "1\t2.5\t-3\n4\t0.5\t6";
+		EXPECT( readDelimited<Matrix<double>>(tsv.data(), tsv.size(), '\t') == A );
+		std::string spaces = "  1   2.5 -3\n4 0.5\t 6\n";
+		EXPECT( readDelimited<Matrix<double>>(spaces.data(), spaces.size(), ' ') == A );
+
+		std::string ragged = "1,2,3\n4,5\n";
+		EXPECT_THROWS_AS( readDelimited<Matrix<double>>(ragged.data(), ragged.size()), std::domain_error );
+		std::string invalid = "1,2,3\n4,x,6\n";
+		EXPECT_THROWS_AS( readDelimited<Matrix<double>>(invalid.data(), invalid.size()), std::domain_error );
+
+		//Large enough to be parsed in several chunks, and bit exact after a round-trip
+		Matrix<double> B(3000, 20, 0, 1);
+		double* values = B.getValues();
+		for(int i = 0; i < 3000 * 20; i++){
+			values[i] = std::sin(i) * std::pow(10.0, i % 17 - 8);
+		}
+		std::ostringstream out;
+		writeDelimited(out, B);
+		std::string text = out.str();
+		Matrix<double> C = readDelimited<Matrix<double>>(text.data(), text.size());
+		EXPECT( C.getRowsCount() == 3000 );
+		EXPECT( C.getColumnsCount() == 20 );
+		EXPECT( std::equal(B.begin(), B.end(), C.begin()) );
+	},
+
+	CASE("MatrixMarket import and export"){
+		std::string coordinate =
+				"%%MatrixMarket matrix coordinate real symmetric\n"
+				"% a comment\n"
+				"3 3 4\n"
+				"1 1 2.0\n"
+				"2 1 -1\n"
+				"3 2 -1\n"
+				"3 3 2\n";
+		double expected[9] = {2, -1, 0, -1, 0, -1, 0, -1, 2};
+		Matrix<double> A = readMatrixMarket<Matrix<double>>(coordinate.data(), coordinate.size());
+		EXPECT( A == Matrix<double>(3, 3, 0, 1, expected) );
+
+		std::ostringstream out;
+		writeMatrixMarket(out, A);
+		std::string array = out.str();
+		EXPECT( array.find("%%MatrixMarket matrix array real general\n3 3\n2\n-1\n0\n") == 0 );
+		EXPECT( readMatrixMarket<Matrix<double>>(array.data(), array.size()) == A );
+
+		std::string notMarket = "1 2 3\n";
+		EXPECT_THROWS_AS( readMatrixMarket<Matrix<double>>(notMarket.data(), notMarket.size()), std::domain_error );
+		std::string outOfRange = "%%MatrixMarket matrix coordinate real general\n2 2 1\n3 1 1\n";
+		EXPECT_THROWS_AS( readMatrixMarket<Matrix<double>>(outOfRange.data(), outOfRange.size()), std::domain_error );
+		std::string notSquare = "%%MatrixMarket matrix coordinate real symmetric\n2 3 1\n2 3 5\n";
+		EXPECT_THROWS_AS( readMatrixMarket<Matrix<double>>(notSquare.data(), notSquare.size()), std::domain_error );
+		std::string denseNotSquare = "%%MatrixMarket matrix array real skew-symmetric\n3 2\n1\n2\n";
+		EXPECT_THROWS_AS( readMatrixMarket<Matrix<double>>(denseNotSquare.data(), denseNotSquare.size()), std::domain_error );
+	},
+
+	CASE("Blocked single precision multiplication"){
+		//Bigger than the kernel blocks, integer values keep the float sums exact
+		Matrix<float> A(70, 130, 0, 1);
+		Matrix<float> B(130, 600, 0, 1);
+		for(int r = 1; r <= 70; r++){
+			for(int c = 1; c <= 130; c++){
+				A.setValue(r, c, (r + 2 * c) % 7 - 3);
+			}
+		}
+		for(int r = 1; r <= 130; r++){
+			for(int c = 1; c <= 600; c++){
+				B.setValue(r, c, (3 * r + c) % 5 - 2);
+			}
+		}
+		Matrix<float> AB = A * B;
+		bool same = true;
+		for(int r = 1; r <= 70; r++){
+			for(int c = 1; c <= 600; c++){
+				float sum = 0;
+				for(int k = 1; k <= 130; k++){
+					sum += A.getValue(r, k) * B.getValue(k, c);
+				}
+				same = same && sum == AB.getValue(r, c);
+			}
+		}
+		EXPECT( same );
+	},
+
+	CASE("Dense and mixed precision solvers"){
+		float valA[9] = {
+				1,4,-3,
+				-2,8,5,
+				3,4,7
+		};
+		float valB[3] = {2, 11, 14};
+		float valX[3] = {1, 1, 1};
+		Matrix<float> A(3, 3, 0, 1, valA);
+		Matrix<float> B(3, 1, 0, 1, valB);
+		Matrix<float> X;
+		EXPECT( !solve(A, B, X) );
+		EXPECT( X == Matrix<float>(3, 1, 0, 1, valX) );
+
+		float valC[9] = {
+				1,2,3,
+				2,5,1,
+				1,3,-2
+		};
+		EXPECT( solve(Matrix<float>(3, 3, 0, 1, valC), B, X) );
+
+		//Mixed precision refinement reaches double precision accuracy
+		const int n = 150;
+		Matrix<double> D(n, n, 0, 1);
+		Matrix<double> E(n, 2, 0, 1);
+		for(int r = 1; r <= n; r++){
+			for(int c = 1; c <= n; c++){
+				D.setValue(r, c, std::sin(r * 0.37 + c * 1.3) + (r == c ? 4 : 0));
+			}
+			E.setValue(r, 1, std::cos(r * 0.1));
+			E.setValue(r, 2, r);
+		}
+		Matrix<double> Y;
+		RefinementResult result = solveMixedPrecision(D, E, Y);
+		EXPECT( result.converged );
+		EXPECT( !result.singular );
+		EXPECT( result.iterations > 0 );
+		EXPECT( result.residual < 1e-11 );
+
+		Matrix<double> Z;
+		EXPECT( !solve(D, E, Z) );
+		double difference = 0;
+		for(auto itY = Y.begin(), itZ = Z.begin(); itY != Y.end(); itY++, itZ++){
+			difference = std::max(difference, std::abs(*itY - *itZ));
+		}
+		EXPECT( difference < 1e-11 );
+	},
+
+	CASE("Low-rank updates of LU and Cholesky factorizations"){
+		const int n = 40;
+		Matrix<double> A(n, n, 0, 1), B(n, 2, 0, 1);
+		for(int r = 1; r <= n; r++){
+			for(int c = 1; c <= n; c++){
+				A.setValue(r, c, std::sin(r * 0.7 + c * 1.3) + (r == c ? 4 : 0));
+			}
+			B.setValue(r, 1, r);
+			B.setValue(r, 2, std::cos(r));
+		}
+		//max |A * X - B|
+		auto residual = [&](const Matrix<double>& M, const Matrix<double>& X){
+			Matrix<double> R = M * X;
+			double worst = 0;
+			for(int r = 1; r <= n; r++){
+				for(int c = 1; c <= int(X.getColumnsCount()); c++){
+					worst = std::max(worst, std::abs(R.getValue(r, c) - B.getValue(r, c)));
+				}
+			}
+			return worst;
+		};
+		Vector<double> x(n), y(n);
+		for(int i = 1; i <= n; i++){
+			x.setValue(i, std::cos(i * 0.3));
+			y.setValue(i, std::sin(i * 0.9) / 2);
+		}
+
+		LUFactorization<double> lu(A);
+		lu.update(x, y);
+		ger(1.0, x, y, A);
+		Matrix<double> X;
+		EXPECT( !lu.solve(B, X) );
+		EXPECT( residual(A, X) < 1e-10 );
+		EXPECT( lu.getMatrix() == A );
+
+		//downdate back, replace a row and a column
+		lu.update(x, Vector<double>(n, 0.0));
+		Vector<double> minusX(x);
+		axpy(-2.0, x, minusX);
+		lu.update(minusX, y);
+		ger(-1.0, x, y, A);
+		lu.replaceRow(7, y);
+		lu.replaceColumn(n, x);
+		for(int i = 1; i <= n; i++){
+			A.setValue(7, i, y.getValue(i));
+		}
+		for(int i = 1; i <= n; i++){
+			A.setValue(i, n, x.getValue(i));
+		}
+		EXPECT( lu.getMatrix() == A );
+		lu.solve(B, X);
+		EXPECT( residual(A, X) < 1e-10 );
+
+		//a bordered system
+		LUFactorization<double> small(Matrix<double>::identity(2, 2, 0, 1));
+		double column[2] = {1, 2}, row[2] = {3, 1};
+		small.append(Vector<double>(2, column), Vector<double>(2, row), 10);
+		double valBig[9] = {
+				1,0,1,
+				0,1,2,
+				3,1,10
+		};
+		double valRhs[3] = {2, 3, 14};
+		Matrix<double> Xs;
+		EXPECT( !small.solve(Matrix<double>(3, 1, 0, 1, valRhs), Xs) );
+		EXPECT( Xs == Matrix<double>(3, 1, 0, 1, 1.0) );
+		EXPECT( small.getMatrix() == Matrix<double>(3, 3, 0, 1, valBig) );
+		EXPECT( small.getRefactorizations() == 0u );
+
+		//an update that needs another row order factors again, an update to a singular matrix is detected
+		Vector<double> e1(2, 0.0), minusE1(2, 0.0);
+		e1.setValue(1, 1);
+		minusE1.setValue(1, -1);
+		double valP[4] = {
+				1,1,
+				1,2
+		};
+		LUFactorization<double> pivoting(Matrix<double>(2, 2, 0, 1, valP));
+		pivoting.update(e1, minusE1);
+		EXPECT( pivoting.getRefactorizations() == 1u );
+		double valRhs2[2] = {1, 3};
+		EXPECT( !pivoting.solve(Matrix<double>(2, 1, 0, 1, valRhs2), Xs) );
+		EXPECT( Xs.getValue(1, 1) == 1 );
+		EXPECT( Xs.getValue(2, 1) == 1 );
+		Vector<double> e2(2, 0.0);
+		e2.setValue(2, 1);
+		pivoting.replaceRow(2, e2);
+		pivoting.replaceRow(1, e2);
+		EXPECT( pivoting.isSingular() );
+		EXPECT_THROWS_AS( pivoting.replaceRow(3, e2), std::out_of_range );
+		EXPECT_THROWS_AS( pivoting.update(x, y), std::domain_error );
+
+		//Cholesky of A^T * A, updated, downdated and bordered
+		Matrix<double> S = A.gram();
+		CholeskyFactorization<double> cholesky(S);
+		cholesky.update(x);
+		ger(1.0, x, x, S);
+		cholesky.solve(B, X);
+		EXPECT( residual(S, X) < 1e-6 );
+		EXPECT( cholesky.downdate(x) );
+		ger(-1.0, x, x, S);
+		cholesky.solve(B, X);
+		EXPECT( residual(S, X) < 1e-6 );
+		TriangularMatrix<double> L = cholesky.getL();
+		Matrix<double> LLt = L.toDense() * L.toDense().transpose();
+		double worst = 0;
+		for(int i = 1; i <= n; i++){
+			for(int j = 1; j <= n; j++){
+				worst = std::max(worst, std::abs(LLt.getValue(i, j) - S.getValue(i, j)));
+			}
+		}
+		EXPECT( worst < 1e-9 );
+		//removing more than there is fails and changes nothing
+		Vector<double> tooMuch(n, 0.0);
+		tooMuch.setValue(3, std::sqrt(S.getValue(3, 3)) * 2);
+		EXPECT( !cholesky.downdate(tooMuch) );
+		cholesky.solve(B, X);
+		EXPECT( residual(S, X) < 1e-6 );
+		EXPECT( CholeskyFactorization<double>(SymmetricMatrix<double>::fromDense(S)).getL()
+				== CholeskyFactorization<double>(S).getL() );
+		EXPECT_THROWS_AS( CholeskyFactorization<double>(Matrix<double>(2, 2, 0, 1, valP) * -1.0), std::domain_error );
+
+		CholeskyFactorization<double> bordered(Matrix<double>::identity(2, 2, 0, 1) * 4.0);
+		double valColumn[2] = {2, 2};
+		EXPECT( !bordered.append(Vector<double>(2, valColumn), 2) );
+		EXPECT( bordered.getSize() == 2u );
+		EXPECT( bordered.append(Vector<double>(2, valColumn), 3) );
+		EXPECT( bordered.getL().getValue(3, 3) == 1 );
+		EXPECT( bordered.getL().getValue(3, 1) == 1 );
+
+		//Sherman-Morrison-Woodbury with the factorization of A
+		LUFactorization<double> base(A);
+		Matrix<double> U(n, 3, 0, 1), V(n, 3, 0, 1);
+		for(int r = 1; r <= n; r++){
+			for(int c = 1; c <= 3; c++){
+				U.setValue(r, c, std::cos(r * c * 0.1));
+				V.setValue(r, c, std::sin(r + c) / n);
+			}
+		}
+		Matrix<double> corrected = A + U * V.transpose();
+		EXPECT( !solveWoodbury(base, U, V, B, X) );
+		EXPECT( residual(corrected, X) < 1e-10 );
+		EXPECT( !solveWoodbury(cholesky, U, V, B, X) );
+		EXPECT( residual(S + U * V.transpose(), X) < 1e-6 );
+		EXPECT_THROWS_AS( solveWoodbury(base, U, B, B, X), std::domain_error );
+	},
+
+	CASE("Batched small matrix operations"){
+		const size_t count = 37, n = 3;
+		for(int layout = 0; layout < 2; layout++){
+			bool interleaved = layout == 1;
+			vector<double> valA(count * n * n), valB(count * n * n), valC(count * n * n), valX(count * n * n);
+			Batch<double> A = interleaved ? Batch<double>::interleaved(&valA[0], count, n, n) : Batch<double>::contiguous(&valA[0], count, n, n);
+			Batch<double> B = interleaved ? Batch<double>::interleaved(&valB[0], count, n, n) : Batch<double>::contiguous(&valB[0], count, n, n);
+			Batch<double> C = interleaved ? Batch<double>::interleaved(&valC[0], count, n, n) : Batch<double>::contiguous(&valC[0], count, n, n);
+			Batch<double> X = interleaved ? Batch<double>::interleaved(&valX[0], count, n, n) : Batch<double>::contiguous(&valX[0], count, n, n);
+			vector<Matrix<double>> matricesA, matricesB;
+			for(size_t b = 0; b < count; b++){
+				Matrix<double> MA(n, n, 0, 1), MB(n, n, 0, 1);
+				for(size_t i = 0; i < n; i++){
+					for(size_t j = 0; j < n; j++){
+						//matrix 5 is singular, its last row being the sum of the first two
+						MA.setValue(i + 1, j + 1, b == 5 && i == 2 ? std::sin(j + 1.0) + std::sin(j + 4.0) : std::sin(b + i * n + j + 1.0) + (i == j ? 2 : 0));
+						MB.setValue(i + 1, j + 1, std::cos(b * 0.5 + i + 2.0 * j));
+						A(b, i, j) = MA.getValue(i + 1, j + 1);
+						B(b, i, j) = MB.getValue(i + 1, j + 1);
+					}
+				}
+				matricesA.push_back(MA);
+				matricesB.push_back(MB);
+			}
+			for(size_t j = 0; j < n; j++){
+				matricesA[5].setValue(1, j + 1, std::sin(j + 1.0));
+				matricesA[5].setValue(2, j + 1, std::sin(j + 4.0));
+				A(5, 0, j) = std::sin(j + 1.0);
+				A(5, 1, j) = std::sin(j + 4.0);
+			}
+
+			batchMultiply(A, B, C);
+			vector<double> determinants(count);
+			batchDeterminant(A, &determinants[0]);
+			EXPECT( batchInverse(A, X) == 1u );
+			double difference = 0;
+			for(size_t b = 0; b < count; b++){
+				Matrix<double> product = matricesA[b] * matricesB[b];
+				for(size_t i = 0; i < n; i++){
+					for(size_t j = 0; j < n; j++){
+						difference = std::max(difference, std::abs(C(b, i, j) - product.getValue(i + 1, j + 1)));
+					}
+				}
+				difference = std::max(difference, std::abs(determinants[b] - matricesA[b].det()));
+				if(b != 5){
+					Matrix<double> inverse(n, n, 0, 1);
+					for(size_t i = 0; i < n; i++){
+						for(size_t j = 0; j < n; j++){
+							inverse.setValue(i + 1, j + 1, X(b, i, j));
+						}
+					}
+					Matrix<double> identity = matricesA[b] * inverse;
+					for(size_t i = 0; i < n; i++){
+						for(size_t j = 0; j < n; j++){
+							difference = std::max(difference, std::abs(identity.getValue(i + 1, j + 1) - (i == j ? 1 : 0)));
+						}
+					}
+				}
+			}
+			EXPECT( difference < 1e-10 );
+
+			//LU then solve matches the dense solver
+			vector<int32_t> pivots(count * n);
+			EXPECT( batchLU(A, &pivots[0]) == 1u );
+			batchSolve(A, &pivots[0], B);
+			difference = 0;
+			for(size_t b = 0; b < count; b++){
+				Matrix<double> expected;
+				if(b == 5 || solve(matricesA[b], matricesB[b], expected)){
+					continue;
+				}
+				for(size_t i = 0; i < n; i++){
+					for(size_t j = 0; j < n; j++){
+						difference = std::max(difference, std::abs(B(b, i, j) - expected.getValue(i + 1, j + 1)));
+					}
+				}
+			}
+			EXPECT( difference < 1e-10 );
+		}
+	},
+
+	CASE("Instrumentation counters and trace"){
+		instrumentation::reset();
+		instrumentation::startTrace();
+		Matrix<double> A(4, 4, 0, 1, 2.0);
+		Matrix<double> B = A * A;
+		Matrix<double> C = B.swapRows(1, 3);
+		Matrix<double> L, U;
+		C.toLU(L, U);
+		instrumentation::stopTrace();
+		B.transpose();
+
+		instrumentation::Snapshot snapshot = instrumentation::snapshot();
+		if(!instrumentation::enabled){
+			//built without -DOH_STRANG_PROFILE, the counters are checked by make test-profile
+			EXPECT( snapshot[instrumentation::MULTIPLY].calls == 0u );
+			ostringstream empty;
+			instrumentation::writeChromeTrace(empty);
+			EXPECT( empty.str() == "{\"traceEvents\":[]}\n" );
+			return;
+		}
+		EXPECT( snapshot[instrumentation::SWAP_ROWS].calls == 1u );
+		EXPECT( snapshot[instrumentation::TO_LU].calls == 1u );
+		EXPECT( snapshot[instrumentation::TRANSPOSE].calls == 2u );
+		//A * A, the permutation multiply hidden in swapRows and the ones inside toLU
+		EXPECT( snapshot[instrumentation::MULTIPLY].calls >= 3u );
+		EXPECT( snapshot[instrumentation::MULTIPLY].flops >= 2.0 * 3 * 4 * 4 * 4 );
+		EXPECT( snapshot[instrumentation::MULTIPLY].bytesAllocated >= 3 * 4 * 4 * sizeof(double) );
+		EXPECT( snapshot[instrumentation::TO_LU].seconds > 0 );
+		EXPECT( snapshot.toJson().find("\"swapRows\":{\"calls\":1,") != string::npos );
+
+		ostringstream trace;
+		instrumentation::writeChromeTrace(trace);
+		EXPECT( trace.str().find("{\"name\":\"toLU\",\"cat\":\"matrix\",\"ph\":\"X\"") != string::npos );
+		//one event per call while tracing, the last transpose is not in the trace
+		size_t events = 0;
+		for(size_t at = trace.str().find("\"ph\""); at != string::npos; at = trace.str().find("\"ph\"", at + 1)){
+			events++;
+		}
+		EXPECT( events + 1 == size_t(snapshot[instrumentation::TRANSPOSE].calls + snapshot[instrumentation::MULTIPLY].calls
+				+ snapshot[instrumentation::SWAP_ROWS].calls + snapshot[instrumentation::TO_LU].calls
+				+ snapshot[instrumentation::IDENTITY].calls + snapshot[instrumentation::PERMUTATION].calls
+				+ snapshot[instrumentation::COPY_ON_WRITE].calls) );
+
+		instrumentation::reset();
+		EXPECT( instrumentation::snapshot()[instrumentation::MULTIPLY].calls == 0u );
+	},
+
+	CASE("Kernel tuning parameters"){
+		//Heuristics from the cache sizes, with fallbacks when sysfs is missing
+		tuning::CacheSizes missing = tuning::detectCaches("no/such/directory");
+		EXPECT( missing.l1 == 0u );
+		tuning::KernelParameters fallback = tuning::heuristicParameters<double>(missing);
+		EXPECT( fallback.gemmBlockK == 128u );
+		EXPECT( fallback.gemmBlockN == 512u );
+		EXPECT( fallback.getrfBlock == 64u );
+		tuning::CacheSizes small = { 16 << 10, 256 << 10, 0 };
+		tuning::KernelParameters smallCaches = tuning::heuristicParameters<float>(small);
+		EXPECT( smallCaches.gemmBlockK * smallCaches.gemmBlockN * sizeof(float) <= small.l2 / 2 );
+
+		//Tuning file round-trip, the other types and unknown keys are ignored
+		tuning::KernelParameters tuned = { 64, 256, 4, 1000, 32, 300 };
+		{
+			ofstream out("tuning.txt");
+			out << "# comment\nfloat.gemmBlockK = 8\ndouble.unknown = 3\n";
+			tuning::writeConfig(out, "double", tuned);
+		}
+		tuning::KernelParameters read = fallback;
+		EXPECT( tuning::readConfig("tuning.txt", "double", read) );
+		EXPECT( read.gemmBlockK == 64u );
+		EXPECT( read.gemmBlockN == 256u );
+		EXPECT( read.gemmUnroll == 4u );
+		EXPECT( read.gemmParallelThreshold == 1000u );
+		EXPECT( read.getrfBlock == 32u );
+		EXPECT( read.strassenCutoff == 300u );
+		std::remove("tuning.txt");
+		EXPECT( !tuning::readConfig("tuning.txt", "double", read) );
+
+		//Every blocking and unrolling gives the same product
+		const size_t m = 37, n = 53, k = 71;
+		vector<double> A(m * k), B(k * n), expected(m * n, 1), C;
+		for(size_t i = 0; i < A.size(); i++){ A[i] = double(i % 7) - 3; }
+		for(size_t i = 0; i < B.size(); i++){ B[i] = double(i % 5) - 2; }
+		tuning::KernelParameters saved = tuning::parameters<double>();
+		tuning::parameters<double>() = tuned;
+		tuning::parameters<double>().gemmUnroll = 1;
+		kernels::gemm(m, n, k, 2.0, &A[0], k, &B[0], n, &expected[0], n);
+		const size_t unrolls[] = { 2, 4 };
+		const size_t blocks[] = { 1, 16, 100 };
+		bool same = true;
+		for(size_t unroll : unrolls){
+			for(size_t block : blocks){
+				tuning::parameters<double>().gemmUnroll = unroll;
+				tuning::parameters<double>().gemmBlockK = block;
+				tuning::parameters<double>().gemmBlockN = block + 7;
+				C.assign(m * n, 1);
+				kernels::gemm(m, n, k, 2.0, &A[0], k, &B[0], n, &C[0], n);
+				same = same && C == expected;
+			}
+		}
+		tuning::parameters<double>() = saved;
+		EXPECT( same );
+	},
+
+	CASE("Reduced row echelon form, rank and fundamental subspaces"){
+		double valA[12] = {
+				1,2,2,2,
+				2,4,6,8,
+				3,6,8,10
+		};
+		double valR[12] = {
+				1,2,0,-2,
+				0,0,1,2,
+				0,0,0,0
+		};
+		double valN[8] = {
+				-2,2,
+				1,0,
+				0,-2,
+				0,1
+		};
+		Matrix<double> A(3, 4, 0, 1, valA);
+		EchelonForm<Matrix<double>> form = A.echelon();
+		EXPECT( form.rank == 2u );
+		EXPECT( form.pivotColumns == vector<size_t>({1, 3}) );
+		EXPECT( form.R == Matrix<double>(3, 4, 0, 1, valR) );
+		EXPECT( form.nullSpace == Matrix<double>(4, 2, 0, 1, valN) );
+		EXPECT( form.columnSpace.getColumnsCount() == 2u );
+		EXPECT( form.columnSpace.getValue(3, 2) == 8 );
+		EXPECT( A * form.nullSpace == Matrix<double>(3, 2, 0, 1) );
+		EXPECT( A.rank() == 2u );
+
+		//Full rank: R is the identity and the null space is empty
+		double valB[9] = {
+				2,1,1,
+				4,-6,0,
+				-2,7,2
+		};
+		Matrix<double> B(3, 3, 0, 1, valB);
+		EXPECT( B.rref() == Matrix<double>::identity(3, 3, 0, 1) );
+		EXPECT( B.nullSpace().getColumnsCount() == 0u );
+
+		//The pivot tolerance is relative to the largest value
+		double valC[4] = {
+				1e10, 2e10,
+				1, 2 + 1e-6
+		};
+		Matrix<double> C(2, 2, 0, 1, valC);
+		EXPECT( C.rank() == 1u );
+		EXPECT( C.echelon(0).rank == 2u );
+		EXPECT( Matrix<double>(2, 3, 0, 1).rank() == 0u );
+
+		//Integral matrices are eliminated fraction free
+		int valD[4] = {
+				2, 4,
+				3, 6
+		};
+		int valN2[2] = {-2, 1};
+		Matrix<int> D(2, 2, 0, 1, valD);
+		EXPECT( D.rank() == 1u );
+		EXPECT( D.nullSpace() == Matrix<int>(2, 1, 0, 1, valN2) );
+		int valAi[12], valRi[12], valNi[8];
+		std::copy(valA, valA + 12, valAi);
+		std::copy(valR, valR + 12, valRi);
+		std::copy(valN, valN + 8, valNi);
+		Matrix<int> Ai(3, 4, 0, 1, valAi);
+		EXPECT( Ai.rank() == 2u );
+		EXPECT( Ai.rref() == Matrix<int>(3, 4, 0, 1, valRi) );
+		EXPECT( Ai.nullSpace() == Matrix<int>(4, 2, 0, 1, valNi) );
+		//reduced values that are not integers: R is truncated, the null space is scaled to stay exact
+		int valF[2] = {2, 3}, valFN[2] = {-3, 2};
+		Matrix<int> F(1, 2, 0, 1, valF);
+		EXPECT( F.rref().getValue(1, 2) == 1 );
+		EXPECT( F.nullSpace() == Matrix<int>(2, 1, 0, 1, valFN) );
+		EXPECT( F * F.nullSpace() == Matrix<int>(1, 1, 0, 1) );
+		int valG[9] = {
+				1000000007, 999999937, 2,
+				-999999929, 3, 1000000009,
+				5, 1000000021, -999999893
+		};
+		EXPECT_THROWS_AS( Matrix<int>(3, 3, 0, 1, valG).rank(), std::overflow_error );
+	},
+
+	CASE("Krylov solvers and preconditioners"){
+		//2D Poisson matrix on a 12 x 12 grid: sparse, symmetric positive definite
+		const size_t grid = 12, n = grid * grid;
+		Matrix<double> P(n, n, 0, 1);
+		for(size_t i = 0; i < n; i++){
+			P.setValue(i + 1, i + 1, 4);
+			if(i % grid != 0){ P.setValue(i + 1, i, -1); P.setValue(i, i + 1, -1); }
+			if(i >= grid){ P.setValue(i + 1, i + 1 - grid, -1); P.setValue(i + 1 - grid, i + 1, -1); }
+		}
+		//A non symmetric, diagonally dominant variation
+		Matrix<double> N = P;
+		for(size_t i = 1; i < n; i++){
+			N.setValue(i + 1, i, -1.5);
+		}
+		vector<double> b(n);
+		for(size_t i = 0; i < n; i++){ b[i] = std::sin(i * 0.3) + 1; }
+
+		CsrMatrix<double> sparseP = CsrMatrix<double>::fromDense(P);
+		CsrMatrix<double> sparseN = CsrMatrix<double>::fromDense(N);
+		EXPECT( sparseP.values.size() == 5 * n - 4 * grid );
+		DenseOperator<double> denseP(P);
+		KrylovOptions<double> options = defaultKrylovOptions<double>();
+		options.relativeTolerance = 1e-10;
+		KrylovWorkspace<double> workspace;
+
+		auto error = [&](const Matrix<double>& A, const vector<double>& x){
+			vector<double> r(n);
+			DenseOperator<double>(A).apply(&x[0], &r[0]);
+			double worst = 0;
+			for(size_t i = 0; i < n; i++){ worst = std::max(worst, std::abs(r[i] - b[i])); }
+			return worst;
+		};
+
+		//Every preconditioner with every solver
+		IdentityPreconditioner<double> none(n);
+		JacobiPreconditioner<double> jacobiP(sparseP), jacobiN(sparseN);
+		ILU0Preconditioner<double> iluP(sparseP), iluN(sparseN);
+		SSORPreconditioner<double> ssorP(sparseP, 1.2), ssorN(sparseN);
+		size_t plain = 0, preconditioned = 0;
+		{
+			vector<double> x(n, 0);
+			KrylovResult result = conjugateGradient(denseP, &b[0], &x[0], none, options, workspace);
+			EXPECT( result.converged );
+			EXPECT( error(P, x) < 1e-8 );
+			plain = result.iterations;
+		}
+		{
+			vector<double> x(n, 0);
+			KrylovResult result = conjugateGradient(sparseP, &b[0], &x[0], iluP, options, workspace);
+			EXPECT( result.converged );
+			EXPECT( error(P, x) < 1e-8 );
+			preconditioned = result.iterations;
+		}
+		EXPECT( preconditioned < plain );
+		{
+			vector<double> x(n, 0);
+			EXPECT( conjugateGradient(sparseP, &b[0], &x[0], ssorP, options, workspace).converged );
+			EXPECT( error(P, x) < 1e-8 );
+			x.assign(n, 0);
+			EXPECT( conjugateGradient(denseP, &b[0], &x[0], JacobiPreconditioner<double>(denseP), options).converged );
+			EXPECT( error(P, x) < 1e-8 );
+		}
+		const size_t bytes = workspace.bytes();
+		{
+			vector<double> x(n, 0);
+			EXPECT( bicgstab(sparseN, &b[0], &x[0], jacobiN, options, workspace).converged );
+			EXPECT( error(N, x) < 1e-8 );
+			x.assign(n, 0);
+			EXPECT( bicgstab(sparseN, &b[0], &x[0], iluN, options, workspace).converged );
+			EXPECT( error(N, x) < 1e-8 );
+		}
+		{
+			options.restart = 10;
+			vector<double> x(n, 0);
+			KrylovResult result = gmres(sparseP, &b[0], &x[0], none, options, workspace);
+			EXPECT( result.converged );
+			EXPECT( result.iterations > options.restart );
+			EXPECT( error(P, x) < 1e-8 );
+			x.assign(n, 0);
+			EXPECT( gmres(sparseN, &b[0], &x[0], ssorN, options, workspace).converged );
+			EXPECT( error(N, x) < 1e-8 );
+			const size_t gmresBytes = workspace.bytes();
+			x.assign(n, 0);
+			EXPECT( gmres(sparseN, &b[0], &x[0], iluN, options, workspace).converged );
+			EXPECT( error(N, x) < 1e-8 );
+			//the workspace is only allocated by the first call needing it
+			EXPECT( workspace.bytes() == gmresBytes );
+			EXPECT( gmresBytes >= bytes );
+		}
+
+		//Matrix-free operator, and the iteration limit
+		CallbackOperator<double> callback(n, [&](const double* x, double* y){ sparseP.apply(x, y); });
+		vector<double> x(n, 0);
+		options.maxIterations = 3;
+		KrylovResult limited = conjugateGradient(callback, &b[0], &x[0], jacobiP, options, workspace);
+		EXPECT( !limited.converged );
+		EXPECT( limited.iterations == 3u );
+		options.maxIterations = 1000;
+		EXPECT( conjugateGradient(callback, &b[0], &x[0], jacobiP, options, workspace).converged );
+		EXPECT( error(P, x) < 1e-8 );
+	},
+
+	CASE("Exact modular, fraction-free and multi-modular elimination"){
+		typedef ModInt<998244353> F;
+		const std::uint64_t p = 998244353;
+		F a(123456789), b(-987654321);
+		EXPECT( a.value() == 123456789u );
+		EXPECT( b.value() == p - 987654321 );
+		EXPECT( (a * b).value() == 123456789ull * (p - 987654321) % p );
+		EXPECT( (a + b).value() == (123456789ull + p - 987654321) % p );
+		EXPECT( (a - a) == F(0) );
+		EXPECT( (a * a.inverse()) == F(1) );
+		EXPECT( (b / a * a) == b );
+
+		//Matrix<ModInt<P>> goes through the generic operations
+		const size_t n = 6;
+		Matrix<F> M(n, n, 0, 1);
+		Matrix<long long> I(n, n, 0, 1);
+		for(size_t i = 1; i <= n; i++){
+			for(size_t j = 1; j <= n; j++){
+				long long v = (long long)((i * 7 + j * j * 3) % 11) - 5 + (i == j ? 9 : 0);
+				M.setValue(i, j, F(v));
+				I.setValue(i, j, v);
+			}
+		}
+		EXPECT( modularDeterminant(M) == M.det() );
+		EXPECT( modularDeterminant(M * M) == M.det() * M.det() );
+		EXPECT( modularRank(M) == n );
+		long long exact = bareissDeterminant(I);
+		EXPECT( modularDeterminant(M) == F(exact) );
+		EXPECT( multiModularDeterminant(I).toString() == std::to_string(exact) );
+
+		//Bareiss on small known matrices, and the rank of a deficient one
+		long long known[] = { 2, -3, 1, 2, 0, -1, 1, 4, 5 };
+		Matrix<long long> K(3, 3, 0, 1, known);
+		EXPECT( bareissDeterminant(K) == 49 );
+		long long deficient[] = { 1, 2, 3, 4, 2, 4, 6, 8, 1, 0, 1, 0 };
+		Matrix<long long> D(3, 4, 0, 1, deficient);
+		EXPECT( bareissRank(D) == 2u );
+		Matrix<F> DF(3, 4, 0, 1);
+		for(size_t i = 1; i <= 3; i++){
+			for(size_t j = 1; j <= 4; j++){
+				DF.setValue(i, j, F(D.getValue(i, j)));
+			}
+		}
+		EXPECT( modularRank(DF) == 2u );
+
+		//Determinants beyond 64 bits, rebuilt from several primes
+		Matrix<long long> U(4, 4, 0, 1);
+		for(size_t i = 1; i <= 4; i++){
+			for(size_t j = i; j <= 4; j++){
+				U.setValue(i, j, i == j ? 1000000000 : (long long)(i * 31 + j * 17));
+			}
+		}
+		EXPECT( multiModularDeterminant(U).toString() == "1000000000000000000000000000000000000" );
+		U = U.swapRows(1, 2);
+		EXPECT( multiModularDeterminant(U).toString() == "-1000000000000000000000000000000000000" );
+		EXPECT( multiModularDeterminant(U).toDouble() == -1e36 );
+
+		//Hilbert matrices: det H4 = 1/6048000, det H5 = 1/266716800000
+		for(size_t size = 4; size <= 5; size++){
+			Matrix<long long> numerators(size, size, 0, 1), denominators(size, size, 0, 1);
+			for(size_t i = 1; i <= size; i++){
+				for(size_t j = 1; j <= size; j++){
+					numerators.setValue(i, j, 1);
+					denominators.setValue(i, j, i + j - 1);
+				}
+			}
+			EXPECT( multiModularDeterminant(numerators, denominators).toString() == (size == 4 ? "1/6048000" : "1/266716800000") );
+		}
+		long long halves[] = { 1, 1, 1, 3 }, twos[] = { 2, 2, 2, 2 };
+		Matrix<long long> N2(2, 2, 0, 1, halves), D2(2, 2, 0, 1, twos);
+		EXPECT( multiModularDeterminant(N2, D2).toString() == "1/2" );
+		//the sign is kept while the factors D are divided out
+		long long minusOne[] = { -1 }, two[] = { 2 };
+		EXPECT( multiModularDeterminant(Matrix<long long>(1, 1, 0, 1, minusOne), Matrix<long long>(1, 1, 0, 1, two)).toString() == "-1/2" );
+		long long diagonal[] = { -1, 0, 0, 0, 1, 0, 0, 0, 1 }, threes[] = { 3, 3, 3, 3, 3, 3, 3, 3, 3 };
+		Matrix<long long> N3(3, 3, 0, 1, diagonal), D3(3, 3, 0, 1, threes);
+		EXPECT( multiModularDeterminant(N3, D3).toString() == "-1/27" );
+		long long large[] = { LLONG_MIN / 2, 1, 1, 1 }, thirds[] = { 1, 3, 3, 3 };
+		EXPECT_THROWS_AS( multiModularDeterminant(Matrix<long long>(2, 2, 0, 1, large), Matrix<long long>(2, 2, 0, 1, thirds)), std::overflow_error );
+	},
+
+	CASE("Structured storage: triangular, symmetric, banded and diagonal"){
+		const size_t n = 7, nrhs = 3;
+		Matrix<double> A(n, n, 0, 1), B(n, nrhs, 0, 1);
+		for(size_t i = 1; i <= n; i++){
+			for(size_t j = 1; j <= n; j++){
+				A.setValue(i, j, std::sin(i * 1.3 + j * 0.7) + (i == j ? 4 : 0));
+			}
+			for(size_t j = 1; j <= nrhs; j++){
+				B.setValue(i, j, std::cos(i + 2.0 * j));
+			}
+		}
+		auto difference = [](const Matrix<double>& X, const Matrix<double>& Y){
+			double largest = 0;
+			for(auto x = X.begin(), y = Y.begin(); x != X.end(); x++, y++){
+				largest = std::max(largest, std::abs(*x - *y));
+			}
+			return largest;
+		};
+
+		//Triangles: TRMM, TRSM and determinant against the dense matrix
+		for(int variant = 0; variant < 4; variant++){
+			bool lower = variant % 2 == 0, unit = variant >= 2;
+			TriangularMatrix<double> T = TriangularMatrix<double>::fromDense(A, lower, unit);
+			Matrix<double> dense = T.toDense();
+			EXPECT( T.getStoredCount() == n * (n + 1) / 2 );
+			EXPECT( T.getValue(lower ? 1 : n, lower ? n : 1) == 0 );
+			EXPECT( T.getValue(2, 2) == (unit ? 1 : A.getValue(2, 2)) );
+			EXPECT( difference(T * B, dense * B) < 1e-12 );
+			Matrix<double> X;
+			EXPECT( !T.solve(B, X) );
+			EXPECT( difference(dense * X, B) < 1e-12 );
+			EXPECT( std::abs(T.det() - dense.det()) < 1e-9 );
+			EXPECT( T.transpose().toDense() == dense.transpose() );
+		}
+		TriangularMatrix<double> U(3, false, 0, 1);
+		EXPECT_THROWS_AS( U.setValue(3, 1, 2.0), std::out_of_range );
+		U.setValue(3, 1, 0.0);
+		U.setValue(1, 3, 2.0);
+		EXPECT( U.getValue(1, 3) == 2 );
+		Matrix<double> X;
+		EXPECT( U.solve(Matrix<double>(3, 1, 0, 1, 1.0), X) );
+		TriangularMatrix<double> unitLower(3, true, 0, 1, true);
+		EXPECT_THROWS_AS( unitLower.setValue(2, 2, 3.0), std::out_of_range );
+
+		//Symmetric: L * D * L^T, and the fallback of an indefinite matrix with a zero pivot
+		Matrix<double> spd = A.transpose() * A;
+		SymmetricMatrix<double> S = SymmetricMatrix<double>::fromDense(spd);
+		EXPECT( S.getValue(2, 5) == S.getValue(5, 2) );
+		EXPECT( difference(S * B, spd * B) < 1e-12 );
+		EXPECT( !S.solve(B, X) );
+		EXPECT( difference(spd * X, B) < 1e-10 );
+		EXPECT( std::abs(S.det() / spd.det() - 1) < 1e-9 );
+		SymmetricMatrix<double> swap(2, 0, 1);
+		swap.setValue(1, 2, 1.0);
+		Matrix<double> b2(2, 1, 0, 1);
+		b2.setValue(1, 1, 3);
+		b2.setValue(2, 1, 5);
+		EXPECT( !swap.solve(b2, X) );
+		EXPECT( X.getValue(1, 1) == 5 );
+		EXPECT( X.getValue(2, 1) == 3 );
+		EXPECT( swap.det() == -1 );
+
+		//Bands: Thomas for the tridiagonal ones, pivoting banded LU otherwise
+		for(size_t kl = 0; kl <= 2; kl++){
+			for(size_t ku = 0; ku <= 2; ku++){
+				BandedMatrix<double> band = BandedMatrix<double>::fromDense(A, kl, ku);
+				Matrix<double> dense = band.toDense();
+				EXPECT( band.getStoredCount() == n * (kl + ku + 1) );
+				EXPECT( band.getValue(n, 1) == 0 );
+				EXPECT( difference(band * B, dense * B) < 1e-12 );
+				EXPECT( !band.solve(B, X) );
+				EXPECT( difference(dense * X, B) < 1e-10 );
+				EXPECT( std::abs(band.det() - dense.det()) < 1e-9 * std::abs(dense.det()) );
+			}
+		}
+		//the first pivot of this tridiagonal matrix is zero
+		double zeroPivot[] = { 0, 2, 0, 1, 1, 3, 0, 4, 1 };
+		Matrix<double> Z(3, 3, 0, 1, zeroPivot);
+		BandedMatrix<double> tridiagonal = BandedMatrix<double>::fromDense(Z, 1, 1);
+		Matrix<double> b3(3, 1, 0, 1, 1.0);
+		EXPECT( !tridiagonal.solve(b3, X) );
+		EXPECT( difference(Z * X, b3) < 1e-14 );
+		EXPECT( std::abs(tridiagonal.det() + 2) < 1e-14 );
+
+		//Diagonal
+		DiagonalMatrix<double> D = DiagonalMatrix<double>::fromDense(A);
+		EXPECT( D.getStoredCount() == n );
+		EXPECT( difference(D * B, D.toDense() * B) == 0 );
+		EXPECT( !D.solve(B, X) );
+		EXPECT( difference(D * X, B) < 1e-14 );
+		EXPECT( std::abs(D.det() - D.toDense().det()) < 1e-9 );
+
+		//LU with triangular factors: P * A = L * U
+		vector<size_t> rows;
+		TriangularMatrix<double> L, R;
+		EXPECT( !A.toLU(rows, L, R) );
+		EXPECT( L.isLower() );
+		EXPECT( L.isUnitDiagonal() );
+		EXPECT( !R.isLower() );
+		Matrix<double> PA(n, n, 0, 1);
+		for(size_t i = 1; i <= n; i++){
+			for(size_t j = 1; j <= n; j++){
+				PA.setValue(i, j, A.getValue(rows[i - 1], j));
+			}
+		}
+		EXPECT( difference(L * R.toDense(), PA) < 1e-12 );
+		EXPECT( Z.toLU(rows, L, R) == false );
+		EXPECT( Matrix<double>(3, 3, 0, 1, 1.0).toLU(rows, L, R) );
+	},
+
+	CASE("Gram matrices with the symmetric rank k update"){
+		for(size_t rows : { 1, 5, 37, 130 }){
+			for(size_t columns : { 1, 4, 29, 70 }){
+				Matrix<double> A(rows, columns, 0, 1);
+				for(size_t i = 1; i <= rows; i++){
+					for(size_t j = 1; j <= columns; j++){
+						A.setValue(i, j, std::sin(i * 0.9 + j * 1.7));
+					}
+				}
+				Matrix<double> gram = A.gram(), outer = A.outerGram();
+				Matrix<double> expectedGram = A.transpose() * A, expectedOuter = A * A.transpose();
+				EXPECT( gram.getRowsCount() == columns );
+				EXPECT( outer.getRowsCount() == rows );
+				double largest = 0;
+				for(auto g = gram.begin(), e = expectedGram.begin(); g != gram.end(); g++, e++){
+					largest = std::max(largest, std::abs(*g - *e));
+				}
+				for(auto g = outer.begin(), e = expectedOuter.begin(); g != outer.end(); g++, e++){
+					largest = std::max(largest, std::abs(*g - *e));
+				}
+				EXPECT( largest < 1e-11 );
+				//exactly symmetric
+				EXPECT( gram.transpose().getValue(columns, 1) == gram.getValue(columns, 1) );
+				EXPECT( SymmetricMatrix<double>::gram(A).toDense() == gram );
+				EXPECT( SymmetricMatrix<double>::gram(A, true).toDense() == outer );
+			}
+		}
+		//the same values on several threads
+		tuning::KernelParameters saved = tuning::parameters<double>();
+		tuning::parameters<double>().gemmParallelThreshold = 1;
+		Matrix<double> A(200, 90, 0, 1);
+		for(size_t i = 0; i < 200 * 90; i++){
+			A.getValues()[i] = std::cos(i * 0.37);
+		}
+		Matrix<double> threaded = A.gram(), threadedOuter = A.outerGram();
+		tuning::parameters<double>() = saved;
+		EXPECT( threaded == A.gram() );
+		EXPECT( threadedOuter == A.outerGram() );
+	},
+
+	CASE("Vectors and matrix-vector kernels"){
+		const size_t m = 45, n = 31;
+		Matrix<double> A(m, n, 0, 1);
+		for(size_t i = 1; i <= m; i++){
+			for(size_t j = 1; j <= n; j++){
+				A.setValue(i, j, std::sin(i * 0.3 + j * 1.1));
+			}
+		}
+		Vector<double> x(n), z(m);
+		Matrix<double> X(n, 1, 0, 1), Z(m, 1, 0, 1);
+		for(size_t j = 1; j <= n; j++){
+			x.setValue(j, std::cos(j * 0.5));
+			X.setValue(j, 1, x.getValue(j));
+		}
+		for(size_t i = 1; i <= m; i++){
+			z.setValue(i, std::cos(i * 0.2));
+			Z.setValue(i, 1, z.getValue(i));
+		}
+
+		//GEMV and GEMV^T against the matrix products
+		Vector<double> y = A * x, w = transposeMultiply(A, z);
+		Matrix<double> Y = A * X, W = A.transpose() * Z;
+		EXPECT( y.getSize() == m );
+		EXPECT( w.getSize() == n );
+		double largest = 0;
+		for(size_t i = 1; i <= m; i++){
+			largest = std::max(largest, std::abs(y.getValue(i) - Y.getValue(i, 1)));
+		}
+		for(size_t j = 1; j <= n; j++){
+			largest = std::max(largest, std::abs(w.getValue(j) - W.getValue(j, 1)));
+		}
+		EXPECT( largest < 1e-13 );
+
+		//Views on the matrix, without copies
+		VectorView<double> column = columnOf(A, 3), row = rowOf(A, 2), diagonal = diagonalOf(A);
+		EXPECT( column.getSize() == m );
+		EXPECT( column.getStride() == n );
+		EXPECT( column.getValue(5) == A.getValue(5, 3) );
+		EXPECT( row.getValue(4) == A.getValue(2, 4) );
+		EXPECT( diagonal.getSize() == n );
+		EXPECT( diagonal.getValue(7) == A.getValue(7, 7) );
+		EXPECT( std::abs(dot(row, x) - y.getValue(2)) < 1e-13 );
+		EXPECT( std::abs(dot(column, z) - w.getValue(3)) < 1e-13 );
+		column.setValue(1, 42.0);
+		EXPECT( A.getValue(1, 3) == 42 );
+		VectorView<double> odd = x.slice(1, (n + 1) / 2, 2);
+		EXPECT( odd.getValue(3) == x.getValue(5) );
+		EXPECT_THROWS_AS( x.slice(2, n, 1), std::out_of_range );
+
+		//axpy, norms, outer product
+		Vector<double> v(3), u(3);
+		v.setValue(1, 3);
+		v.setValue(2, -4);
+		u.setValue(1, 1);
+		u.setValue(3, 2);
+		EXPECT( norm2(v) == 5 );
+		EXPECT( norm1(v) == 7 );
+		EXPECT( normInf(v) == 4 );
+		axpy(2.0, u, v);
+		EXPECT( v.getValue(1) == 5 );
+		EXPECT( v.getValue(3) == 4 );
+		Matrix<double> O = outer(u, v);
+		EXPECT( O.getRowsCount() == 3 );
+		EXPECT( O.getValue(3, 1) == 10 );
+		EXPECT( O.getValue(2, 2) == 0 );
+		Vector<double> huge(2, 1e300), tiny(2, 1e-300);
+		EXPECT( std::abs(norm2(huge) / (std::sqrt(2.0) * 1e300) - 1) < 1e-15 );
+		EXPECT( std::abs(norm2(tiny) / (std::sqrt(2.0) * 1e-300) - 1) < 1e-15 );
+
+		//Long vectors and large matrices over several threads give the same values
+		tuning::KernelParameters saved = tuning::parameters<double>();
+		const size_t big = 100000;
+		Vector<double> a(big), b(big);
+		for(size_t i = 1; i <= big; i++){
+			a.setValue(i, std::sin(i * 0.01));
+			b.setValue(i, std::cos(i * 0.03));
+		}
+		double serial = dot(a, b);
+		Vector<double> ySerial = A * x, wSerial = transposeMultiply(A, z);
+		tuning::parameters<double>().gemmParallelThreshold = 1;
+		EXPECT( dot(a, b) == serial );
+		EXPECT( (A * x) == ySerial );
+		EXPECT( transposeMultiply(A, z) == wSerial );
+		tuning::parameters<double>() = saved;
+	},
+
+	CASE("Strassen-Winograd multiplication"){
+		tuning::KernelParameters saved = tuning::parameters<double>();
+		tuning::parameters<double>().strassenCutoff = 8;
+		for(size_t n : { 1, 2, 7, 16, 33, 64, 75 }){
+			Matrix<double> A(n, n, 0, 1), B(n, n, 0, 1);
+			for(size_t i = 0; i < n * n; i++){
+				A.getValues()[i] = std::sin(i * 0.61);
+				B.getValues()[i] = std::cos(i * 0.29);
+			}
+			StrassenReport report;
+			Matrix<double> fast = strassenMultiply(A, B, &report), classical = A * B;
+			double largest = 0;
+			for(auto f = fast.begin(), c = classical.begin(); f != fast.end(); f++, c++){
+				largest = std::max(largest, std::abs(*f - *c));
+			}
+			EXPECT( report.levels == strassenLevels(n, 8) );
+			EXPECT( report.leafOrder <= 8u );
+			EXPECT( largest <= report.errorBound + report.classicalErrorBound );
+			EXPECT( report.errorBound >= report.classicalErrorBound );
+			EXPECT( largest < 1e-11 );
+		}
+
+		//A capped workspace gives up levels of recursion, not the product
+		const size_t n = 64;
+		Matrix<double> A(n, n, 0, 1), B(n, n, 0, 1);
+		for(size_t i = 0; i < n * n; i++){
+			A.getValues()[i] = double(i % 13) - 6;
+			B.getValues()[i] = double(i % 11) - 5;
+		}
+		StrassenWorkspace<double> capped(2 * 32 * 32 * sizeof(double));
+		StrassenReport report;
+		Matrix<double> product = strassenMultiply(A, B, capped, &report);
+		EXPECT( report.levels == 1u );
+		EXPECT( capped.bytes() <= capped.getMaxBytes() );
+		EXPECT( product == A * B );
+		StrassenWorkspace<double> unbounded;
+		EXPECT( strassenMultiply(A, B, unbounded, &report) == A * B );
+		EXPECT( report.levels == 3u );
+		EXPECT( report.workspaceBytes == kernels::strassenWorkspace(n, 3) * sizeof(double) );
+		tuning::parameters<double>() = saved;
+	},
+
 };
 
 int main( int argc, char * argv[] )